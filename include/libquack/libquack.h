@@ -104,6 +104,12 @@ extern "C" {
         QU_BLEND_SRC_ALPHA, QU_BLEND_ONE, QU_BLEND_ADD, \
     }
 
+#define QU_BLEND_MODE_PREMULTIPLIED \
+    QU_COMPOUND(qu_blend_mode) { \
+        QU_BLEND_ONE, QU_BLEND_ONE_MINUS_SRC_ALPHA, QU_BLEND_ADD, \
+        QU_BLEND_ONE, QU_BLEND_ONE_MINUS_SRC_ALPHA, QU_BLEND_ADD, \
+    }
+
 #define QU_BLEND_MODE_MUL \
     QU_COMPOUND(qu_blend_mode) { \
         QU_BLEND_ZERO, QU_BLEND_SRC_COLOR, QU_BLEND_ADD, \
@@ -257,6 +263,8 @@ typedef enum qu_texture_flags
 {
     QU_TEXTURE_SMOOTH = (1 << 0),
     QU_TEXTURE_REPEAT = (1 << 1),
+    QU_TEXTURE_TRIM = (1 << 2),     /*!< Draw as a tight mesh around opaque texels */
+    QU_TEXTURE_SDF = (1 << 3),      /*!< Alpha is a signed distance field, edge at 0.5 */
 } qu_texture_flags;
 
 typedef enum qu_blend_factor
@@ -338,6 +346,73 @@ typedef struct qu_texture
     qu_handle id;
 } qu_texture;
 
+typedef struct qu_tilemap
+{
+    qu_handle id;
+} qu_tilemap;
+
+typedef struct qu_emitter
+{
+    qu_handle id;
+} qu_emitter;
+
+typedef struct qu_virtual_texture
+{
+    qu_handle id;
+} qu_virtual_texture;
+
+typedef struct qu_font
+{
+    qu_handle id;
+} qu_font;
+
+typedef struct qu_scene
+{
+    qu_handle id;
+} qu_scene;
+
+typedef enum qu_text_align
+{
+    QU_ALIGN_LEFT,
+    QU_ALIGN_CENTER,
+    QU_ALIGN_RIGHT,
+} qu_text_align;
+
+/**
+ * Initial state of a particle. Color is interpolated from `start_color`
+ * to `end_color` over its lifetime.
+ */
+typedef struct qu_particle
+{
+    qu_vec2f position;
+    qu_vec2f velocity;
+    float size;
+    float lifetime;             /*!< Lifetime in seconds */
+    qu_color start_color;
+    qu_color end_color;
+} qu_particle;
+
+typedef struct qu_emitter_stats
+{
+    int count;                  /*!< Live particles */
+    double update_time;         /*!< Time spent in the last update, in seconds */
+    double submit_time;         /*!< Time spent in the last draw, in seconds */
+} qu_emitter_stats;
+
+typedef struct qu_graphics_stats
+{
+    int peak_vertices;          /*!< Most vertices submitted at once */
+    int peak_commands;          /*!< Most render commands submitted at once */
+    int flush_count;            /*!< Mid-frame flushes due to the high-water mark */
+    size_t texture_memory;      /*!< Bytes of texture data held by the backend */
+    int texture_evictions;      /*!< Textures evicted to stay within the budget */
+    float render_scale;         /*!< Current render resolution relative to the window */
+    double gpu_frame_time;      /*!< GPU time of a recent frame in seconds, 0 if unknown */
+    int frame_count;            /*!< Frames ended with qu_present() */
+    int skipped_frames;         /*!< Frames not drawn because nothing changed */
+    float redraw_area;          /*!< Part of the window redrawn in the last frame */
+} qu_graphics_stats;
+
 typedef struct qu_blend_mode
 {
     qu_blend_factor color_src_factor;
@@ -403,8 +478,17 @@ QU_API void QU_CALL qu_destroy_image(qu_image image);
 QU_API qu_vec2i QU_CALL qu_get_image_size(qu_image image);
 QU_API qu_pixel_format QU_CALL qu_get_image_format(qu_image image);
 QU_API unsigned char * QU_CALL qu_get_image_pixels(qu_image image);
+QU_API qu_image QU_CALL qu_convert_image(qu_image image, qu_pixel_format format);
+QU_API void QU_CALL qu_flip_image(qu_image image);
+QU_API void QU_CALL qu_premultiply_image(qu_image image);
+QU_API void QU_CALL qu_unpremultiply_image(qu_image image);
+QU_API void QU_CALL qu_blit_image(qu_image dst, qu_image src, int x, int y, qu_blend_mode mode);
+QU_API bool QU_CALL qu_save_image_qoi(qu_image image, char const *path);
 
 QU_API void QU_CALL qu_set_default_texture_flags(unsigned int flags);
+QU_API void QU_CALL qu_set_premultiplied_alpha(bool enabled);
+QU_API void QU_CALL qu_set_texture_downscale(int factor);
+QU_API void QU_CALL qu_set_texture_residency(bool release_pixels, size_t budget);
 QU_API qu_texture QU_CALL qu_load_texture_from_file(char const *path);
 QU_API qu_texture QU_CALL qu_load_texture_from_buffer(void *buffer, size_t size);
 QU_API qu_texture QU_CALL qu_load_texture_from_image(qu_image image);
@@ -418,10 +502,69 @@ QU_API void QU_CALL qu_draw_texture_r(qu_texture texture, qu_rectf rect);
 QU_API void QU_CALL qu_draw_subtexture(qu_texture texture, float x, float y, float w, float h, float s, float t, float u, float v);
 QU_API void QU_CALL qu_draw_subtexture_r(qu_texture texture, qu_rectf rect, qu_rectf sub);
 
+QU_API qu_tilemap QU_CALL qu_create_tilemap(qu_texture tileset, int tile_width, int tile_height, int width, int height);
+QU_API void QU_CALL qu_destroy_tilemap(qu_tilemap tilemap);
+QU_API int QU_CALL qu_get_tile(qu_tilemap tilemap, int x, int y);
+QU_API void QU_CALL qu_set_tile(qu_tilemap tilemap, int x, int y, int tile);
+QU_API void QU_CALL qu_draw_tilemap(qu_tilemap tilemap, float x, float y);
+
+QU_API qu_emitter QU_CALL qu_create_emitter(qu_texture texture, int capacity);
+QU_API qu_emitter QU_CALL qu_create_gpu_emitter(qu_texture texture, int capacity);
+QU_API void QU_CALL qu_destroy_emitter(qu_emitter emitter);
+QU_API void QU_CALL qu_set_emitter_gravity(qu_emitter emitter, float x, float y);
+QU_API void QU_CALL qu_emit_particle(qu_emitter emitter, qu_particle const *particle);
+QU_API void QU_CALL qu_update_emitter(qu_emitter emitter, float dt);
+QU_API void QU_CALL qu_draw_emitter(qu_emitter emitter);
+QU_API qu_emitter_stats QU_CALL qu_get_emitter_stats(qu_emitter emitter);
+
+QU_API bool QU_CALL qu_save_virtual_texture(qu_image image, char const *path, int tile_size);
+QU_API qu_virtual_texture QU_CALL qu_load_virtual_texture(char const *path);
+QU_API void QU_CALL qu_destroy_virtual_texture(qu_virtual_texture texture);
+QU_API qu_vec2i QU_CALL qu_get_virtual_texture_size(qu_virtual_texture texture);
+QU_API void QU_CALL qu_draw_virtual_texture(qu_virtual_texture texture, float x, float y, float w, float h);
+QU_API void QU_CALL qu_draw_virtual_subtexture(qu_virtual_texture texture, float x, float y, float w, float h, float s, float t, float u, float v);
+
+QU_API qu_font QU_CALL qu_load_font(char const *path);
+QU_API void QU_CALL qu_destroy_font(qu_font font);
+QU_API qu_vec2f QU_CALL qu_measure_text(qu_font font, float width, float scale, char const *text);
+QU_API void QU_CALL qu_draw_text(qu_font font, float x, float y, qu_color color, char const *text);
+QU_API void QU_CALL qu_draw_text_block(qu_font font, float x, float y, float width, float scale, qu_text_align align, qu_color color, char const *text);
+
+QU_API qu_scene QU_CALL qu_create_scene(float cell_size);
+QU_API void QU_CALL qu_destroy_scene(qu_scene scene);
+QU_API int QU_CALL qu_add_sprite(qu_scene scene, qu_texture texture, float x, float y, float w, float h);
+QU_API void QU_CALL qu_remove_sprite(qu_scene scene, int sprite);
+QU_API void QU_CALL qu_set_sprite_parent(qu_scene scene, int sprite, int parent);
+QU_API void QU_CALL qu_set_sprite_position(qu_scene scene, int sprite, float x, float y);
+QU_API void QU_CALL qu_set_sprite_transform(qu_scene scene, int sprite, float x, float y, float rotation, float scale_x, float scale_y);
+QU_API void QU_CALL qu_set_sprite_subrect(qu_scene scene, int sprite, float s, float t, float u, float v);
+QU_API void QU_CALL qu_set_sprite_color(qu_scene scene, int sprite, qu_color color);
+QU_API void QU_CALL qu_set_sprite_order(qu_scene scene, int sprite, int order);
+QU_API void QU_CALL qu_set_sprite_visible(qu_scene scene, int sprite, bool visible);
+QU_API void QU_CALL qu_draw_scene(qu_scene scene, float x, float y);
+
 QU_API qu_image QU_CALL qu_capture_screen(void);
 
 QU_API void QU_CALL qu_set_blend_mode(qu_blend_mode mode);
 
+QU_API void QU_CALL qu_push_clip_rect(int x, int y, int w, int h);
+QU_API void QU_CALL qu_pop_clip_rect(void);
+
+QU_API void QU_CALL qu_push_transform(void);
+QU_API void QU_CALL qu_pop_transform(void);
+QU_API void QU_CALL qu_reset_transform(void);
+QU_API void QU_CALL qu_translate(float x, float y);
+QU_API void QU_CALL qu_rotate(float degrees);
+QU_API void QU_CALL qu_scale(float x, float y);
+
+QU_API void QU_CALL qu_set_flush_threshold(int vertices, int commands);
+QU_API void QU_CALL qu_set_render_scale(float scale, bool smooth);
+QU_API void QU_CALL qu_set_dynamic_resolution(double frame_time, float min_scale, bool smooth);
+QU_API void QU_CALL qu_set_incremental_redraw(bool enabled);
+QU_API void QU_CALL qu_set_frame_skipping(bool enabled, bool skip_swap);
+QU_API void QU_CALL qu_invalidate_rect(int x, int y, int w, int h);
+QU_API qu_graphics_stats QU_CALL qu_get_graphics_stats(void);
+
 QU_API qu_wave QU_CALL qu_create_wave(int16_t channels, int64_t samples, int64_t sample_rate);
 QU_API qu_wave QU_CALL qu_load_wave(char const *path);
 QU_API void QU_CALL qu_destroy_wave(qu_wave wave);
@@ -20,6 +20,7 @@
 
 #include <string.h>
 #include "algebra.h"
+#include "simd.h"
 
 //------------------------------------------------------------------------------
 
@@ -180,8 +181,178 @@ void mat4_inverse(mat4_t *dst, mat4_t const *src)
 qu_vec2f mat4_transform_point(mat4_t const *mat, qu_vec2f p)
 {
     return (qu_vec2f) {
-        .x = mat->m[0] * p.x + mat->m[1] * p.y + mat->m[3],
-        .y = mat->m[4] * p.x + mat->m[5] * p.y + mat->m[7],
+        .x = mat->m[0] * p.x + mat->m[4] * p.y + mat->m[12],
+        .y = mat->m[1] * p.x + mat->m[5] * p.y + mat->m[13],
     };
 }
 
+/**
+ * Points are transformed in the XY plane, the Z and W rows are ignored.
+ */
+void mat4_transform_points(mat4_t const *mat, qu_vec2f *dst,
+    qu_vec2f const *src, size_t count)
+{
+    affine_t const affine = {
+        {
+            mat->m[0],  mat->m[1],
+            mat->m[4],  mat->m[5],
+            mat->m[12], mat->m[13],
+        },
+    };
+
+    affine_transform_points(&affine, dst, src, count);
+}
+
+//------------------------------------------------------------------------------
+
+void affine_identity(affine_t *mat)
+{
+    static float const identity[] = {
+        1.0f, 0.0f,
+        0.0f, 1.0f,
+        0.0f, 0.0f,
+    };
+
+    memcpy(mat->m, identity, sizeof(float) * 6);
+}
+
+bool affine_is_identity(affine_t const *mat)
+{
+    return mat->m[0] == 1.f && mat->m[1] == 0.f
+        && mat->m[2] == 0.f && mat->m[3] == 1.f
+        && mat->m[4] == 0.f && mat->m[5] == 0.f;
+}
+
+void affine_multiply(affine_t *a, affine_t const *b)
+{
+    float const result[] = {
+        a->m[0] * b->m[0] + a->m[2] * b->m[1],
+        a->m[1] * b->m[0] + a->m[3] * b->m[1],
+        a->m[0] * b->m[2] + a->m[2] * b->m[3],
+        a->m[1] * b->m[2] + a->m[3] * b->m[3],
+        a->m[0] * b->m[4] + a->m[2] * b->m[5] + a->m[4],
+        a->m[1] * b->m[4] + a->m[3] * b->m[5] + a->m[5],
+    };
+
+    memcpy(a->m, result, sizeof(float) * 6);
+}
+
+void affine_translate(affine_t *mat, float x, float y)
+{
+    mat->m[4] += mat->m[0] * x + mat->m[2] * y;
+    mat->m[5] += mat->m[1] * x + mat->m[3] * y;
+}
+
+void affine_scale(affine_t *mat, float x, float y)
+{
+    mat->m[0] *= x;
+    mat->m[1] *= x;
+    mat->m[2] *= y;
+    mat->m[3] *= y;
+}
+
+void affine_rotate(affine_t *mat, float rad)
+{
+    float c = cosf(rad);
+    float s = sinf(rad);
+
+    affine_t const rotation = {
+        {
+            c,      s,
+            -s,     c,
+            0.f,    0.f,
+        },
+    };
+
+    affine_multiply(mat, &rotation);
+}
+
+void affine_inverse(affine_t *dst, affine_t const *src)
+{
+    float det = src->m[0] * src->m[3] - src->m[1] * src->m[2];
+
+    if (det == 0.f) {
+        affine_identity(dst);
+        return;
+    }
+
+    float const result[] = {
+        +src->m[3] / det,
+        -src->m[1] / det,
+        -src->m[2] / det,
+        +src->m[0] / det,
+        (src->m[2] * src->m[5] - src->m[3] * src->m[4]) / det,
+        (src->m[1] * src->m[4] - src->m[0] * src->m[5]) / det,
+    };
+
+    memcpy(dst->m, result, sizeof(float) * 6);
+}
+
+qu_vec2f affine_transform_point(affine_t const *mat, qu_vec2f p)
+{
+    return (qu_vec2f) {
+        .x = mat->m[0] * p.x + mat->m[2] * p.y + mat->m[4],
+        .y = mat->m[1] * p.x + mat->m[3] * p.y + mat->m[5],
+    };
+}
+
+void affine_transform_points_scalar(affine_t const *mat, qu_vec2f *dst,
+    qu_vec2f const *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = affine_transform_point(mat, src[i]);
+    }
+}
+
+/**
+ * Transforms four points per iteration. `dst` may be the same as `src`.
+ */
+void affine_transform_points(affine_t const *mat, qu_vec2f *dst,
+    qu_vec2f const *src, size_t count)
+{
+    size_t i = 0;
+
+#if defined(LIBQU_SIMD_SSE2)
+    // Points are kept interleaved: each register holds two of them.
+    __m128 ab = _mm_setr_ps(mat->m[0], mat->m[1], mat->m[0], mat->m[1]);
+    __m128 cd = _mm_setr_ps(mat->m[2], mat->m[3], mat->m[2], mat->m[3]);
+    __m128 t = _mm_setr_ps(mat->m[4], mat->m[5], mat->m[4], mat->m[5]);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 p01 = _mm_loadu_ps(&src[i].x);
+        __m128 p23 = _mm_loadu_ps(&src[i + 2].x);
+
+        __m128 x01 = _mm_shuffle_ps(p01, p01, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 y01 = _mm_shuffle_ps(p01, p01, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 x23 = _mm_shuffle_ps(p23, p23, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 y23 = _mm_shuffle_ps(p23, p23, _MM_SHUFFLE(3, 3, 1, 1));
+
+        _mm_storeu_ps(&dst[i].x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ab, x01), _mm_mul_ps(cd, y01)), t));
+        _mm_storeu_ps(&dst[i + 2].x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ab, x23), _mm_mul_ps(cd, y23)), t));
+    }
+#elif defined(LIBQU_SIMD_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4x2_t p = vld2q_f32(&src[i].x);
+        float32x4x2_t r;
+
+        r.val[0] = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(mat->m[4]), p.val[0], mat->m[0]), p.val[1], mat->m[2]);
+        r.val[1] = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(mat->m[5]), p.val[0], mat->m[1]), p.val[1], mat->m[3]);
+
+        vst2q_f32(&dst[i].x, r);
+    }
+#endif
+
+    affine_transform_points_scalar(mat, &dst[i], &src[i], count - i);
+}
+
+void affine_to_mat4(mat4_t *dst, affine_t const *src)
+{
+    mat4_identity(dst);
+
+    dst->m[ 0] = src->m[0];
+    dst->m[ 1] = src->m[1];
+    dst->m[ 4] = src->m[2];
+    dst->m[ 5] = src->m[3];
+    dst->m[12] = src->m[4];
+    dst->m[13] = src->m[5];
+}
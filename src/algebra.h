@@ -33,6 +33,15 @@ typedef struct mat4_s
     float m[16];
 } mat4_t;
 
+/**
+ * 2D affine transform, stored by columns: x' = m[0] * x + m[2] * y + m[4],
+ * y' = m[1] * x + m[3] * y + m[5].
+ */
+typedef struct affine_s
+{
+    float m[6];
+} affine_t;
+
 //------------------------------------------------------------------------------
 
 void mat4_identity(mat4_t *mat);
@@ -44,6 +53,21 @@ void mat4_scale(mat4_t *mat, float x, float y, float z);
 void mat4_rotate(mat4_t *mat, float rad, float x, float y, float z);
 void mat4_inverse(mat4_t *dst, mat4_t const *src);
 qu_vec2f mat4_transform_point(mat4_t const *mat, qu_vec2f p);
+void mat4_transform_points(mat4_t const *mat, qu_vec2f *dst, qu_vec2f const *src, size_t count);
+
+void affine_identity(affine_t *mat);
+bool affine_is_identity(affine_t const *mat);
+void affine_multiply(affine_t *a, affine_t const *b);
+void affine_translate(affine_t *mat, float x, float y);
+void affine_scale(affine_t *mat, float x, float y);
+void affine_rotate(affine_t *mat, float rad);
+void affine_inverse(affine_t *dst, affine_t const *src);
+qu_vec2f affine_transform_point(affine_t const *mat, qu_vec2f p);
+void affine_transform_points(affine_t const *mat, qu_vec2f *dst, qu_vec2f const *src, size_t count);
+void affine_to_mat4(mat4_t *dst, affine_t const *src);
+
+// Plain C version of the vectorized function, for reference.
+void affine_transform_points_scalar(affine_t const *mat, qu_vec2f *dst, qu_vec2f const *src, size_t count);
 
 //------------------------------------------------------------------------------
 
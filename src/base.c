@@ -28,6 +28,8 @@
 
 //------------------------------------------------------------------------------
 
+#define SKIPPED_FRAME_INTERVAL 16
+
 #define QU_SOUND_NONE \
     (qu_sound) { .id = 0 }
 
@@ -56,6 +58,7 @@ static struct
 
     uint32_t start_ticks_mediump;
     uint64_t start_ticks_highp;
+    uint32_t present_ticks;
 
     struct {
         struct libqu_core_params core;
@@ -160,8 +163,20 @@ bool qu_process(void)
 
 void qu_present(void)
 {
-    libqu_graphics_flush();
-    libqu_core_swap();
+    // Unchanged frames may not be swapped, the window keeps showing the
+    // last one. Nothing waits for vertical sync then, so the loop is
+    // slowed down here instead of spinning.
+    if (libqu_graphics_present()) {
+        libqu_core_swap();
+    } else {
+        uint32_t elapsed = pl_get_ticks_mediump() - priv.present_ticks;
+
+        if (elapsed < SKIPPED_FRAME_INTERVAL) {
+            pl_sleep(SKIPPED_FRAME_INTERVAL - elapsed);
+        }
+    }
+
+    priv.present_ticks = pl_get_ticks_mediump();
 }
 
 //------------------------------------------------------------------------------
@@ -406,11 +421,90 @@ unsigned char *qu_get_image_pixels(qu_image handle)
     return NULL;
 }
 
+qu_image qu_convert_image(qu_image handle, qu_pixel_format format)
+{
+    qu_image copy_h = { 0 };
+    struct libqu_image *image = libqu_handle_get(LIBQU_HANDLE_IMAGE, handle.id);
+
+    if (image) {
+        struct libqu_image *copy = libqu_image_convert(image, format);
+
+        if (copy) {
+            copy_h.id = libqu_handle_create(LIBQU_HANDLE_IMAGE, copy);
+        }
+    }
+
+    return copy_h;
+}
+
+void qu_flip_image(qu_image handle)
+{
+    struct libqu_image *image = libqu_handle_get(LIBQU_HANDLE_IMAGE, handle.id);
+
+    if (image) {
+        libqu_image_flip(image);
+    }
+}
+
+void qu_premultiply_image(qu_image handle)
+{
+    struct libqu_image *image = libqu_handle_get(LIBQU_HANDLE_IMAGE, handle.id);
+
+    if (image) {
+        libqu_image_premultiply(image);
+    }
+}
+
+void qu_unpremultiply_image(qu_image handle)
+{
+    struct libqu_image *image = libqu_handle_get(LIBQU_HANDLE_IMAGE, handle.id);
+
+    if (image) {
+        libqu_image_unpremultiply(image);
+    }
+}
+
+void qu_blit_image(qu_image dst_h, qu_image src_h, int x, int y, qu_blend_mode mode)
+{
+    struct libqu_image *dst = libqu_handle_get(LIBQU_HANDLE_IMAGE, dst_h.id);
+    struct libqu_image *src = libqu_handle_get(LIBQU_HANDLE_IMAGE, src_h.id);
+
+    if (dst && src) {
+        libqu_image_blit(dst, src, (qu_vec2i) { x, y }, &mode);
+    }
+}
+
+bool qu_save_image_qoi(qu_image image_h, char const *path)
+{
+    struct libqu_image *image = libqu_handle_get(LIBQU_HANDLE_IMAGE, image_h.id);
+
+    if (image) {
+        return libqu_qoi_save(image, path);
+    }
+
+    return false;
+}
+
 void qu_set_default_texture_flags(unsigned int flags)
 {
     libqu_graphics_set_default_texture_flags(flags);
 }
 
+void qu_set_premultiplied_alpha(bool enabled)
+{
+    libqu_graphics_set_premultiplied_alpha(enabled);
+}
+
+void qu_set_texture_downscale(int factor)
+{
+    libqu_graphics_set_texture_downscale(factor);
+}
+
+void qu_set_texture_residency(bool release_pixels, size_t budget)
+{
+    libqu_graphics_set_texture_residency(release_pixels, budget);
+}
+
 qu_texture qu_load_texture_from_file(char const *path)
 {
     qu_texture texture_h = { 0 };
@@ -421,7 +515,9 @@ qu_texture qu_load_texture_from_file(char const *path)
         struct libqu_image *image = libqu_image_load(file);
 
         if (image) {
-            struct libqu_texture *texture = libqu_graphics_load_texture(image);
+            struct libqu_texture_source source = { .path = path };
+            struct libqu_texture *texture =
+                libqu_graphics_load_downscaled_texture(image, &source);
 
             if (texture) {
                 texture_h.id =
@@ -445,7 +541,13 @@ qu_texture qu_load_texture_from_buffer(void *buffer, size_t size)
         struct libqu_image *image = libqu_image_load(file);
 
         if (image) {
-            struct libqu_texture *texture = libqu_graphics_load_texture(image);
+            struct libqu_texture_source source = {
+                .buffer = buffer,
+                .size = size,
+            };
+
+            struct libqu_texture *texture =
+                libqu_graphics_load_downscaled_texture(image, &source);
 
             if (texture) {
                 texture_h.id =
@@ -466,8 +568,11 @@ qu_texture qu_load_texture_from_image(qu_image image_h)
     struct libqu_image *image =
         libqu_handle_get(LIBQU_HANDLE_IMAGE, image_h.id);
     
-    if (image) {
-        struct libqu_texture *texture = libqu_graphics_load_texture(image);
+    // Texture owns its pixels, the image stays with the caller.
+    struct libqu_image *copy = image ? libqu_image_copy(image) : NULL;
+
+    if (copy) {
+        struct libqu_texture *texture = libqu_graphics_load_texture(copy, NULL);
 
         if (texture) {
             texture_h.id = libqu_handle_create(LIBQU_HANDLE_TEXTURE, texture);
@@ -490,7 +595,7 @@ qu_vec2i qu_get_texture_size(qu_texture texture_h)
         libqu_handle_get(LIBQU_HANDLE_TEXTURE, texture_h.id);
 
     if (texture) {
-        size = texture->image->size;
+        size = texture->full_size;
     }
 
     return size;
@@ -502,7 +607,7 @@ qu_pixel_format qu_get_texture_format(qu_texture texture_h)
         libqu_handle_get(LIBQU_HANDLE_TEXTURE, texture_h.id);
     
     if (texture) {
-        return texture->image->format;
+        return texture->format;
     }
 
     return QU_PIXFMT_INVALID;
@@ -575,6 +680,416 @@ void qu_draw_subtexture_r(qu_texture texture_h, qu_rectf rect, qu_rectf sub)
     }
 }
 
+qu_tilemap qu_create_tilemap(qu_texture tileset_h,
+    int tile_width, int tile_height, int width, int height)
+{
+    qu_tilemap tilemap_h = { 0 };
+
+    struct libqu_texture *tileset =
+        libqu_handle_get(LIBQU_HANDLE_TEXTURE, tileset_h.id);
+
+    if (tileset) {
+        qu_vec2i tile_size = { tile_width, tile_height };
+        qu_vec2i size = { width, height };
+
+        struct libqu_tilemap *tilemap =
+            libqu_tilemap_create(tileset, tile_size, size);
+
+        if (tilemap) {
+            tilemap_h.id = libqu_handle_create(LIBQU_HANDLE_TILEMAP, tilemap);
+        }
+    }
+
+    return tilemap_h;
+}
+
+void qu_destroy_tilemap(qu_tilemap tilemap_h)
+{
+    libqu_handle_destroy(LIBQU_HANDLE_TILEMAP, tilemap_h.id);
+}
+
+int qu_get_tile(qu_tilemap tilemap_h, int x, int y)
+{
+    struct libqu_tilemap *tilemap =
+        libqu_handle_get(LIBQU_HANDLE_TILEMAP, tilemap_h.id);
+
+    if (tilemap) {
+        return libqu_tilemap_get_tile(tilemap, x, y);
+    }
+
+    return -1;
+}
+
+void qu_set_tile(qu_tilemap tilemap_h, int x, int y, int tile)
+{
+    struct libqu_tilemap *tilemap =
+        libqu_handle_get(LIBQU_HANDLE_TILEMAP, tilemap_h.id);
+
+    if (tilemap) {
+        libqu_tilemap_set_tile(tilemap, x, y, tile);
+    }
+}
+
+void qu_draw_tilemap(qu_tilemap tilemap_h, float x, float y)
+{
+    struct libqu_tilemap *tilemap =
+        libqu_handle_get(LIBQU_HANDLE_TILEMAP, tilemap_h.id);
+
+    if (tilemap) {
+        qu_vec2f pos = { x, y };
+        libqu_tilemap_draw(tilemap, pos);
+    }
+}
+
+static qu_emitter create_emitter(qu_texture texture_h, int capacity, bool gpu)
+{
+    qu_emitter emitter_h = { 0 };
+
+    // Zero texture handle means untextured particles.
+    struct libqu_texture *texture = NULL;
+
+    if (texture_h.id) {
+        texture = libqu_handle_get(LIBQU_HANDLE_TEXTURE, texture_h.id);
+
+        if (!texture) {
+            return emitter_h;
+        }
+    }
+
+    struct libqu_emitter *emitter = libqu_emitter_create(texture, capacity, gpu);
+
+    if (emitter) {
+        emitter_h.id = libqu_handle_create(LIBQU_HANDLE_EMITTER, emitter);
+    }
+
+    return emitter_h;
+}
+
+qu_emitter qu_create_emitter(qu_texture texture_h, int capacity)
+{
+    return create_emitter(texture_h, capacity, false);
+}
+
+qu_emitter qu_create_gpu_emitter(qu_texture texture_h, int capacity)
+{
+    return create_emitter(texture_h, capacity, true);
+}
+
+void qu_destroy_emitter(qu_emitter emitter_h)
+{
+    libqu_handle_destroy(LIBQU_HANDLE_EMITTER, emitter_h.id);
+}
+
+void qu_set_emitter_gravity(qu_emitter emitter_h, float x, float y)
+{
+    struct libqu_emitter *emitter =
+        libqu_handle_get(LIBQU_HANDLE_EMITTER, emitter_h.id);
+
+    if (emitter) {
+        qu_vec2f gravity = { x, y };
+        libqu_emitter_set_gravity(emitter, gravity);
+    }
+}
+
+void qu_emit_particle(qu_emitter emitter_h, qu_particle const *particle)
+{
+    struct libqu_emitter *emitter =
+        libqu_handle_get(LIBQU_HANDLE_EMITTER, emitter_h.id);
+
+    if (emitter) {
+        libqu_emitter_emit(emitter, particle);
+    }
+}
+
+void qu_update_emitter(qu_emitter emitter_h, float dt)
+{
+    struct libqu_emitter *emitter =
+        libqu_handle_get(LIBQU_HANDLE_EMITTER, emitter_h.id);
+
+    if (emitter) {
+        libqu_emitter_update(emitter, dt);
+    }
+}
+
+void qu_draw_emitter(qu_emitter emitter_h)
+{
+    struct libqu_emitter *emitter =
+        libqu_handle_get(LIBQU_HANDLE_EMITTER, emitter_h.id);
+
+    if (emitter) {
+        libqu_emitter_draw(emitter);
+    }
+}
+
+qu_emitter_stats qu_get_emitter_stats(qu_emitter emitter_h)
+{
+    qu_emitter_stats stats = { 0 };
+
+    struct libqu_emitter *emitter =
+        libqu_handle_get(LIBQU_HANDLE_EMITTER, emitter_h.id);
+
+    if (emitter) {
+        libqu_emitter_get_stats(emitter, &stats);
+    }
+
+    return stats;
+}
+
+bool qu_save_virtual_texture(qu_image image_h, char const *path, int tile_size)
+{
+    struct libqu_image *image = libqu_handle_get(LIBQU_HANDLE_IMAGE, image_h.id);
+
+    if (image) {
+        return libqu_vtexture_save(image, path, tile_size);
+    }
+
+    return false;
+}
+
+qu_virtual_texture qu_load_virtual_texture(char const *path)
+{
+    qu_virtual_texture vt_h = { 0 };
+    struct libqu_file *file = libqu_fopen(path);
+
+    if (file) {
+        // File is kept open by the loader thread.
+        struct libqu_vtexture *vt = libqu_vtexture_load(file);
+
+        if (vt) {
+            vt_h.id = libqu_handle_create(LIBQU_HANDLE_VTEXTURE, vt);
+        }
+    }
+
+    return vt_h;
+}
+
+void qu_destroy_virtual_texture(qu_virtual_texture vt_h)
+{
+    libqu_handle_destroy(LIBQU_HANDLE_VTEXTURE, vt_h.id);
+}
+
+qu_vec2i qu_get_virtual_texture_size(qu_virtual_texture vt_h)
+{
+    qu_vec2i size = { -1, -1 };
+
+    struct libqu_vtexture *vt = libqu_handle_get(LIBQU_HANDLE_VTEXTURE, vt_h.id);
+
+    if (vt) {
+        size = libqu_vtexture_get_size(vt);
+    }
+
+    return size;
+}
+
+void qu_draw_virtual_texture(qu_virtual_texture vt_h,
+    float x, float y, float w, float h)
+{
+    struct libqu_vtexture *vt = libqu_handle_get(LIBQU_HANDLE_VTEXTURE, vt_h.id);
+
+    if (vt) {
+        qu_vec2i size = libqu_vtexture_get_size(vt);
+        qu_rectf rect = { x, y, w, h };
+        qu_rectf sub = { 0.f, 0.f, (float) size.x, (float) size.y };
+        libqu_vtexture_draw(vt, rect, sub);
+    }
+}
+
+void qu_draw_virtual_subtexture(qu_virtual_texture vt_h,
+    float x, float y, float w, float h,
+    float s, float t, float u, float v)
+{
+    struct libqu_vtexture *vt = libqu_handle_get(LIBQU_HANDLE_VTEXTURE, vt_h.id);
+
+    if (vt) {
+        qu_rectf rect = { x, y, w, h };
+        qu_rectf sub = { s, t, u, v };
+        libqu_vtexture_draw(vt, rect, sub);
+    }
+}
+
+qu_font qu_load_font(char const *path)
+{
+    qu_font font_h = { 0 };
+    struct libqu_file *file = libqu_fopen(path);
+
+    if (file) {
+        struct libqu_font *font = libqu_font_load(file);
+
+        if (font) {
+            font_h.id = libqu_handle_create(LIBQU_HANDLE_FONT, font);
+        }
+
+        libqu_fclose(file);
+    }
+
+    return font_h;
+}
+
+void qu_destroy_font(qu_font font_h)
+{
+    libqu_handle_destroy(LIBQU_HANDLE_FONT, font_h.id);
+}
+
+qu_vec2f qu_measure_text(qu_font font_h, float width, float scale, char const *text)
+{
+    qu_vec2f size = { 0.f, 0.f };
+
+    struct libqu_font *font = libqu_handle_get(LIBQU_HANDLE_FONT, font_h.id);
+
+    if (font && text) {
+        size = libqu_font_measure(font, text, width, scale);
+    }
+
+    return size;
+}
+
+void qu_draw_text(qu_font font_h, float x, float y, qu_color color, char const *text)
+{
+    struct libqu_font *font = libqu_handle_get(LIBQU_HANDLE_FONT, font_h.id);
+
+    if (font && text) {
+        qu_vec2f pos = { x, y };
+        libqu_font_draw(font, pos, text, 0.f, 1.f, QU_ALIGN_LEFT, color);
+    }
+}
+
+void qu_draw_text_block(qu_font font_h, float x, float y, float width,
+    float scale, qu_text_align align, qu_color color, char const *text)
+{
+    struct libqu_font *font = libqu_handle_get(LIBQU_HANDLE_FONT, font_h.id);
+
+    if (font && text) {
+        qu_vec2f pos = { x, y };
+        libqu_font_draw(font, pos, text, width, scale, align, color);
+    }
+}
+
+qu_scene qu_create_scene(float cell_size)
+{
+    qu_scene scene_h = { 0 };
+    struct libqu_scene *scene = libqu_scene_create(cell_size);
+
+    if (scene) {
+        scene_h.id = libqu_handle_create(LIBQU_HANDLE_SCENE, scene);
+    }
+
+    return scene_h;
+}
+
+void qu_destroy_scene(qu_scene scene_h)
+{
+    libqu_handle_destroy(LIBQU_HANDLE_SCENE, scene_h.id);
+}
+
+int qu_add_sprite(qu_scene scene_h, qu_texture texture_h,
+    float x, float y, float w, float h)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+    struct libqu_texture *texture = NULL;
+
+    if (!scene) {
+        return -1;
+    }
+
+    // Sprites without a texture only group other sprites.
+    if (texture_h.id) {
+        texture = libqu_handle_get(LIBQU_HANDLE_TEXTURE, texture_h.id);
+
+        if (!texture) {
+            return -1;
+        }
+    }
+
+    qu_rectf rect = { x, y, w, h };
+    return libqu_scene_add_sprite(scene, texture, rect);
+}
+
+void qu_remove_sprite(qu_scene scene_h, int sprite)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        libqu_scene_remove_sprite(scene, sprite);
+    }
+}
+
+void qu_set_sprite_parent(qu_scene scene_h, int sprite, int parent)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        libqu_scene_set_parent(scene, sprite, parent);
+    }
+}
+
+void qu_set_sprite_position(qu_scene scene_h, int sprite, float x, float y)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        libqu_scene_set_position(scene, sprite, (qu_vec2f) { x, y });
+    }
+}
+
+void qu_set_sprite_transform(qu_scene scene_h, int sprite, float x, float y,
+    float rotation, float scale_x, float scale_y)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        qu_vec2f position = { x, y };
+        qu_vec2f scale = { scale_x, scale_y };
+        libqu_scene_set_transform(scene, sprite, position, rotation, scale);
+    }
+}
+
+void qu_set_sprite_subrect(qu_scene scene_h, int sprite,
+    float s, float t, float u, float v)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        qu_rectf sub = { s, t, u, v };
+        libqu_scene_set_subrect(scene, sprite, sub);
+    }
+}
+
+void qu_set_sprite_color(qu_scene scene_h, int sprite, qu_color color)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        libqu_scene_set_color(scene, sprite, color);
+    }
+}
+
+void qu_set_sprite_order(qu_scene scene_h, int sprite, int order)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        libqu_scene_set_order(scene, sprite, order);
+    }
+}
+
+void qu_set_sprite_visible(qu_scene scene_h, int sprite, bool visible)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        libqu_scene_set_visible(scene, sprite, visible);
+    }
+}
+
+void qu_draw_scene(qu_scene scene_h, float x, float y)
+{
+    struct libqu_scene *scene = libqu_handle_get(LIBQU_HANDLE_SCENE, scene_h.id);
+
+    if (scene) {
+        libqu_scene_draw(scene, (qu_vec2f) { x, y });
+    }
+}
+
 qu_image qu_capture_screen(void)
 {
     qu_image image_h = { 0 };
@@ -592,6 +1107,84 @@ void qu_set_blend_mode(qu_blend_mode mode)
     libqu_graphics_set_blend_mode(mode);
 }
 
+void qu_push_clip_rect(int x, int y, int w, int h)
+{
+    libqu_graphics_push_clip_rect((qu_recti) { x, y, w, h });
+}
+
+void qu_pop_clip_rect(void)
+{
+    libqu_graphics_pop_clip_rect();
+}
+
+void qu_push_transform(void)
+{
+    libqu_graphics_push_transform();
+}
+
+void qu_pop_transform(void)
+{
+    libqu_graphics_pop_transform();
+}
+
+void qu_reset_transform(void)
+{
+    libqu_graphics_reset_transform();
+}
+
+void qu_translate(float x, float y)
+{
+    libqu_graphics_translate((qu_vec2f) { x, y });
+}
+
+void qu_rotate(float degrees)
+{
+    libqu_graphics_rotate(degrees);
+}
+
+void qu_scale(float x, float y)
+{
+    libqu_graphics_scale((qu_vec2f) { x, y });
+}
+
+void qu_set_flush_threshold(int vertices, int commands)
+{
+    libqu_graphics_set_flush_threshold(vertices, commands);
+}
+
+void qu_set_render_scale(float scale, bool smooth)
+{
+    libqu_graphics_set_render_scale(scale, smooth);
+}
+
+void qu_set_dynamic_resolution(double frame_time, float min_scale, bool smooth)
+{
+    libqu_graphics_set_dynamic_resolution(frame_time, min_scale, smooth);
+}
+
+void qu_set_incremental_redraw(bool enabled)
+{
+    libqu_graphics_set_incremental_redraw(enabled);
+}
+
+void qu_set_frame_skipping(bool enabled, bool skip_swap)
+{
+    libqu_graphics_set_frame_skipping(enabled, skip_swap);
+}
+
+void qu_invalidate_rect(int x, int y, int w, int h)
+{
+    libqu_graphics_invalidate_rect((qu_recti) { x, y, w, h });
+}
+
+qu_graphics_stats qu_get_graphics_stats(void)
+{
+    qu_graphics_stats stats = { 0 };
+    libqu_graphics_get_stats(&stats);
+
+    return stats;
+}
+
 //------------------------------------------------------------------------------
 
 qu_wave qu_create_wave(int16_t channels, int64_t samples, int64_t sample_rate)
@@ -18,22 +18,31 @@
 // 3. This notice may not be removed or altered from any source distribution.
 //------------------------------------------------------------------------------
 
+#include <string.h>
 #include <stb_ds.h>
 #include "core.h"
 #include "log.h"
 
 //------------------------------------------------------------------------------
 
-static struct libqu_core_impl const *impl_list[] = {
+static struct
+{
+    char const *name;
+    struct libqu_core_impl const *impl;
+} const impl_list[] = {
 #ifdef _WIN32
-    &libqu_core_win32_impl,
+    { "win32", &libqu_core_win32_impl },
 #endif
 
 #ifdef QU_USE_X11
-    &libqu_core_x11_impl,
+    { "x11", &libqu_core_x11_impl },
+#endif
+
+#ifdef QU_USE_EGL
+    { "egl", &libqu_core_egl_impl },
 #endif
 
-    &libqu_core_null_impl,
+    { "null", &libqu_core_null_impl },
 };
 
 //------------------------------------------------------------------------------
@@ -57,9 +66,23 @@ static struct libqu_core_impl const *choose_impl(void)
 {
     int count = sizeof(impl_list) / sizeof(impl_list[0]);
 
+    // Backend can be forced, e.g. LIBQU_CORE=egl for offscreen rendering.
+    char const *name = getenv("LIBQU_CORE");
+
+    if (name) {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(impl_list[i].name, name) == 0
+                    && impl_list[i].impl->check_if_available()) {
+                return impl_list[i].impl;
+            }
+        }
+
+        LIBQU_LOGW("Core backend \"%s\" is not available.\n", name);
+    }
+
     for (int i = 0; i < count; i++) {
-        if (impl_list[i]->check_if_available()) {
-            return impl_list[i];
+        if (impl_list[i].impl->check_if_available()) {
+            return impl_list[i].impl;
         }
     }
 
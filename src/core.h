@@ -79,6 +79,10 @@ extern struct libqu_core_impl const libqu_core_win32_impl;
 extern struct libqu_core_impl const libqu_core_x11_impl;
 #endif
 
+#ifdef QU_USE_EGL
+extern struct libqu_core_impl const libqu_core_egl_impl;
+#endif
+
 //------------------------------------------------------------------------------
 
 void libqu_core_initialize(struct libqu_core_params const *params);
@@ -0,0 +1,467 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#ifdef QU_USE_EGL
+
+//------------------------------------------------------------------------------
+// Headless core: OpenGL context without a window system. Everything is
+// rendered into an offscreen framebuffer object that stays bound, so the
+// graphics backend and glReadPixels() work as they do with a window.
+
+#define EGL_NO_X11
+
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "core.h"
+#include "log.h"
+#include "platform.h"
+
+//------------------------------------------------------------------------------
+
+typedef void (APIENTRYP PFNGLFLUSHPROC)(void);
+
+//------------------------------------------------------------------------------
+
+static struct
+{
+    void *so;
+    void *gl_so;
+
+    PFNEGLGETPROCADDRESSPROC            _eglGetProcAddress;
+    PFNEGLGETDISPLAYPROC                _eglGetDisplay;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC     _eglGetPlatformDisplayEXT;
+    PFNEGLINITIALIZEPROC                _eglInitialize;
+    PFNEGLTERMINATEPROC                 _eglTerminate;
+    PFNEGLQUERYSTRINGPROC               _eglQueryString;
+    PFNEGLBINDAPIPROC                   _eglBindAPI;
+    PFNEGLCHOOSECONFIGPROC              _eglChooseConfig;
+    PFNEGLCREATECONTEXTPROC             _eglCreateContext;
+    PFNEGLDESTROYCONTEXTPROC            _eglDestroyContext;
+    PFNEGLCREATEPBUFFERSURFACEPROC      _eglCreatePbufferSurface;
+    PFNEGLDESTROYSURFACEPROC            _eglDestroySurface;
+    PFNEGLMAKECURRENTPROC               _eglMakeCurrent;
+
+    PFNGLGENFRAMEBUFFERSPROC            _glGenFramebuffers;
+    PFNGLDELETEFRAMEBUFFERSPROC         _glDeleteFramebuffers;
+    PFNGLBINDFRAMEBUFFERPROC            _glBindFramebuffer;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC    _glFramebufferRenderbuffer;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC     _glCheckFramebufferStatus;
+    PFNGLGENRENDERBUFFERSPROC           _glGenRenderbuffers;
+    PFNGLDELETERENDERBUFFERSPROC        _glDeleteRenderbuffers;
+    PFNGLBINDRENDERBUFFERPROC           _glBindRenderbuffer;
+    PFNGLRENDERBUFFERSTORAGEPROC        _glRenderbufferStorage;
+    PFNGLFLUSHPROC                      _glFlush;
+
+    bool KHR_surfaceless_context;
+
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+
+    GLuint fbo;
+    GLuint rbo;
+
+    int gl_version;
+} priv;
+
+//------------------------------------------------------------------------------
+
+#define eglGetProcAddress               priv._eglGetProcAddress
+#define eglGetDisplay                   priv._eglGetDisplay
+#define eglGetPlatformDisplayEXT        priv._eglGetPlatformDisplayEXT
+#define eglInitialize                   priv._eglInitialize
+#define eglTerminate                    priv._eglTerminate
+#define eglQueryString                  priv._eglQueryString
+#define eglBindAPI                      priv._eglBindAPI
+#define eglChooseConfig                 priv._eglChooseConfig
+#define eglCreateContext                priv._eglCreateContext
+#define eglDestroyContext               priv._eglDestroyContext
+#define eglCreatePbufferSurface         priv._eglCreatePbufferSurface
+#define eglDestroySurface               priv._eglDestroySurface
+#define eglMakeCurrent                  priv._eglMakeCurrent
+
+#define glGenFramebuffers               priv._glGenFramebuffers
+#define glDeleteFramebuffers            priv._glDeleteFramebuffers
+#define glBindFramebuffer               priv._glBindFramebuffer
+#define glFramebufferRenderbuffer       priv._glFramebufferRenderbuffer
+#define glCheckFramebufferStatus        priv._glCheckFramebufferStatus
+#define glGenRenderbuffers              priv._glGenRenderbuffers
+#define glDeleteRenderbuffers           priv._glDeleteRenderbuffers
+#define glBindRenderbuffer              priv._glBindRenderbuffer
+#define glRenderbufferStorage           priv._glRenderbufferStorage
+#define glFlush                         priv._glFlush
+
+//------------------------------------------------------------------------------
+
+static bool load_egl_funcs(void)
+{
+    eglGetProcAddress = pl_get_dll_proc(priv.so, "eglGetProcAddress");
+    eglGetDisplay = pl_get_dll_proc(priv.so, "eglGetDisplay");
+    eglInitialize = pl_get_dll_proc(priv.so, "eglInitialize");
+    eglTerminate = pl_get_dll_proc(priv.so, "eglTerminate");
+    eglQueryString = pl_get_dll_proc(priv.so, "eglQueryString");
+    eglBindAPI = pl_get_dll_proc(priv.so, "eglBindAPI");
+    eglChooseConfig = pl_get_dll_proc(priv.so, "eglChooseConfig");
+    eglCreateContext = pl_get_dll_proc(priv.so, "eglCreateContext");
+    eglDestroyContext = pl_get_dll_proc(priv.so, "eglDestroyContext");
+    eglCreatePbufferSurface = pl_get_dll_proc(priv.so, "eglCreatePbufferSurface");
+    eglDestroySurface = pl_get_dll_proc(priv.so, "eglDestroySurface");
+    eglMakeCurrent = pl_get_dll_proc(priv.so, "eglMakeCurrent");
+
+    return eglGetProcAddress && eglGetDisplay && eglInitialize
+        && eglTerminate && eglQueryString && eglBindAPI
+        && eglChooseConfig && eglCreateContext && eglDestroyContext
+        && eglCreatePbufferSurface && eglDestroySurface && eglMakeCurrent;
+}
+
+static bool load_egl_lib(void)
+{
+    char const *names[] = {
+        "libEGL.so.1",
+        "libEGL.so",
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        priv.so = pl_open_dll(names[i]);
+
+        if (priv.so) {
+            LIBQU_LOGI("EGL dynamic library opened from %s.\n", names[i]);
+            break;
+        }
+    }
+
+    if (!priv.so) {
+        return false;
+    }
+
+    if (!load_egl_funcs()) {
+        LIBQU_LOGE("Failed to load EGL functions.\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void *get_gl_proc_address(char const *name)
+{
+    void *proc = (void *) eglGetProcAddress(name);
+
+    if (proc) {
+        return proc;
+    }
+
+    // Before EGL 1.5, core functions may be exported only by the GL library.
+    if (!priv.gl_so) {
+        priv.gl_so = pl_open_dll("libOpenGL.so.0");
+    }
+
+    if (!priv.gl_so) {
+        priv.gl_so = pl_open_dll("libGL.so.1");
+    }
+
+    return priv.gl_so ? pl_get_dll_proc(priv.gl_so, name) : NULL;
+}
+
+static bool load_gl_funcs(void)
+{
+    glGenFramebuffers = get_gl_proc_address("glGenFramebuffers");
+    glDeleteFramebuffers = get_gl_proc_address("glDeleteFramebuffers");
+    glBindFramebuffer = get_gl_proc_address("glBindFramebuffer");
+    glFramebufferRenderbuffer = get_gl_proc_address("glFramebufferRenderbuffer");
+    glCheckFramebufferStatus = get_gl_proc_address("glCheckFramebufferStatus");
+    glGenRenderbuffers = get_gl_proc_address("glGenRenderbuffers");
+    glDeleteRenderbuffers = get_gl_proc_address("glDeleteRenderbuffers");
+    glBindRenderbuffer = get_gl_proc_address("glBindRenderbuffer");
+    glRenderbufferStorage = get_gl_proc_address("glRenderbufferStorage");
+    glFlush = get_gl_proc_address("glFlush");
+
+    return glGenFramebuffers && glDeleteFramebuffers && glBindFramebuffer
+        && glFramebufferRenderbuffer && glCheckFramebufferStatus
+        && glGenRenderbuffers && glDeleteRenderbuffers && glBindRenderbuffer
+        && glRenderbufferStorage && glFlush;
+}
+
+static bool has_extension(char const *list, char const *name)
+{
+    size_t length = strlen(name);
+
+    while (list && *list) {
+        char const *end = strchr(list, ' ');
+        size_t size = end ? (size_t) (end - list) : strlen(list);
+
+        if (size == length && strncmp(list, name, length) == 0) {
+            return true;
+        }
+
+        list = end ? end + 1 : NULL;
+    }
+
+    return false;
+}
+
+static EGLDisplay open_display(void)
+{
+    // Client extensions are queried without a display.
+    char const *client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    if (has_extension(client, "EGL_MESA_platform_surfaceless")) {
+        eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+        if (eglGetPlatformDisplayEXT) {
+            EGLDisplay display = eglGetPlatformDisplayEXT(
+                EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+            if (display != EGL_NO_DISPLAY) {
+                LIBQU_LOGI("Using surfaceless EGL platform.\n");
+                return display;
+            }
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static bool create_context(EGLConfig config)
+{
+    int versions[] = {
+        460, 450, 440, 430, 420, 410, 400,
+        330,
+    };
+
+    for (size_t i = 0; i < sizeof(versions) / sizeof(versions[0]); i++) {
+        EGLint attribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION,          versions[i] / 100,
+            EGL_CONTEXT_MINOR_VERSION,          (versions[i] % 100) / 10,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK,    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE,
+        };
+
+        priv.context = eglCreateContext(priv.display, config, EGL_NO_CONTEXT, attribs);
+
+        if (priv.context != EGL_NO_CONTEXT) {
+            priv.gl_version = versions[i];
+            LIBQU_LOGI("Created OpenGL context %d.%d.\n",
+                versions[i] / 100, (versions[i] % 100) / 10);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool create_framebuffer(qu_vec2i size)
+{
+    glGenFramebuffers(1, &priv.fbo);
+    glGenRenderbuffers(1, &priv.rbo);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, priv.rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, priv.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_RENDERBUFFER, priv.rbo);
+
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+//------------------------------------------------------------------------------
+
+static bool core_egl_check_if_available(void)
+{
+    if (!load_egl_lib()) {
+        return false;
+    }
+
+    priv.display = open_display();
+
+    if (priv.display == EGL_NO_DISPLAY) {
+        return false;
+    }
+
+    if (!eglInitialize(priv.display, NULL, NULL)) {
+        priv.display = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    return true;
+}
+
+static bool core_egl_initialize(struct libqu_core_params const *params)
+{
+    if (priv.display == EGL_NO_DISPLAY) {
+        return false;
+    }
+
+    LIBQU_LOGI("EGL version %s\n", eglQueryString(priv.display, EGL_VERSION));
+
+    priv.KHR_surfaceless_context = has_extension(
+        eglQueryString(priv.display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        LIBQU_LOGE("Desktop OpenGL is not supported by EGL.\n");
+        return false;
+    }
+
+    EGLint config_attribs[] = {
+        EGL_RED_SIZE,           8,
+        EGL_GREEN_SIZE,         8,
+        EGL_BLUE_SIZE,          8,
+        EGL_ALPHA_SIZE,         8,
+        EGL_SURFACE_TYPE,       EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE,    EGL_OPENGL_BIT,
+        EGL_NONE,
+    };
+
+    EGLConfig config;
+    EGLint total = 0;
+
+    if (!eglChooseConfig(priv.display, config_attribs, &config, 1, &total) || total == 0) {
+        LIBQU_LOGE("Failed to choose suitable EGLConfig.\n");
+        return false;
+    }
+
+    if (!create_context(config)) {
+        LIBQU_LOGE("Failed to create OpenGL 3.3+ context.\n");
+        return false;
+    }
+
+    // Rendering goes to the FBO, so a 1x1 pbuffer is enough for drivers
+    // that can't make a context current without a surface.
+    priv.surface = EGL_NO_SURFACE;
+
+    if (!priv.KHR_surfaceless_context) {
+        EGLint pbuffer_attribs[] = {
+            EGL_WIDTH,  1,
+            EGL_HEIGHT, 1,
+            EGL_NONE,
+        };
+
+        priv.surface = eglCreatePbufferSurface(priv.display, config, pbuffer_attribs);
+
+        if (priv.surface == EGL_NO_SURFACE) {
+            LIBQU_LOGE("Failed to create EGL pbuffer surface.\n");
+            return false;
+        }
+    }
+
+    if (!eglMakeCurrent(priv.display, priv.surface, priv.surface, priv.context)) {
+        LIBQU_LOGE("Failed to activate EGL context.\n");
+        return false;
+    }
+
+    if (!load_gl_funcs()) {
+        LIBQU_LOGE("Failed to load OpenGL framebuffer functions.\n");
+        return false;
+    }
+
+    if (!create_framebuffer(params->window_size)) {
+        LIBQU_LOGE("Failed to create offscreen framebuffer.\n");
+        return false;
+    }
+
+    LIBQU_LOGI("Initialized.\n");
+
+    return true;
+}
+
+static void core_egl_terminate(void)
+{
+    if (priv.context != EGL_NO_CONTEXT) {
+        if (priv.fbo) {
+            glDeleteFramebuffers(1, &priv.fbo);
+            glDeleteRenderbuffers(1, &priv.rbo);
+        }
+
+        eglMakeCurrent(priv.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(priv.display, priv.context);
+
+        LIBQU_LOGI("OpenGL context is destroyed.\n");
+    }
+
+    if (priv.surface != EGL_NO_SURFACE) {
+        eglDestroySurface(priv.display, priv.surface);
+    }
+
+    if (priv.display != EGL_NO_DISPLAY) {
+        eglTerminate(priv.display);
+    }
+
+    pl_close_dll(priv.gl_so);
+    pl_close_dll(priv.so);
+
+    memset(&priv, 0, sizeof(priv));
+
+    LIBQU_LOGI("Terminated.\n");
+}
+
+static bool core_egl_process(void)
+{
+    return true;
+}
+
+static void core_egl_swap(void)
+{
+    glFlush();
+}
+
+static bool core_egl_set_window_title(char const *title)
+{
+    return true;
+}
+
+static bool core_egl_set_window_size(qu_vec2i size)
+{
+    glBindRenderbuffer(GL_RENDERBUFFER, priv.rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+
+    return true;
+}
+
+static int core_egl_gl_get_version(void)
+{
+    return priv.gl_version;
+}
+
+static void *core_egl_gl_get_proc_address(char const *name)
+{
+    return get_gl_proc_address(name);
+}
+
+//------------------------------------------------------------------------------
+
+struct libqu_core_impl const libqu_core_egl_impl = {
+    core_egl_check_if_available,
+    core_egl_initialize,
+    core_egl_terminate,
+    core_egl_process,
+    core_egl_swap,
+    core_egl_set_window_title,
+    core_egl_set_window_size,
+    core_egl_gl_get_version,
+    core_egl_gl_get_proc_address,
+};
+
+//------------------------------------------------------------------------------
+
+#endif // QU_USE_EGL
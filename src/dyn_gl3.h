@@ -543,6 +543,35 @@ static int dyn_load_gl3(void)
 
 #undef PROC
 
+//------------------------------------------------------------------------------
+
+/*
+ * Functions beyond OpenGL 3.3. These are loaded without failing, so
+ * check for NULL before use.
+ */
+
+#define OPTIONAL_PROC_LIST \
+    PROC(PFNGLGETPROGRAMBINARYPROC,     glGetProgramBinary)             \
+    PROC(PFNGLPROGRAMBINARYPROC,        glProgramBinary)                \
+    PROC(PFNGLPROGRAMPARAMETERIPROC,    glProgramParameteri)
+
+#define PROC(type, name) \
+    static type dyn_##name;
+
+OPTIONAL_PROC_LIST
+
+#undef PROC
+
+#define PROC(type, name) \
+    dyn_##name = (type) libqu_gl_get_proc_address(#name);
+
+static void dyn_load_gl3_optional(void)
+{
+    OPTIONAL_PROC_LIST
+}
+
+#undef PROC
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
@@ -986,6 +1015,14 @@ static int dyn_load_gl3(void)
 #define glSecondaryColorP3ui            dyn_glSecondaryColorP3ui
 #define glSecondaryColorP3uiv           dyn_glSecondaryColorP3uiv
 
+/*
+ * OpenGL 4.1 or ARB_get_program_binary (optional)
+ */
+
+#define glGetProgramBinary              dyn_glGetProgramBinary
+#define glProgramBinary                 dyn_glProgramBinary
+#define glProgramParameteri             dyn_glProgramParameteri
+
 //------------------------------------------------------------------------------
 
 #endif // LIBQU_DYN_GL3_H_INC
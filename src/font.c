@@ -0,0 +1,842 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_ds.h>
+#include "fs.h"
+#include "graphics.h"
+#include "log.h"
+#include "platform.h"
+
+//------------------------------------------------------------------------------
+
+#define MAX_PAGES                   16
+#define LAYOUT_CACHE_SIZE           256
+#define REPLACEMENT_CHARACTER       0xFFFD
+
+//------------------------------------------------------------------------------
+
+/**
+ * Quad of a glyph relative to the pen position at the top of the line,
+ * with texture coordinates already normalized.
+ */
+struct glyph
+{
+    float x0, y0, x1, y1;
+    float s0, t0, s1, t1;
+    float advance;
+    int page;
+};
+
+struct glyph_item
+{
+    uint32_t key;
+    int value;
+};
+
+struct kerning_item
+{
+    uint64_t key;
+    float value;
+};
+
+struct placement
+{
+    int glyph;
+    float x;
+    float y;
+};
+
+/**
+ * Laid out text block. Placements are sorted by page, so each page is
+ * drawn as a single run of triangles.
+ */
+struct layout
+{
+    char *text;
+    float width;
+    qu_text_align align;
+    qu_vec2f size;
+    struct placement *placements;
+    int page_counts[MAX_PAGES];
+    uint32_t last_use;
+};
+
+struct layout_item
+{
+    uint64_t key;
+    struct layout *value;
+};
+
+struct line
+{
+    int start;
+    int end;
+    float width;
+};
+
+struct libqu_font
+{
+    struct libqu_texture *pages[MAX_PAGES];
+    int page_count;
+    float line_height;
+    bool sdf;
+
+    struct glyph *glyphs;
+    int ascii[128];
+    struct glyph_item *unicode;
+    struct kerning_item *kerning;
+
+    struct layout_item *layouts;
+    uint32_t layout_clock;
+};
+
+/**
+ * Scratch state shared by all fonts, layouts are built one at a time.
+ */
+static struct
+{
+    struct placement *placements;
+    struct line *lines;
+} priv;
+
+//------------------------------------------------------------------------------
+// Loading
+
+/**
+ * Finds `key=` in a line of the text format and returns its value.
+ * Quoted values are copied without quotes.
+ */
+static bool get_field(char const *line, char const *key, char *value, size_t size)
+{
+    size_t length = strlen(key);
+    char const *p = line;
+
+    while ((p = strstr(p, key))) {
+        bool at_start = (p == line) || p[-1] == ' ' || p[-1] == '\t';
+
+        if (!at_start || p[length] != '=') {
+            p += length;
+            continue;
+        }
+
+        p += length + 1;
+
+        char terminator = ' ';
+
+        if (*p == '"') {
+            terminator = '"';
+            p++;
+        }
+
+        size_t n = 0;
+
+        while (p[n] && p[n] != terminator && p[n] != '\r' && p[n] != '\n') {
+            n++;
+        }
+
+        if (n >= size) {
+            return false;
+        }
+
+        memcpy(value, p, n);
+        value[n] = '\0';
+        return true;
+    }
+
+    return false;
+}
+
+static int get_int_field(char const *line, char const *key, int fallback)
+{
+    char value[32];
+
+    if (!get_field(line, key, value, sizeof(value))) {
+        return fallback;
+    }
+
+    return atoi(value);
+}
+
+static bool starts_with_tag(char const *line, char const *tag)
+{
+    size_t length = strlen(tag);
+    return strncmp(line, tag, length) == 0 && (line[length] == ' ' || line[length] == '\t');
+}
+
+static char *read_text(struct libqu_file *file)
+{
+    char *text = pl_malloc(file->size + 1);
+
+    if (!text) {
+        return NULL;
+    }
+
+    if (libqu_fread(text, file->size, file) != (int64_t) file->size) {
+        pl_free(text);
+        return NULL;
+    }
+
+    text[file->size] = '\0';
+    return text;
+}
+
+/**
+ * Font pages are drawn tinted, so images without alpha are treated as
+ * coverage (or distance) masks of white glyphs.
+ */
+static struct libqu_image *convert_page_image(struct libqu_image *image)
+{
+    // Pixel format values are equal to channel counts.
+    int channels = image->format;
+
+    if (image->format == QU_PIXFMT_Y8A8 || image->format == QU_PIXFMT_R8G8B8A8) {
+        return image;
+    }
+
+    struct libqu_image *mask = libqu_image_create(QU_PIXFMT_Y8A8, image->size);
+
+    if (mask) {
+        int count = image->size.x * image->size.y;
+
+        for (int i = 0; i < count; i++) {
+            mask->pixels[2 * i + 0] = 255;
+            mask->pixels[2 * i + 1] = image->pixels[channels * i];
+        }
+    }
+
+    libqu_image_destroy(image);
+    return mask;
+}
+
+static struct libqu_texture *load_page(char const *font_path, char const *name, bool sdf)
+{
+    char path[LIBQU_FILE_NAME_LENGTH];
+    char const *slash = strrchr(font_path, '/');
+    char const *backslash = strrchr(font_path, '\\');
+
+    if (backslash > slash) {
+        slash = backslash;
+    }
+
+    int dir_length = slash ? (int) (slash - font_path + 1) : 0;
+
+    if (snprintf(path, sizeof(path), "%.*s%s", dir_length, font_path, name) >= (int) sizeof(path)) {
+        LIBQU_LOGE("Font page path is too long: %s\n", name);
+        return NULL;
+    }
+
+    struct libqu_file *file = libqu_fopen(path);
+
+    if (!file) {
+        LIBQU_LOGE("Failed to open font page %s.\n", path);
+        return NULL;
+    }
+
+    struct libqu_image *image = libqu_image_load(file);
+    libqu_fclose(file);
+
+    if (!image) {
+        return NULL;
+    }
+
+    // Converted pixels can't be decoded again from the file.
+    bool converted = image->format != QU_PIXFMT_Y8A8 && image->format != QU_PIXFMT_R8G8B8A8;
+    image = convert_page_image(image);
+
+    if (!image) {
+        return NULL;
+    }
+
+    struct libqu_texture_source source = { .path = path };
+    unsigned int flags = sdf ? (QU_TEXTURE_SMOOTH | QU_TEXTURE_SDF) : 0;
+
+    return libqu_graphics_load_texture_ex(image,
+        converted ? NULL : &source, flags);
+}
+
+static void add_glyph(struct libqu_font *font, char const *line, qu_vec2i scale)
+{
+    int id = get_int_field(line, "id", -1);
+    int page = get_int_field(line, "page", 0);
+
+    if (id < 0 || page < 0 || page >= MAX_PAGES) {
+        return;
+    }
+
+    float x = (float) get_int_field(line, "x", 0);
+    float y = (float) get_int_field(line, "y", 0);
+    float w = (float) get_int_field(line, "width", 0);
+    float h = (float) get_int_field(line, "height", 0);
+    float xoffset = (float) get_int_field(line, "xoffset", 0);
+    float yoffset = (float) get_int_field(line, "yoffset", 0);
+
+    struct glyph glyph = {
+        .x0 = xoffset,
+        .y0 = yoffset,
+        .x1 = xoffset + w,
+        .y1 = yoffset + h,
+        .s0 = x / scale.x,
+        .t0 = y / scale.y,
+        .s1 = (x + w) / scale.x,
+        .t1 = (y + h) / scale.y,
+        .advance = (float) get_int_field(line, "xadvance", 0),
+        .page = page,
+    };
+
+    int index = (int) arrlen(font->glyphs);
+    arrput(font->glyphs, glyph);
+
+    if (id < 128) {
+        font->ascii[id] = index;
+    } else {
+        hmput(font->unicode, (uint32_t) id, index);
+    }
+}
+
+static void add_kerning(struct libqu_font *font, char const *line)
+{
+    int first = get_int_field(line, "first", -1);
+    int second = get_int_field(line, "second", -1);
+    int amount = get_int_field(line, "amount", 0);
+
+    if (first < 0 || second < 0 || amount == 0) {
+        return;
+    }
+
+    uint64_t key = ((uint64_t) first << 32) | (uint32_t) second;
+    hmput(font->kerning, key, (float) amount);
+}
+
+/**
+ * Reads the text variant of the BMFont format. Glyph rectangles are
+ * converted to texture coordinates once, here.
+ */
+static bool parse_font(struct libqu_font *font, char *text, char const *path)
+{
+    char page_files[MAX_PAGES][LIBQU_FILE_NAME_LENGTH] = { { 0 } };
+    qu_vec2i scale = { 0, 0 };
+    int base = 0;
+
+    char *line = text;
+
+    // Distance field tag may come after pages, glyphs need the scale first.
+    font->sdf = strstr(text, "fieldType=sdf") || strstr(text, "fieldType=\"sdf\"");
+
+    while (line && *line) {
+        char *next = strchr(line, '\n');
+
+        if (next) {
+            *next++ = '\0';
+        }
+
+        if (starts_with_tag(line, "common")) {
+            font->line_height = (float) get_int_field(line, "lineHeight", 0);
+            base = get_int_field(line, "base", 0);
+            scale.x = get_int_field(line, "scaleW", 0);
+            scale.y = get_int_field(line, "scaleH", 0);
+        } else if (starts_with_tag(line, "page")) {
+            int id = get_int_field(line, "id", -1);
+
+            if (id >= 0 && id < MAX_PAGES) {
+                get_field(line, "file", page_files[id], LIBQU_FILE_NAME_LENGTH);
+                font->page_count = LIBQU_MAX(font->page_count, id + 1);
+            }
+        } else if (starts_with_tag(line, "char")) {
+            if (scale.x <= 0 || scale.y <= 0) {
+                LIBQU_LOGE("Font %s has no valid common block.\n", path);
+                return false;
+            }
+
+            add_glyph(font, line, scale);
+        } else if (starts_with_tag(line, "kerning")) {
+            add_kerning(font, line);
+        }
+
+        line = next;
+    }
+
+    if (arrlen(font->glyphs) == 0 || font->page_count == 0) {
+        LIBQU_LOGE("Font %s has no glyphs.\n", path);
+        return false;
+    }
+
+    if (font->line_height <= 0.f) {
+        font->line_height = (float) base;
+    }
+
+    for (int i = 0; i < font->page_count; i++) {
+        if (!page_files[i][0]) {
+            continue;
+        }
+
+        font->pages[i] = load_page(path, page_files[i], font->sdf);
+
+        if (!font->pages[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Layout
+
+static uint32_t decode_utf8(unsigned char const **cursor)
+{
+    unsigned char const *p = *cursor;
+    uint32_t c = *p++;
+    int extra = 0;
+
+    if (c >= 0xF0 && c < 0xF8) {
+        c &= 0x07;
+        extra = 3;
+    } else if (c >= 0xE0) {
+        c &= 0x0F;
+        extra = 2;
+    } else if (c >= 0xC0) {
+        c &= 0x1F;
+        extra = 1;
+    } else if (c >= 0x80) {
+        c = REPLACEMENT_CHARACTER;
+    }
+
+    for (int i = 0; i < extra; i++) {
+        if ((*p & 0xC0) != 0x80) {
+            c = REPLACEMENT_CHARACTER;
+            break;
+        }
+
+        c = (c << 6) | (*p++ & 0x3F);
+    }
+
+    *cursor = p;
+    return c;
+}
+
+static int find_glyph(struct libqu_font const *font, uint32_t c)
+{
+    if (c < 128) {
+        return font->ascii[c];
+    }
+
+    struct glyph_item *unicode = font->unicode;
+    ptrdiff_t index = hmgeti(unicode, c);
+
+    if (index >= 0) {
+        return unicode[index].value;
+    }
+
+    return font->ascii['?'];
+}
+
+static float get_kerning(struct libqu_font const *font, uint32_t first, uint32_t second)
+{
+    if (!font->kerning || first == 0) {
+        return 0.f;
+    }
+
+    struct kerning_item *kerning = font->kerning;
+    ptrdiff_t index = hmgeti(kerning, ((uint64_t) first << 32) | second);
+
+    return (index >= 0) ? kerning[index].value : 0.f;
+}
+
+static void finish_line(int start, int end, float width)
+{
+    struct line line = { start, end, width };
+    arrput(priv.lines, line);
+}
+
+/**
+ * Breaks text into lines at '\n', and also at the last space before
+ * `width` is exceeded (if `width` is positive). Words longer than a line
+ * are broken between glyphs.
+ */
+static void break_lines(struct libqu_font const *font, char const *text, float width)
+{
+    unsigned char const *cursor = (unsigned char const *) text;
+
+    float x = 0.f;
+    float y = 0.f;
+    float content = 0.f;        // Pen position after the last visible glyph
+    int start = 0;
+    int space = -1;             // First placement after the last space
+    float space_x = 0.f;        // Pen position after that space
+    float space_content = 0.f;  // Content width before that space
+    uint32_t previous = 0;
+
+    arrsetlen(priv.placements, 0);
+    arrsetlen(priv.lines, 0);
+
+    while (*cursor) {
+        uint32_t c = decode_utf8(&cursor);
+
+        if (c == '\n') {
+            finish_line(start, (int) arrlen(priv.placements), content);
+            start = (int) arrlen(priv.placements);
+            x = content = 0.f;
+            y += font->line_height;
+            space = -1;
+            previous = 0;
+            continue;
+        }
+
+        int index = find_glyph(font, c);
+
+        if (index < 0) {
+            continue;
+        }
+
+        struct glyph const *glyph = &font->glyphs[index];
+        x += get_kerning(font, previous, c);
+        previous = c;
+
+        if (c == ' ') {
+            space = (int) arrlen(priv.placements);
+            space_content = content;
+            x += glyph->advance;
+            space_x = x;
+            continue;
+        }
+
+        int count = (int) arrlen(priv.placements);
+
+        if (width > 0.f && x + glyph->advance > width && count > start) {
+            float shift;
+
+            if (space > start) {
+                finish_line(start, space, space_content);
+                start = space;
+                shift = space_x;
+            } else {
+                finish_line(start, count, content);
+                start = count;
+                shift = x;
+            }
+
+            y += font->line_height;
+
+            for (int i = start; i < count; i++) {
+                priv.placements[i].x -= shift;
+                priv.placements[i].y = y;
+            }
+
+            x -= shift;
+            content = LIBQU_MAX(0.f, content - shift);
+            space = -1;
+            space_x = 0.f;
+        }
+
+        if (glyph->x1 > glyph->x0 && glyph->y1 > glyph->y0) {
+            struct placement placement = { index, x, y };
+            arrput(priv.placements, placement);
+        }
+
+        x += glyph->advance;
+        content = x;
+    }
+
+    finish_line(start, (int) arrlen(priv.placements), content);
+}
+
+static struct layout *create_layout(struct libqu_font const *font,
+    char const *text, float width, qu_text_align align)
+{
+    struct layout *layout = pl_calloc(1, sizeof(*layout));
+
+    if (!layout) {
+        return NULL;
+    }
+
+    size_t length = strlen(text);
+    layout->text = pl_malloc(length + 1);
+
+    if (!layout->text) {
+        pl_free(layout);
+        return NULL;
+    }
+
+    memcpy(layout->text, text, length + 1);
+    layout->width = width;
+    layout->align = align;
+
+    break_lines(font, text, width);
+
+    float block = 0.f;
+
+    for (int i = 0; i < arrlen(priv.lines); i++) {
+        block = LIBQU_MAX(block, priv.lines[i].width);
+    }
+
+    if (width > 0.f) {
+        block = LIBQU_MAX(block, width);
+    }
+
+    int line_count = (int) arrlen(priv.lines);
+    layout->size.x = block;
+    layout->size.y = line_count * font->line_height;
+
+    if (align != QU_ALIGN_LEFT) {
+        float factor = (align == QU_ALIGN_CENTER) ? 0.5f : 1.f;
+
+        for (int i = 0; i < line_count; i++) {
+            struct line const *line = &priv.lines[i];
+            float offset = floorf((block - line->width) * factor);
+
+            for (int j = line->start; j < line->end; j++) {
+                priv.placements[j].x += offset;
+            }
+        }
+    }
+
+    // Counting sort by page keeps the text order within each page.
+    int offsets[MAX_PAGES] = { 0 };
+    int count = (int) arrlen(priv.placements);
+
+    for (int i = 0; i < count; i++) {
+        layout->page_counts[font->glyphs[priv.placements[i].glyph].page]++;
+    }
+
+    for (int page = 1; page < MAX_PAGES; page++) {
+        offsets[page] = offsets[page - 1] + layout->page_counts[page - 1];
+    }
+
+    arrsetlen(layout->placements, count);
+
+    for (int i = 0; i < count; i++) {
+        int page = font->glyphs[priv.placements[i].glyph].page;
+        layout->placements[offsets[page]++] = priv.placements[i];
+    }
+
+    return layout;
+}
+
+static void destroy_layout(struct layout *layout)
+{
+    arrfree(layout->placements);
+    pl_free(layout->text);
+    pl_free(layout);
+}
+
+static uint64_t get_layout_key(char const *text, float width, qu_text_align align)
+{
+    uint32_t bits;
+    memcpy(&bits, &width, sizeof(bits));
+
+    uint64_t key = stbds_hash_string((char *) text, 0x51F15EED);
+    key ^= ((uint64_t) bits << 2 | (uint64_t) align) * 0x9E3779B97F4A7C15ull;
+
+    return key;
+}
+
+static void evict_layout(struct libqu_font *font)
+{
+    ptrdiff_t oldest = -1;
+
+    for (ptrdiff_t i = 0; i < hmlen(font->layouts); i++) {
+        if (oldest < 0 || font->layouts[i].value->last_use < font->layouts[oldest].value->last_use) {
+            oldest = i;
+        }
+    }
+
+    if (oldest >= 0) {
+        destroy_layout(font->layouts[oldest].value);
+        (void) hmdel(font->layouts, font->layouts[oldest].key);
+    }
+}
+
+/**
+ * Returns the cached layout of the text, laying it out on a miss.
+ * Cache is keyed by a hash, the stored copy of the text confirms a hit.
+ */
+static struct layout *get_layout(struct libqu_font *font,
+    char const *text, float width, qu_text_align align)
+{
+    uint64_t key = get_layout_key(text, width, align);
+    ptrdiff_t index = hmgeti(font->layouts, key);
+    struct layout *layout = NULL;
+
+    if (index >= 0) {
+        layout = font->layouts[index].value;
+
+        if (layout->width != width || layout->align != align || strcmp(layout->text, text) != 0) {
+            destroy_layout(layout);
+            (void) hmdel(font->layouts, key);
+            layout = NULL;
+        }
+    }
+
+    if (!layout) {
+        if (hmlen(font->layouts) >= LAYOUT_CACHE_SIZE) {
+            evict_layout(font);
+        }
+
+        layout = create_layout(font, text, width, align);
+
+        if (!layout) {
+            return NULL;
+        }
+
+        hmput(font->layouts, key, layout);
+    }
+
+    layout->last_use = ++font->layout_clock;
+    return layout;
+}
+
+//------------------------------------------------------------------------------
+
+struct libqu_font *libqu_font_load(struct libqu_file *file)
+{
+    char *text = read_text(file);
+
+    if (!text) {
+        LIBQU_LOGE("Failed to read font %s.\n", file->name);
+        return NULL;
+    }
+
+    if (strncmp(text, "info", 4) != 0) {
+        LIBQU_LOGE("%s is not a text BMFont file.\n", file->name);
+        pl_free(text);
+        return NULL;
+    }
+
+    struct libqu_font *font = pl_calloc(1, sizeof(*font));
+
+    if (!font) {
+        pl_free(text);
+        return NULL;
+    }
+
+    for (int i = 0; i < 128; i++) {
+        font->ascii[i] = -1;
+    }
+
+    bool parsed = parse_font(font, text, file->name);
+    pl_free(text);
+
+    if (!parsed) {
+        libqu_font_destroy(font);
+        return NULL;
+    }
+
+    LIBQU_LOGI("Loaded font %s: %d glyphs, %d page(s)%s.\n", file->name,
+        (int) arrlen(font->glyphs), font->page_count, font->sdf ? ", SDF" : "");
+
+    return font;
+}
+
+void libqu_font_destroy(struct libqu_font *font)
+{
+    for (ptrdiff_t i = 0; i < hmlen(font->layouts); i++) {
+        destroy_layout(font->layouts[i].value);
+    }
+
+    for (int i = 0; i < font->page_count; i++) {
+        if (font->pages[i]) {
+            libqu_graphics_destroy_texture(font->pages[i]);
+        }
+    }
+
+    hmfree(font->layouts);
+    hmfree(font->kerning);
+    hmfree(font->unicode);
+    arrfree(font->glyphs);
+    pl_free(font);
+
+    arrfree(priv.placements);
+    arrfree(priv.lines);
+}
+
+qu_vec2f libqu_font_measure(struct libqu_font *font, char const *text,
+    float width, float scale)
+{
+    qu_vec2f size = { 0.f, 0.f };
+
+    if (scale <= 0.f) {
+        return size;
+    }
+
+    struct layout *layout = get_layout(font, text, width / scale, QU_ALIGN_LEFT);
+
+    if (layout) {
+        size.x = layout->size.x * scale;
+        size.y = layout->size.y * scale;
+    }
+
+    return size;
+}
+
+/**
+ * Every page used by the text is drawn with a single run of triangles
+ * written straight into the frame's vertex stream.
+ */
+void libqu_font_draw(struct libqu_font *font, qu_vec2f pos, char const *text,
+    float width, float scale, qu_text_align align, qu_color color)
+{
+    if (scale <= 0.f) {
+        return;
+    }
+
+    struct layout *layout = get_layout(font, text, width / scale, align);
+
+    if (!layout) {
+        return;
+    }
+
+    struct placement const *placement = layout->placements;
+
+    for (int page = 0; page < font->page_count; page++) {
+        int count = layout->page_counts[page];
+
+        if (count == 0) {
+            continue;
+        }
+
+        if (!font->pages[page]) {
+            placement += count;
+            continue;
+        }
+
+        struct libqu_vertex *v =
+            libqu_graphics_reserve_triangles(font->pages[page], 6 * count);
+
+        for (int i = 0; i < count; i++, placement++, v += 6) {
+            struct glyph const *glyph = &font->glyphs[placement->glyph];
+
+            float ax = pos.x + (placement->x + glyph->x0) * scale;
+            float ay = pos.y + (placement->y + glyph->y0) * scale;
+            float bx = pos.x + (placement->x + glyph->x1) * scale;
+            float by = pos.y + (placement->y + glyph->y1) * scale;
+
+            v[0] = (struct libqu_vertex) { { ax, ay }, color, { glyph->s0, glyph->t0 } };
+            v[1] = (struct libqu_vertex) { { bx, ay }, color, { glyph->s1, glyph->t0 } };
+            v[2] = (struct libqu_vertex) { { bx, by }, color, { glyph->s1, glyph->t1 } };
+            v[3] = v[2];
+            v[4] = (struct libqu_vertex) { { ax, by }, color, { glyph->s0, glyph->t1 } };
+            v[5] = v[0];
+        }
+    }
+}
@@ -18,20 +18,55 @@
 // 3. This notice may not be removed or altered from any source distribution.
 //------------------------------------------------------------------------------
 
+#include <limits.h>
+#include <math.h>
+#include <string.h>
 #include <stb_ds.h>
 #include <stb_image.h>
 #include "graphics.h"
 #include "log.h"
+#include "pixels.h"
 #include "platform.h"
+#include "simd.h"
 
 //------------------------------------------------------------------------------
 
-static struct libqu_graphics_impl const *impl_list[] = {
+#define ALPHA_TILE_SIZE             64
+#define ALPHA_TILE_THRESHOLD        256
+
+#define DEFAULT_FLUSH_VERTICES      65536
+#define DEFAULT_FLUSH_COMMANDS      4096
+
+#define MIN_RENDER_SCALE            0.25f
+#define DYNAMIC_RESOLUTION_FRAMES   30
+#define DYNAMIC_RESOLUTION_STEP     0.05f
+#define DYNAMIC_RESOLUTION_MAX_STEP 0.25f
+
+#define REDRAW_TILE_SIZE            64
+#define MAX_REDRAW_RECTS            8
+#define TILE_HASH_SEED              0xCBF29CE484222325ull
+
+#define BLIT_CHUNK_PIXELS           256
+
+// Memory sizes below which textures are scaled down automatically.
+#define AUTO_DOWNSCALE_4X_MEMORY    (1024ull << 20)
+#define AUTO_DOWNSCALE_2X_MEMORY    (3072ull << 20)
+
+#define DEGREES_TO_RADIANS          0.017453292519943295f
+
+//------------------------------------------------------------------------------
+
+static struct
+{
+    char const *name;
+    struct libqu_graphics_impl const *impl;
+} const impl_list[] = {
 #ifdef QU_USE_OPENGL
-    &libqu_graphics_gl3_impl,
+    { "gl3", &libqu_graphics_gl3_impl },
 #endif
 
-    &libqu_graphics_null_impl,
+    { "soft", &libqu_graphics_soft_impl },
+    { "null", &libqu_graphics_null_impl },
 };
 
 //------------------------------------------------------------------------------
@@ -41,6 +76,10 @@ enum renderop
     RENDEROP_CLEAR,
     RENDEROP_DRAW,
     RENDEROP_SET_BLEND_MODE,
+    RENDEROP_DRAW_BUFFER,
+    RENDEROP_DRAW_PARTICLES,
+    RENDEROP_SET_CLIP,
+    RENDEROP_SET_TEXTURES,
 };
 
 struct rendercmd
@@ -57,11 +96,35 @@ struct rendercmd
             size_t vertex;
             size_t count;
             struct libqu_texture *texture;
+            enum libqu_blend_hint hint;
         } draw;
 
         struct {
             qu_blend_mode mode;
         } set_blend_mode;
+
+        struct {
+            struct libqu_vertex_buffer *buffer;
+            struct libqu_texture *texture;
+            enum libqu_blend_hint hint;
+            affine_t transform;
+        } draw_buffer;
+
+        struct {
+            struct libqu_particle_buffer *buffer;
+            struct libqu_texture *texture;
+            affine_t transform;
+        } draw_particles;
+
+        struct {
+            bool enabled;
+            qu_recti rect;
+        } set_clip;
+
+        struct {
+            struct libqu_texture *textures[LIBQU_MAX_TEXTURE_UNITS];
+            int count;
+        } set_textures;
     } args;
 };
 
@@ -69,9 +132,84 @@ static struct
 {
     struct libqu_graphics_impl const *impl;
     struct libqu_vertex *vertbuf;
+    int8_t *unitbuf;
     struct rendercmd *rendercmds;
     unsigned int default_texture_flags;
+    bool premultiplied;
+    int texture_downscale;
     qu_vec2i window_size;
+    qu_blend_mode blend_mode;
+
+    qu_recti *clip_stack;
+    bool clip_enabled;
+    qu_recti clip_rect;
+
+    // Transform applied to vertices on the CPU as they are recorded, so
+    // that it never splits a batch.
+    affine_t transform;
+    affine_t *transform_stack;
+    bool transform_identity;
+
+    // Vertices handed out by libqu_graphics_reserve_triangles() are only
+    // transformed once filled in, i.e. when anything else is recorded.
+    size_t reserved_vertex;
+    size_t reserved_count;
+    affine_t reserved_transform;
+
+    // Texture units bound at once, and the texture set command that is
+    // still open for new textures (-1 if none).
+    int texture_units;
+    ptrdiff_t texture_set;
+
+    // High-water marks, zero means default.
+    size_t flush_vertices;
+    size_t flush_commands;
+    qu_graphics_stats stats;
+
+    struct libqu_texture **textures;
+    bool release_pixels;
+    size_t texture_budget;
+    size_t texture_memory;
+    unsigned int serial;
+
+    // Render resolution. Requested scale is applied when the next frame
+    // begins, since the backend can't change its target in the middle of
+    // a frame, and the presented one has to stay readable until then.
+    float render_scale;
+    float requested_scale;
+    bool upscale_smooth;
+    bool render_scale_dirty;
+    bool frame_begun;
+    double target_frame_time;
+    float min_render_scale;
+    double average_frame_time;
+    int measured_frames;
+
+    // Incremental redraw. Every frame leaves a hash per screen tile of
+    // everything drawn over it, and tiles that hash the same as in the
+    // previous frame are left alone.
+    bool incremental;
+    bool full_redraw;
+    bool frame_flushed;
+    int tile_cols;
+    int tile_rows;
+    uint64_t *tile_hashes;
+    uint64_t *prev_tile_hashes;
+    bool *invalid_tiles;
+    unsigned int texture_version;
+    unsigned int frame_index;
+
+    // Identical frame skipping. The hash covers every command and vertex
+    // of a frame, so it can only tell whether the whole frame changed.
+    bool frame_skipping;
+    bool skip_swap;
+    uint64_t frame_hash;
+    uint64_t prev_frame_hash;
+
+    // State of the backend after the commands executed so far.
+    qu_blend_mode exec_blend_mode;
+    bool exec_clip_enabled;
+    qu_recti exec_clip_rect;
 } priv;
 
 //------------------------------------------------------------------------------
@@ -80,9 +218,23 @@ static struct libqu_graphics_impl const *choose_impl(void)
 {
     int count = sizeof(impl_list) / sizeof(impl_list[0]);
 
+    // Backend can be forced, e.g. LIBQU_GRAPHICS=soft for headless runs.
+    char const *name = getenv("LIBQU_GRAPHICS");
+
+    if (name) {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(impl_list[i].name, name) == 0
+                    && impl_list[i].impl->check_if_available()) {
+                return impl_list[i].impl;
+            }
+        }
+
+        LIBQU_LOGW("Graphics backend \"%s\" is not available.\n", name);
+    }
+
     for (int i = 0; i < count; i++) {
-        if (impl_list[i]->check_if_available()) {
-            return impl_list[i];
+        if (impl_list[i].impl->check_if_available()) {
+            return impl_list[i].impl;
         }
     }
 
@@ -96,514 +248,3278 @@ static void exec_cmd(struct rendercmd const *cmd)
         priv.impl->clear(cmd->args.clear.color);
         break;
     case RENDEROP_DRAW:
-        priv.impl->apply_texture(cmd->args.draw.texture);
+        priv.impl->apply_blend_hint(cmd->args.draw.hint);
+
+        // Batched draws take textures from the last texture set.
+        if (priv.texture_units == 1) {
+            priv.impl->apply_texture(cmd->args.draw.texture);
+        }
+
         priv.impl->draw(cmd->args.draw.mode, cmd->args.draw.vertex, cmd->args.draw.count);
         break;
     case RENDEROP_SET_BLEND_MODE:
         priv.impl->apply_blend_mode(&cmd->args.set_blend_mode.mode);
+        priv.exec_blend_mode = cmd->args.set_blend_mode.mode;
+        break;
+    case RENDEROP_DRAW_BUFFER:
+        priv.impl->apply_blend_hint(cmd->args.draw_buffer.hint);
+        priv.impl->apply_texture(cmd->args.draw_buffer.texture);
+        priv.impl->draw_vertex_buffer(cmd->args.draw_buffer.buffer, &cmd->args.draw_buffer.transform);
+        cmd->args.draw_buffer.buffer->queued = false;
+        break;
+    case RENDEROP_DRAW_PARTICLES:
+        priv.impl->apply_blend_hint(LIBQU_BLEND_HINT_NONE);
+        priv.impl->apply_texture(cmd->args.draw_particles.texture);
+        priv.impl->draw_particle_buffer(cmd->args.draw_particles.buffer, &cmd->args.draw_particles.transform);
+        cmd->args.draw_particles.buffer->queued = false;
+        break;
+    case RENDEROP_SET_CLIP:
+        priv.impl->apply_clip(cmd->args.set_clip.enabled ? &cmd->args.set_clip.rect : NULL);
+        priv.exec_clip_enabled = cmd->args.set_clip.enabled;
+        priv.exec_clip_rect = cmd->args.set_clip.rect;
+        break;
+    case RENDEROP_SET_TEXTURES:
+        priv.impl->apply_texture_set(cmd->args.set_textures.textures, cmd->args.set_textures.count);
         break;
     default:
         break;
     }
 }
 
-static size_t append_vertices(struct libqu_vertex const *vertices, size_t count)
+static int pixfmt_to_channels(qu_pixel_format format)
 {
-    size_t offset = arrlenu(priv.vertbuf);
+    switch (format) {
+    default:
+        return 0;
+    case QU_PIXFMT_Y8:
+        return 1;
+    case QU_PIXFMT_Y8A8:
+        return 2;
+    case QU_PIXFMT_R8G8B8:
+        return 3;
+    case QU_PIXFMT_R8G8B8A8:
+        return 4;
+    }
+}
 
-    struct libqu_vertex *ptr = arraddnptr(priv.vertbuf, (int) count);
-    memcpy(ptr, vertices, sizeof(*ptr) * count);
+//------------------------------------------------------------------------------
+// Texture residency. With pixel release enabled, textures that know their
+// source keep no CPU copy of their pixels after upload. With a budget set,
+// idle textures are evicted from the backend in LRU order and uploaded
+// again (decoding the source) when they are drawn next time.
 
-    return offset;
+static size_t get_texture_memory(struct libqu_texture const *texture)
+{
+    return (size_t) texture->size.x * texture->size.y * pixfmt_to_channels(texture->format);
 }
 
-//------------------------------------------------------------------------------
+static bool has_texture_source(struct libqu_texture const *texture)
+{
+    return texture->source.path || texture->source.buffer;
+}
 
-void libqu_graphics_initialize(struct libqu_graphics_params const *params)
+static void copy_texture_source(struct libqu_texture_source *dst,
+    struct libqu_texture_source const *src)
 {
-    priv.impl = choose_impl();
+    if (src->path) {
+        size_t length = strlen(src->path) + 1;
+        char *path = pl_malloc(length);
 
-    if (!priv.impl->initialize(params)) {
-        LIBQU_LOGE("Failed to initialize libqu::graphics implementation.\n");
-        abort();
+        if (path) {
+            memcpy(path, src->path, length);
+            dst->path = path;
+        }
+    } else if (src->buffer) {
+        void *buffer = pl_malloc(src->size);
+
+        if (buffer) {
+            memcpy(buffer, src->buffer, src->size);
+            dst->buffer = buffer;
+            dst->size = src->size;
+        }
     }
+}
 
-    priv.window_size = params->window_size;
+static void free_texture_source(struct libqu_texture_source *source)
+{
+    pl_free((void *) source->path);
+    pl_free((void *) source->buffer);
+    memset(source, 0, sizeof(*source));
+}
 
-    LIBQU_LOGI("Initialized.\n");
+/**
+ * Distance fields are kept as is: their alpha only becomes coverage in
+ * the backend, which multiplies color by it there.
+ */
+static bool needs_premultiplied_pixels(struct libqu_texture const *texture)
+{
+    return texture->premultiplied && !(texture->flags & QU_TEXTURE_SDF);
 }
 
-void libqu_graphics_terminate(void)
+/**
+ * Brings decoded pixels to the form the texture stores them in: color
+ * premultiplied if needed, then scaled down. Alpha is premultiplied
+ * first, so that averaging doesn't bleed color of transparent texels.
+ * Consumes the image, returns NULL on failure.
+ */
+static struct libqu_image *prepare_texture_pixels(
+    struct libqu_texture const *texture, struct libqu_image *image)
 {
-    arrfree(priv.rendercmds);
-    priv.impl->terminate();
+    if (needs_premultiplied_pixels(texture)) {
+        libqu_image_premultiply(image);
+    }
 
-    memset(&priv, 0, sizeof(priv));
+    if (texture->downscale > 0) {
+        struct libqu_image *scaled = libqu_image_downscale(image, texture->downscale);
 
-    LIBQU_LOGI("Terminated.\n");
+        libqu_image_destroy(image);
+        image = scaled;
+    }
+
+    return image;
 }
 
-void libqu_graphics_flush(void)
+static bool fetch_texture_pixels(struct libqu_texture *texture)
 {
-    priv.impl->upload_vertices(priv.vertbuf, arrlenu(priv.vertbuf));
+    if (texture->image) {
+        return true;
+    }
 
-    for (size_t i = 0; i < arrlenu(priv.rendercmds); i++) {
-        exec_cmd(&priv.rendercmds[i]);
+    if (!has_texture_source(texture)) {
+        return false;
     }
 
-    arrsetlen(priv.vertbuf, 0);
-    arrsetlen(priv.rendercmds, 0);
+    struct libqu_texture_source const *source = &texture->source;
+    struct libqu_file *file = source->path
+        ? libqu_fopen(source->path)
+        : libqu_fopen_buffer(source->buffer, source->size);
+
+    if (file) {
+        texture->image = libqu_image_load(file);
+        libqu_fclose(file);
+    }
+
+    if (texture->image) {
+        texture->image = prepare_texture_pixels(texture, texture->image);
+    }
+
+    if (!texture->image) {
+        LIBQU_LOGE("Failed to decode texture pixels again.\n");
+        return false;
+    }
+
+    return true;
 }
 
-void libqu_graphics_clear(qu_color color)
+static void release_texture_pixels(struct libqu_texture *texture)
 {
-    struct rendercmd cmd = {
-        .op = RENDEROP_CLEAR,
-        .args = {
-            .clear = {
-                .color = color,
-            },
-        },
-    };
+    if (!priv.release_pixels || !texture->resident || !texture->image) {
+        return;
+    }
 
-    arrput(priv.rendercmds, cmd);
+    if (has_texture_source(texture)) {
+        libqu_image_destroy(texture->image);
+        texture->image = NULL;
+    }
 }
 
-void libqu_graphics_draw_point(qu_vec2f pos, qu_color color)
+static bool upload_texture(struct libqu_texture *texture)
 {
-    struct libqu_vertex vertices[] = {
-        { .pos = pos, .color = color },
-    };
+    if (!fetch_texture_pixels(texture)) {
+        return false;
+    }
 
-    struct rendercmd cmd = {
-        .op = RENDEROP_DRAW,
-        .args = {
-            .draw = {
-                .mode = LIBQU_DRAW_MODE_POINTS,
-                .vertex = append_vertices(vertices, 1),
-                .count = 1,
-            },
-        },
-    };
+    if (priv.impl->load_texture(texture) != 0) {
+        return false;
+    }
 
-    arrput(priv.rendercmds, cmd);
+    texture->resident = true;
+    priv.texture_memory += get_texture_memory(texture);
+
+    release_texture_pixels(texture);
+
+    return true;
 }
 
-void libqu_graphics_draw_line(qu_vec2f a, qu_vec2f b, qu_color color)
+static void evict_texture(struct libqu_texture *texture)
 {
-    struct libqu_vertex vertices[] = {
-        { .pos = a, .color = color },
-        { .pos = b, .color = color },
-    };
-
-    struct rendercmd cmd = {
-        .op = RENDEROP_DRAW,
-        .args = {
-            .draw = {
-                .mode = LIBQU_DRAW_MODE_LINES,
-                .vertex = append_vertices(vertices, 2),
-                .count = 2,
-            },
-        },
-    };
+    priv.impl->destroy_texture(texture);
+    memset(texture->priv, 0, sizeof(texture->priv));
 
-    arrput(priv.rendercmds, cmd);
+    texture->resident = false;
+    priv.texture_memory -= get_texture_memory(texture);
+    priv.stats.texture_evictions++;
 }
 
-void libqu_graphics_draw_triangle(qu_vec2f a, qu_vec2f b, qu_vec2f c, qu_color outline, qu_color fill)
+/**
+ * Evicts least recently used textures until the budget is met. Textures
+ * referenced by commands that aren't flushed yet are kept, as well as
+ * those that can't be decoded again.
+ */
+static void enforce_texture_budget(void)
 {
-    if (QU_EXTRACT_ALPHA(fill) > 0) {
-        struct libqu_vertex vertices[] = {
-            { .pos = a, .color = fill },
-            { .pos = b, .color = fill },
-            { .pos = c, .color = fill },
-        };
+    if (priv.texture_budget == 0) {
+        return;
+    }
 
-        struct rendercmd cmd = {
-            .op = RENDEROP_DRAW,
-            .args = {
-                .draw = {
-                    .mode = LIBQU_DRAW_MODE_TRIANGLE_FAN,
-                    .vertex = append_vertices(vertices, 3),
-                    .count = 3,
-                },
-            },
-        };
+    while (priv.texture_memory > priv.texture_budget) {
+        struct libqu_texture *victim = NULL;
 
-        arrput(priv.rendercmds, cmd);
-    }
+        for (size_t i = 0; i < arrlenu(priv.textures); i++) {
+            struct libqu_texture *texture = priv.textures[i];
 
-    if (QU_EXTRACT_ALPHA(outline) > 0) {
-        struct libqu_vertex vertices[] = {
-            { .pos = a, .color = outline },
-            { .pos = b, .color = outline },
-            { .pos = c, .color = outline },
-        };
+            if (!texture->resident || texture->last_use == priv.serial
+                || !has_texture_source(texture)) {
+                continue;
+            }
 
-        struct rendercmd cmd = {
-            .op = RENDEROP_DRAW,
-            .args = {
-                .draw = {
-                    .mode = LIBQU_DRAW_MODE_LINE_LOOP,
-                    .vertex = append_vertices(vertices, 3),
-                    .count = 3,
-                },
-            },
-        };
+            if (!victim || texture->last_use < victim->last_use) {
+                victim = texture;
+            }
+        }
+
+        if (!victim) {
+            break;
+        }
 
-        arrput(priv.rendercmds, cmd);
+        evict_texture(victim);
     }
 }
 
-void libqu_graphics_draw_rectangle(qu_vec2f pos, qu_vec2f size, qu_color outline, qu_color fill)
+/**
+ * Marks the texture as used by the current batch of commands, uploading
+ * it again if it was evicted.
+ */
+static void touch_texture(struct libqu_texture *texture)
 {
-    float ax = pos.x;
-    float ay = pos.y;
-    float bx = pos.x + size.x;
-    float by = pos.y + size.y;
-
-    if (QU_EXTRACT_ALPHA(fill) > 0) {
-        struct libqu_vertex vertices[] = {
-            { .pos = { ax, ay }, .color = fill },
-            { .pos = { bx, ay }, .color = fill },
-            { .pos = { bx, by }, .color = fill },
-            { .pos = { ax, by }, .color = fill },
-        };
-
-        struct rendercmd cmd = {
-            .op = RENDEROP_DRAW,
-            .args = {
-                .draw = {
-                    .mode = LIBQU_DRAW_MODE_TRIANGLE_FAN,
-                    .vertex = append_vertices(vertices, 4),
-                    .count = 4,
-                },
-            },
-        };
-
-        arrput(priv.rendercmds, cmd);
+    if (!texture) {
+        return;
     }
 
-    if (QU_EXTRACT_ALPHA(outline) > 0) {
-        struct libqu_vertex vertices[] = {
-            { .pos = { ax, ay }, .color = outline },
-            { .pos = { bx, ay }, .color = outline },
-            { .pos = { bx, by }, .color = outline },
-            { .pos = { ax, by }, .color = outline },
-        };
+    texture->last_use = priv.serial;
 
-        struct rendercmd cmd = {
-            .op = RENDEROP_DRAW,
-            .args = {
-                .draw = {
-                    .mode = LIBQU_DRAW_MODE_LINE_LOOP,
-                    .vertex = append_vertices(vertices, 4),
-                    .count = 4,
-                },
-            },
-        };
+    // Split textures are only drawn through their cells.
+    if (texture->resident || texture->grid.cells) {
+        return;
+    }
 
-        arrput(priv.rendercmds, cmd);
+    if (!upload_texture(texture)) {
+        LIBQU_LOGE("Failed to restore evicted texture.\n");
+        return;
     }
+
+    enforce_texture_budget();
 }
 
 //------------------------------------------------------------------------------
 
-static int _stbi_io_read(struct libqu_file *file, char *data, int size)
+static void transform_vertices_scalar(struct libqu_vertex *dst,
+    struct libqu_vertex const *src, size_t start, size_t end, affine_t const *m)
 {
-    return (int) libqu_fread(data, size, file);
+    for (size_t i = start; i < end; i++) {
+        dst[i] = src[i];
+        dst[i].pos.x = m->m[0] * src[i].pos.x + m->m[2] * src[i].pos.y + m->m[4];
+        dst[i].pos.y = m->m[1] * src[i].pos.x + m->m[3] * src[i].pos.y + m->m[5];
+    }
 }
 
-static void _stbi_io_skip(struct libqu_file *file, int n)
-{
-    libqu_fseek(file, n, SEEK_CUR);
-}
+#ifdef LIBQU_SIMD_SSE2
 
-static int _stbi_io_eof(struct libqu_file *file)
+/**
+ * Positions of four vertices are gathered into x and y lanes, which are
+ * transformed at once and scattered back. Other attributes are copied
+ * as they are.
+ */
+static void transform_vertices_sse2(struct libqu_vertex *dst,
+    struct libqu_vertex const *src, size_t end, affine_t const *m)
 {
-    return libqu_ftell(file) == (int64_t) file->size;
-}
+    __m128 a = _mm_set1_ps(m->m[0]);
+    __m128 b = _mm_set1_ps(m->m[1]);
+    __m128 c = _mm_set1_ps(m->m[2]);
+    __m128 d = _mm_set1_ps(m->m[3]);
+    __m128 tx = _mm_set1_ps(m->m[4]);
+    __m128 ty = _mm_set1_ps(m->m[5]);
+    __m128 zero = _mm_setzero_ps();
+
+    for (size_t i = 0; i < end; i += 4) {
+        if (dst != src) {
+            memcpy(&dst[i], &src[i], sizeof(*dst) * 4);
+        }
 
-typedef int (*_stbi_io_read_func)(void *, char *, int);
-typedef void (*_stbi_io_skip_func)(void *, int);
-typedef int (*_stbi_io_eof_func)(void *);
+        __m128 p01 = _mm_loadh_pi(_mm_loadl_pi(zero, (__m64 const *) &src[i + 0].pos),
+                                  (__m64 const *) &src[i + 1].pos);
+        __m128 p23 = _mm_loadh_pi(_mm_loadl_pi(zero, (__m64 const *) &src[i + 2].pos),
+                                  (__m64 const *) &src[i + 3].pos);
 
-static stbi_io_callbacks const _stbi_io = {
-    .read = (_stbi_io_read_func) _stbi_io_read,
-    .skip = (_stbi_io_skip_func) _stbi_io_skip,
-    .eof = (_stbi_io_eof_func) _stbi_io_eof,
-};
+        __m128 x = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1));
 
-//------------------------------------------------------------------------------
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(c, y)), tx);
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, x), _mm_mul_ps(d, y)), ty);
 
-static int pixfmt_to_channels(qu_pixel_format format)
-{
-    switch (format) {
-    default:
-        return 0;
-    case QU_PIXFMT_Y8:
-        return 1;
-    case QU_PIXFMT_Y8A8:
-        return 2;
-    case QU_PIXFMT_R8G8B8:
-        return 3;
-    case QU_PIXFMT_R8G8B8A8:
-        return 4;
+        __m128 lo = _mm_unpacklo_ps(rx, ry);
+        __m128 hi = _mm_unpackhi_ps(rx, ry);
+
+        _mm_storel_pi((__m64 *) &dst[i + 0].pos, lo);
+        _mm_storeh_pi((__m64 *) &dst[i + 1].pos, lo);
+        _mm_storel_pi((__m64 *) &dst[i + 2].pos, hi);
+        _mm_storeh_pi((__m64 *) &dst[i + 3].pos, hi);
     }
 }
 
-static qu_pixel_format channels_to_pixfmt(int channels)
+#endif
+
+/**
+ * Copies vertices from `src` to `dst` with positions transformed. Both
+ * may point to the same vertices.
+ */
+static void transform_vertices(struct libqu_vertex *dst,
+    struct libqu_vertex const *src, size_t count, affine_t const *m)
 {
-    switch (channels) {
-    default:
-        return QU_PIXFMT_INVALID;
-    case 1:
-        return QU_PIXFMT_Y8;
-    case 2:
-        return QU_PIXFMT_Y8A8;
-    case 3:
-        return QU_PIXFMT_R8G8B8;
-    case 4:
-        return QU_PIXFMT_R8G8B8A8;
-    }
+    size_t i = 0;
+
+#ifdef LIBQU_SIMD_SSE2
+    i = count & ~(size_t) 3;
+    transform_vertices_sse2(dst, src, i, m);
+#endif
+
+    transform_vertices_scalar(dst, src, i, count, m);
 }
 
-struct libqu_image *libqu_image_create(qu_pixel_format format, qu_vec2i size)
+/**
+ * Applies the transform to vertices reserved by the last call to
+ * libqu_graphics_reserve_triangles(), which have been filled in since.
+ */
+static void finish_reserved_vertices(void)
 {
-    struct libqu_image *image = pl_calloc(1, sizeof(*image));
+    if (priv.reserved_count == 0) {
+        return;
+    }
 
-    if (image) {
-        int channels = pixfmt_to_channels(format);
+    struct libqu_vertex *vertices = &priv.vertbuf[priv.reserved_vertex];
+    transform_vertices(vertices, vertices, priv.reserved_count, &priv.reserved_transform);
 
-        if (channels > 0) {
-            image->pixels = pl_malloc(channels * size.x * size.y);
+    priv.reserved_count = 0;
+}
+
+/**
+ * Appends vertices that are already in window coordinates.
+ */
+static size_t append_transformed_vertices(struct libqu_vertex const *vertices, size_t count)
+{
+    size_t offset = arrlenu(priv.vertbuf);
+
+    struct libqu_vertex *ptr = arraddnptr(priv.vertbuf, (int) count);
+    memcpy(ptr, vertices, sizeof(*ptr) * count);
+
+    return offset;
+}
+
+static size_t append_vertices(struct libqu_vertex const *vertices, size_t count)
+{
+    if (priv.transform_identity) {
+        return append_transformed_vertices(vertices, count);
+    }
+
+    size_t offset = arrlenu(priv.vertbuf);
+
+    struct libqu_vertex *ptr = arraddnptr(priv.vertbuf, (int) count);
+    transform_vertices(ptr, vertices, count, &priv.transform);
+
+    return offset;
+}
+
+static void apply_render_scale(void)
+{
+    if (!priv.render_scale_dirty) {
+        return;
+    }
+
+    priv.render_scale_dirty = false;
+
+    if (priv.impl->set_render_scale(priv.requested_scale, priv.upscale_smooth)) {
+        priv.render_scale = priv.requested_scale;
+        priv.full_redraw = true;
+    } else {
+        LIBQU_LOGW("Render scale %.2f is not supported.\n", priv.requested_scale);
+        priv.requested_scale = priv.render_scale;
+        priv.target_frame_time = 0.0;
+    }
+
+    priv.stats.render_scale = priv.render_scale;
+}
+
+/**
+ * Called before the first command of every frame is recorded, and on
+ * present in case nothing was.
+ */
+static void begin_frame(void)
+{
+    if (priv.frame_begun) {
+        return;
+    }
+
+    priv.frame_begun = true;
+    apply_render_scale();
+}
+
+/**
+ * Submits everything recorded so far if adding `count` more vertices or
+ * another command would go past the high-water mark. Must be called
+ * before anything is appended, since merging with the previous command
+ * is not possible after a flush.
+ */
+static void check_high_water_mark(size_t count)
+{
+    begin_frame();
+
+    size_t max_vertices = priv.flush_vertices ? priv.flush_vertices : DEFAULT_FLUSH_VERTICES;
+    size_t max_commands = priv.flush_commands ? priv.flush_commands : DEFAULT_FLUSH_COMMANDS;
+
+    finish_reserved_vertices();
+
+    if (arrlenu(priv.rendercmds) == 0) {
+        return;
+    }
+
+    if (arrlenu(priv.vertbuf) + count > max_vertices
+        || arrlenu(priv.rendercmds) >= max_commands) {
+        libqu_graphics_flush();
+        priv.stats.flush_count++;
+    }
+}
+
+/**
+ * Records a change of the scissor state, unless it's already in effect.
+ * Draw commands are only merged between such changes.
+ */
+static void set_clip_state(bool enabled, qu_recti rect)
+{
+    if (priv.clip_enabled == enabled) {
+        if (!enabled || memcmp(&priv.clip_rect, &rect, sizeof(rect)) == 0) {
+            return;
+        }
+    }
+
+    priv.clip_enabled = enabled;
+    priv.clip_rect = rect;
+
+    struct rendercmd cmd = {
+        .op = RENDEROP_SET_CLIP,
+        .args = {
+            .set_clip = {
+                .enabled = enabled,
+                .rect = rect,
+            },
+        },
+    };
+
+    arrput(priv.rendercmds, cmd);
+}
+
+/**
+ * Makes the scissor state match the top of the clip stack. Used for
+ * geometry that can't be clipped on the CPU.
+ */
+static void sync_clip_state(void)
+{
+    size_t depth = arrlenu(priv.clip_stack);
+
+    if (depth == 0) {
+        qu_recti none = { 0 };
+        set_clip_state(false, none);
+    } else {
+        set_clip_state(true, priv.clip_stack[depth - 1]);
+    }
+}
+
+static bool is_mode_mergeable(enum libqu_draw_mode mode)
+{
+    switch (mode) {
+    case LIBQU_DRAW_MODE_POINTS:
+    case LIBQU_DRAW_MODE_LINES:
+    case LIBQU_DRAW_MODE_TRIANGLES:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Picks a texture unit for a batched draw, -1 for untextured ones.
+ * Textures are added to the open texture set greedily; once it's full,
+ * a new set is started. Commands recorded earlier don't use the units
+ * being added, so the open set can be extended in place.
+ */
+static int choose_texture_unit(struct libqu_texture *texture)
+{
+    if (priv.texture_set >= 0) {
+        struct rendercmd *set = &priv.rendercmds[priv.texture_set];
+        int count = set->args.set_textures.count;
+
+        if (!texture) {
+            return -1;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (set->args.set_textures.textures[i] == texture) {
+                return i;
+            }
+        }
+
+        if (count < priv.texture_units) {
+            set->args.set_textures.textures[count] = texture;
+            set->args.set_textures.count++;
+            return count;
+        }
+    }
+
+    struct rendercmd cmd = {
+        .op = RENDEROP_SET_TEXTURES,
+        .args = {
+            .set_textures = {
+                .textures = { texture },
+                .count = texture ? 1 : 0,
+            },
+        },
+    };
+
+    priv.texture_set = arrlen(priv.rendercmds);
+    arrput(priv.rendercmds, cmd);
+
+    return texture ? 0 : -1;
+}
+
+/**
+ * Appends a draw command. If the previous command draws with the same
+ * state and its vertices directly precede the new ones, it's extended
+ * instead, so that consecutive sprites end up in a single draw call.
+ * With texture sets, sprites with different textures can share it too.
+ */
+static void append_draw_cmd(enum libqu_draw_mode mode, size_t vertex,
+    size_t count, struct libqu_texture *texture, enum libqu_blend_hint hint)
+{
+    touch_texture(texture);
+
+    bool batched = priv.texture_units > 1;
+
+    if (batched) {
+        int unit = choose_texture_unit(texture);
+
+        arrsetlen(priv.unitbuf, vertex + count);
+        memset(&priv.unitbuf[vertex], unit, count);
+    }
+
+    size_t total = arrlenu(priv.rendercmds);
+
+    if (total > 0 && is_mode_mergeable(mode)) {
+        struct rendercmd *last = &priv.rendercmds[total - 1];
+
+        if (last->op == RENDEROP_DRAW
+            && last->args.draw.mode == mode
+            && (batched || last->args.draw.texture == texture)
+            && (batched || last->args.draw.hint == hint)
+            && last->args.draw.vertex + last->args.draw.count == vertex) {
+            // Hints are only set when regular blending gives the same
+            // result, so mixed batches just fall back to blending.
+            if (last->args.draw.hint != hint) {
+                last->args.draw.hint = LIBQU_BLEND_HINT_NONE;
+            }
+
+            last->args.draw.count += count;
+            return;
+        }
+    }
+
+    struct rendercmd cmd = {
+        .op = RENDEROP_DRAW,
+        .args = {
+            .draw = {
+                .mode = mode,
+                .vertex = vertex,
+                .count = count,
+                .texture = texture,
+                .hint = hint,
+            },
+        },
+    };
+
+    arrput(priv.rendercmds, cmd);
+}
+
+static void append_draw(enum libqu_draw_mode mode,
+    struct libqu_vertex const *vertices, size_t count,
+    struct libqu_texture *texture, enum libqu_blend_hint hint)
+{
+    check_high_water_mark(count);
+    sync_clip_state();
+
+    size_t vertex = append_vertices(vertices, count);
+    append_draw_cmd(mode, vertex, count, texture, hint);
+}
+
+/**
+ * Cuts an axis-aligned quad (as built by append_textured_rect) to the
+ * rectangle, adjusting its texture coordinates. Returns false if nothing
+ * is left.
+ */
+static bool clip_quad(struct libqu_vertex const *quad, qu_recti rect,
+    struct libqu_vertex *out)
+{
+    float ax = quad[0].pos.x;
+    float ay = quad[0].pos.y;
+    float bx = quad[2].pos.x;
+    float by = quad[2].pos.y;
+
+    if (ax == bx || ay == by) {
+        return false;
+    }
+
+    float l = LIBQU_MAX(LIBQU_MIN(ax, bx), (float) rect.x);
+    float t = LIBQU_MAX(LIBQU_MIN(ay, by), (float) rect.y);
+    float r = LIBQU_MIN(LIBQU_MAX(ax, bx), (float) (rect.x + rect.w));
+    float b = LIBQU_MIN(LIBQU_MAX(ay, by), (float) (rect.y + rect.h));
+
+    if (l >= r || t >= b) {
+        return false;
+    }
+
+    // Keep the orientation of the original quad.
+    float cx[2] = { (ax < bx) ? l : r, (ax < bx) ? r : l };
+    float cy[2] = { (ay < by) ? t : b, (ay < by) ? b : t };
+
+    float s0 = quad[0].texcoord.x;
+    float t0 = quad[0].texcoord.y;
+    float s1 = quad[2].texcoord.x;
+    float t1 = quad[2].texcoord.y;
+
+    for (int i = 0; i < 4; i++) {
+        float x = cx[(i == 1 || i == 2) ? 1 : 0];
+        float y = cy[(i >= 2) ? 1 : 0];
+
+        out[i] = quad[i];
+        out[i].pos.x = x;
+        out[i].pos.y = y;
+        out[i].texcoord.x = s0 + (x - ax) / (bx - ax) * (s1 - s0);
+        out[i].texcoord.y = t0 + (y - ay) / (by - ay) * (t1 - t0);
+    }
+
+    return true;
+}
+
+static bool is_quad_inside(struct libqu_vertex const *quad, qu_recti rect)
+{
+    return LIBQU_MIN(quad[0].pos.x, quad[2].pos.x) >= rect.x
+        && LIBQU_MIN(quad[0].pos.y, quad[2].pos.y) >= rect.y
+        && LIBQU_MAX(quad[0].pos.x, quad[2].pos.x) <= rect.x + rect.w
+        && LIBQU_MAX(quad[0].pos.y, quad[2].pos.y) <= rect.y + rect.h;
+}
+
+/**
+ * Quads are clipped on the CPU instead of changing the scissor state,
+ * so that clipped and unclipped sprites can still share a draw call.
+ * Clip rectangles are in window coordinates, so quads are transformed
+ * first. Rotated quads are left to the scissor test.
+ */
+static void append_quad(struct libqu_vertex const *quad,
+    struct libqu_texture *texture, enum libqu_blend_hint hint)
+{
+    struct libqu_vertex transformed[4];
+    struct libqu_vertex clipped[4];
+    size_t depth = arrlenu(priv.clip_stack);
+
+    if (!priv.transform_identity) {
+        transform_vertices(transformed, quad, 4, &priv.transform);
+        quad = transformed;
+
+        if (priv.transform.m[1] != 0.f || priv.transform.m[2] != 0.f) {
+            check_high_water_mark(6);
+            sync_clip_state();
+
+            struct libqu_vertex vertices[6] = {
+                quad[0], quad[1], quad[2],
+                quad[2], quad[3], quad[0],
+            };
+
+            size_t vertex = append_transformed_vertices(vertices, 6);
+            append_draw_cmd(LIBQU_DRAW_MODE_TRIANGLES, vertex, 6, texture, hint);
+            return;
+        }
+    }
+
+    if (depth > 0) {
+        if (!clip_quad(quad, priv.clip_stack[depth - 1], clipped)) {
+            return;
+        }
+
+        quad = clipped;
+    }
+
+    check_high_water_mark(6);
+
+    if (priv.clip_enabled && !is_quad_inside(quad, priv.clip_rect)) {
+        qu_recti none = { 0 };
+        set_clip_state(false, none);
+    }
+
+    struct libqu_vertex vertices[6] = {
+        quad[0], quad[1], quad[2],
+        quad[2], quad[3], quad[0],
+    };
+
+    size_t vertex = append_transformed_vertices(vertices, 6);
+    append_draw_cmd(LIBQU_DRAW_MODE_TRIANGLES, vertex, 6, texture, hint);
+}
+
+static bool is_blend_factor_in(qu_blend_factor factor,
+    qu_blend_factor a, qu_blend_factor b)
+{
+    return factor == a || factor == b;
+}
+
+/**
+ * True if drawing with source alpha of 1 gives the source color as is,
+ * i.e. blending can be turned off for opaque pixels.
+ */
+static bool is_blend_mode_opaque_safe(qu_blend_mode const *mode)
+{
+    return is_blend_factor_in(mode->color_src_factor, QU_BLEND_ONE, QU_BLEND_SRC_ALPHA)
+        && is_blend_factor_in(mode->color_dst_factor, QU_BLEND_ZERO, QU_BLEND_ONE_MINUS_SRC_ALPHA)
+        && is_blend_factor_in(mode->alpha_src_factor, QU_BLEND_ONE, QU_BLEND_SRC_ALPHA)
+        && is_blend_factor_in(mode->alpha_dst_factor, QU_BLEND_ZERO, QU_BLEND_ONE_MINUS_SRC_ALPHA)
+        && mode->color_equation == QU_BLEND_ADD
+        && mode->alpha_equation == QU_BLEND_ADD;
+}
+
+/**
+ * True if drawing with source alpha of 0 leaves the destination intact,
+ * i.e. fully transparent pixels can be discarded or not drawn at all.
+ */
+static bool is_blend_mode_transparent_safe(qu_blend_mode const *mode)
+{
+    return is_blend_factor_in(mode->color_src_factor, QU_BLEND_ZERO, QU_BLEND_SRC_ALPHA)
+        && is_blend_factor_in(mode->color_dst_factor, QU_BLEND_ONE, QU_BLEND_ONE_MINUS_SRC_ALPHA)
+        && is_blend_factor_in(mode->alpha_src_factor, QU_BLEND_ZERO, QU_BLEND_SRC_ALPHA)
+        && is_blend_factor_in(mode->alpha_dst_factor, QU_BLEND_ONE, QU_BLEND_ONE_MINUS_SRC_ALPHA)
+        && mode->color_equation == QU_BLEND_ADD
+        && mode->alpha_equation == QU_BLEND_ADD;
+}
+
+//------------------------------------------------------------------------------
+// Frame signature
+
+static uint64_t hash_word(uint64_t hash, uint64_t word)
+{
+    hash ^= word * 0x9E3779B97F4A7C15ull;
+    hash = (hash << 27) | (hash >> 37);
+
+    return hash * 0xC2B2AE3D27D4EB4Full;
+}
+
+static uint64_t hash_bytes(uint64_t hash, void const *data, size_t size)
+{
+    unsigned char const *bytes = data;
+
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        hash = hash_word(hash, word);
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, bytes, size);
+
+    return hash_word(hash, tail ^ size);
+}
+
+/**
+ * Textures are identified by address and version, so that a texture
+ * that is written to or freed and reallocated doesn't look the same.
+ */
+static uint64_t hash_texture(uint64_t hash, struct libqu_texture const *texture)
+{
+    if (!texture) {
+        return hash_word(hash, 0);
+    }
+
+    hash = hash_word(hash, (uintptr_t) texture);
+
+    return hash_word(hash, ((uint64_t) texture->version << 32) | texture->flags);
+}
+
+static uint64_t hash_draw_state(qu_blend_mode const *blend_mode,
+    bool clip_enabled, qu_recti const *clip_rect)
+{
+    uint64_t hash = hash_bytes(TILE_HASH_SEED, blend_mode, sizeof(*blend_mode));
+    hash = hash_word(hash, clip_enabled);
+
+    return hash_bytes(hash, clip_rect, sizeof(*clip_rect));
+}
+
+/**
+ * Folds a hash into every tile that a box in window coordinates touches.
+ * Box is grown by a pixel, since rasterization may touch pixels just
+ * outside of it. Clear ignores the clip rectangle, everything else
+ * doesn't.
+ */
+static void add_to_tiles(float x0, float y0, float x1, float y1,
+    qu_recti const *clip, uint64_t hash)
+{
+    if (!(x0 <= x1 && y0 <= y1)) {
+        return;
+    }
+
+    x0 = LIBQU_MAX(0.f, x0 - 1.f);
+    y0 = LIBQU_MAX(0.f, y0 - 1.f);
+    x1 = LIBQU_MIN((float) priv.window_size.x - 1.f, x1 + 1.f);
+    y1 = LIBQU_MIN((float) priv.window_size.y - 1.f, y1 + 1.f);
+
+    if (clip) {
+        x0 = LIBQU_MAX((float) clip->x, x0);
+        y0 = LIBQU_MAX((float) clip->y, y0);
+        x1 = LIBQU_MIN((float) (clip->x + clip->w - 1), x1);
+        y1 = LIBQU_MIN((float) (clip->y + clip->h - 1), y1);
+    }
+
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+
+    int col0 = (int) x0 / REDRAW_TILE_SIZE;
+    int row0 = (int) y0 / REDRAW_TILE_SIZE;
+    int col1 = (int) x1 / REDRAW_TILE_SIZE;
+    int row1 = (int) y1 / REDRAW_TILE_SIZE;
+
+    for (int row = row0; row <= row1; row++) {
+        uint64_t *tiles = &priv.tile_hashes[row * priv.tile_cols];
+
+        for (int col = col0; col <= col1; col++) {
+            tiles[col] = hash_word(tiles[col], hash);
+        }
+    }
+}
+
+/**
+ * Mergeable draws may be a whole batch of sprites, so they are hashed
+ * one primitive at a time. This keeps a moving sprite from dirtying the
+ * area of every other sprite in its batch.
+ */
+static void hash_draw(struct rendercmd const *cmd, uint64_t state,
+    qu_recti const *clip, struct libqu_texture *const *textures)
+{
+    enum libqu_draw_mode mode = cmd->args.draw.mode;
+    size_t count = cmd->args.draw.count;
+    size_t step;
+
+    switch (mode) {
+    case LIBQU_DRAW_MODE_POINTS:
+        step = 1;
+        break;
+    case LIBQU_DRAW_MODE_LINES:
+        step = 2;
+        break;
+    case LIBQU_DRAW_MODE_TRIANGLES:
+        step = 3;
+        break;
+    default:
+        step = count;
+        break;
+    }
+
+    for (size_t i = 0; i < count; i += step) {
+        size_t vertex = cmd->args.draw.vertex + i;
+        size_t n = LIBQU_MIN(step, count - i);
+        struct libqu_vertex const *v = &priv.vertbuf[vertex];
+        struct libqu_texture *texture = cmd->args.draw.texture;
+
+        // Only the texture of the primitive matters, not the whole set.
+        if (priv.texture_units > 1) {
+            int unit = priv.unitbuf[vertex];
+            texture = (unit >= 0) ? textures[unit] : NULL;
+        }
+
+        uint64_t hash = hash_word(state, mode);
+        hash = hash_texture(hash, texture);
+        hash = hash_bytes(hash, v, sizeof(*v) * n);
+
+        float x0 = v[0].pos.x, y0 = v[0].pos.y;
+        float x1 = x0, y1 = y0;
+
+        for (size_t j = 1; j < n; j++) {
+            x0 = LIBQU_MIN(x0, v[j].pos.x);
+            y0 = LIBQU_MIN(y0, v[j].pos.y);
+            x1 = LIBQU_MAX(x1, v[j].pos.x);
+            y1 = LIBQU_MAX(y1, v[j].pos.y);
+        }
+
+        add_to_tiles(x0, y0, x1, y1, clip, hash);
+    }
+}
+
+/**
+ * Adds recorded commands to the signature of the current frame. State
+ * that affects drawing (blend mode and clip rectangle) goes into the
+ * hash of every draw, starting from what the backend has now.
+ */
+static void hash_commands(void)
+{
+    qu_blend_mode blend_mode = priv.exec_blend_mode;
+    bool clip_enabled = priv.exec_clip_enabled;
+    qu_recti clip_rect = priv.exec_clip_rect;
+    struct libqu_texture *textures[LIBQU_MAX_TEXTURE_UNITS] = { 0 };
+
+    uint64_t state = hash_draw_state(&blend_mode, clip_enabled, &clip_rect);
+
+    for (size_t i = 0; i < arrlenu(priv.rendercmds); i++) {
+        struct rendercmd const *cmd = &priv.rendercmds[i];
+        qu_recti const *clip = clip_enabled ? &clip_rect : NULL;
+        float w = (float) priv.window_size.x;
+        float h = (float) priv.window_size.y;
+        uint64_t hash;
+
+        switch (cmd->op) {
+        case RENDEROP_CLEAR:
+            hash = hash_word(hash_word(0, cmd->op), cmd->args.clear.color);
+            add_to_tiles(0.f, 0.f, w, h, NULL, hash);
+            break;
+        case RENDEROP_DRAW:
+            hash_draw(cmd, state, clip, textures);
+            break;
+        case RENDEROP_SET_BLEND_MODE:
+        case RENDEROP_SET_CLIP:
+            if (cmd->op == RENDEROP_SET_BLEND_MODE) {
+                blend_mode = cmd->args.set_blend_mode.mode;
+            } else {
+                clip_enabled = cmd->args.set_clip.enabled;
+                clip_rect = cmd->args.set_clip.rect;
+            }
+
+            state = hash_draw_state(&blend_mode, clip_enabled, &clip_rect);
+            break;
+        case RENDEROP_DRAW_BUFFER: {
+            struct libqu_vertex_buffer const *buffer = cmd->args.draw_buffer.buffer;
+            affine_t const *transform = &cmd->args.draw_buffer.transform;
+            qu_rectf bounds = buffer->bounds;
+
+            if (buffer->count == 0) {
+                break;
+            }
+
+            hash = hash_word(state, buffer->hash);
+            hash = hash_texture(hash, cmd->args.draw_buffer.texture);
+            hash = hash_bytes(hash, transform, sizeof(*transform));
+
+            qu_vec2f corners[4] = {
+                affine_transform_point(transform, (qu_vec2f) { bounds.x, bounds.y }),
+                affine_transform_point(transform, (qu_vec2f) { bounds.x + bounds.w, bounds.y }),
+                affine_transform_point(transform, (qu_vec2f) { bounds.x + bounds.w, bounds.y + bounds.h }),
+                affine_transform_point(transform, (qu_vec2f) { bounds.x, bounds.y + bounds.h }),
+            };
+
+            float x0 = corners[0].x, y0 = corners[0].y;
+            float x1 = x0, y1 = y0;
+
+            for (int j = 1; j < 4; j++) {
+                x0 = LIBQU_MIN(x0, corners[j].x);
+                y0 = LIBQU_MIN(y0, corners[j].y);
+                x1 = LIBQU_MAX(x1, corners[j].x);
+                y1 = LIBQU_MAX(y1, corners[j].y);
+            }
+
+            add_to_tiles(x0, y0, x1, y1, clip, hash);
+            break;
+        }
+        case RENDEROP_DRAW_PARTICLES:
+            // Particles are simulated elsewhere and may be anywhere.
+            add_to_tiles(0.f, 0.f, w, h, clip, hash_word(state, priv.frame_index));
+            break;
+        case RENDEROP_SET_TEXTURES:
+            memset(textures, 0, sizeof(textures));
+            memcpy(textures, cmd->args.set_textures.textures,
+                   sizeof(textures[0]) * cmd->args.set_textures.count);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * Adds recorded commands and their vertices to the hash of the whole
+ * frame. Commands are hashed field by field, since unions and padding
+ * may contain garbage.
+ */
+static void hash_frame(void)
+{
+    uint64_t hash = priv.frame_hash;
+
+    hash = hash_bytes(hash, priv.vertbuf, sizeof(*priv.vertbuf) * arrlenu(priv.vertbuf));
+
+    if (priv.texture_units > 1) {
+        hash = hash_bytes(hash, priv.unitbuf, arrlenu(priv.unitbuf));
+    }
+
+    for (size_t i = 0; i < arrlenu(priv.rendercmds); i++) {
+        struct rendercmd const *cmd = &priv.rendercmds[i];
+
+        hash = hash_word(hash, cmd->op);
+
+        switch (cmd->op) {
+        case RENDEROP_CLEAR:
+            hash = hash_word(hash, cmd->args.clear.color);
+            break;
+        case RENDEROP_DRAW:
+            hash = hash_word(hash, cmd->args.draw.mode);
+            hash = hash_word(hash, cmd->args.draw.vertex);
+            hash = hash_word(hash, cmd->args.draw.count);
+            hash = hash_texture(hash, cmd->args.draw.texture);
+            break;
+        case RENDEROP_SET_BLEND_MODE:
+            hash = hash_bytes(hash, &cmd->args.set_blend_mode.mode,
+                              sizeof(cmd->args.set_blend_mode.mode));
+            break;
+        case RENDEROP_DRAW_BUFFER:
+            hash = hash_word(hash, cmd->args.draw_buffer.buffer->hash);
+            hash = hash_texture(hash, cmd->args.draw_buffer.texture);
+            hash = hash_bytes(hash, &cmd->args.draw_buffer.transform,
+                              sizeof(cmd->args.draw_buffer.transform));
+            break;
+        case RENDEROP_DRAW_PARTICLES:
+            // Particles are simulated elsewhere and may have moved.
+            hash = hash_word(hash, priv.frame_index);
+            break;
+        case RENDEROP_SET_CLIP:
+            hash = hash_word(hash, cmd->args.set_clip.enabled);
+            hash = hash_bytes(hash, &cmd->args.set_clip.rect,
+                              sizeof(cmd->args.set_clip.rect));
+            break;
+        case RENDEROP_SET_TEXTURES:
+            for (int j = 0; j < cmd->args.set_textures.count; j++) {
+                hash = hash_texture(hash, cmd->args.set_textures.textures[j]);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    priv.frame_hash = hash;
+}
+
+static bool is_tile_dirty(int row, int col)
+{
+    int index = row * priv.tile_cols + col;
+
+    return priv.invalid_tiles[index]
+        || priv.tile_hashes[index] != priv.prev_tile_hashes[index];
+}
+
+/**
+ * Covers dirty tiles with a few rectangles: runs of tiles in a row,
+ * merged with runs of the same span in the row above. If that takes too
+ * many, a single bounding rectangle is used instead.
+ */
+static int build_redraw_rects(qu_recti *rects)
+{
+    int count = 0;
+    bool overflow = false;
+    int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+
+    for (int row = 0; row < priv.tile_rows; row++) {
+        int col = 0;
+
+        while (col < priv.tile_cols) {
+            if (!is_tile_dirty(row, col)) {
+                col++;
+                continue;
+            }
+
+            int start = col;
+
+            while (col < priv.tile_cols && is_tile_dirty(row, col)) {
+                col++;
+            }
+
+            qu_recti rect = {
+                start * REDRAW_TILE_SIZE,
+                row * REDRAW_TILE_SIZE,
+                (col - start) * REDRAW_TILE_SIZE,
+                REDRAW_TILE_SIZE,
+            };
+
+            x0 = LIBQU_MIN(x0, rect.x);
+            y0 = LIBQU_MIN(y0, rect.y);
+            x1 = LIBQU_MAX(x1, rect.x + rect.w);
+            y1 = LIBQU_MAX(y1, rect.y + rect.h);
+
+            int k = 0;
+
+            for (; k < count; k++) {
+                if (rects[k].x == rect.x && rects[k].w == rect.w
+                    && rects[k].y + rects[k].h == rect.y) {
+                    rects[k].h += REDRAW_TILE_SIZE;
+                    break;
+                }
+            }
+
+            if (k == count) {
+                if (count < MAX_REDRAW_RECTS) {
+                    rects[count++] = rect;
+                } else {
+                    overflow = true;
+                }
+            }
+        }
+    }
+
+    if (overflow) {
+        rects[0] = (qu_recti) { x0, y0, x1 - x0, y1 - y0 };
+        count = 1;
+    }
+
+    // Tiles on the right and bottom edges may stick out of the window.
+    for (int i = 0; i < count; i++) {
+        rects[i].w = LIBQU_MIN(rects[i].w, priv.window_size.x - rects[i].x);
+        rects[i].h = LIBQU_MIN(rects[i].h, priv.window_size.y - rects[i].y);
+    }
+
+    return count;
+}
+
+/**
+ * Starts the signature of the next frame. The one just finished is kept
+ * to compare against.
+ */
+static void swap_tile_hashes(void)
+{
+    uint64_t *prev = priv.prev_tile_hashes;
+    int count = priv.tile_cols * priv.tile_rows;
+
+    priv.prev_tile_hashes = priv.tile_hashes;
+    priv.tile_hashes = prev;
+
+    for (int i = 0; i < count; i++) {
+        priv.tile_hashes[i] = TILE_HASH_SEED;
+    }
+
+    memset(priv.invalid_tiles, 0, sizeof(*priv.invalid_tiles) * count);
+
+    priv.full_redraw = false;
+    priv.frame_flushed = false;
+    priv.frame_index++;
+}
+
+static void free_tiles(void)
+{
+    pl_free(priv.tile_hashes);
+    pl_free(priv.prev_tile_hashes);
+    pl_free(priv.invalid_tiles);
+
+    priv.tile_hashes = NULL;
+    priv.prev_tile_hashes = NULL;
+    priv.invalid_tiles = NULL;
+    priv.tile_cols = 0;
+    priv.tile_rows = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void libqu_graphics_initialize(struct libqu_graphics_params const *params)
+{
+    priv.impl = choose_impl();
+
+    if (!priv.impl->initialize(params)) {
+        LIBQU_LOGE("Failed to initialize libqu::graphics implementation.\n");
+        abort();
+    }
+
+    priv.window_size = params->window_size;
+    priv.blend_mode = QU_BLEND_MODE_ALPHA;
+    priv.exec_blend_mode = QU_BLEND_MODE_ALPHA;
+    priv.skip_swap = true;
+
+    affine_identity(&priv.transform);
+    priv.transform_identity = true;
+
+    priv.texture_units = priv.impl->get_texture_units();
+    priv.texture_units = LIBQU_MAX(1, LIBQU_MIN(priv.texture_units, LIBQU_MAX_TEXTURE_UNITS));
+    priv.texture_set = -1;
+
+    priv.render_scale = 1.f;
+    priv.requested_scale = 1.f;
+
+    if (priv.texture_units > 1) {
+        LIBQU_LOGI("Batching draws across %d textures.\n", priv.texture_units);
+    }
+
+    LIBQU_LOGI("Initialized.\n");
+}
+
+void libqu_graphics_terminate(void)
+{
+    LIBQU_LOGI("Peak usage: %d vertices, %d commands, %d mid-frame flushes.\n",
+        priv.stats.peak_vertices, priv.stats.peak_commands, priv.stats.flush_count);
+
+    arrfree(priv.textures);
+    arrfree(priv.vertbuf);
+    arrfree(priv.unitbuf);
+    arrfree(priv.rendercmds);
+    arrfree(priv.clip_stack);
+    arrfree(priv.transform_stack);
+    free_tiles();
+    priv.impl->terminate();
+
+    memset(&priv, 0, sizeof(priv));
+
+    LIBQU_LOGI("Terminated.\n");
+}
+
+/**
+ * Executes recorded commands once for every redraw rectangle, or just
+ * once over the whole target if there are none. Every pass starts with
+ * the same backend state.
+ */
+static void execute_commands(qu_recti const *rects, int count)
+{
+    int8_t const *units = NULL;
+
+    if (priv.texture_units > 1) {
+        arrsetlen(priv.unitbuf, arrlenu(priv.vertbuf));
+        units = priv.unitbuf;
+    }
+
+    priv.impl->upload_vertices(priv.vertbuf, units, arrlenu(priv.vertbuf));
+
+    qu_blend_mode blend_mode = priv.exec_blend_mode;
+    bool clip_enabled = priv.exec_clip_enabled;
+    qu_recti clip_rect = priv.exec_clip_rect;
+
+    for (int pass = 0; pass < LIBQU_MAX(1, count); pass++) {
+        if (pass > 0) {
+            priv.impl->apply_blend_mode(&blend_mode);
+            priv.impl->apply_clip(clip_enabled ? &clip_rect : NULL);
+        }
+
+        if (count > 0) {
+            priv.impl->set_redraw_rect(&rects[pass]);
+        }
+
+        priv.exec_blend_mode = blend_mode;
+        priv.exec_clip_enabled = clip_enabled;
+        priv.exec_clip_rect = clip_rect;
+
+        for (size_t i = 0; i < arrlenu(priv.rendercmds); i++) {
+            exec_cmd(&priv.rendercmds[i]);
+        }
+    }
+
+    if (count > 0) {
+        priv.impl->set_redraw_rect(NULL);
+    }
+}
+
+/**
+ * Used instead of execute_commands() when nothing on screen would
+ * change. Draws are dropped, but state changes still have to reach the
+ * backend.
+ */
+static void skip_commands(void)
+{
+    for (size_t i = 0; i < arrlenu(priv.rendercmds); i++) {
+        struct rendercmd *cmd = &priv.rendercmds[i];
+
+        switch (cmd->op) {
+        case RENDEROP_SET_BLEND_MODE:
+        case RENDEROP_SET_CLIP:
+            exec_cmd(cmd);
+            break;
+        case RENDEROP_DRAW_BUFFER:
+            cmd->args.draw_buffer.buffer->queued = false;
+            break;
+        case RENDEROP_DRAW_PARTICLES:
+            cmd->args.draw_particles.buffer->queued = false;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void finish_commands(void)
+{
+    priv.stats.peak_vertices = LIBQU_MAX(priv.stats.peak_vertices, (int) arrlen(priv.vertbuf));
+    priv.stats.peak_commands = LIBQU_MAX(priv.stats.peak_commands, (int) arrlen(priv.rendercmds));
+
+    arrsetlen(priv.vertbuf, 0);
+    arrsetlen(priv.unitbuf, 0);
+    arrsetlen(priv.rendercmds, 0);
+    priv.texture_set = -1;
+
+    // Textures used so far may be evicted from now on.
+    priv.serial++;
+    enforce_texture_budget();
+}
+
+void libqu_graphics_flush(void)
+{
+    finish_reserved_vertices();
+
+    // Once a part of the frame is drawn, the rest of it can't be limited
+    // to dirty tiles. It's still hashed, for the next frame to compare.
+    if (priv.incremental) {
+        hash_commands();
+        priv.frame_flushed = true;
+    } else if (priv.frame_skipping) {
+        hash_frame();
+        priv.frame_flushed = true;
+    }
+
+    execute_commands(NULL, 0);
+    finish_commands();
+}
+
+/**
+ * Dynamic resolution controller. GPU time is smoothed over a number of
+ * frames and assumed to be proportional to the number of pixels, i.e.
+ * to the square of the scale. Scale goes down as soon as frames are
+ * over budget, and only goes up when there is a clear margin, so it
+ * doesn't oscillate around the target.
+ */
+static void update_dynamic_resolution(void)
+{
+    double frame_time = priv.impl->get_frame_time();
+
+    if (frame_time < 0.0) {
+        return;
+    }
+
+    priv.stats.gpu_frame_time = frame_time;
+
+    if (priv.target_frame_time <= 0.0) {
+        return;
+    }
+
+    priv.average_frame_time = (priv.measured_frames == 0)
+        ? frame_time
+        : priv.average_frame_time * 0.9 + frame_time * 0.1;
+
+    if (++priv.measured_frames < DYNAMIC_RESOLUTION_FRAMES) {
+        return;
+    }
+
+    double ratio = priv.target_frame_time / LIBQU_MAX(priv.average_frame_time, 1e-6);
+
+    if (ratio >= 1.0 && ratio < 1.25) {
+        return;
+    }
+
+    float scale = priv.render_scale * (float) sqrt(ratio);
+
+    // Large jumps are usually caused by a single slow frame.
+    scale = LIBQU_MAX(priv.render_scale - DYNAMIC_RESOLUTION_MAX_STEP, scale);
+    scale = LIBQU_MIN(priv.render_scale + DYNAMIC_RESOLUTION_MAX_STEP, scale);
+
+    // Coarse steps keep the target from being recreated too often.
+    // Rounding is away from the current scale, so it always moves.
+    scale = (ratio < 1.0)
+        ? floorf(scale / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP
+        : ceilf(scale / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP;
+    scale = LIBQU_MAX(priv.min_render_scale, LIBQU_MIN(1.f, scale));
+
+    if (scale != priv.render_scale) {
+        priv.requested_scale = scale;
+        priv.render_scale_dirty = true;
+        priv.measured_frames = 0;
+    }
+}
+
+/**
+ * Draws only the tiles whose signature changed since the last frame.
+ * Returns false if there are none, in which case the frame isn't drawn
+ * and shouldn't be presented at all.
+ */
+static bool redraw_incrementally(void)
+{
+    finish_reserved_vertices();
+    hash_commands();
+
+    qu_recti rects[MAX_REDRAW_RECTS];
+    bool full = priv.full_redraw || priv.frame_flushed;
+    int count = full ? 0 : build_redraw_rects(rects);
+
+    if (full) {
+        execute_commands(NULL, 0);
+        priv.stats.redraw_area = 1.f;
+    } else if (count > 0) {
+        execute_commands(rects, count);
+
+        int area = 0;
+
+        for (int i = 0; i < count; i++) {
+            area += rects[i].w * rects[i].h;
+        }
+
+        priv.stats.redraw_area = (float) area / (priv.window_size.x * priv.window_size.y);
+    } else {
+        skip_commands();
+        priv.stats.redraw_area = 0.f;
+    }
+
+    finish_commands();
+    swap_tile_hashes();
+
+    return full || count > 0;
+}
+
+/**
+ * Draws the frame unless it's identical to the previous one. Frames
+ * that are partly drawn by a mid-frame flush are never skipped.
+ */
+static bool redraw_if_changed(void)
+{
+    finish_reserved_vertices();
+    hash_frame();
+
+    bool changed = priv.full_redraw || priv.frame_flushed
+        || priv.frame_hash != priv.prev_frame_hash;
+
+    if (changed) {
+        execute_commands(NULL, 0);
+    } else {
+        skip_commands();
+    }
+
+    finish_commands();
+
+    priv.prev_frame_hash = priv.frame_hash;
+    priv.frame_hash = TILE_HASH_SEED;
+    priv.full_redraw = false;
+    priv.frame_flushed = false;
+    priv.frame_index++;
+
+    return changed;
+}
+
+/**
+ * Returns false if the frame shouldn't be swapped, i.e. it wasn't drawn
+ * and the window still shows the previous one.
+ */
+bool libqu_graphics_present(void)
+{
+    bool drawn = true;
+
+    begin_frame();
+
+    if (priv.incremental) {
+        drawn = redraw_incrementally();
+    } else if (priv.frame_skipping) {
+        drawn = redraw_if_changed();
+        priv.stats.redraw_area = drawn ? 1.f : 0.f;
+    } else {
+        libqu_graphics_flush();
+    }
+
+    priv.frame_begun = false;
+    priv.stats.frame_count++;
+
+    if (!drawn) {
+        priv.stats.skipped_frames++;
+
+        if (priv.skip_swap) {
+            return false;
+        }
+    }
+
+    priv.impl->present();
+
+    if (drawn) {
+        update_dynamic_resolution();
+    }
+
+    return true;
+}
+
+void libqu_graphics_clear(qu_color color)
+{
+    check_high_water_mark(0);
+
+    struct rendercmd cmd = {
+        .op = RENDEROP_CLEAR,
+        .args = {
+            .clear = {
+                .color = color,
+            },
+        },
+    };
+
+    arrput(priv.rendercmds, cmd);
+}
+
+void libqu_graphics_draw_point(qu_vec2f pos, qu_color color)
+{
+    struct libqu_vertex vertices[] = {
+        { .pos = pos, .color = color },
+    };
+
+    append_draw(LIBQU_DRAW_MODE_POINTS, vertices, 1, NULL, LIBQU_BLEND_HINT_NONE);
+}
+
+void libqu_graphics_draw_line(qu_vec2f a, qu_vec2f b, qu_color color)
+{
+    struct libqu_vertex vertices[] = {
+        { .pos = a, .color = color },
+        { .pos = b, .color = color },
+    };
+
+    append_draw(LIBQU_DRAW_MODE_LINES, vertices, 2, NULL, LIBQU_BLEND_HINT_NONE);
+}
+
+void libqu_graphics_draw_triangle(qu_vec2f a, qu_vec2f b, qu_vec2f c, qu_color outline, qu_color fill)
+{
+    if (QU_EXTRACT_ALPHA(fill) > 0) {
+        struct libqu_vertex vertices[] = {
+            { .pos = a, .color = fill },
+            { .pos = b, .color = fill },
+            { .pos = c, .color = fill },
+        };
+
+        append_draw(LIBQU_DRAW_MODE_TRIANGLES, vertices, 3, NULL, LIBQU_BLEND_HINT_NONE);
+    }
+
+    if (QU_EXTRACT_ALPHA(outline) > 0) {
+        struct libqu_vertex vertices[] = {
+            { .pos = a, .color = outline },
+            { .pos = b, .color = outline },
+            { .pos = b, .color = outline },
+            { .pos = c, .color = outline },
+            { .pos = c, .color = outline },
+            { .pos = a, .color = outline },
+        };
+
+        append_draw(LIBQU_DRAW_MODE_LINES, vertices, 6, NULL, LIBQU_BLEND_HINT_NONE);
+    }
+}
+
+void libqu_graphics_draw_rectangle(qu_vec2f pos, qu_vec2f size, qu_color outline, qu_color fill)
+{
+    float ax = pos.x;
+    float ay = pos.y;
+    float bx = pos.x + size.x;
+    float by = pos.y + size.y;
+
+    if (QU_EXTRACT_ALPHA(fill) > 0) {
+        struct libqu_vertex vertices[] = {
+            { .pos = { ax, ay }, .color = fill },
+            { .pos = { bx, ay }, .color = fill },
+            { .pos = { bx, by }, .color = fill },
+            { .pos = { ax, by }, .color = fill },
+        };
+
+        append_quad(vertices, NULL, LIBQU_BLEND_HINT_NONE);
+    }
+
+    if (QU_EXTRACT_ALPHA(outline) > 0) {
+        struct libqu_vertex vertices[] = {
+            { .pos = { ax, ay }, .color = outline },
+            { .pos = { bx, ay }, .color = outline },
+            { .pos = { bx, ay }, .color = outline },
+            { .pos = { bx, by }, .color = outline },
+            { .pos = { bx, by }, .color = outline },
+            { .pos = { ax, by }, .color = outline },
+            { .pos = { ax, by }, .color = outline },
+            { .pos = { ax, ay }, .color = outline },
+        };
+
+        append_draw(LIBQU_DRAW_MODE_LINES, vertices, 8, NULL, LIBQU_BLEND_HINT_NONE);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static int _stbi_io_read(struct libqu_file *file, char *data, int size)
+{
+    return (int) libqu_fread(data, size, file);
+}
+
+static void _stbi_io_skip(struct libqu_file *file, int n)
+{
+    libqu_fseek(file, n, SEEK_CUR);
+}
+
+static int _stbi_io_eof(struct libqu_file *file)
+{
+    return libqu_ftell(file) == (int64_t) file->size;
+}
+
+typedef int (*_stbi_io_read_func)(void *, char *, int);
+typedef void (*_stbi_io_skip_func)(void *, int);
+typedef int (*_stbi_io_eof_func)(void *);
+
+static stbi_io_callbacks const _stbi_io = {
+    .read = (_stbi_io_read_func) _stbi_io_read,
+    .skip = (_stbi_io_skip_func) _stbi_io_skip,
+    .eof = (_stbi_io_eof_func) _stbi_io_eof,
+};
+
+//------------------------------------------------------------------------------
+
+static qu_pixel_format channels_to_pixfmt(int channels)
+{
+    switch (channels) {
+    default:
+        return QU_PIXFMT_INVALID;
+    case 1:
+        return QU_PIXFMT_Y8;
+    case 2:
+        return QU_PIXFMT_Y8A8;
+    case 3:
+        return QU_PIXFMT_R8G8B8;
+    case 4:
+        return QU_PIXFMT_R8G8B8A8;
+    }
+}
+
+struct libqu_image *libqu_image_create(qu_pixel_format format, qu_vec2i size)
+{
+    struct libqu_image *image = pl_calloc(1, sizeof(*image));
+
+    if (image) {
+        int channels = pixfmt_to_channels(format);
+
+        if (channels > 0) {
+            image->pixels = pl_malloc(channels * size.x * size.y);
 
             if (image->pixels) {
                 image->format = format;
                 image->size.x = size.x;
                 image->size.y = size.y;
 
-                return image;
+                return image;
+            }
+        }
+
+        pl_free(image);
+    }
+
+    return NULL;
+}
+
+/**
+ * QOI images are recognized by their magic and decoded natively, any
+ * other format goes to stb_image.
+ */
+struct libqu_image *libqu_image_load(struct libqu_file *file)
+{
+    if (libqu_qoi_check(file)) {
+        return libqu_qoi_load(file);
+    }
+
+    int w, h, c;
+
+    unsigned char *data =
+        stbi_load_from_callbacks(&_stbi_io, file, &w, &h, &c, 0);
+    
+    struct libqu_image *image = NULL;
+
+    if (data) {
+        qu_pixel_format format = channels_to_pixfmt(c);
+
+        if (format != QU_PIXFMT_INVALID) {
+            qu_vec2i size = { w, h };
+            image = libqu_image_create(format, size);
+
+            if (image) {
+                memcpy(image->pixels, data, w * h * c);
+            }
+        }
+
+        stbi_image_free(data);
+    }
+
+    return image;
+}
+
+struct libqu_image *libqu_image_copy(struct libqu_image const *image)
+{
+    struct libqu_image *copy = libqu_image_create(image->format, image->size);
+
+    if (copy) {
+        int c = pixfmt_to_channels(image->format);
+        memcpy(copy->pixels, image->pixels, image->size.x * image->size.y * c);
+    }
+
+    return copy;
+}
+
+struct libqu_image *libqu_image_copy_flipped(struct libqu_image const *image)
+{
+    struct libqu_image *copy = libqu_image_create(image->format, image->size);
+
+    if (!copy) {
+        return NULL;
+    }
+
+    int w = image->size.x;
+    int h = image->size.y;
+    int c = pixfmt_to_channels(image->format);
+
+    for (int y = 0; y < image->size.y; y++) {
+        void *src = &image->pixels[w * c * y];
+        void *dst = &copy->pixels[w * c * (h - y - 1)];
+
+        memcpy(dst, src, w * c);
+    }
+
+    return copy;
+}
+
+void libqu_image_destroy(struct libqu_image *image)
+{
+    pl_free(image->pixels);
+    pl_free(image);
+}
+
+void libqu_image_flip(struct libqu_image *image)
+{
+    int w = image->size.x;
+    int h = image->size.y;
+    int c = pixfmt_to_channels(image->format);
+
+    for (int y = 0; y < h / 2; y++) {
+        unsigned char *top = &image->pixels[w * c * y];
+        unsigned char *bottom = &image->pixels[w * c * (h - y - 1)];
+
+        pixels_swap(top, bottom, w * c);
+    }
+}
+
+struct libqu_image *libqu_image_convert(struct libqu_image const *image,
+    qu_pixel_format format)
+{
+    struct libqu_image *copy = libqu_image_create(format, image->size);
+
+    if (copy) {
+        pixels_convert(copy->pixels, format, image->pixels, image->format,
+                       (size_t) image->size.x * image->size.y);
+    }
+
+    return copy;
+}
+
+void libqu_image_premultiply(struct libqu_image *image)
+{
+    pixels_premultiply(image->pixels, image->format,
+                       (size_t) image->size.x * image->size.y);
+}
+
+void libqu_image_unpremultiply(struct libqu_image *image)
+{
+    pixels_unpremultiply(image->pixels, image->format,
+                         (size_t) image->size.x * image->size.y);
+}
+
+/**
+ * Blends `src` into `dst` with its top-left corner at `pos`. Pixels are
+ * converted to RGBA in small chunks on the stack when formats differ.
+ */
+void libqu_image_blit(struct libqu_image *dst, struct libqu_image const *src,
+    qu_vec2i pos, qu_blend_mode const *mode)
+{
+    int x0 = LIBQU_MAX(0, pos.x);
+    int y0 = LIBQU_MAX(0, pos.y);
+    int x1 = LIBQU_MIN(dst->size.x, pos.x + src->size.x);
+    int y1 = LIBQU_MIN(dst->size.y, pos.y + src->size.y);
+
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    int sc = pixfmt_to_channels(src->format);
+    int dc = pixfmt_to_channels(dst->format);
+
+    unsigned char src_chunk[BLIT_CHUNK_PIXELS * 4];
+    unsigned char dst_chunk[BLIT_CHUNK_PIXELS * 4];
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x += BLIT_CHUNK_PIXELS) {
+            size_t count = LIBQU_MIN(BLIT_CHUNK_PIXELS, x1 - x);
+
+            unsigned char const *sp = &src->pixels[((y - pos.y) * src->size.x + (x - pos.x)) * sc];
+            unsigned char *dp = &dst->pixels[(y * dst->size.x + x) * dc];
+
+            unsigned char const *s = sp;
+            unsigned char *d = dp;
+
+            if (src->format != QU_PIXFMT_R8G8B8A8) {
+                pixels_convert(src_chunk, QU_PIXFMT_R8G8B8A8, sp, src->format, count);
+                s = src_chunk;
+            }
+
+            if (dst->format != QU_PIXFMT_R8G8B8A8) {
+                pixels_convert(dst_chunk, QU_PIXFMT_R8G8B8A8, dp, dst->format, count);
+                d = dst_chunk;
+            }
+
+            pixels_blend(d, s, count, mode);
+
+            if (d != dp) {
+                pixels_convert(dp, dst->format, d, QU_PIXFMT_R8G8B8A8, count);
+            }
+        }
+    }
+}
+
+/**
+ * Box filter: each pixel of the result is the average of a block of
+ * 2^shift by 2^shift source pixels. Size is rounded up, so that edge
+ * texels aren't lost; blocks on the right and bottom edges average only
+ * the pixels they cover. Sums of a row of blocks are gathered one source
+ * row at a time, so that pixels are read in order.
+ */
+struct libqu_image *libqu_image_downscale(struct libqu_image const *image,
+    int shift)
+{
+    int n = 1 << shift;
+    int c = pixfmt_to_channels(image->format);
+    int w = image->size.x;
+
+    qu_vec2i size = {
+        (image->size.x + n - 1) >> shift,
+        (image->size.y + n - 1) >> shift,
+    };
+
+    struct libqu_image *result = libqu_image_create(image->format, size);
+    unsigned int *sums = pl_malloc(sizeof(*sums) * size.x * c);
+
+    if (!result || !sums) {
+        if (result) {
+            libqu_image_destroy(result);
+        }
+
+        pl_free(sums);
+        return NULL;
+    }
+
+    for (int y = 0; y < size.y; y++) {
+        int y0 = y << shift;
+        int y1 = LIBQU_MIN(y0 + n, image->size.y);
+
+        memset(sums, 0, sizeof(*sums) * size.x * c);
+
+        for (int sy = y0; sy < y1; sy++) {
+            unsigned char const *src = &image->pixels[sy * w * c];
+
+            for (int x = 0; x < size.x; x++) {
+                unsigned int *sum = &sums[x * c];
+                unsigned char const *block = &src[(x << shift) * c];
+                int bw = LIBQU_MIN(n, w - (x << shift));
+
+                for (int k = 0; k < bw; k++, block += c) {
+                    for (int i = 0; i < c; i++) {
+                        sum[i] += block[i];
+                    }
+                }
+            }
+        }
+
+        unsigned char *dst = &result->pixels[y * size.x * c];
+
+        for (int x = 0; x < size.x; x++) {
+            int bw = LIBQU_MIN(n, w - (x << shift));
+            unsigned int count = (unsigned int) ((y1 - y0) * bw);
+
+            for (int i = x * c; i < (x + 1) * c; i++) {
+                dst[i] = (unsigned char) ((sums[i] + count / 2) / count);
+            }
+        }
+    }
+
+    pl_free(sums);
+
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+/**
+ * Scans alpha values of `count` consecutive pixels. Only formats with
+ * an alpha channel (2 or 4 channels) are supported.
+ */
+static unsigned int scan_alpha_span(unsigned char const *pixels, int count,
+    int channels)
+{
+    unsigned int bits = 0;
+    int i = 0;
+
+#ifdef LIBQU_SIMD_SSE2
+    int step = 16 / channels;
+    int alpha_mask = (channels == 4) ? 0x8888 : 0xAAAA;
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi8((char) 0xFF);
+
+    __m128i has_zero = zero;
+    __m128i has_full = zero;
+    __m128i has_partial = zero;
+
+    for (; (i + step) <= count; i += step) {
+        __m128i v = _mm_loadu_si128((__m128i const *) &pixels[i * channels]);
+        __m128i is_zero = _mm_cmpeq_epi8(v, zero);
+        __m128i is_full = _mm_cmpeq_epi8(v, full);
+
+        has_zero = _mm_or_si128(has_zero, is_zero);
+        has_full = _mm_or_si128(has_full, is_full);
+        has_partial = _mm_or_si128(has_partial,
+            _mm_andnot_si128(_mm_or_si128(is_zero, is_full), full));
+    }
+
+    if (_mm_movemask_epi8(has_zero) & alpha_mask) {
+        bits |= LIBQU_ALPHA_ZERO;
+    }
+
+    if (_mm_movemask_epi8(has_full) & alpha_mask) {
+        bits |= LIBQU_ALPHA_FULL;
+    }
+
+    if (_mm_movemask_epi8(has_partial) & alpha_mask) {
+        bits |= LIBQU_ALPHA_PARTIAL;
+    }
+#endif
+
+    for (; i < count; i++) {
+        unsigned char alpha = pixels[i * channels + (channels - 1)];
+
+        if (alpha == 0) {
+            bits |= LIBQU_ALPHA_ZERO;
+        } else if (alpha == 255) {
+            bits |= LIBQU_ALPHA_FULL;
+        } else {
+            bits |= LIBQU_ALPHA_PARTIAL;
+        }
+    }
+
+    return bits;
+}
+
+/**
+ * Classifies texture's alpha channel once at load time. Large textures
+ * also get a coarse grid of per-tile bits, so that draws of a part of
+ * the texture can be classified separately.
+ */
+static void analyze_texture_alpha(struct libqu_texture *texture)
+{
+    struct libqu_image *image = texture->image;
+    struct libqu_alpha_tiles *tiles = &texture->tiles;
+
+    int w = image->size.x;
+    int h = image->size.y;
+    int c = pixfmt_to_channels(image->format);
+
+    if (c != 2 && c != 4) {
+        texture->alpha = LIBQU_ALPHA_FULL;
+        return;
+    }
+
+    if (w > ALPHA_TILE_THRESHOLD || h > ALPHA_TILE_THRESHOLD) {
+        tiles->size = ALPHA_TILE_SIZE;
+        tiles->cols = (w + ALPHA_TILE_SIZE - 1) / ALPHA_TILE_SIZE;
+        tiles->rows = (h + ALPHA_TILE_SIZE - 1) / ALPHA_TILE_SIZE;
+        tiles->bits = pl_calloc(tiles->cols * tiles->rows, 1);
+    }
+
+    if (!tiles->bits) {
+        memset(tiles, 0, sizeof(*tiles));
+        texture->alpha = scan_alpha_span(image->pixels, w * h, c);
+        return;
+    }
+
+    for (int y = 0; y < h; y++) {
+        unsigned char const *row = &image->pixels[w * c * y];
+        unsigned char *bits = &tiles->bits[(y / tiles->size) * tiles->cols];
+
+        for (int col = 0; col < tiles->cols; col++) {
+            int x = col * tiles->size;
+            int count = LIBQU_MIN(tiles->size, w - x);
+
+            bits[col] |= scan_alpha_span(&row[x * c], count, c);
+        }
+    }
+
+    texture->alpha = 0;
+
+    for (int i = 0; i < tiles->cols * tiles->rows; i++) {
+        texture->alpha |= tiles->bits[i];
+    }
+}
+
+/**
+ * Texel coordinates given by callers refer to the full size of the
+ * texture. Converts them to texels of the stored, maybe downscaled,
+ * pixels.
+ */
+static qu_rectf get_stored_region(struct libqu_texture const *texture,
+    qu_rectf sub)
+{
+    if (texture->downscale == 0) {
+        return sub;
+    }
+
+    float kx = (float) texture->size.x / texture->full_size.x;
+    float ky = (float) texture->size.y / texture->full_size.y;
+
+    return (qu_rectf) { sub.x * kx, sub.y * ky, sub.w * kx, sub.h * ky };
+}
+
+/**
+ * Returns alpha bits of a sub-rectangle of a texture (in pixels).
+ * Falls back to the texture-wide bits if there is no tile grid.
+ */
+unsigned int libqu_graphics_get_region_alpha(struct libqu_texture *texture,
+    qu_rectf sub)
+{
+    struct libqu_alpha_tiles const *tiles = &texture->tiles;
+
+    if (!tiles->bits) {
+        return texture->alpha;
+    }
+
+    sub = get_stored_region(texture, sub);
+
+    // Extend the region by a pixel to account for filtering.
+    float l = LIBQU_MIN(sub.x, sub.x + sub.w) - 1.f;
+    float t = LIBQU_MIN(sub.y, sub.y + sub.h) - 1.f;
+    float r = LIBQU_MAX(sub.x, sub.x + sub.w) + 1.f;
+    float b = LIBQU_MAX(sub.y, sub.y + sub.h) + 1.f;
+
+    if (l < 0.f || t < 0.f
+        || r > texture->size.x || b > texture->size.y) {
+        if (texture->flags & QU_TEXTURE_REPEAT) {
+            return texture->alpha;
+        }
+    }
+
+    int col0 = LIBQU_MAX(0, (int) l / tiles->size);
+    int row0 = LIBQU_MAX(0, (int) t / tiles->size);
+    int col1 = LIBQU_MIN(tiles->cols - 1, (int) r / tiles->size);
+    int row1 = LIBQU_MIN(tiles->rows - 1, (int) b / tiles->size);
+
+    unsigned int bits = 0;
+
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            bits |= tiles->bits[row * tiles->cols + col];
+        }
+    }
+
+    return bits;
+}
+
+/**
+ * Decides how a textured quad with the given alpha bits can be drawn
+ * under the current blend mode. Returns false if it can be skipped.
+ */
+static bool choose_blend_hint(struct libqu_texture *texture,
+    unsigned int alpha, qu_rectf rect, qu_rectf sub,
+    enum libqu_blend_hint *hint)
+{
+    bool opaque_safe = is_blend_mode_opaque_safe(&priv.blend_mode);
+    bool transparent_safe = is_blend_mode_transparent_safe(&priv.blend_mode);
+
+    *hint = LIBQU_BLEND_HINT_NONE;
+
+    if (alpha == LIBQU_ALPHA_ZERO) {
+        return !transparent_safe;
+    }
+
+    if (!opaque_safe) {
+        return true;
+    }
+
+    if (alpha == LIBQU_ALPHA_FULL) {
+        *hint = LIBQU_BLEND_HINT_OPAQUE;
+        return true;
+    }
+
+    if (alpha & LIBQU_ALPHA_PARTIAL || !transparent_safe) {
+        return true;
+    }
+
+    // Binary alpha can be tested instead of blended, but only if
+    // the texture isn't filtered: linear filter produces in-between
+    // values on edges. Minification always uses linear filter.
+    if (texture->flags & QU_TEXTURE_SMOOTH) {
+        return true;
+    }
+
+    // Quad size is in local coordinates, the transform scales it further.
+    float sx = sqrtf(priv.transform.m[0] * priv.transform.m[0]
+        + priv.transform.m[1] * priv.transform.m[1]);
+    float sy = sqrtf(priv.transform.m[2] * priv.transform.m[2]
+        + priv.transform.m[3] * priv.transform.m[3]);
+
+    if (fabsf(rect.w) * sx < fabsf(sub.w) || fabsf(rect.h) * sy < fabsf(sub.h)) {
+        return true;
+    }
+
+    *hint = LIBQU_BLEND_HINT_ALPHA_TEST;
+    return true;
+}
+
+static void update_texture_mesh(struct libqu_texture *texture)
+{
+    if (!(texture->flags & QU_TEXTURE_TRIM) || texture->mesh.count > 0) {
+        return;
+    }
+
+    if (texture->alpha & LIBQU_ALPHA_ZERO) {
+        if (!fetch_texture_pixels(texture)) {
+            return;
+        }
+
+        libqu_mesh_build_outline(&texture->mesh, texture->image);
+        release_texture_pixels(texture);
+    }
+}
+
+/**
+ * Draws a region of a texture split into a grid, one quad per cell that
+ * overlaps the region. Cells that end up off-screen are skipped.
+ */
+static void append_grid_rect(struct libqu_texture *texture, qu_rectf rect,
+    float s, float t, float u, float v, enum libqu_blend_hint hint)
+{
+    struct libqu_texture_grid const *grid = &texture->grid;
+
+    // Region in texels. Repeating isn't possible across cells.
+    float sx0 = s * texture->size.x;
+    float sy0 = t * texture->size.y;
+    float sx1 = u * texture->size.x;
+    float sy1 = v * texture->size.y;
+
+    if (sx0 == sx1 || sy0 == sy1) {
+        return;
+    }
+
+    float l = LIBQU_MAX(LIBQU_MIN(sx0, sx1), 0.f);
+    float r = LIBQU_MIN(LIBQU_MAX(sx0, sx1), (float) texture->size.x);
+    float top = LIBQU_MAX(LIBQU_MIN(sy0, sy1), 0.f);
+    float bottom = LIBQU_MIN(LIBQU_MAX(sy0, sy1), (float) texture->size.y);
+
+    int col0 = LIBQU_MAX(0, (int) (l / grid->step));
+    int row0 = LIBQU_MAX(0, (int) (top / grid->step));
+    int col1 = LIBQU_MIN(grid->cols - 1, (int) (r / grid->step));
+    int row1 = LIBQU_MIN(grid->rows - 1, (int) (bottom / grid->step));
+
+    float kx = rect.w / (sx1 - sx0);
+    float ky = rect.h / (sy1 - sy0);
+
+    qu_rectf visible = libqu_graphics_get_visible_rect();
+
+    for (int row = row0; row <= row1; row++) {
+        float py0 = LIBQU_MAX(top, (float) (row * grid->step));
+        float py1 = LIBQU_MIN(bottom, (float) ((row + 1) * grid->step));
+
+        if (py0 >= py1) {
+            continue;
+        }
+
+        float ay = rect.y + (py0 - sy0) * ky;
+        float by = rect.y + (py1 - sy0) * ky;
+
+        if (LIBQU_MAX(ay, by) <= visible.y || LIBQU_MIN(ay, by) >= visible.y + visible.h) {
+            continue;
+        }
+
+        for (int col = col0; col <= col1; col++) {
+            float px0 = LIBQU_MAX(l, (float) (col * grid->step));
+            float px1 = LIBQU_MIN(r, (float) ((col + 1) * grid->step));
+
+            if (px0 >= px1) {
+                continue;
+            }
+
+            float ax = rect.x + (px0 - sx0) * kx;
+            float bx = rect.x + (px1 - sx0) * kx;
+
+            if (LIBQU_MAX(ax, bx) <= visible.x || LIBQU_MIN(ax, bx) >= visible.x + visible.w) {
+                continue;
+            }
+
+            struct libqu_texture *cell = grid->cells[row * grid->cols + col];
+
+            // Cell origin in texels, accounting for the overlap.
+            float ox = (float) LIBQU_MAX(0, col * grid->step - 1);
+            float oy = (float) LIBQU_MAX(0, row * grid->step - 1);
+
+            float cs = (px0 - ox) / cell->size.x;
+            float ct = (py0 - oy) / cell->size.y;
+            float cu = (px1 - ox) / cell->size.x;
+            float cv = (py1 - oy) / cell->size.y;
+
+            struct libqu_vertex vertices[] = {
+                { { ax, ay }, 0xFFFFFFFF, { cs, ct } },
+                { { bx, ay }, 0xFFFFFFFF, { cu, ct } },
+                { { bx, by }, 0xFFFFFFFF, { cu, cv } },
+                { { ax, by }, 0xFFFFFFFF, { cs, cv } },
+            };
+
+            append_quad(vertices, cell, hint);
+        }
+    }
+}
+
+/**
+ * Emits a textured rectangle sampling the (s, t)-(u, v) region of the
+ * texture. Trimmed textures are drawn as a triangle fan over their
+ * outline clipped to that region, leaving transparent texels out.
+ */
+static void append_textured_rect(struct libqu_texture *texture, qu_rectf rect,
+    float s, float t, float u, float v, enum libqu_blend_hint hint)
+{
+    float ax = rect.x;
+    float ay = rect.y;
+    float bx = rect.x + rect.w;
+    float by = rect.y + rect.h;
+
+    if (texture->grid.cells) {
+        append_grid_rect(texture, rect, s, t, u, v, hint);
+        return;
+    }
+
+    bool trim = (texture->flags & QU_TEXTURE_TRIM)
+        && texture->mesh.count > 0
+        && s != u && t != v
+        && LIBQU_MIN(s, u) >= 0.f && LIBQU_MAX(s, u) <= 1.f
+        && LIBQU_MIN(t, v) >= 0.f && LIBQU_MAX(t, v) <= 1.f
+        && is_blend_mode_transparent_safe(&priv.blend_mode);
+
+    if (!trim) {
+        struct libqu_vertex vertices[] = {
+            { { ax, ay }, 0xFFFFFFFF, { s, t } },
+            { { bx, ay }, 0xFFFFFFFF, { u, t } },
+            { { bx, by }, 0xFFFFFFFF, { u, v } },
+            { { ax, by }, 0xFFFFFFFF, { s, v } },
+        };
+
+        append_quad(vertices, texture, hint);
+        return;
+    }
+
+    qu_vec2f points[LIBQU_MESH_MAX_CLIPPED_POINTS];
+    int n;
+
+    if (s == 0.f && t == 0.f && u == 1.f && v == 1.f) {
+        n = texture->mesh.count;
+        memcpy(points, texture->mesh.points, sizeof(*points) * n);
+    } else {
+        qu_rectf region = { s, t, u - s, v - t };
+        n = libqu_mesh_clip(&texture->mesh, region, points);
+    }
+
+    if (n < 3) {
+        return;
+    }
+
+    struct libqu_vertex vertices[3 * (LIBQU_MESH_MAX_CLIPPED_POINTS - 2)];
+    struct libqu_vertex fan[LIBQU_MESH_MAX_CLIPPED_POINTS];
+
+    for (int i = 0; i < n; i++) {
+        fan[i].pos.x = ax + (points[i].x - s) / (u - s) * (bx - ax);
+        fan[i].pos.y = ay + (points[i].y - t) / (v - t) * (by - ay);
+        fan[i].color = 0xFFFFFFFF;
+        fan[i].texcoord = points[i];
+    }
+
+    for (int i = 1; i < n - 1; i++) {
+        vertices[3 * (i - 1) + 0] = fan[0];
+        vertices[3 * (i - 1) + 1] = fan[i];
+        vertices[3 * (i - 1) + 2] = fan[i + 1];
+    }
+
+    append_draw(LIBQU_DRAW_MODE_TRIANGLES, vertices, 3 * (n - 2), texture, hint);
+}
+
+//------------------------------------------------------------------------------
+
+void libqu_graphics_set_default_texture_flags(unsigned int flags)
+{
+    priv.default_texture_flags = flags;
+}
+
+/**
+ * Only textures loaded after this call are premultiplied. Vertex colors
+ * are taken as premultiplied too, so that a color with zero alpha adds
+ * to the destination without a change of blend mode.
+ */
+void libqu_graphics_set_premultiplied_alpha(bool enabled)
+{
+    priv.premultiplied = enabled;
+
+    libqu_graphics_set_blend_mode(enabled
+        ? QU_BLEND_MODE_PREMULTIPLIED
+        : QU_BLEND_MODE_ALPHA);
+}
+
+/**
+ * Picks a downscale factor from installed memory. Devices with little
+ * RAM mostly share it with the GPU, so it bounds texture memory too.
+ */
+static int choose_texture_downscale(void)
+{
+    uint64_t memory = pl_get_memory_size();
+
+    if (memory == 0) {
+        return 0;
+    }
+
+    if (memory < AUTO_DOWNSCALE_4X_MEMORY) {
+        return 2;
+    }
+
+    if (memory < AUTO_DOWNSCALE_2X_MEMORY) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Textures decoded from files and buffers after this call are scaled
+ * down by `factor`, which is 1, 2 or 4; zero chooses it automatically.
+ */
+void libqu_graphics_set_texture_downscale(int factor)
+{
+    switch (factor) {
+    case 0:
+        priv.texture_downscale = choose_texture_downscale();
+        LIBQU_LOGI("Chose texture downscale factor of %d.\n",
+            1 << priv.texture_downscale);
+        break;
+    case 1:
+        priv.texture_downscale = 0;
+        break;
+    case 2:
+        priv.texture_downscale = 1;
+        break;
+    case 4:
+        priv.texture_downscale = 2;
+        break;
+    default:
+        LIBQU_LOGW("Invalid texture downscale factor: %d\n", factor);
+        break;
+    }
+}
+
+static void destroy_texture_grid(struct libqu_texture_grid *grid)
+{
+    for (int i = 0; i < grid->cols * grid->rows; i++) {
+        struct libqu_texture *cell = grid->cells[i];
+
+        if (!cell) {
+            continue;
+        }
+
+        if (cell->resident) {
+            priv.impl->destroy_texture(cell);
+            priv.texture_memory -= get_texture_memory(cell);
+        }
+
+        pl_free(cell);
+    }
+
+    pl_free(grid->cells);
+    memset(grid, 0, sizeof(*grid));
+}
+
+/**
+ * Uploads an image that exceeds the backend's size limit as a grid of
+ * smaller textures. Cells don't keep their pixels.
+ */
+static bool split_texture(struct libqu_texture *texture, int max_size)
+{
+    struct libqu_texture_grid *grid = &texture->grid;
+    struct libqu_image const *image = texture->image;
+
+    int w = image->size.x;
+    int h = image->size.y;
+    int c = pixfmt_to_channels(image->format);
+
+    grid->step = max_size - 2;
+    grid->cols = (w + grid->step - 1) / grid->step;
+    grid->rows = (h + grid->step - 1) / grid->step;
+    grid->cells = pl_calloc(grid->cols * grid->rows, sizeof(*grid->cells));
+
+    if (!grid->cells) {
+        return false;
+    }
+
+    for (int row = 0; row < grid->rows; row++) {
+        for (int col = 0; col < grid->cols; col++) {
+            int x0 = LIBQU_MAX(0, col * grid->step - 1);
+            int y0 = LIBQU_MAX(0, row * grid->step - 1);
+            int x1 = LIBQU_MIN(w, (col + 1) * grid->step + 1);
+            int y1 = LIBQU_MIN(h, (row + 1) * grid->step + 1);
+
+            struct libqu_texture *cell = pl_calloc(1, sizeof(*cell));
+            qu_vec2i size = { x1 - x0, y1 - y0 };
+
+            if (!cell) {
+                destroy_texture_grid(grid);
+                return false;
+            }
+
+            grid->cells[row * grid->cols + col] = cell;
+            cell->version = ++priv.texture_version;
+
+            cell->image = libqu_image_create(image->format, size);
+
+            if (!cell->image) {
+                destroy_texture_grid(grid);
+                return false;
+            }
+
+            for (int y = y0; y < y1; y++) {
+                memcpy(&cell->image->pixels[(y - y0) * size.x * c],
+                    &image->pixels[(y * w + x0) * c], size.x * c);
+            }
+
+            cell->format = image->format;
+            cell->size = size;
+            cell->full_size = size;
+            cell->flags = texture->flags;
+            cell->alpha = texture->alpha;
+            cell->premultiplied = texture->premultiplied;
+
+            bool uploaded = upload_texture(cell);
+
+            libqu_image_destroy(cell->image);
+            cell->image = NULL;
+
+            if (!uploaded) {
+                destroy_texture_grid(grid);
+                return false;
             }
         }
+    }
+
+    LIBQU_LOGI("Split %dx%d texture into %dx%d grid.\n",
+        w, h, grid->cols, grid->rows);
+
+    return true;
+}
+
+/**
+ * Only textures loaded after this call are affected. Budget is in bytes,
+ * zero means unlimited.
+ */
+void libqu_graphics_set_texture_residency(bool release_pixels, size_t budget)
+{
+    priv.release_pixels = release_pixels;
+    priv.texture_budget = budget;
+
+    enforce_texture_budget();
+}
+
+/**
+ * Takes ownership of the image. `source` may be NULL, in which case the
+ * texture keeps its pixels and is never evicted. `flags` are added to
+ * the default ones; those that affect how pixels are stored, such as
+ * QU_TEXTURE_SDF, must be given here rather than set later. Image is
+ * scaled down by 2^`downscale`, but callers keep using texel coordinates
+ * of the full size.
+ */
+static struct libqu_texture *load_texture(struct libqu_image *image,
+    struct libqu_texture_source const *source, unsigned int flags,
+    int downscale)
+{
+    struct libqu_texture *texture = pl_calloc(1, sizeof(*texture));
+
+    if (!texture) {
+        libqu_image_destroy(image);
+        return NULL;
+    }
+
+    texture->format = image->format;
+    texture->full_size = image->size;
+    texture->flags = priv.default_texture_flags | flags;
+    texture->last_use = priv.serial;
+    texture->version = ++priv.texture_version;
+    texture->premultiplied = priv.premultiplied;
+    texture->downscale = downscale;
+    texture->image = prepare_texture_pixels(texture, image);
+
+    if (!texture->image) {
+        pl_free(texture);
+        return NULL;
+    }
+
+    image = texture->image;
+    texture->size = image->size;
+
+    analyze_texture_alpha(texture);
+    update_texture_mesh(texture);
+
+    // Source is only worth keeping if pixels can go away.
+    if (source && (priv.release_pixels || priv.texture_budget > 0)) {
+        copy_texture_source(&texture->source, source);
+    }
+
+    int max_size = priv.impl->get_max_texture_size();
+
+    if (max_size > 2 && (image->size.x > max_size || image->size.y > max_size)) {
+        if (split_texture(texture, max_size)) {
+            // Only the cells are needed from now on.
+            libqu_image_destroy(texture->image);
+            texture->image = NULL;
+
+            return texture;
+        }
+    } else if (upload_texture(texture)) {
+        arrput(priv.textures, texture);
+        enforce_texture_budget();
+
+        return texture;
+    }
+
+    // Upload failed, so the image is still there.
+    texture->image = NULL;
+
+    free_texture_source(&texture->source);
+    libqu_mesh_destroy(&texture->mesh);
+    pl_free(texture->tiles.bits);
+    pl_free(texture);
+
+    libqu_image_destroy(image);
+
+    return NULL;
+}
+
+struct libqu_texture *libqu_graphics_load_texture(struct libqu_image *image,
+    struct libqu_texture_source const *source)
+{
+    return load_texture(image, source, 0, 0);
+}
+
+struct libqu_texture *libqu_graphics_load_texture_ex(struct libqu_image *image,
+    struct libqu_texture_source const *source, unsigned int flags)
+{
+    return load_texture(image, source, flags, 0);
+}
+
+/**
+ * Used for images decoded from files and buffers, which follow the
+ * factor set with libqu_graphics_set_texture_downscale().
+ */
+struct libqu_texture *libqu_graphics_load_downscaled_texture(
+    struct libqu_image *image, struct libqu_texture_source const *source)
+{
+    return load_texture(image, source, 0, priv.texture_downscale);
+}
+
+/**
+ * Creates a blank texture meant to be filled with
+ * libqu_graphics_write_texture(). It keeps no pixels on the CPU side and
+ * starts with no alpha bits, which are added as it's written to.
+ */
+struct libqu_texture *libqu_graphics_create_texture(qu_pixel_format format,
+    qu_vec2i size)
+{
+    struct libqu_image *image = libqu_image_create(format, size);
+
+    if (!image) {
+        return NULL;
+    }
+
+    memset(image->pixels, 0, size.x * size.y * pixfmt_to_channels(format));
+
+    struct libqu_texture *texture = libqu_graphics_load_texture(image, NULL);
+
+    if (texture) {
+        libqu_image_destroy(texture->image);
+        texture->image = NULL;
+
+        pl_free(texture->tiles.bits);
+        memset(&texture->tiles, 0, sizeof(texture->tiles));
+        texture->alpha = 0;
+    }
+
+    return texture;
+}
+
+/**
+ * Replaces a region of the texture. Commands that are already recorded
+ * must see the old contents, so they are executed first if any of them
+ * uses the texture.
+ */
+void libqu_graphics_write_texture(struct libqu_texture *texture,
+    qu_vec2i pos, struct libqu_image const *image)
+{
+    if (image->format != texture->format || !texture->resident) {
+        return;
+    }
+
+    int c = pixfmt_to_channels(image->format);
+    struct libqu_image *premultiplied = NULL;
+
+    if ((c == 2 || c == 4) && needs_premultiplied_pixels(texture)) {
+        premultiplied = libqu_image_copy(image);
+
+        if (!premultiplied) {
+            return;
+        }
+
+        libqu_image_premultiply(premultiplied);
+        image = premultiplied;
+    }
+
+    if (texture->last_use == priv.serial && arrlenu(priv.rendercmds) > 0) {
+        libqu_graphics_flush();
+    }
+
+    priv.impl->write_texture(texture, pos, image);
+    texture->version = ++priv.texture_version;
+
+    for (int y = 0; y < image->size.y; y++) {
+        unsigned char const *src = &image->pixels[y * image->size.x * c];
+
+        if (texture->image) {
+            unsigned char *dst = &texture->image->pixels[
+                ((pos.y + y) * texture->size.x + pos.x) * c];
+
+            memcpy(dst, src, image->size.x * c);
+        }
+
+        if (c == 2 || c == 4) {
+            texture->alpha |= scan_alpha_span(src, image->size.x, c);
+        } else {
+            texture->alpha |= LIBQU_ALPHA_FULL;
+        }
+    }
+
+    if (premultiplied) {
+        libqu_image_destroy(premultiplied);
+    }
+}
+
+int libqu_graphics_get_max_texture_size(void)
+{
+    return priv.impl->get_max_texture_size();
+}
+
+void libqu_graphics_destroy_texture(struct libqu_texture *texture)
+{
+    // Pending commands (and texture sets) may still refer to it.
+    if (texture->last_use == priv.serial && arrlenu(priv.rendercmds) > 0) {
+        libqu_graphics_flush();
+    }
+
+    if (texture->resident) {
+        priv.impl->destroy_texture(texture);
+        priv.texture_memory -= get_texture_memory(texture);
+    }
+
+    for (size_t i = 0; i < arrlenu(priv.textures); i++) {
+        if (priv.textures[i] == texture) {
+            arrdelswap(priv.textures, i);
+            break;
+        }
+    }
+
+    if (texture->image) {
+        libqu_image_destroy(texture->image);
+    }
+
+    destroy_texture_grid(&texture->grid);
+    free_texture_source(&texture->source);
+    libqu_mesh_destroy(&texture->mesh);
+    pl_free(texture->tiles.bits);
+    pl_free(texture);
+}
+
+void libqu_graphics_set_texture_flags(struct libqu_texture *texture,
+    unsigned int flags)
+{
+    texture->flags = flags;
+
+    if (texture->grid.cells) {
+        for (int i = 0; i < texture->grid.cols * texture->grid.rows; i++) {
+            texture->grid.cells[i]->flags = flags;
+            priv.impl->update_texture_flags(texture->grid.cells[i]);
+        }
+
+        return;
+    }
+
+    update_texture_mesh(texture);
+
+    // Evicted textures get their flags when uploaded again.
+    if (texture->resident) {
+        priv.impl->update_texture_flags(texture);
+    }
+}
+
+void libqu_graphics_draw_texture(struct libqu_texture *texture, qu_rectf rect)
+{
+    qu_rectf sub = {
+        0.f, 0.f,
+        (float) texture->size.x,
+        (float) texture->size.y,
+    };
+
+    enum libqu_blend_hint hint;
+
+    if (!choose_blend_hint(texture, texture->alpha, rect, sub, &hint)) {
+        return;
+    }
+
+    append_textured_rect(texture, rect, 0.f, 0.f, 1.f, 1.f, hint);
+}
+
+void libqu_graphics_draw_subtexture(struct libqu_texture *texture,
+    qu_rectf rect, qu_rectf sub)
+{
+    enum libqu_blend_hint hint;
+    unsigned int alpha = libqu_graphics_get_region_alpha(texture, sub);
+
+    sub = get_stored_region(texture, sub);
+
+    if (!choose_blend_hint(texture, alpha, rect, sub, &hint)) {
+        return;
+    }
+
+    float s = sub.x / texture->size.x;
+    float t = sub.y / texture->size.y;
+    float u = (sub.x + sub.w) / texture->size.x;
+    float v = (sub.y + sub.h) / texture->size.y;
+
+    append_textured_rect(texture, rect, s, t, u, v, hint);
+}
+
+struct libqu_image *libqu_graphics_capture_screen(void)
+{
+    struct libqu_image *image =
+        libqu_image_create(QU_PIXFMT_R8G8B8, priv.window_size);
+    
+    if (!image) {
+        return NULL;
+    }
 
-        pl_free(image);
+    if (priv.impl->capture_screen(image) == -1) {
+        libqu_image_destroy(image);
+        return NULL;
     }
 
-    return NULL;
+    return image;
 }
 
-struct libqu_image *libqu_image_load(struct libqu_file *file)
+void libqu_graphics_set_blend_mode(qu_blend_mode mode)
 {
-    int w, h, c;
+    check_high_water_mark(0);
 
-    unsigned char *data =
-        stbi_load_from_callbacks(&_stbi_io, file, &w, &h, &c, 0);
-    
-    struct libqu_image *image = NULL;
+    priv.blend_mode = mode;
 
-    if (data) {
-        qu_pixel_format format = channels_to_pixfmt(c);
+    struct rendercmd cmd = {
+        .op = RENDEROP_SET_BLEND_MODE,
+        .args = {
+            .set_blend_mode = {
+                .mode = mode,
+            },
+        },
+    };
 
-        if (format != QU_PIXFMT_INVALID) {
-            qu_vec2i size = { w, h };
-            image = libqu_image_create(format, size);
+    arrput(priv.rendercmds, cmd);
+}
 
-            if (image) {
-                memcpy(image->pixels, data, w * h * c);
-            }
-        }
+/**
+ * Reserves `count` vertices drawn as a triangle list and returns them to
+ * be filled in place. The pointer is only valid until the next draw.
+ * Vertices are transformed with the current transform afterwards.
+ */
+struct libqu_vertex *libqu_graphics_reserve_triangles(
+    struct libqu_texture *texture, size_t count)
+{
+    check_high_water_mark(count);
+    sync_clip_state();
 
-        stbi_image_free(data);
+    size_t vertex = arrlenu(priv.vertbuf);
+    struct libqu_vertex *vertices = arraddnptr(priv.vertbuf, (int) count);
+
+    append_draw_cmd(LIBQU_DRAW_MODE_TRIANGLES, vertex, count, texture,
+        LIBQU_BLEND_HINT_NONE);
+
+    if (!priv.transform_identity) {
+        priv.reserved_vertex = vertex;
+        priv.reserved_count = count;
+        priv.reserved_transform = priv.transform;
     }
 
-    return image;
+    return vertices;
 }
 
-struct libqu_image *libqu_image_copy_flipped(struct libqu_image *image)
+qu_vec2i libqu_graphics_get_window_size(void)
 {
-    struct libqu_image *copy = libqu_image_create(image->format, image->size);
+    return priv.window_size;
+}
 
-    if (!copy) {
-        return NULL;
+/**
+ * Returns the bounding box of the window in the coordinates of the
+ * current transform, for culling.
+ */
+qu_rectf libqu_graphics_get_visible_rect(void)
+{
+    float w = (float) priv.window_size.x;
+    float h = (float) priv.window_size.y;
+
+    if (priv.transform_identity) {
+        return (qu_rectf) { 0.f, 0.f, w, h };
     }
 
-    int w = image->size.x;
-    int h = image->size.y;
-    int c = pixfmt_to_channels(image->format);
+    affine_t inverse;
+    affine_inverse(&inverse, &priv.transform);
 
-    for (int y = 0; y < image->size.y; y++) {
-        void *src = &image->pixels[w * c * y];
-        void *dst = &copy->pixels[w * c * (h - y - 1)];
+    qu_vec2f corners[4] = {
+        affine_transform_point(&inverse, (qu_vec2f) { 0.f, 0.f }),
+        affine_transform_point(&inverse, (qu_vec2f) { w, 0.f }),
+        affine_transform_point(&inverse, (qu_vec2f) { w, h }),
+        affine_transform_point(&inverse, (qu_vec2f) { 0.f, h }),
+    };
 
-        memcpy(dst, src, w * c);
+    float x0 = corners[0].x, y0 = corners[0].y;
+    float x1 = x0, y1 = y0;
+
+    for (int i = 1; i < 4; i++) {
+        x0 = LIBQU_MIN(x0, corners[i].x);
+        y0 = LIBQU_MIN(y0, corners[i].y);
+        x1 = LIBQU_MAX(x1, corners[i].x);
+        y1 = LIBQU_MAX(y1, corners[i].y);
     }
 
-    return copy;
+    return (qu_rectf) { x0, y0, x1 - x0, y1 - y0 };
 }
 
-void libqu_image_destroy(struct libqu_image *image)
+/**
+ * Returns how much the current transform scales areas, as a linear
+ * factor. Used to pick detail levels.
+ */
+float libqu_graphics_get_transform_scale(void)
 {
-    pl_free(image->pixels);
-    pl_free(image);
+    float det = priv.transform.m[0] * priv.transform.m[3]
+        - priv.transform.m[1] * priv.transform.m[2];
+
+    return sqrtf(fabsf(det));
 }
 
-void libqu_image_flip(struct libqu_image *image)
-{
-    int w = image->size.x;
-    int h = image->size.y;
-    int c = pixfmt_to_channels(image->format);
+//------------------------------------------------------------------------------
 
-    unsigned char *tmp = pl_malloc(w * c);
+/**
+ * Buffer contents can't be changed while a draw command still refers
+ * to them, so pending commands are executed first.
+ */
+bool libqu_graphics_update_vertex_buffer(struct libqu_vertex_buffer *buffer,
+    struct libqu_vertex const *vertices, size_t count)
+{
+    if (buffer->queued) {
+        libqu_graphics_flush();
+    }
 
-    if (!tmp) {
-        return;
+    if (priv.impl->update_vertex_buffer(buffer, vertices, count) != 0) {
+        return false;
     }
 
-    for (int y = 0; y < h / 2; y++) {
-        void *top = &image->pixels[w * c * y];
-        void *bottom = &image->pixels[w * c * (h - y - 1)];
+    // Kept for the frame signature, so that the vertices aren't needed.
+    float x0 = 0.f, y0 = 0.f, x1 = 0.f, y1 = 0.f;
+
+    for (size_t i = 0; i < count; i++) {
+        qu_vec2f pos = vertices[i].pos;
 
-        memcpy(tmp, top, w * c);
-        memcpy(top, bottom, w * c);
-        memcpy(bottom, tmp, w * c);
+        x0 = (i == 0) ? pos.x : LIBQU_MIN(x0, pos.x);
+        y0 = (i == 0) ? pos.y : LIBQU_MIN(y0, pos.y);
+        x1 = (i == 0) ? pos.x : LIBQU_MAX(x1, pos.x);
+        y1 = (i == 0) ? pos.y : LIBQU_MAX(y1, pos.y);
     }
 
-    pl_free(tmp);
-}
+    buffer->bounds = (qu_rectf) { x0, y0, x1 - x0, y1 - y0 };
+    buffer->hash = hash_bytes(hash_word(TILE_HASH_SEED, buffer->mode),
+                              vertices, sizeof(*vertices) * count);
 
-//------------------------------------------------------------------------------
+    return true;
+}
 
-void libqu_graphics_set_default_texture_flags(unsigned int flags)
+void libqu_graphics_destroy_vertex_buffer(struct libqu_vertex_buffer *buffer)
 {
-    priv.default_texture_flags = flags;
+    if (buffer->queued) {
+        libqu_graphics_flush();
+    }
+
+    priv.impl->destroy_vertex_buffer(buffer);
 }
 
-struct libqu_texture *libqu_graphics_load_texture(struct libqu_image *image)
+/**
+ * Retained vertices can't be transformed on the CPU every frame, so the
+ * backend applies the current transform, moved by `offset`.
+ */
+void libqu_graphics_draw_vertex_buffer(struct libqu_vertex_buffer *buffer,
+    struct libqu_texture *texture, unsigned int alpha, qu_vec2f offset)
 {
-    struct libqu_texture *texture = pl_calloc(1, sizeof(*texture));
+    if (buffer->count == 0) {
+        return;
+    }
+
+    enum libqu_blend_hint hint = LIBQU_BLEND_HINT_NONE;
 
     if (texture) {
-        texture->image = image;
-        texture->flags = priv.default_texture_flags;
+        // Buffer vertices map texels one to one, so only the transform
+        // can minify them.
+        qu_rectf rect = { 0.f, 0.f, 1.f, 1.f };
 
-        if (priv.impl->load_texture(texture) == 0) {
-            return texture;
+        if (!choose_blend_hint(texture, alpha, rect, rect, &hint)) {
+            return;
         }
-
-        pl_free(texture);
     }
 
-    libqu_image_destroy(image);
+    struct rendercmd cmd = {
+        .op = RENDEROP_DRAW_BUFFER,
+        .args = {
+            .draw_buffer = {
+                .buffer = buffer,
+                .texture = texture,
+                .hint = hint,
+                .transform = priv.transform,
+            },
+        },
+    };
 
-    return NULL;
+    affine_translate(&cmd.args.draw_buffer.transform, offset.x, offset.y);
+
+    check_high_water_mark(0);
+    sync_clip_state();
+    touch_texture(texture);
+
+    buffer->queued = true;
+    arrput(priv.rendercmds, cmd);
+
+    // Binds its own texture, so the next batched draw needs a new set.
+    priv.texture_set = -1;
 }
 
-void libqu_graphics_destroy_texture(struct libqu_texture *texture)
+//------------------------------------------------------------------------------
+
+bool libqu_graphics_create_particle_buffer(struct libqu_particle_buffer *buffer)
 {
-    priv.impl->destroy_texture(texture);
-    libqu_image_destroy(texture->image);
-    pl_free(texture);
+    return priv.impl->create_particle_buffer(buffer) == 0;
 }
 
-void libqu_graphics_set_texture_flags(struct libqu_texture *texture,
-    unsigned int flags)
+/**
+ * Particle buffers follow the same rule as vertex buffers: pending draws
+ * are executed before the buffer is modified.
+ */
+void libqu_graphics_destroy_particle_buffer(struct libqu_particle_buffer *buffer)
 {
-    texture->flags = flags;
-    priv.impl->update_texture_flags(texture);
+    if (buffer->queued) {
+        libqu_graphics_flush();
+    }
+
+    priv.impl->destroy_particle_buffer(buffer);
 }
 
-void libqu_graphics_draw_texture(struct libqu_texture *texture, qu_rectf rect)
+void libqu_graphics_write_particles(struct libqu_particle_buffer *buffer,
+    int slot, struct libqu_particle_state const *states, int count)
 {
-    float ax = rect.x;
-    float ay = rect.y;
-    float bx = rect.x + rect.w;
-    float by = rect.y + rect.h;
+    if (buffer->queued) {
+        libqu_graphics_flush();
+    }
 
-    struct libqu_vertex vertices[] = {
-        { { ax, ay }, 0xFFFFFFFF, { 0.f, 0.f } },
-        { { bx, ay }, 0xFFFFFFFF, { 1.f, 0.f } },
-        { { bx, by }, 0xFFFFFFFF, { 1.f, 1.f } },
-        { { ax, by }, 0xFFFFFFFF, { 0.f, 1.f } },
-    };
+    priv.impl->write_particles(buffer, slot, states, count);
+}
+
+void libqu_graphics_update_particle_buffer(struct libqu_particle_buffer *buffer,
+    float dt, qu_vec2f gravity)
+{
+    if (buffer->queued) {
+        libqu_graphics_flush();
+    }
+
+    priv.impl->update_particle_buffer(buffer, dt, gravity);
+}
+
+void libqu_graphics_draw_particle_buffer(struct libqu_particle_buffer *buffer,
+    struct libqu_texture *texture)
+{
+    if (buffer->count == 0) {
+        return;
+    }
 
     struct rendercmd cmd = {
-        .op = RENDEROP_DRAW,
+        .op = RENDEROP_DRAW_PARTICLES,
         .args = {
-            .draw = {
-                .mode = LIBQU_DRAW_MODE_TRIANGLE_FAN,
-                .vertex = append_vertices(vertices, 4),
-                .count = 4,
+            .draw_particles = {
+                .buffer = buffer,
                 .texture = texture,
+                .transform = priv.transform,
             },
         },
     };
 
+    check_high_water_mark(0);
+    sync_clip_state();
+    touch_texture(texture);
+
+    buffer->queued = true;
     arrput(priv.rendercmds, cmd);
+
+    // Binds its own texture, so the next batched draw needs a new set.
+    priv.texture_set = -1;
 }
 
-void libqu_graphics_draw_subtexture(struct libqu_texture *texture,
-    qu_rectf rect, qu_rectf sub)
+//------------------------------------------------------------------------------
+
+/**
+ * Clip rectangles are nested: the new one is intersected with the
+ * current one.
+ */
+void libqu_graphics_push_clip_rect(qu_recti rect)
 {
-    float ax = rect.x;
-    float ay = rect.y;
-    float bx = rect.x + rect.w;
-    float by = rect.y + rect.h;
+    if (rect.w < 0) {
+        rect.x += rect.w;
+        rect.w = -rect.w;
+    }
+
+    if (rect.h < 0) {
+        rect.y += rect.h;
+        rect.h = -rect.h;
+    }
 
-    float s = sub.x / texture->image->size.x;
-    float t = sub.y / texture->image->size.y;
-    float u = (sub.x + sub.w) / texture->image->size.x;
-    float v = (sub.y + sub.h) / texture->image->size.y;
+    size_t depth = arrlenu(priv.clip_stack);
 
-    struct libqu_vertex vertices[] = {
-        { { ax, ay }, 0xFFFFFFFF, { s, t } },
-        { { bx, ay }, 0xFFFFFFFF, { u, t } },
-        { { bx, by }, 0xFFFFFFFF, { u, v } },
-        { { ax, by }, 0xFFFFFFFF, { s, v } },
-    };
+    if (depth > 0) {
+        qu_recti top = priv.clip_stack[depth - 1];
 
-    struct rendercmd cmd = {
-        .op = RENDEROP_DRAW,
-        .args = {
-            .draw = {
-                .mode = LIBQU_DRAW_MODE_TRIANGLE_FAN,
-                .vertex = append_vertices(vertices, 4),
-                .count = 4,
-                .texture = texture,
-            },
-        },
-    };
+        int l = LIBQU_MAX(rect.x, top.x);
+        int t = LIBQU_MAX(rect.y, top.y);
+        int r = LIBQU_MIN(rect.x + rect.w, top.x + top.w);
+        int b = LIBQU_MIN(rect.y + rect.h, top.y + top.h);
 
-    arrput(priv.rendercmds, cmd);
+        rect.x = l;
+        rect.y = t;
+        rect.w = LIBQU_MAX(0, r - l);
+        rect.h = LIBQU_MAX(0, b - t);
+    }
+
+    arrput(priv.clip_stack, rect);
 }
 
-struct libqu_image *libqu_graphics_capture_screen(void)
+void libqu_graphics_pop_clip_rect(void)
 {
-    struct libqu_image *image =
-        libqu_image_create(QU_PIXFMT_R8G8B8, priv.window_size);
-    
-    if (!image) {
-        return NULL;
+    if (arrlenu(priv.clip_stack) == 0) {
+        LIBQU_LOGW("Clip rectangle stack is empty.\n");
+        return;
     }
 
-    if (priv.impl->capture_screen(image) == -1) {
-        libqu_image_destroy(image);
-        return NULL;
+    arrsetlen(priv.clip_stack, arrlenu(priv.clip_stack) - 1);
+}
+
+//------------------------------------------------------------------------------
+
+static void update_transform(void)
+{
+    priv.transform_identity = affine_is_identity(&priv.transform);
+}
+
+void libqu_graphics_push_transform(void)
+{
+    arrput(priv.transform_stack, priv.transform);
+}
+
+void libqu_graphics_pop_transform(void)
+{
+    if (arrlenu(priv.transform_stack) == 0) {
+        LIBQU_LOGW("Transform stack is empty.\n");
+        return;
     }
 
-    return image;
+    priv.transform = arrpop(priv.transform_stack);
+    update_transform();
 }
 
-void libqu_graphics_set_blend_mode(qu_blend_mode mode)
+void libqu_graphics_reset_transform(void)
 {
-    struct rendercmd cmd = {
-        .op = RENDEROP_SET_BLEND_MODE,
-        .args = {
-            .set_blend_mode = {
-                .mode = mode,
-            },
-        },
-    };
+    affine_identity(&priv.transform);
+    update_transform();
+}
 
-    arrput(priv.rendercmds, cmd);
+void libqu_graphics_translate(qu_vec2f offset)
+{
+    affine_translate(&priv.transform, offset.x, offset.y);
+    update_transform();
+}
+
+void libqu_graphics_rotate(float degrees)
+{
+    affine_rotate(&priv.transform, degrees * DEGREES_TO_RADIANS);
+    update_transform();
+}
+
+void libqu_graphics_scale(qu_vec2f scale)
+{
+    affine_scale(&priv.transform, scale.x, scale.y);
+    update_transform();
+}
+
+//------------------------------------------------------------------------------
+
+/**
+ * Vertices and commands are accumulated until the frame is presented, or
+ * until either count reaches its limit. Zero restores the default limit,
+ * negative values remove it.
+ */
+void libqu_graphics_set_flush_threshold(int vertices, int commands)
+{
+    priv.flush_vertices = (vertices < 0) ? SIZE_MAX : (size_t) vertices;
+    priv.flush_commands = (commands < 0) ? SIZE_MAX : (size_t) commands;
+}
+
+void libqu_graphics_get_stats(qu_graphics_stats *stats)
+{
+    *stats = priv.stats;
+    stats->texture_memory = priv.texture_memory;
+    stats->render_scale = priv.render_scale;
+}
+
+/**
+ * Fixed render scale, also turns off dynamic resolution. Smooth
+ * upscale uses linear filtering, otherwise pixels are repeated.
+ */
+void libqu_graphics_set_render_scale(float scale, bool smooth)
+{
+    priv.requested_scale = LIBQU_MAX(MIN_RENDER_SCALE, LIBQU_MIN(1.f, scale));
+    priv.upscale_smooth = smooth;
+    priv.render_scale_dirty = true;
+    priv.target_frame_time = 0.0;
+}
+
+/**
+ * Lets the scale follow GPU frame time (in seconds), never going below
+ * `min_scale`. Zero or negative frame time turns it off and keeps the
+ * current scale.
+ */
+void libqu_graphics_set_dynamic_resolution(double frame_time, float min_scale,
+    bool smooth)
+{
+    if (smooth != priv.upscale_smooth) {
+        priv.upscale_smooth = smooth;
+        priv.requested_scale = priv.render_scale;
+        priv.render_scale_dirty = true;
+    }
+
+    priv.target_frame_time = frame_time;
+    priv.min_render_scale = LIBQU_MAX(MIN_RENDER_SCALE, LIBQU_MIN(1.f, min_scale));
+    priv.measured_frames = 0;
+}
+
+/**
+ * Keeps the render target between frames if incremental redraw needs it,
+ * or if skipped frames are still swapped.
+ */
+static bool update_persistence(void)
+{
+    bool persistent = priv.incremental || (priv.frame_skipping && !priv.skip_swap);
+
+    return priv.impl->set_incremental(persistent) || !persistent;
+}
+
+/**
+ * In incremental mode the previous frame is kept in the render target,
+ * and only parts of the screen where drawing differs from it are drawn
+ * again. Frames that don't differ at all are skipped.
+ */
+void libqu_graphics_set_incremental_redraw(bool enabled)
+{
+    if (enabled == priv.incremental) {
+        return;
+    }
+
+    // Commands recorded so far belong to the previous mode.
+    if (arrlenu(priv.rendercmds) > 0) {
+        libqu_graphics_flush();
+    }
+
+    priv.incremental = enabled;
+
+    if (!enabled) {
+        update_persistence();
+        free_tiles();
+        return;
+    }
+
+    if (!update_persistence()) {
+        priv.incremental = false;
+        update_persistence();
+        LIBQU_LOGW("Incremental redraw is not supported.\n");
+        return;
+    }
+
+    int cols = (priv.window_size.x + REDRAW_TILE_SIZE - 1) / REDRAW_TILE_SIZE;
+    int rows = (priv.window_size.y + REDRAW_TILE_SIZE - 1) / REDRAW_TILE_SIZE;
+
+    priv.tile_hashes = pl_calloc(cols * rows, sizeof(*priv.tile_hashes));
+    priv.prev_tile_hashes = pl_calloc(cols * rows, sizeof(*priv.prev_tile_hashes));
+    priv.invalid_tiles = pl_calloc(cols * rows, sizeof(*priv.invalid_tiles));
+
+    if (!priv.tile_hashes || !priv.prev_tile_hashes || !priv.invalid_tiles) {
+        LIBQU_LOGE("Failed to allocate redraw tiles.\n");
+        priv.incremental = false;
+        update_persistence();
+        free_tiles();
+        return;
+    }
+
+    priv.tile_cols = cols;
+    priv.tile_rows = rows;
+
+    swap_tile_hashes();
+    priv.full_redraw = true;
+}
+
+/**
+ * Skips drawing of frames identical to the previous one. Skipped frames
+ * are either not swapped at all, or swapped with the contents of the
+ * render target kept from the previous frame.
+ */
+void libqu_graphics_set_frame_skipping(bool enabled, bool skip_swap)
+{
+    if (arrlenu(priv.rendercmds) > 0) {
+        libqu_graphics_flush();
+    }
+
+    priv.frame_skipping = enabled;
+    priv.skip_swap = skip_swap;
+    priv.frame_hash = TILE_HASH_SEED;
+    priv.full_redraw = true;
+
+    if (!update_persistence()) {
+        LIBQU_LOGW("Render target can't be kept, skipped frames won't be swapped.\n");
+        priv.skip_swap = true;
+    }
+}
+
+/**
+ * Makes the next frame redraw a region even if nothing drawn over it
+ * has changed, e.g. when the application draws with its own calls.
+ */
+void libqu_graphics_invalidate_rect(qu_recti rect)
+{
+    if (!priv.incremental || rect.w <= 0 || rect.h <= 0) {
+        return;
+    }
+
+    int col0 = LIBQU_MAX(0, rect.x / REDRAW_TILE_SIZE);
+    int row0 = LIBQU_MAX(0, rect.y / REDRAW_TILE_SIZE);
+    int col1 = LIBQU_MIN(priv.tile_cols - 1, (rect.x + rect.w - 1) / REDRAW_TILE_SIZE);
+    int row1 = LIBQU_MIN(priv.tile_rows - 1, (rect.y + rect.h - 1) / REDRAW_TILE_SIZE);
+
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            priv.invalid_tiles[row * priv.tile_cols + col] = true;
+        }
+    }
 }
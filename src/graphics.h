@@ -23,10 +23,21 @@
 
 //------------------------------------------------------------------------------
 
+#include "algebra.h"
 #include "fs.h"
 
 //------------------------------------------------------------------------------
 
+#define LIBQU_MIN(a, b)     ((a) < (b) ? (a) : (b))
+#define LIBQU_MAX(a, b)     ((a) > (b) ? (a) : (b))
+
+#define LIBQU_MESH_MAX_POINTS           8
+#define LIBQU_MESH_MAX_CLIPPED_POINTS   (LIBQU_MESH_MAX_POINTS + 4)
+
+#define LIBQU_MAX_TEXTURE_UNITS         8
+
+//------------------------------------------------------------------------------
+
 enum libqu_draw_mode
 {
     LIBQU_DRAW_MODE_POINTS,
@@ -39,6 +50,28 @@ enum libqu_draw_mode
     LIBQU_TOTAL_DRAW_MODES,
 };
 
+/**
+ * Alpha channel summary of a texture or a part of it. Bits are combined
+ * with bitwise OR when merging several regions.
+ */
+enum libqu_alpha_bits
+{
+    LIBQU_ALPHA_ZERO = (1 << 0),        /*!< Has fully transparent texels */
+    LIBQU_ALPHA_FULL = (1 << 1),        /*!< Has fully opaque texels */
+    LIBQU_ALPHA_PARTIAL = (1 << 2),     /*!< Has translucent texels */
+};
+
+/**
+ * Tells the backend how the draw call can be blended.
+ */
+enum libqu_blend_hint
+{
+    LIBQU_BLEND_HINT_NONE,              /*!< Use current blend mode */
+    LIBQU_BLEND_HINT_OPAQUE,            /*!< Blending can be disabled */
+    LIBQU_BLEND_HINT_ALPHA_TEST,        /*!< Discard instead of blending */
+    LIBQU_TOTAL_BLEND_HINTS,
+};
+
 struct libqu_vertex
 {
     qu_vec2f pos;
@@ -53,13 +86,115 @@ struct libqu_image
     unsigned char *pixels;
 };
 
+struct libqu_alpha_tiles
+{
+    int size;
+    int cols;
+    int rows;
+    unsigned char *bits;
+};
+
+/**
+ * Convex outline of the visible part of a texture, in normalized
+ * texture coordinates.
+ */
+struct libqu_mesh
+{
+    int count;
+    qu_vec2f *points;
+};
+
+/**
+ * Where the pixels of a texture came from. Either `path` or `buffer` is
+ * set. Textures that know their source can drop their pixels after
+ * upload and be evicted, as they can be decoded again when needed.
+ */
+struct libqu_texture_source
+{
+    char const *path;
+    void const *buffer;
+    size_t size;
+};
+
+/**
+ * Textures larger than the backend allows are split into a grid of
+ * smaller ones. Each cell covers `step` texels plus a texel of its
+ * neighbours on every side, so that filtering doesn't show seams.
+ */
+struct libqu_texture_grid
+{
+    int cols;
+    int rows;
+    int step;
+    struct libqu_texture **cells;
+};
+
 struct libqu_texture
 {
-    struct libqu_image *image;
+    struct libqu_image *image;      /*!< NULL once pixels are released */
+    struct libqu_texture_source source;
+    qu_pixel_format format;
+    qu_vec2i size;                  /*!< Size of the stored pixels */
+    qu_vec2i full_size;             /*!< Size seen by callers, before downscaling */
+    int downscale;                  /*!< Pixels are scaled down by 2^downscale */
+    bool resident;                  /*!< Uploaded to the backend */
+    unsigned int last_use;          /*!< Flush serial of the last draw */
     unsigned int flags;
+    unsigned int alpha;
+    struct libqu_alpha_tiles tiles;
+    struct libqu_mesh mesh;
+    struct libqu_texture_grid grid;
+    unsigned int version;           /*!< Changes with contents and flags */
+    bool premultiplied;             /*!< Color is sampled multiplied by alpha */
     uintptr_t priv[4];
 };
 
+/**
+ * Vertices stored by the backend across frames. Used for geometry that
+ * rarely changes, e.g. chunks of a tilemap.
+ */
+struct libqu_vertex_buffer
+{
+    enum libqu_draw_mode mode;
+    size_t count;
+    bool queued;
+    qu_rectf bounds;                /*!< Bounding box of the vertices */
+    uint64_t hash;                  /*!< Hash of the vertices */
+    uintptr_t priv[2];
+};
+
+/**
+ * State of a single particle simulated on the GPU. Colors are in the
+ * 0-255 range, deltas are per second.
+ */
+struct libqu_particle_state
+{
+    qu_vec2f position;
+    qu_vec2f velocity;
+    float color[4];
+    float color_delta[4];
+    float size;
+    float life;
+};
+
+/**
+ * Ring of particle slots owned by the backend. `count` slots starting
+ * from zero are simulated and drawn.
+ */
+struct libqu_particle_buffer
+{
+    int capacity;
+    int count;
+    bool queued;
+    uintptr_t priv[8];
+};
+
+struct libqu_tilemap;
+struct libqu_emitter;
+struct libqu_vtexture;
+struct libqu_font;
+struct libqu_scene;
+
 struct libqu_graphics_params
 {
     qu_vec2i window_size;
@@ -70,7 +205,7 @@ struct libqu_graphics_impl
     bool (*check_if_available)(void);
     bool (*initialize)(struct libqu_graphics_params const *params);
     void (*terminate)(void);
-    void (*upload_vertices)(struct libqu_vertex *vertices, size_t count);
+    void (*upload_vertices)(struct libqu_vertex *vertices, int8_t const *units, size_t count);
     void (*clear)(qu_color color);
     void (*draw)(enum libqu_draw_mode mode, size_t vertex, size_t count);
     int (*load_texture)(struct libqu_texture *texture);
@@ -78,12 +213,32 @@ struct libqu_graphics_impl
     void (*update_texture_flags)(struct libqu_texture *texture);
     void (*apply_texture)(struct libqu_texture *texture);
     void (*apply_blend_mode)(qu_blend_mode const *mode);
+    void (*apply_blend_hint)(enum libqu_blend_hint hint);
     int (*capture_screen)(struct libqu_image *image);
+    int (*update_vertex_buffer)(struct libqu_vertex_buffer *buffer, struct libqu_vertex const *vertices, size_t count);
+    void (*destroy_vertex_buffer)(struct libqu_vertex_buffer *buffer);
+    void (*draw_vertex_buffer)(struct libqu_vertex_buffer *buffer, affine_t const *transform);
+    int (*create_particle_buffer)(struct libqu_particle_buffer *buffer);
+    void (*destroy_particle_buffer)(struct libqu_particle_buffer *buffer);
+    void (*write_particles)(struct libqu_particle_buffer *buffer, int slot, struct libqu_particle_state const *states, int count);
+    void (*update_particle_buffer)(struct libqu_particle_buffer *buffer, float dt, qu_vec2f gravity);
+    void (*draw_particle_buffer)(struct libqu_particle_buffer *buffer, affine_t const *transform);
+    void (*apply_clip)(qu_recti const *rect);
+    int (*get_max_texture_size)(void);
+    void (*write_texture)(struct libqu_texture *texture, qu_vec2i pos, struct libqu_image const *image);
+    int (*get_texture_units)(void);
+    void (*apply_texture_set)(struct libqu_texture *const *textures, int count);
+    bool (*set_render_scale)(float scale, bool smooth);
+    void (*present)(void);
+    double (*get_frame_time)(void);
+    bool (*set_incremental)(bool enabled);
+    void (*set_redraw_rect)(qu_recti const *rect);
 };
 
 //------------------------------------------------------------------------------
 
 extern struct libqu_graphics_impl const libqu_graphics_null_impl;
+extern struct libqu_graphics_impl const libqu_graphics_soft_impl;
 
 #ifdef QU_USE_OPENGL
 extern struct libqu_graphics_impl const libqu_graphics_gl3_impl;
@@ -94,6 +249,7 @@ extern struct libqu_graphics_impl const libqu_graphics_gl3_impl;
 void libqu_graphics_initialize(struct libqu_graphics_params const *params);
 void libqu_graphics_terminate(void);
 void libqu_graphics_flush(void);
+bool libqu_graphics_present(void);
 void libqu_graphics_clear(qu_color color);
 void libqu_graphics_draw_point(qu_vec2f pos, qu_color color);
 void libqu_graphics_draw_line(qu_vec2f a, qu_vec2f b, qu_color color);
@@ -101,21 +257,116 @@ void libqu_graphics_draw_triangle(qu_vec2f a, qu_vec2f b, qu_vec2f c, qu_color o
 void libqu_graphics_draw_rectangle(qu_vec2f pos, qu_vec2f size, qu_color outline, qu_color fill);
 
 struct libqu_image *libqu_image_create(qu_pixel_format format, qu_vec2i size);
-struct libqu_image *libqu_image_copy_flipped(struct libqu_image *image);
+struct libqu_image *libqu_image_copy(struct libqu_image const *image);
+struct libqu_image *libqu_image_copy_flipped(struct libqu_image const *image);
 struct libqu_image *libqu_image_load(struct libqu_file *file);
 void libqu_image_destroy(struct libqu_image *image);
 void libqu_image_flip(struct libqu_image *image);
+struct libqu_image *libqu_image_convert(struct libqu_image const *image, qu_pixel_format format);
+void libqu_image_premultiply(struct libqu_image *image);
+void libqu_image_unpremultiply(struct libqu_image *image);
+void libqu_image_blit(struct libqu_image *dst, struct libqu_image const *src, qu_vec2i pos, qu_blend_mode const *mode);
+struct libqu_image *libqu_image_downscale(struct libqu_image const *image, int shift);
+
+bool libqu_mesh_build_outline(struct libqu_mesh *mesh, struct libqu_image const *image);
+void libqu_mesh_destroy(struct libqu_mesh *mesh);
+int libqu_mesh_clip(struct libqu_mesh const *mesh, qu_rectf rect, qu_vec2f *out);
+
+bool libqu_qoi_check(struct libqu_file *file);
+struct libqu_image *libqu_qoi_load(struct libqu_file *file);
+bool libqu_qoi_save(struct libqu_image const *image, char const *path);
 
 void libqu_graphics_set_default_texture_flags(unsigned int flags);
-struct libqu_texture *libqu_graphics_load_texture(struct libqu_image *image);
+void libqu_graphics_set_premultiplied_alpha(bool enabled);
+void libqu_graphics_set_texture_downscale(int factor);
+void libqu_graphics_set_texture_residency(bool release_pixels, size_t budget);
+struct libqu_texture *libqu_graphics_load_texture(struct libqu_image *image, struct libqu_texture_source const *source);
+struct libqu_texture *libqu_graphics_load_texture_ex(struct libqu_image *image, struct libqu_texture_source const *source, unsigned int flags);
+struct libqu_texture *libqu_graphics_load_downscaled_texture(struct libqu_image *image, struct libqu_texture_source const *source);
+struct libqu_texture *libqu_graphics_create_texture(qu_pixel_format format, qu_vec2i size);
+void libqu_graphics_write_texture(struct libqu_texture *texture, qu_vec2i pos, struct libqu_image const *image);
+int libqu_graphics_get_max_texture_size(void);
 void libqu_graphics_destroy_texture(struct libqu_texture *texture);
 void libqu_graphics_set_texture_flags(struct libqu_texture *texture, unsigned int flags);
 void libqu_graphics_draw_texture(struct libqu_texture *texture, qu_rectf rect);
 void libqu_graphics_draw_subtexture(struct libqu_texture *texture, qu_rectf rect, qu_rectf sub);
 
+unsigned int libqu_graphics_get_region_alpha(struct libqu_texture *texture, qu_rectf sub);
+
 struct libqu_image *libqu_graphics_capture_screen(void);
 
 void libqu_graphics_set_blend_mode(qu_blend_mode mode);
+void libqu_graphics_push_clip_rect(qu_recti rect);
+void libqu_graphics_pop_clip_rect(void);
+
+void libqu_graphics_set_flush_threshold(int vertices, int commands);
+void libqu_graphics_set_render_scale(float scale, bool smooth);
+void libqu_graphics_set_dynamic_resolution(double frame_time, float min_scale, bool smooth);
+void libqu_graphics_set_incremental_redraw(bool enabled);
+void libqu_graphics_set_frame_skipping(bool enabled, bool skip_swap);
+void libqu_graphics_invalidate_rect(qu_recti rect);
+void libqu_graphics_get_stats(qu_graphics_stats *stats);
+
+struct libqu_vertex *libqu_graphics_reserve_triangles(struct libqu_texture *texture, size_t count);
+
+qu_vec2i libqu_graphics_get_window_size(void);
+qu_rectf libqu_graphics_get_visible_rect(void);
+float libqu_graphics_get_transform_scale(void);
+
+void libqu_graphics_push_transform(void);
+void libqu_graphics_pop_transform(void);
+void libqu_graphics_reset_transform(void);
+void libqu_graphics_translate(qu_vec2f offset);
+void libqu_graphics_rotate(float degrees);
+void libqu_graphics_scale(qu_vec2f scale);
+
+bool libqu_graphics_update_vertex_buffer(struct libqu_vertex_buffer *buffer, struct libqu_vertex const *vertices, size_t count);
+void libqu_graphics_destroy_vertex_buffer(struct libqu_vertex_buffer *buffer);
+void libqu_graphics_draw_vertex_buffer(struct libqu_vertex_buffer *buffer, struct libqu_texture *texture, unsigned int alpha, qu_vec2f offset);
+
+bool libqu_graphics_create_particle_buffer(struct libqu_particle_buffer *buffer);
+void libqu_graphics_destroy_particle_buffer(struct libqu_particle_buffer *buffer);
+void libqu_graphics_write_particles(struct libqu_particle_buffer *buffer, int slot, struct libqu_particle_state const *states, int count);
+void libqu_graphics_update_particle_buffer(struct libqu_particle_buffer *buffer, float dt, qu_vec2f gravity);
+void libqu_graphics_draw_particle_buffer(struct libqu_particle_buffer *buffer, struct libqu_texture *texture);
+
+struct libqu_tilemap *libqu_tilemap_create(struct libqu_texture *tileset, qu_vec2i tile_size, qu_vec2i size);
+void libqu_tilemap_destroy(struct libqu_tilemap *tilemap);
+int libqu_tilemap_get_tile(struct libqu_tilemap *tilemap, int x, int y);
+void libqu_tilemap_set_tile(struct libqu_tilemap *tilemap, int x, int y, int tile);
+void libqu_tilemap_draw(struct libqu_tilemap *tilemap, qu_vec2f pos);
+
+struct libqu_emitter *libqu_emitter_create(struct libqu_texture *texture, int capacity, bool gpu);
+void libqu_emitter_destroy(struct libqu_emitter *emitter);
+void libqu_emitter_set_gravity(struct libqu_emitter *emitter, qu_vec2f gravity);
+void libqu_emitter_emit(struct libqu_emitter *emitter, qu_particle const *particle);
+void libqu_emitter_update(struct libqu_emitter *emitter, float dt);
+void libqu_emitter_draw(struct libqu_emitter *emitter);
+void libqu_emitter_get_stats(struct libqu_emitter *emitter, qu_emitter_stats *stats);
+
+struct libqu_vtexture *libqu_vtexture_load(struct libqu_file *file);
+void libqu_vtexture_destroy(struct libqu_vtexture *vt);
+qu_vec2i libqu_vtexture_get_size(struct libqu_vtexture *vt);
+void libqu_vtexture_draw(struct libqu_vtexture *vt, qu_rectf rect, qu_rectf sub);
+bool libqu_vtexture_save(struct libqu_image const *image, char const *path, int tile_size);
+
+struct libqu_font *libqu_font_load(struct libqu_file *file);
+void libqu_font_destroy(struct libqu_font *font);
+qu_vec2f libqu_font_measure(struct libqu_font *font, char const *text, float width, float scale);
+void libqu_font_draw(struct libqu_font *font, qu_vec2f pos, char const *text, float width, float scale, qu_text_align align, qu_color color);
+
+struct libqu_scene *libqu_scene_create(float cell_size);
+void libqu_scene_destroy(struct libqu_scene *scene);
+int libqu_scene_add_sprite(struct libqu_scene *scene, struct libqu_texture *texture, qu_rectf rect);
+void libqu_scene_remove_sprite(struct libqu_scene *scene, int index);
+bool libqu_scene_set_parent(struct libqu_scene *scene, int index, int parent);
+void libqu_scene_set_position(struct libqu_scene *scene, int index, qu_vec2f position);
+void libqu_scene_set_transform(struct libqu_scene *scene, int index, qu_vec2f position, float rotation, qu_vec2f scale);
+void libqu_scene_set_subrect(struct libqu_scene *scene, int index, qu_rectf sub);
+void libqu_scene_set_color(struct libqu_scene *scene, int index, qu_color color);
+void libqu_scene_set_order(struct libqu_scene *scene, int index, int order);
+void libqu_scene_set_visible(struct libqu_scene *scene, int index, bool visible);
+void libqu_scene_draw(struct libqu_scene *scene, qu_vec2f pos);
 
 //------------------------------------------------------------------------------
 
@@ -23,10 +23,14 @@
 //------------------------------------------------------------------------------
 
 #include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <stb_ds.h>
 #include "algebra.h"
 #include "dyn_gl3.h"
 #include "graphics.h"
+#include "platform.h"
 
 //------------------------------------------------------------------------------
 
@@ -40,6 +44,15 @@
         } while (0);
 #endif
 
+#define PROGRAM_CACHE_MAGIC         0x43505551  // "QUPC"
+#define PROGRAM_CACHE_PATH_LENGTH   512
+#define PROGRAM_CACHE_MAX_BINARY    (16 << 20)
+
+#define PARTICLE_COMPONENTS         14
+#define VERTEX_COMPONENTS           9
+#define FRAME_QUERIES               4
+#define FRAME_QUERY_MAX_NSEC        1000000000u
+
 //------------------------------------------------------------------------------
 
 enum
@@ -47,6 +60,13 @@ enum
     SHADER_VERT_GENERIC,
     SHADER_FRAG_PRIMITIVE,
     SHADER_FRAG_TEXTURED,
+    SHADER_FRAG_ALPHA_TEST,
+    SHADER_VERT_PARTICLE_UPDATE,
+    SHADER_VERT_PARTICLE_DRAW,
+    SHADER_VERT_BATCH,
+    SHADER_FRAG_BATCH,
+    SHADER_FRAG_BATCH_ALPHA_TEST,
+    SHADER_FRAG_SDF,
     TOTAL_SHADERS,
 };
 
@@ -54,6 +74,13 @@ enum
 {
     PROGRAM_PRIMITIVE,
     PROGRAM_TEXTURED,
+    PROGRAM_ALPHA_TEST,
+    PROGRAM_PARTICLE_UPDATE,
+    PROGRAM_PARTICLE_PRIMITIVE,
+    PROGRAM_PARTICLE_TEXTURED,
+    PROGRAM_BATCH,
+    PROGRAM_BATCH_ALPHA_TEST,
+    PROGRAM_SDF,
     TOTAL_PROGRAMS,
 };
 
@@ -61,9 +88,46 @@ enum
 {
     UNIFORM_PROJECTION,
     UNIFORM_MODELVIEW,
+    UNIFORM_DELTA,
+    UNIFORM_GRAVITY,
+    UNIFORM_SDF_UNITS,
     TOTAL_UNIFORMS,
 };
 
+/**
+ * Vertex attributes, bound to the same locations in every program.
+ * Particle attributes follow the layout of struct libqu_particle_state.
+ */
+enum
+{
+    ATTRIB_POSITION,
+    ATTRIB_COLOR,
+    ATTRIB_TEXCOORD,
+    ATTRIB_VELOCITY,
+    ATTRIB_COLOR_DELTA,
+    ATTRIB_SIZE,
+    ATTRIB_LIFE,
+    ATTRIB_CORNER,
+    ATTRIB_UNIT,
+    TOTAL_ATTRIBS,
+};
+
+/**
+ * GPU particle buffer objects kept in libqu_particle_buffer::priv.
+ * Two state buffers are ping-ponged: one is read, the other is written
+ * by transform feedback. Each has a VAO for update and one for drawing.
+ */
+enum
+{
+    PARTICLE_VBO_0,
+    PARTICLE_VBO_1,
+    PARTICLE_UPDATE_VAO_0,
+    PARTICLE_UPDATE_VAO_1,
+    PARTICLE_DRAW_VAO_0,
+    PARTICLE_DRAW_VAO_1,
+    PARTICLE_CURRENT,
+};
+
 struct shader_info
 {
     char const *src;
@@ -73,7 +137,8 @@ struct shader_info
 struct program_info
 {
     int vsh;
-    int fsh;
+    int fsh;                    // -1 if there is no fragment shader
+    bool feedback;              // captures particle state
 };
 
 struct shader
@@ -86,6 +151,18 @@ struct program
     GLuint id;
     GLint uniloc[TOTAL_UNIFORMS];
     unsigned int dirty;
+    GLint sdf_units;
+};
+
+/**
+ * Header of the program binary cache file. It is followed by one record
+ * per program: binary format, binary length and the binary itself.
+ */
+struct program_cache_header
+{
+    uint32_t magic;
+    uint32_t count;
+    uint64_t key;
 };
 
 //------------------------------------------------------------------------------
@@ -100,6 +177,58 @@ static GLenum const mode_map[LIBQU_TOTAL_DRAW_MODES] = {
     GL_TRIANGLE_FAN,
 };
 
+/**
+ * Turns distance into coverage, smoothed over about a pixel.
+ */
+#define SDF_COVERAGE_SRC \
+    "float sdfCoverage(float distance, float width)\n" \
+    "{\n" \
+    "    float w = max(0.5 * width, 0.001);\n" \
+    "    return smoothstep(0.5 - w, 0.5 + w, distance);\n" \
+    "}\n"
+
+/**
+ * Batch programs sample one of the bound textures, chosen per vertex;
+ * unit -1 means no texture. Samplers can only be indexed by constants
+ * in GLSL 3.30, hence the switch. Gradients are taken outside of it, as
+ * they are undefined in non-uniform control flow. Number of samplers
+ * must match LIBQU_MAX_TEXTURE_UNITS. Units with distance field textures
+ * are flagged in the low byte of u_sdfUnits, and in the high byte too if
+ * coverage must also be applied to color to keep it premultiplied.
+ */
+#define BATCH_SAMPLE_SRC \
+    "uniform sampler2D u_textures[8];\n" \
+    "uniform int u_sdfUnits;\n" \
+    SDF_COVERAGE_SRC \
+    "vec4 sampleTexture()\n" \
+    "{\n" \
+    "    vec2 dx = dFdx(v_texCoord);\n" \
+    "    vec2 dy = dFdy(v_texCoord);\n" \
+    "    switch (v_unit) {\n" \
+    "    case 0: return textureGrad(u_textures[0], v_texCoord, dx, dy);\n" \
+    "    case 1: return textureGrad(u_textures[1], v_texCoord, dx, dy);\n" \
+    "    case 2: return textureGrad(u_textures[2], v_texCoord, dx, dy);\n" \
+    "    case 3: return textureGrad(u_textures[3], v_texCoord, dx, dy);\n" \
+    "    case 4: return textureGrad(u_textures[4], v_texCoord, dx, dy);\n" \
+    "    case 5: return textureGrad(u_textures[5], v_texCoord, dx, dy);\n" \
+    "    case 6: return textureGrad(u_textures[6], v_texCoord, dx, dy);\n" \
+    "    case 7: return textureGrad(u_textures[7], v_texCoord, dx, dy);\n" \
+    "    default: return vec4(1.0);\n" \
+    "    }\n" \
+    "}\n" \
+    "vec4 sampleBatch()\n" \
+    "{\n" \
+    "    vec4 texel = sampleTexture();\n" \
+    "    float width = fwidth(texel.a);\n" \
+    "    if (v_unit >= 0 && ((u_sdfUnits >> v_unit) & 1) != 0) {\n" \
+    "        texel.a = sdfCoverage(texel.a, width);\n" \
+    "        if (((u_sdfUnits >> (v_unit + 8)) & 1) != 0) {\n" \
+    "            texel.rgb *= texel.a;\n" \
+    "        }\n" \
+    "    }\n" \
+    "    return texel;\n" \
+    "}\n"
+
 static struct shader_info const shader_info[TOTAL_SHADERS] = {
     {
         "#version 330 core\n"
@@ -139,11 +268,198 @@ static struct shader_info const shader_info[TOTAL_SHADERS] = {
         "}\n",
         GL_FRAGMENT_SHADER,
     },
+    {
+        "#version 330 core\n"
+        "in vec4 v_color;\n"
+        "in vec2 v_texCoord;\n"
+        "uniform sampler2D u_texture;\n"
+        "void main()\n"
+        "{\n"
+        "    vec4 color = texture2D(u_texture, v_texCoord) * v_color;\n"
+        "    if (color.a < 0.5) {\n"
+        "        discard;\n"
+        "    }\n"
+        "    gl_FragColor = color;\n"
+        "}\n",
+        GL_FRAGMENT_SHADER,
+    },
+    {
+        "#version 330 core\n"
+        "in vec2 a_position;\n"
+        "in vec2 a_velocity;\n"
+        "in vec4 a_color;\n"
+        "in vec4 a_colorDelta;\n"
+        "in float a_size;\n"
+        "in float a_life;\n"
+        "out vec2 o_position;\n"
+        "out vec2 o_velocity;\n"
+        "out vec4 o_color;\n"
+        "out vec4 o_colorDelta;\n"
+        "out float o_size;\n"
+        "out float o_life;\n"
+        "uniform float u_delta;\n"
+        "uniform vec2 u_gravity;\n"
+        "void main()\n"
+        "{\n"
+        "    o_velocity = a_velocity + u_gravity * u_delta;\n"
+        "    o_position = a_position + o_velocity * u_delta;\n"
+        "    o_color = a_color + a_colorDelta * u_delta;\n"
+        "    o_colorDelta = a_colorDelta;\n"
+        "    o_size = a_size;\n"
+        "    o_life = a_life - u_delta;\n"
+        "}\n",
+        GL_VERTEX_SHADER,
+    },
+    {
+        "#version 330 core\n"
+        "in vec2 a_corner;\n"
+        "in vec2 a_position;\n"
+        "in vec4 a_color;\n"
+        "in float a_size;\n"
+        "in float a_life;\n"
+        "out vec4 v_color;\n"
+        "out vec2 v_texCoord;\n"
+        "uniform mat4 u_projection;\n"
+        "uniform mat4 u_modelView;\n"
+        "void main()\n"
+        "{\n"
+        "    v_texCoord = vec2(a_corner.x + 0.5, 0.5 - a_corner.y);\n"
+        "    v_color = clamp(a_color / 255.0, 0.0, 1.0);\n"
+        "    vec4 position = vec4(a_position + a_corner * a_size, 0.0, 1.0);\n"
+        "    gl_Position = u_projection * u_modelView * position;\n"
+        "    if (a_life <= 0.0) {\n"
+        "        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);\n"
+        "    }\n"
+        "}\n",
+        GL_VERTEX_SHADER,
+    },
+    {
+        "#version 330 core\n"
+        "in vec2 a_position;\n"
+        "in vec4 a_color;\n"
+        "in vec2 a_texCoord;\n"
+        "in float a_unit;\n"
+        "out vec4 v_color;\n"
+        "out vec2 v_texCoord;\n"
+        "flat out int v_unit;\n"
+        "uniform mat4 u_projection;\n"
+        "uniform mat4 u_modelView;\n"
+        "void main()\n"
+        "{\n"
+        "    v_texCoord = a_texCoord;\n"
+        "    v_color = a_color;\n"
+        "    v_unit = int(a_unit);\n"
+        "    vec4 position = vec4(a_position, 0.0, 1.0);\n"
+        "    gl_Position = u_projection * u_modelView * position;\n"
+        "}\n",
+        GL_VERTEX_SHADER,
+    },
+    {
+        "#version 330 core\n"
+        "in vec4 v_color;\n"
+        "in vec2 v_texCoord;\n"
+        "flat in int v_unit;\n"
+        BATCH_SAMPLE_SRC
+        "void main()\n"
+        "{\n"
+        "    gl_FragColor = sampleBatch() * v_color;\n"
+        "}\n",
+        GL_FRAGMENT_SHADER,
+    },
+    {
+        "#version 330 core\n"
+        "in vec4 v_color;\n"
+        "in vec2 v_texCoord;\n"
+        "flat in int v_unit;\n"
+        BATCH_SAMPLE_SRC
+        "void main()\n"
+        "{\n"
+        "    vec4 color = sampleBatch() * v_color;\n"
+        "    if (color.a < 0.5) {\n"
+        "        discard;\n"
+        "    }\n"
+        "    gl_FragColor = color;\n"
+        "}\n",
+        GL_FRAGMENT_SHADER,
+    },
+    {
+        "#version 330 core\n"
+        "in vec4 v_color;\n"
+        "in vec2 v_texCoord;\n"
+        "uniform sampler2D u_texture;\n"
+        "uniform int u_sdfUnits;\n"
+        SDF_COVERAGE_SRC
+        "void main()\n"
+        "{\n"
+        "    vec4 texel = texture2D(u_texture, v_texCoord);\n"
+        "    texel.a = sdfCoverage(texel.a, fwidth(texel.a));\n"
+        "    if ((u_sdfUnits & 256) != 0) {\n"
+        "        texel.rgb *= texel.a;\n"
+        "    }\n"
+        "    gl_FragColor = texel * v_color;\n"
+        "}\n",
+        GL_FRAGMENT_SHADER,
+    },
+};
+
+static char const *const attrib_names[TOTAL_ATTRIBS] = {
+    "a_position",
+    "a_color",
+    "a_texCoord",
+    "a_velocity",
+    "a_colorDelta",
+    "a_size",
+    "a_life",
+    "a_corner",
+    "a_unit",
+};
+
+static char const *const feedback_varyings[] = {
+    "o_position",
+    "o_velocity",
+    "o_color",
+    "o_colorDelta",
+    "o_size",
+    "o_life",
+};
+
+/**
+ * Offsets of particle attributes in floats, in the same order as
+ * feedback varyings.
+ */
+static struct
+{
+    int attrib;
+    int size;
+    int offset;
+} const particle_layout[] = {
+    { ATTRIB_POSITION,      2,  0 },
+    { ATTRIB_VELOCITY,      2,  2 },
+    { ATTRIB_COLOR,         4,  4 },
+    { ATTRIB_COLOR_DELTA,   4,  8 },
+    { ATTRIB_SIZE,          1,  12 },
+    { ATTRIB_LIFE,          1,  13 },
+};
+
+static GLfloat const particle_corners[] = {
+    -0.5f, -0.5f,
+     0.5f, -0.5f,
+     0.5f,  0.5f,
+     0.5f,  0.5f,
+    -0.5f,  0.5f,
+    -0.5f, -0.5f,
 };
 
 static struct program_info const program_info[TOTAL_PROGRAMS] = {
-    { SHADER_VERT_GENERIC, SHADER_FRAG_PRIMITIVE },
-    { SHADER_VERT_GENERIC, SHADER_FRAG_TEXTURED },
+    { SHADER_VERT_GENERIC, SHADER_FRAG_PRIMITIVE, false },
+    { SHADER_VERT_GENERIC, SHADER_FRAG_TEXTURED, false },
+    { SHADER_VERT_GENERIC, SHADER_FRAG_ALPHA_TEST, false },
+    { SHADER_VERT_PARTICLE_UPDATE, -1, true },
+    { SHADER_VERT_PARTICLE_DRAW, SHADER_FRAG_PRIMITIVE, false },
+    { SHADER_VERT_PARTICLE_DRAW, SHADER_FRAG_TEXTURED, false },
+    { SHADER_VERT_BATCH, SHADER_FRAG_BATCH, false },
+    { SHADER_VERT_BATCH, SHADER_FRAG_BATCH_ALPHA_TEST, false },
+    { SHADER_VERT_GENERIC, SHADER_FRAG_SDF, false },
 };
 
 //------------------------------------------------------------------------------
@@ -153,6 +469,7 @@ static struct
     GLfloat *vertbuf;
     GLuint vao;
     GLuint vbo;
+    GLuint corner_vbo;
 
     struct shader shaders[TOTAL_SHADERS];
     struct program programs[TOTAL_PROGRAMS];
@@ -160,8 +477,42 @@ static struct
     mat4_t projection;
     mat4_t modelview;
 
+    bool program_binary;
+
     int current_program;
-    struct libqu_texture *current_texture;
+    struct libqu_texture *current_textures[LIBQU_MAX_TEXTURE_UNITS];
+    enum libqu_blend_hint current_blend_hint;
+
+    // Texture set is in use, draws go through batch programs.
+    bool batching;
+    GLint texture_units;
+    GLint sdf_units;
+
+    // Scissor test is on while clipping or redrawing a region, both
+    // rectangles are in window coordinates.
+    bool scissor;
+    bool clip;
+    qu_recti clip_rect;
+    bool redraw;
+    qu_recti redraw_rect;
+    GLint max_texture_size;
+
+    // Frames are rendered to an offscreen target when its size differs
+    // from the window, and upscaled on present.
+    qu_vec2i window_size;
+    qu_vec2i render_size;
+    GLint window_fbo;
+    bool persistent;            // Target is kept between frames
+    GLuint fbo;
+    GLuint fbo_texture;
+    GLenum upscale_filter;
+
+    // Ring of timer queries, results arrive a few frames late.
+    GLuint queries[FRAME_QUERIES];
+    int query_first;
+    int query_count;
+    bool query_running;
+    double frame_time;
 } priv;
 
 //------------------------------------------------------------------------------
@@ -220,7 +571,7 @@ static void unpack_color(qu_color color, GLfloat *out)
 static int choose_texture_format(struct libqu_texture *texture,
     GLenum *iformat, GLenum *format)
 {
-    switch (texture->image->format) {
+    switch (texture->format) {
     case QU_PIXFMT_Y8:
         *iformat = GL_R8;
         *format = GL_RED;
@@ -259,7 +610,7 @@ static void set_texture_parameters(unsigned int flags)
 
 static void get_texture_swizzle(struct libqu_texture *texture, GLenum *swizzle)
 {
-    switch (texture->image->format) {
+    switch (texture->format) {
     case QU_PIXFMT_Y8:
         swizzle[0] = GL_RED;
         swizzle[1] = GL_RED;
@@ -306,16 +657,28 @@ static GLuint compile_shader(char const *src, GLenum type)
     return id;
 }
 
-static GLuint link_program(GLuint vsh, GLuint fsh)
+static GLuint link_program(GLuint vsh, GLuint fsh, bool feedback)
 {
     GLuint id = glCreateProgram();
 
     _GL(glAttachShader(id, vsh));
-    _GL(glAttachShader(id, fsh));
 
-    _GL(glBindAttribLocation(id, 0, "a_position"));
-    _GL(glBindAttribLocation(id, 1, "a_color"));
-    _GL(glBindAttribLocation(id, 2, "a_texCoord"));
+    if (fsh) {
+        _GL(glAttachShader(id, fsh));
+    }
+
+    for (int i = 0; i < TOTAL_ATTRIBS; i++) {
+        _GL(glBindAttribLocation(id, i, attrib_names[i]));
+    }
+
+    if (feedback) {
+        GLsizei count = sizeof(feedback_varyings) / sizeof(*feedback_varyings);
+        _GL(glTransformFeedbackVaryings(id, count, feedback_varyings, GL_INTERLEAVED_ATTRIBS));
+    }
+
+    if (priv.program_binary) {
+        _GL(glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
 
     _GL(glLinkProgram(id));
 
@@ -345,215 +708,862 @@ static bool load_shaders(void)
     return true;
 }
 
+static void setup_program(int program)
+{
+    priv.programs[program].uniloc[UNIFORM_PROJECTION] =
+        glGetUniformLocation(priv.programs[program].id, "u_projection");
+
+    priv.programs[program].uniloc[UNIFORM_MODELVIEW] =
+        glGetUniformLocation(priv.programs[program].id, "u_modelView");
+
+    priv.programs[program].uniloc[UNIFORM_DELTA] =
+        glGetUniformLocation(priv.programs[program].id, "u_delta");
+
+    priv.programs[program].uniloc[UNIFORM_GRAVITY] =
+        glGetUniformLocation(priv.programs[program].id, "u_gravity");
+
+    priv.programs[program].uniloc[UNIFORM_SDF_UNITS] =
+        glGetUniformLocation(priv.programs[program].id, "u_sdfUnits");
+
+    // Sampler bindings are fixed, each sampler reads its own unit.
+    GLint textures = glGetUniformLocation(priv.programs[program].id, "u_textures");
+
+    if (textures != -1) {
+        GLint units[LIBQU_MAX_TEXTURE_UNITS];
+
+        for (int i = 0; i < LIBQU_MAX_TEXTURE_UNITS; i++) {
+            units[i] = i;
+        }
+
+        _GL(glUseProgram(priv.programs[program].id));
+        _GL(glUniform1iv(textures, LIBQU_MAX_TEXTURE_UNITS, units));
+    }
+
+    priv.programs[program].dirty = 0xFFFFFFFF;
+    priv.programs[program].sdf_units = 0;
+}
+
 static bool load_programs(void)
 {
     for (int i = 0; i < TOTAL_PROGRAMS; i++) {
+        int fsh_index = program_info[i].fsh;
+
         GLuint vsh = priv.shaders[program_info[i].vsh].id;
-        GLuint fsh = priv.shaders[program_info[i].fsh].id;
+        GLuint fsh = (fsh_index >= 0) ? priv.shaders[fsh_index].id : 0;
 
-        priv.programs[i].id = link_program(vsh, fsh);
+        priv.programs[i].id = link_program(vsh, fsh, program_info[i].feedback);
 
         if (!priv.programs[i].id) {
             return false;
         }
 
-        priv.programs[i].uniloc[UNIFORM_PROJECTION] =
-            glGetUniformLocation(priv.programs[i].id, "u_projection");
-
-        priv.programs[i].uniloc[UNIFORM_MODELVIEW] =
-            glGetUniformLocation(priv.programs[i].id, "u_modelView");
-        
-        priv.programs[i].dirty = 0xFFFFFFFF;
+        setup_program(i);
     }
 
     return true;
 }
 
-static void apply_program(int program)
+//------------------------------------------------------------------------------
+// Program binary cache
+
+static bool check_program_binary_support(void)
 {
-    if (priv.current_program == program) {
-        return;
+    if (!glGetProgramBinary || !glProgramBinary || !glProgramParameteri) {
+        return false;
     }
 
-    priv.current_program = program;
+    bool supported = libqu_gl_get_version() >= 410;
 
-    _GL(glUseProgram(priv.programs[program].id));
+    if (!supported) {
+        GLint count = 0;
+        _GL(glGetIntegerv(GL_NUM_EXTENSIONS, &count));
 
-    if (priv.programs[program].dirty & (1 << UNIFORM_PROJECTION)) {
-        _GL(glUniformMatrix4fv(
-            priv.programs[program].uniloc[UNIFORM_PROJECTION],
-            1, GL_FALSE, priv.projection.m
-        ));
+        for (GLint i = 0; i < count; i++) {
+            char const *ext = (char const *) glGetStringi(GL_EXTENSIONS, i);
+
+            if (ext && strcmp(ext, "GL_ARB_get_program_binary") == 0) {
+                supported = true;
+                break;
+            }
+        }
     }
 
-    if (priv.programs[program].dirty & (1 << UNIFORM_MODELVIEW)) {
-        _GL(glUniformMatrix4fv(
-            priv.programs[program].uniloc[UNIFORM_MODELVIEW],
-            1, GL_FALSE, priv.modelview.m
-        ));
+    GLint formats = 0;
+
+    if (supported) {
+        _GL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats));
     }
 
-    priv.programs[program].dirty = 0;
+    return formats > 0;
 }
 
-static void apply_texture(struct libqu_texture *texture)
+static uint64_t hash_bytes(uint64_t hash, void const *data, size_t size)
 {
-    if (priv.current_texture == texture) {
-        return;
+    unsigned char const *bytes = data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
     }
 
-    priv.current_texture = texture;
+    return hash;
+}
 
-    if (priv.current_texture) {
-        _GL(glBindTexture(GL_TEXTURE_2D, texture->priv[0]));
+static uint64_t hash_string(uint64_t hash, char const *str)
+{
+    return hash_bytes(hash, str ? str : "", str ? strlen(str) + 1 : 1);
+}
 
-        if (priv.current_program != PROGRAM_TEXTURED) {
-            apply_program(PROGRAM_TEXTURED);
-        }
-    } else {
-        _GL(glBindTexture(GL_TEXTURE_2D, 0));
+/**
+ * Binaries are only valid for the same driver and the same sources, so
+ * both are folded into the cache key.
+ */
+static uint64_t get_program_cache_key(void)
+{
+    uint64_t key = 0xcbf29ce484222325ull;
 
-        if (priv.current_program != PROGRAM_PRIMITIVE) {
-            apply_program(PROGRAM_PRIMITIVE);
-        }
+    key = hash_string(key, (char const *) glGetString(GL_VENDOR));
+    key = hash_string(key, (char const *) glGetString(GL_RENDERER));
+    key = hash_string(key, (char const *) glGetString(GL_VERSION));
+
+    for (int i = 0; i < TOTAL_SHADERS; i++) {
+        key = hash_string(key, shader_info[i].src);
+        key = hash_bytes(key, &shader_info[i].type, sizeof(shader_info[i].type));
     }
-}
 
-static void push_vertex(size_t index, struct libqu_vertex const *vertex)
-{
-    GLfloat *d = &priv.vertbuf[8 * index];
+    key = hash_bytes(key, program_info, sizeof(program_info));
 
-    *d++ = vertex->pos.x;
-    *d++ = vertex->pos.y;
+    for (int i = 0; i < TOTAL_ATTRIBS; i++) {
+        key = hash_string(key, attrib_names[i]);
+    }
 
-    *d++ = QU_EXTRACT_RED(vertex->color) / 255.f;
-    *d++ = QU_EXTRACT_GREEN(vertex->color) / 255.f;
-    *d++ = QU_EXTRACT_BLUE(vertex->color) / 255.f;
-    *d++ = QU_EXTRACT_ALPHA(vertex->color) / 255.f;
+    for (size_t i = 0; i < sizeof(feedback_varyings) / sizeof(*feedback_varyings); i++) {
+        key = hash_string(key, feedback_varyings[i]);
+    }
 
-    *d++ = vertex->texcoord.x;
-    *d++ = 1.f - vertex->texcoord.y;
+    return key;
 }
 
-static void convert_blend_mode(qu_blend_mode const *mode,
-    GLenum *csf, GLenum *cdf, GLenum *asf, GLenum *adf,
-    GLenum *ceq, GLenum *aeq)
+static bool get_program_cache_path(char *path, size_t size, uint64_t key)
 {
-    GLenum factor_map[] = {
-        GL_ZERO,
-        GL_ONE,
-        GL_SRC_COLOR,
-        GL_ONE_MINUS_SRC_COLOR,
-        GL_DST_COLOR,
-        GL_ONE_MINUS_DST_COLOR,
-        GL_SRC_ALPHA,
-        GL_ONE_MINUS_SRC_ALPHA,
-        GL_DST_ALPHA,
-        GL_ONE_MINUS_DST_ALPHA,
-    };
-
-    GLenum equation_map[] = {
-        GL_FUNC_ADD,
-        GL_FUNC_SUBTRACT,
-        GL_FUNC_REVERSE_SUBTRACT,
-    };
+    char dir[PROGRAM_CACHE_PATH_LENGTH];
 
-    assert(mode->color_src_factor >= 0);
-    assert(mode->color_src_factor < sizeof(factor_map) / sizeof(*factor_map));
-    assert(mode->color_dst_factor >= 0);
-    assert(mode->color_dst_factor < sizeof(factor_map) / sizeof(*factor_map));
-    assert(mode->color_equation >= 0);
-    assert(mode->color_equation < sizeof(equation_map) / sizeof(*equation_map));
+    if (!pl_get_cache_dir(dir, sizeof(dir))) {
+        return false;
+    }
 
-    assert(mode->alpha_src_factor >= 0);
-    assert(mode->alpha_src_factor < sizeof(factor_map) / sizeof(*factor_map));
-    assert(mode->alpha_dst_factor >= 0);
-    assert(mode->alpha_dst_factor < sizeof(factor_map) / sizeof(*factor_map));
-    assert(mode->alpha_equation >= 0);
-    assert(mode->alpha_equation < sizeof(equation_map) / sizeof(*equation_map));
+    int length = snprintf(path, size, "%s/gl3-programs-%08x%08x.bin", dir,
+        (unsigned int) (key >> 32), (unsigned int) (key & 0xffffffff));
 
-    *csf = factor_map[mode->color_src_factor];
-    *cdf = factor_map[mode->color_dst_factor];
-    *asf = factor_map[mode->alpha_src_factor];
-    *adf = factor_map[mode->alpha_dst_factor];
-    *ceq = equation_map[mode->color_equation];
-    *aeq = equation_map[mode->alpha_equation];
+    return length > 0 && (size_t) length < size;
 }
 
-//------------------------------------------------------------------------------
-
-static bool graphics_gl3_check_if_available(void)
+static void delete_programs(void)
 {
-    if (dyn_load_gl3() == -1) {
-        return false;
+    for (int i = 0; i < TOTAL_PROGRAMS; i++) {
+        if (priv.programs[i].id) {
+            _GL(glDeleteProgram(priv.programs[i].id));
+            priv.programs[i].id = 0;
+        }
     }
-
-    return libqu_gl_get_version() >= 330;
 }
 
-static bool graphics_gl3_initialize(struct libqu_graphics_params const *params)
+/**
+ * Cache file may be truncated or corrupt, so the binary size it states
+ * is checked against the rest of the file before anything is allocated.
+ */
+static bool read_cached_program(FILE *file, long file_size, int program)
 {
-    if (!load_shaders()) {
-        LIBQU_LOGE("Failed to compile GLSL shaders.\n");
-        return false;
-    }
+    uint32_t record[2];
 
-    if (!load_programs()) {
-        LIBQU_LOGE("Failed to build GLSL programs.\n");
+    if (fread(record, sizeof(record), 1, file) != 1) {
         return false;
     }
 
-    priv.current_program = -1;
-    priv.current_texture = NULL;
+    long offset = ftell(file);
 
-    _GL(glGenVertexArrays(1, &priv.vao));
-    _GL(glGenBuffers(1, &priv.vbo));
+    if (record[1] == 0 || record[1] > PROGRAM_CACHE_MAX_BINARY
+        || offset < 0 || (long) record[1] > file_size - offset) {
+        return false;
+    }
 
-    _GL(glBindVertexArray(priv.vao));
-    _GL(glEnableVertexAttribArray(0));
-    _GL(glEnableVertexAttribArray(1));
-    _GL(glEnableVertexAttribArray(2));
+    void *binary = pl_malloc(record[1]);
 
-    int width = params->window_size.x;
-    int height = params->window_size.y;
+    if (!binary) {
+        return false;
+    }
 
-    _GL(glViewport(0, 0, width, height));
+    bool success = false;
 
-    mat4_ortho(&priv.projection, 0.f, width, height, 0.f);
-    mat4_identity(&priv.modelview);
+    if (fread(binary, record[1], 1, file) == 1) {
+        GLuint id = glCreateProgram();
+        _GL(glProgramBinary(id, (GLenum) record[0], binary, (GLsizei) record[1]));
 
-    apply_program(PROGRAM_PRIMITIVE);
+        GLint status;
+        _GL(glGetProgramiv(id, GL_LINK_STATUS, &status));
 
-    _GL(glEnable(GL_BLEND));
-    _GL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+        if (status) {
+            priv.programs[program].id = id;
+            success = true;
+        } else {
+            _GL(glDeleteProgram(id));
+        }
+    }
 
-    LIBQU_LOGI("Initialized.\n");
+    pl_free(binary);
 
-    return true;
+    return success;
 }
 
-static void graphics_gl3_terminate(void)
+static bool load_cached_programs(uint64_t key)
 {
-    arrfree(priv.vertbuf);
+    char path[PROGRAM_CACHE_PATH_LENGTH];
 
-    LIBQU_LOGI("Terminated.\n");
-}
+    if (!priv.program_binary || !get_program_cache_path(path, sizeof(path), key)) {
+        return false;
+    }
+
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        return false;
+    }
+
+    long file_size = -1;
+
+    if (fseek(file, 0, SEEK_END) == 0) {
+        file_size = ftell(file);
+        rewind(file);
+    }
+
+    struct program_cache_header header;
+    bool success = file_size > 0
+        && fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == PROGRAM_CACHE_MAGIC
+        && header.count == TOTAL_PROGRAMS
+        && header.key == key;
+
+    for (int i = 0; success && i < TOTAL_PROGRAMS; i++) {
+        success = read_cached_program(file, file_size, i);
+    }
+
+    fclose(file);
+
+    // Driver may reject binaries after an update; sources are still there.
+    if (!success) {
+        LIBQU_LOGW("Cached GLSL programs are rejected, compiling from source.\n");
+        delete_programs();
+        return false;
+    }
+
+    for (int i = 0; i < TOTAL_PROGRAMS; i++) {
+        setup_program(i);
+    }
+
+    LIBQU_LOGI("Loaded GLSL programs from %s.\n", path);
+
+    return true;
+}
+
+static bool write_cached_program(FILE *file, int program)
+{
+    GLint length = 0;
+    _GL(glGetProgramiv(priv.programs[program].id, GL_PROGRAM_BINARY_LENGTH, &length));
+
+    if (length <= 0) {
+        return false;
+    }
+
+    void *binary = pl_malloc(length);
+
+    if (!binary) {
+        return false;
+    }
+
+    GLenum format;
+    _GL(glGetProgramBinary(priv.programs[program].id, length, &length, &format, binary));
+
+    uint32_t record[2] = { (uint32_t) format, (uint32_t) length };
+    bool success = fwrite(record, sizeof(record), 1, file) == 1
+        && fwrite(binary, length, 1, file) == 1;
+
+    pl_free(binary);
+
+    return success;
+}
+
+static void save_cached_programs(uint64_t key)
+{
+    char path[PROGRAM_CACHE_PATH_LENGTH];
+    char temp[PROGRAM_CACHE_PATH_LENGTH + 4];
+
+    if (!priv.program_binary || !get_program_cache_path(path, sizeof(path), key)) {
+        return;
+    }
+
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    FILE *file = fopen(temp, "wb");
+
+    if (!file) {
+        return;
+    }
+
+    struct program_cache_header header = {
+        .magic = PROGRAM_CACHE_MAGIC,
+        .count = TOTAL_PROGRAMS,
+        .key = key,
+    };
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (int i = 0; success && i < TOTAL_PROGRAMS; i++) {
+        success = write_cached_program(file, i);
+    }
+
+    success = (fclose(file) == 0) && success;
+
+    // Write to a temporary file first, so that other processes never
+    // see a partially written cache.
+    if (success) {
+        remove(path);
+        success = rename(temp, path) == 0;
+    }
+
+    if (!success) {
+        remove(temp);
+        LIBQU_LOGW("Failed to write GLSL program cache.\n");
+        return;
+    }
+
+    LIBQU_LOGI("Saved GLSL programs to %s.\n", path);
+}
+
+static void update_sdf_units(int program)
+{
+    GLint location = priv.programs[program].uniloc[UNIFORM_SDF_UNITS];
+
+    if (location == -1 || priv.programs[program].sdf_units == priv.sdf_units) {
+        return;
+    }
+
+    _GL(glUniform1i(location, priv.sdf_units));
+    priv.programs[program].sdf_units = priv.sdf_units;
+}
+
+static void apply_program(int program)
+{
+    if (priv.current_program == program) {
+        update_sdf_units(program);
+        return;
+    }
+
+    priv.current_program = program;
+
+    _GL(glUseProgram(priv.programs[program].id));
+
+    if (priv.programs[program].dirty & (1 << UNIFORM_PROJECTION)) {
+        _GL(glUniformMatrix4fv(
+            priv.programs[program].uniloc[UNIFORM_PROJECTION],
+            1, GL_FALSE, priv.projection.m
+        ));
+    }
+
+    if (priv.programs[program].dirty & (1 << UNIFORM_MODELVIEW)) {
+        _GL(glUniformMatrix4fv(
+            priv.programs[program].uniloc[UNIFORM_MODELVIEW],
+            1, GL_FALSE, priv.modelview.m
+        ));
+    }
+
+    priv.programs[program].dirty = 0;
+
+    update_sdf_units(program);
+}
+
+static void set_modelview(mat4_t const *modelview)
+{
+    mat4_copy(&priv.modelview, modelview);
+
+    for (int i = 0; i < TOTAL_PROGRAMS; i++) {
+        priv.programs[i].dirty |= (1 << UNIFORM_MODELVIEW);
+    }
+
+    if (priv.current_program >= 0) {
+        int program = priv.current_program;
+
+        _GL(glUniformMatrix4fv(
+            priv.programs[program].uniloc[UNIFORM_MODELVIEW],
+            1, GL_FALSE, priv.modelview.m
+        ));
+
+        priv.programs[program].dirty &= ~(1 << UNIFORM_MODELVIEW);
+    }
+}
+
+static int choose_program(void)
+{
+    if (priv.batching) {
+        if (priv.current_blend_hint == LIBQU_BLEND_HINT_ALPHA_TEST) {
+            return PROGRAM_BATCH_ALPHA_TEST;
+        }
+
+        return PROGRAM_BATCH;
+    }
+
+    if (!priv.current_textures[0]) {
+        return PROGRAM_PRIMITIVE;
+    }
+
+    if (priv.current_textures[0]->flags & QU_TEXTURE_SDF) {
+        return PROGRAM_SDF;
+    }
+
+    if (priv.current_blend_hint == LIBQU_BLEND_HINT_ALPHA_TEST) {
+        return PROGRAM_ALPHA_TEST;
+    }
+
+    return PROGRAM_TEXTURED;
+}
+
+/**
+ * Bits of u_sdfUnits for a texture bound to the given unit.
+ */
+static GLint get_sdf_bits(int unit, struct libqu_texture const *texture)
+{
+    if (!texture || !(texture->flags & QU_TEXTURE_SDF)) {
+        return 0;
+    }
+
+    return (texture->premultiplied ? 0x101 : 0x001) << unit;
+}
+
+/**
+ * Unit 0 stays active, other units are only switched to for binding.
+ */
+static void bind_texture(int unit, struct libqu_texture *texture)
+{
+    if (priv.current_textures[unit] == texture) {
+        return;
+    }
+
+    priv.current_textures[unit] = texture;
+
+    if (unit > 0) {
+        _GL(glActiveTexture(GL_TEXTURE0 + unit));
+    }
+
+    if (texture) {
+        _GL(glBindTexture(GL_TEXTURE_2D, texture->priv[0]));
+    } else {
+        _GL(glBindTexture(GL_TEXTURE_2D, 0));
+    }
+
+    if (unit > 0) {
+        _GL(glActiveTexture(GL_TEXTURE0));
+    }
+}
+
+static void apply_texture(struct libqu_texture *texture)
+{
+    if (!priv.batching && priv.current_textures[0] == texture) {
+        return;
+    }
+
+    priv.batching = false;
+    priv.sdf_units = get_sdf_bits(0, texture);
+    bind_texture(0, texture);
+
+    apply_program(choose_program());
+}
+
+static void apply_texture_set(struct libqu_texture *const *textures, int count)
+{
+    priv.sdf_units = 0;
+
+    for (int i = 0; i < count; i++) {
+        bind_texture(i, textures[i]);
+        priv.sdf_units |= get_sdf_bits(i, textures[i]);
+    }
+
+    priv.batching = true;
+
+    apply_program(choose_program());
+}
+
+static void apply_blend_hint(enum libqu_blend_hint hint)
+{
+    if (priv.current_blend_hint == hint) {
+        return;
+    }
+
+    priv.current_blend_hint = hint;
+
+    if (hint == LIBQU_BLEND_HINT_NONE) {
+        _GL(glEnable(GL_BLEND));
+    } else {
+        _GL(glDisable(GL_BLEND));
+    }
+
+    apply_program(choose_program());
+}
+
+static void push_vertex(size_t index, struct libqu_vertex const *vertex, int unit)
+{
+    GLfloat *d = &priv.vertbuf[VERTEX_COMPONENTS * index];
+
+    *d++ = vertex->pos.x;
+    *d++ = vertex->pos.y;
+
+    *d++ = QU_EXTRACT_RED(vertex->color) / 255.f;
+    *d++ = QU_EXTRACT_GREEN(vertex->color) / 255.f;
+    *d++ = QU_EXTRACT_BLUE(vertex->color) / 255.f;
+    *d++ = QU_EXTRACT_ALPHA(vertex->color) / 255.f;
+
+    *d++ = vertex->texcoord.x;
+    *d++ = 1.f - vertex->texcoord.y;
+
+    *d++ = (GLfloat) unit;
+}
+
+/**
+ * Clip rectangles are given in window coordinates, the render target
+ * may be smaller. Partially covered pixels are kept inside.
+ */
+static void set_scissor_rect(qu_recti const *rect)
+{
+    float sx = (float) priv.render_size.x / priv.window_size.x;
+    float sy = (float) priv.render_size.y / priv.window_size.y;
+
+    int x0 = (int) floorf(rect->x * sx);
+    int y0 = (int) floorf(rect->y * sy);
+    int x1 = (int) ceilf((rect->x + rect->w) * sx);
+    int y1 = (int) ceilf((rect->y + rect->h) * sy);
+
+    // Scissor box origin is at the bottom-left corner.
+    _GL(glScissor(x0, priv.render_size.y - y1, x1 - x0, y1 - y0));
+}
+
+static void update_scissor(void)
+{
+    bool enabled = priv.clip || priv.redraw;
+
+    if (enabled != priv.scissor) {
+        if (enabled) {
+            _GL(glEnable(GL_SCISSOR_TEST));
+        } else {
+            _GL(glDisable(GL_SCISSOR_TEST));
+        }
+
+        priv.scissor = enabled;
+    }
+
+    if (!enabled) {
+        return;
+    }
+
+    qu_recti rect = priv.clip ? priv.clip_rect : priv.redraw_rect;
+
+    if (priv.clip && priv.redraw) {
+        qu_recti const *r = &priv.redraw_rect;
+
+        int x0 = LIBQU_MAX(rect.x, r->x);
+        int y0 = LIBQU_MAX(rect.y, r->y);
+        int x1 = LIBQU_MIN(rect.x + rect.w, r->x + r->w);
+        int y1 = LIBQU_MIN(rect.y + rect.h, r->y + r->h);
+
+        rect = (qu_recti) { x0, y0, LIBQU_MAX(0, x1 - x0), LIBQU_MAX(0, y1 - y0) };
+    }
+
+    set_scissor_rect(&rect);
+}
+
+static void destroy_render_target(void)
+{
+    if (priv.fbo) {
+        _GL(glBindFramebuffer(GL_FRAMEBUFFER, priv.window_fbo));
+        _GL(glDeleteFramebuffers(1, &priv.fbo));
+        _GL(glDeleteTextures(1, &priv.fbo_texture));
+        priv.fbo = 0;
+        priv.fbo_texture = 0;
+    }
+
+    priv.render_size = priv.window_size;
+}
+
+static bool create_render_target(qu_vec2i size)
+{
+    _GL(glGenTextures(1, &priv.fbo_texture));
+    _GL(glBindTexture(GL_TEXTURE_2D, priv.fbo_texture));
+    _GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, NULL));
+    _GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    _GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+
+    // Unit 0 is tracked, put back whatever it had.
+    struct libqu_texture *current = priv.current_textures[0];
+    _GL(glBindTexture(GL_TEXTURE_2D, current ? (GLuint) current->priv[0] : 0));
+
+    _GL(glGenFramebuffers(1, &priv.fbo));
+    _GL(glBindFramebuffer(GL_FRAMEBUFFER, priv.fbo));
+    _GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, priv.fbo_texture, 0));
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        destroy_render_target();
+        return false;
+    }
+
+    priv.render_size = size;
+    return true;
+}
+
+/**
+ * Copies the offscreen target to the back buffer of the window. Scissor
+ * test affects blits, so it's turned off for the copy.
+ */
+static void blit_render_target(void)
+{
+    if (priv.scissor) {
+        _GL(glDisable(GL_SCISSOR_TEST));
+    }
+
+    _GL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, priv.window_fbo));
+    _GL(glBlitFramebuffer(0, 0, priv.render_size.x, priv.render_size.y,
+        0, 0, priv.window_size.x, priv.window_size.y,
+        GL_COLOR_BUFFER_BIT, priv.upscale_filter));
+    _GL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, priv.fbo));
+
+    if (priv.scissor) {
+        _GL(glEnable(GL_SCISSOR_TEST));
+    }
+}
+
+/**
+ * Collects finished timer queries without waiting for the GPU.
+ */
+static void poll_frame_queries(void)
+{
+    while (priv.query_count > 0) {
+        GLuint query = priv.queries[priv.query_first];
+        GLint available = 0;
+
+        _GL(glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available));
+
+        if (!available) {
+            break;
+        }
+
+        GLuint64 elapsed = 0;
+        _GL(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed));
+
+        // Some drivers report garbage for the first query of a context.
+        if (elapsed < FRAME_QUERY_MAX_NSEC) {
+            priv.frame_time = elapsed / 1e9;
+        }
+
+        priv.query_first = (priv.query_first + 1) % FRAME_QUERIES;
+        priv.query_count--;
+    }
+}
+
+/**
+ * Started when the first commands of a frame are executed, so that the
+ * swap and any idle time before the frame don't count towards it.
+ */
+static void begin_frame_query(void)
+{
+    if (priv.query_running) {
+        return;
+    }
+
+    // Frame isn't measured if all queries are still in flight.
+    if (priv.query_count == FRAME_QUERIES) {
+        return;
+    }
+
+    int index = (priv.query_first + priv.query_count) % FRAME_QUERIES;
+
+    _GL(glBeginQuery(GL_TIME_ELAPSED, priv.queries[index]));
+    priv.query_count++;
+    priv.query_running = true;
+}
+
+static void end_frame_query(void)
+{
+    if (priv.query_running) {
+        _GL(glEndQuery(GL_TIME_ELAPSED));
+        priv.query_running = false;
+    }
+}
+
+static void convert_blend_mode(qu_blend_mode const *mode,
+    GLenum *csf, GLenum *cdf, GLenum *asf, GLenum *adf,
+    GLenum *ceq, GLenum *aeq)
+{
+    GLenum factor_map[] = {
+        GL_ZERO,
+        GL_ONE,
+        GL_SRC_COLOR,
+        GL_ONE_MINUS_SRC_COLOR,
+        GL_DST_COLOR,
+        GL_ONE_MINUS_DST_COLOR,
+        GL_SRC_ALPHA,
+        GL_ONE_MINUS_SRC_ALPHA,
+        GL_DST_ALPHA,
+        GL_ONE_MINUS_DST_ALPHA,
+    };
+
+    GLenum equation_map[] = {
+        GL_FUNC_ADD,
+        GL_FUNC_SUBTRACT,
+        GL_FUNC_REVERSE_SUBTRACT,
+    };
+
+    assert(mode->color_src_factor >= 0);
+    assert(mode->color_src_factor < sizeof(factor_map) / sizeof(*factor_map));
+    assert(mode->color_dst_factor >= 0);
+    assert(mode->color_dst_factor < sizeof(factor_map) / sizeof(*factor_map));
+    assert(mode->color_equation >= 0);
+    assert(mode->color_equation < sizeof(equation_map) / sizeof(*equation_map));
+
+    assert(mode->alpha_src_factor >= 0);
+    assert(mode->alpha_src_factor < sizeof(factor_map) / sizeof(*factor_map));
+    assert(mode->alpha_dst_factor >= 0);
+    assert(mode->alpha_dst_factor < sizeof(factor_map) / sizeof(*factor_map));
+    assert(mode->alpha_equation >= 0);
+    assert(mode->alpha_equation < sizeof(equation_map) / sizeof(*equation_map));
+
+    *csf = factor_map[mode->color_src_factor];
+    *cdf = factor_map[mode->color_dst_factor];
+    *asf = factor_map[mode->alpha_src_factor];
+    *adf = factor_map[mode->alpha_dst_factor];
+    *ceq = equation_map[mode->color_equation];
+    *aeq = equation_map[mode->alpha_equation];
+}
+
+//------------------------------------------------------------------------------
+
+static bool graphics_gl3_check_if_available(void)
+{
+    if (dyn_load_gl3() == -1) {
+        return false;
+    }
+
+    return libqu_gl_get_version() >= 330;
+}
+
+static bool graphics_gl3_initialize(struct libqu_graphics_params const *params)
+{
+    dyn_load_gl3_optional();
+
+    priv.program_binary = check_program_binary_support();
+    uint64_t cache_key = get_program_cache_key();
+
+    if (!load_cached_programs(cache_key)) {
+        if (!load_shaders()) {
+            LIBQU_LOGE("Failed to compile GLSL shaders.\n");
+            return false;
+        }
+
+        if (!load_programs()) {
+            LIBQU_LOGE("Failed to build GLSL programs.\n");
+            return false;
+        }
+
+        save_cached_programs(cache_key);
+    }
+
+    priv.current_program = -1;
+    priv.current_blend_hint = LIBQU_BLEND_HINT_NONE;
+
+    _GL(glGenVertexArrays(1, &priv.vao));
+    _GL(glGenBuffers(1, &priv.vbo));
+
+    _GL(glGenBuffers(1, &priv.corner_vbo));
+    _GL(glBindBuffer(GL_ARRAY_BUFFER, priv.corner_vbo));
+    _GL(glBufferData(GL_ARRAY_BUFFER, sizeof(particle_corners), particle_corners, GL_STATIC_DRAW));
+
+    _GL(glBindVertexArray(priv.vao));
+    _GL(glEnableVertexAttribArray(0));
+    _GL(glEnableVertexAttribArray(1));
+    _GL(glEnableVertexAttribArray(2));
+    _GL(glEnableVertexAttribArray(ATTRIB_UNIT));
+
+    int width = params->window_size.x;
+    int height = params->window_size.y;
+
+    _GL(glViewport(0, 0, width, height));
+
+    // Window contents may live in a framebuffer object of the core.
+    _GL(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &priv.window_fbo));
+
+    priv.window_size = params->window_size;
+    priv.render_size = params->window_size;
+    priv.upscale_filter = GL_NEAREST;
+    priv.frame_time = -1.0;
+
+    _GL(glGenQueries(FRAME_QUERIES, priv.queries));
+
+    // Rows of RGB and grayscale images aren't padded.
+    _GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+    _GL(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &priv.max_texture_size));
+    LIBQU_LOGI("Maximum texture size: %d\n", priv.max_texture_size);
+
+    _GL(glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &priv.texture_units));
+
+    mat4_ortho(&priv.projection, 0.f, width, height, 0.f);
+    mat4_identity(&priv.modelview);
+
+    apply_program(PROGRAM_PRIMITIVE);
+
+    _GL(glEnable(GL_BLEND));
+    _GL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+
+    LIBQU_LOGI("Initialized.\n");
+
+    return true;
+}
+
+static void graphics_gl3_terminate(void)
+{
+    end_frame_query();
 
-static void graphics_gl3_upload_vertices(struct libqu_vertex *vertices, size_t count)
+    _GL(glDeleteQueries(FRAME_QUERIES, priv.queries));
+    destroy_render_target();
+
+    arrfree(priv.vertbuf);
+
+    LIBQU_LOGI("Terminated.\n");
+}
+
+static void set_vertex_attributes(void)
+{
+    GLsizei stride = sizeof(GLfloat) * VERTEX_COMPONENTS;
+
+    _GL(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *) 0));
+    _GL(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void *) (sizeof(GLfloat) * 2)));
+    _GL(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *) (sizeof(GLfloat) * 6)));
+    _GL(glVertexAttribPointer(ATTRIB_UNIT, 1, GL_FLOAT, GL_FALSE, stride, (void *) (sizeof(GLfloat) * 8)));
+}
+
+static void graphics_gl3_upload_vertices(struct libqu_vertex *vertices,
+    int8_t const *units, size_t count)
 {
-    arrsetlen(priv.vertbuf, 8 * count);
+    // Every execution of recorded commands starts with an upload.
+    begin_frame_query();
+
+    arrsetlen(priv.vertbuf, VERTEX_COMPONENTS * count);
 
     for (size_t v = 0; v < count; v++) {
-        push_vertex(v, &vertices[v]);
+        push_vertex(v, &vertices[v], units ? units[v] : -1);
     }
 
     _GL(glBindBuffer(GL_ARRAY_BUFFER, priv.vbo));
     _GL(glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * arrlen(priv.vertbuf), priv.vertbuf, GL_STREAM_DRAW));
 
     _GL(glBindVertexArray(priv.vao));
-    _GL(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void *) 0));
-    _GL(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void *) (sizeof(GLfloat) * 2)));
-    _GL(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void *) (sizeof(GLfloat) * 6)));
+    set_vertex_attributes();
 }
 
 static void graphics_gl3_clear(qu_color color)
@@ -562,7 +1572,18 @@ static void graphics_gl3_clear(qu_color color)
     unpack_color(color, c);
 
     _GL(glClearColor(c[0], c[1], c[2], c[3]));
-    _GL(glClear(GL_COLOR_BUFFER_BIT));
+
+    // Clearing affects the whole screen (or the region being redrawn)
+    // regardless of clipping.
+    if (priv.clip) {
+        priv.clip = false;
+        update_scissor();
+        _GL(glClear(GL_COLOR_BUFFER_BIT));
+        priv.clip = true;
+        update_scissor();
+    } else {
+        _GL(glClear(GL_COLOR_BUFFER_BIT));
+    }
 }
 
 static void graphics_gl3_draw(enum libqu_draw_mode mode, size_t vertex, size_t count)
@@ -585,15 +1606,15 @@ static int graphics_gl3_load_texture(struct libqu_texture *texture)
         return -1;
     }
 
-    priv.current_texture = texture;
+    priv.current_textures[0] = texture;
     _GL(glBindTexture(GL_TEXTURE_2D, id));
 
     struct libqu_image *flipped = libqu_image_copy_flipped(texture->image);
 
     _GL(glTexImage2D(GL_TEXTURE_2D,
         0, iformat,
-        texture->image->size.x,
-        texture->image->size.y,
+        texture->size.x,
+        texture->size.y,
         0, format,
         GL_UNSIGNED_BYTE, flipped->pixels));
     
@@ -611,19 +1632,21 @@ static int graphics_gl3_load_texture(struct libqu_texture *texture)
 
     texture->priv[0] = (uintptr_t) id;
 
-	if (priv.current_program != PROGRAM_TEXTURED) {
-		apply_program(PROGRAM_TEXTURED);
-	}
+    apply_program(choose_program());
 
     return 0;
 }
 
 static void graphics_gl3_destroy_texture(struct libqu_texture *texture)
 {
-    if (priv.current_texture == texture) {
-        apply_texture(NULL);
+    for (int i = 0; i < LIBQU_MAX_TEXTURE_UNITS; i++) {
+        if (priv.current_textures[i] == texture) {
+            bind_texture(i, NULL);
+        }
     }
 
+    apply_program(choose_program());
+
     GLuint id = (GLuint) texture->priv[0];
     _GL(glDeleteTextures(1, &id));
 }
@@ -632,6 +1655,10 @@ static void graphics_gl3_update_texture_flags(struct libqu_texture *texture)
 {
     apply_texture(texture);
     set_texture_parameters(texture->flags);
+
+    // Distance field flag selects a different program.
+    priv.sdf_units = get_sdf_bits(0, texture);
+    apply_program(choose_program());
 }
 
 static void graphics_gl3_apply_texture(struct libqu_texture *texture)
@@ -639,6 +1666,12 @@ static void graphics_gl3_apply_texture(struct libqu_texture *texture)
     apply_texture(texture);
 }
 
+static void graphics_gl3_apply_texture_set(struct libqu_texture *const *textures,
+    int count)
+{
+    apply_texture_set(textures, count);
+}
+
 static void graphics_gl3_apply_blend_mode(qu_blend_mode const *mode)
 {
     GLenum csf, cdf, asf, adf, ceq, aeq;
@@ -648,16 +1681,394 @@ static void graphics_gl3_apply_blend_mode(qu_blend_mode const *mode)
     _GL(glBlendEquationSeparate(ceq, aeq));
 }
 
+static void graphics_gl3_apply_blend_hint(enum libqu_blend_hint hint)
+{
+    apply_blend_hint(hint);
+}
+
 static int graphics_gl3_capture_screen(struct libqu_image *image)
 {
+    // Screen shows the upscaled frame, which is only built on present.
+    if (priv.fbo) {
+        blit_render_target();
+        _GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, priv.window_fbo));
+    }
+
     _GL(glReadPixels(0, 0, image->size.x, image->size.y,
         GL_RGB, GL_UNSIGNED_BYTE, image->pixels));
 
+    if (priv.fbo) {
+        _GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, priv.fbo));
+    }
+
     libqu_image_flip(image);
 
     return 0;
 }
 
+/**
+ * Each buffer has its own VAO and VBO. The stream VAO is bound back
+ * after every operation, so regular draw calls are not affected.
+ */
+static int graphics_gl3_update_vertex_buffer(struct libqu_vertex_buffer *buffer,
+    struct libqu_vertex const *vertices, size_t count)
+{
+    GLuint vao = (GLuint) buffer->priv[0];
+    GLuint vbo = (GLuint) buffer->priv[1];
+
+    if (!vao) {
+        _GL(glGenVertexArrays(1, &vao));
+        _GL(glGenBuffers(1, &vbo));
+
+        if (!vao || !vbo) {
+            return -1;
+        }
+
+        _GL(glBindVertexArray(vao));
+        _GL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+        _GL(glEnableVertexAttribArray(0));
+        _GL(glEnableVertexAttribArray(1));
+        _GL(glEnableVertexAttribArray(2));
+        set_vertex_attributes();
+        _GL(glBindVertexArray(priv.vao));
+
+        buffer->priv[0] = (uintptr_t) vao;
+        buffer->priv[1] = (uintptr_t) vbo;
+    }
+
+    arrsetlen(priv.vertbuf, VERTEX_COMPONENTS * count);
+
+    for (size_t v = 0; v < count; v++) {
+        push_vertex(v, &vertices[v], -1);
+    }
+
+    _GL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+    _GL(glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * VERTEX_COMPONENTS * count, priv.vertbuf, GL_STATIC_DRAW));
+    _GL(glBindBuffer(GL_ARRAY_BUFFER, priv.vbo));
+
+    buffer->count = count;
+
+    return 0;
+}
+
+static void graphics_gl3_destroy_vertex_buffer(struct libqu_vertex_buffer *buffer)
+{
+    GLuint vao = (GLuint) buffer->priv[0];
+    GLuint vbo = (GLuint) buffer->priv[1];
+
+    if (vao) {
+        _GL(glDeleteVertexArrays(1, &vao));
+        _GL(glDeleteBuffers(1, &vbo));
+    }
+
+    buffer->priv[0] = 0;
+    buffer->priv[1] = 0;
+    buffer->count = 0;
+}
+
+static void graphics_gl3_draw_vertex_buffer(struct libqu_vertex_buffer *buffer,
+    affine_t const *transform)
+{
+    if (!buffer->priv[0]) {
+        return;
+    }
+
+    mat4_t modelview;
+    affine_to_mat4(&modelview, transform);
+    set_modelview(&modelview);
+
+    _GL(glBindVertexArray((GLuint) buffer->priv[0]));
+    _GL(glDrawArrays(mode_map[buffer->mode], 0, (GLsizei) buffer->count));
+    _GL(glBindVertexArray(priv.vao));
+
+    mat4_identity(&modelview);
+    set_modelview(&modelview);
+}
+
+static void set_particle_attributes(GLuint vao, GLuint vbo, GLuint divisor)
+{
+    _GL(glBindVertexArray(vao));
+
+    if (divisor) {
+        _GL(glBindBuffer(GL_ARRAY_BUFFER, priv.corner_vbo));
+        _GL(glEnableVertexAttribArray(ATTRIB_CORNER));
+        _GL(glVertexAttribPointer(ATTRIB_CORNER, 2, GL_FLOAT, GL_FALSE, 0, (void *) 0));
+    }
+
+    _GL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+
+    for (size_t i = 0; i < sizeof(particle_layout) / sizeof(*particle_layout); i++) {
+        GLuint attrib = particle_layout[i].attrib;
+        size_t offset = sizeof(GLfloat) * particle_layout[i].offset;
+
+        _GL(glEnableVertexAttribArray(attrib));
+        _GL(glVertexAttribPointer(attrib, particle_layout[i].size, GL_FLOAT, GL_FALSE,
+            sizeof(GLfloat) * PARTICLE_COMPONENTS, (void *) offset));
+        _GL(glVertexAttribDivisor(attrib, divisor));
+    }
+}
+
+static int graphics_gl3_create_particle_buffer(struct libqu_particle_buffer *buffer)
+{
+    GLuint vbo[2];
+    GLuint vao[4];
+
+    _GL(glGenBuffers(2, vbo));
+    _GL(glGenVertexArrays(4, vao));
+
+    for (int i = 0; i < 2; i++) {
+        _GL(glBindBuffer(GL_ARRAY_BUFFER, vbo[i]));
+        _GL(glBufferData(GL_ARRAY_BUFFER,
+            sizeof(struct libqu_particle_state) * buffer->capacity, NULL, GL_DYNAMIC_COPY));
+
+        set_particle_attributes(vao[i], vbo[i], 0);
+        set_particle_attributes(vao[2 + i], vbo[i], 1);
+
+        buffer->priv[PARTICLE_VBO_0 + i] = vbo[i];
+        buffer->priv[PARTICLE_UPDATE_VAO_0 + i] = vao[i];
+        buffer->priv[PARTICLE_DRAW_VAO_0 + i] = vao[2 + i];
+    }
+
+    buffer->priv[PARTICLE_CURRENT] = 0;
+
+    _GL(glBindVertexArray(priv.vao));
+    _GL(glBindBuffer(GL_ARRAY_BUFFER, priv.vbo));
+
+    return 0;
+}
+
+static void graphics_gl3_destroy_particle_buffer(struct libqu_particle_buffer *buffer)
+{
+    for (int i = 0; i < 2; i++) {
+        GLuint vbo = (GLuint) buffer->priv[PARTICLE_VBO_0 + i];
+        GLuint update_vao = (GLuint) buffer->priv[PARTICLE_UPDATE_VAO_0 + i];
+        GLuint draw_vao = (GLuint) buffer->priv[PARTICLE_DRAW_VAO_0 + i];
+
+        _GL(glDeleteBuffers(1, &vbo));
+        _GL(glDeleteVertexArrays(1, &update_vao));
+        _GL(glDeleteVertexArrays(1, &draw_vao));
+    }
+
+    memset(buffer->priv, 0, sizeof(buffer->priv));
+}
+
+static void graphics_gl3_write_particles(struct libqu_particle_buffer *buffer,
+    int slot, struct libqu_particle_state const *states, int count)
+{
+    GLuint vbo = (GLuint) buffer->priv[PARTICLE_VBO_0 + buffer->priv[PARTICLE_CURRENT]];
+
+    _GL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+    _GL(glBufferSubData(GL_ARRAY_BUFFER, sizeof(*states) * slot, sizeof(*states) * count, states));
+    _GL(glBindBuffer(GL_ARRAY_BUFFER, priv.vbo));
+}
+
+/**
+ * Advances particles with transform feedback: the current buffer is
+ * read as vertex attributes, and the result is written to the other one.
+ * Nothing is rasterized and nothing is read back.
+ */
+static void graphics_gl3_update_particle_buffer(struct libqu_particle_buffer *buffer,
+    float dt, qu_vec2f gravity)
+{
+    if (buffer->count == 0) {
+        return;
+    }
+
+    int src = (int) buffer->priv[PARTICLE_CURRENT];
+    int dst = 1 - src;
+
+    apply_program(PROGRAM_PARTICLE_UPDATE);
+
+    _GL(glUniform1f(priv.programs[PROGRAM_PARTICLE_UPDATE].uniloc[UNIFORM_DELTA], dt));
+    _GL(glUniform2f(priv.programs[PROGRAM_PARTICLE_UPDATE].uniloc[UNIFORM_GRAVITY], gravity.x, gravity.y));
+
+    _GL(glBindVertexArray((GLuint) buffer->priv[PARTICLE_UPDATE_VAO_0 + src]));
+    _GL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, (GLuint) buffer->priv[PARTICLE_VBO_0 + dst]));
+
+    _GL(glEnable(GL_RASTERIZER_DISCARD));
+    _GL(glBeginTransformFeedback(GL_POINTS));
+    _GL(glDrawArrays(GL_POINTS, 0, buffer->count));
+    _GL(glEndTransformFeedback());
+    _GL(glDisable(GL_RASTERIZER_DISCARD));
+
+    _GL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0));
+    _GL(glBindVertexArray(priv.vao));
+
+    buffer->priv[PARTICLE_CURRENT] = dst;
+
+    apply_program(choose_program());
+}
+
+static void graphics_gl3_draw_particle_buffer(struct libqu_particle_buffer *buffer,
+    affine_t const *transform)
+{
+    if (buffer->count == 0) {
+        return;
+    }
+
+    int current = (int) buffer->priv[PARTICLE_CURRENT];
+
+    mat4_t modelview;
+    affine_to_mat4(&modelview, transform);
+    set_modelview(&modelview);
+
+    apply_program(priv.current_textures[0] ? PROGRAM_PARTICLE_TEXTURED : PROGRAM_PARTICLE_PRIMITIVE);
+
+    _GL(glBindVertexArray((GLuint) buffer->priv[PARTICLE_DRAW_VAO_0 + current]));
+    _GL(glDrawArraysInstanced(GL_TRIANGLES, 0, 6, buffer->count));
+    _GL(glBindVertexArray(priv.vao));
+
+    mat4_identity(&modelview);
+    set_modelview(&modelview);
+
+    apply_program(choose_program());
+}
+
+static void graphics_gl3_apply_clip(qu_recti const *rect)
+{
+    priv.clip = (rect != NULL);
+
+    if (rect) {
+        priv.clip_rect = *rect;
+    }
+
+    update_scissor();
+}
+
+static int graphics_gl3_get_max_texture_size(void)
+{
+    return priv.max_texture_size;
+}
+
+static void graphics_gl3_write_texture(struct libqu_texture *texture,
+    qu_vec2i pos, struct libqu_image const *image)
+{
+    GLenum iformat, format;
+
+    if (choose_texture_format(texture, &iformat, &format) == -1) {
+        return;
+    }
+
+    struct libqu_image *flipped = libqu_image_copy_flipped(image);
+
+    if (!flipped) {
+        return;
+    }
+
+    apply_texture(texture);
+
+    // Textures are stored upside down.
+    _GL(glTexSubImage2D(GL_TEXTURE_2D, 0,
+        pos.x, texture->size.y - pos.y - image->size.y,
+        image->size.x, image->size.y,
+        format, GL_UNSIGNED_BYTE, flipped->pixels));
+
+    libqu_image_destroy(flipped);
+
+    apply_program(choose_program());
+}
+
+static int graphics_gl3_get_texture_units(void)
+{
+    return priv.texture_units;
+}
+
+/**
+ * Renders offscreen when the frame is smaller than the window, or when
+ * it has to persist between frames. Only called between frames: the
+ * target is recreated and its previous contents are lost.
+ */
+static bool update_render_target(qu_vec2i size)
+{
+    bool offscreen = priv.persistent
+        || size.x != priv.window_size.x || size.y != priv.window_size.y;
+
+    if (offscreen == (priv.fbo != 0)
+            && size.x == priv.render_size.x && size.y == priv.render_size.y) {
+        return true;
+    }
+
+    destroy_render_target();
+
+    bool result = true;
+
+    if (offscreen) {
+        result = create_render_target(size);
+
+        if (!result) {
+            LIBQU_LOGE("Failed to create %dx%d render target.\n", size.x, size.y);
+        }
+    }
+
+    _GL(glViewport(0, 0, priv.render_size.x, priv.render_size.y));
+    update_scissor();
+
+    return result;
+}
+
+static bool graphics_gl3_set_render_scale(float scale, bool smooth)
+{
+    qu_vec2i size = {
+        LIBQU_MAX(1, (int) lroundf(priv.window_size.x * scale)),
+        LIBQU_MAX(1, (int) lroundf(priv.window_size.y * scale)),
+    };
+
+    priv.upscale_filter = smooth ? GL_LINEAR : GL_NEAREST;
+
+    return update_render_target(size);
+}
+
+/**
+ * GPU time of a frame covers its commands, from the first execution
+ * to the upscale, but not the swap that follows. Frames that weren't
+ * drawn have no query running and aren't measured.
+ */
+static void graphics_gl3_present(void)
+{
+    if (priv.fbo) {
+        blit_render_target();
+    }
+
+    end_frame_query();
+    poll_frame_queries();
+}
+
+static double graphics_gl3_get_frame_time(void)
+{
+    double frame_time = priv.frame_time;
+    priv.frame_time = -1.0;
+
+    return frame_time;
+}
+
+/**
+ * Back buffer contents are undefined after a swap, so incremental
+ * frames are kept in the offscreen target and copied to the window
+ * as a whole.
+ */
+static bool graphics_gl3_set_incremental(bool enabled)
+{
+    priv.persistent = enabled;
+
+    if (!update_render_target(priv.render_size)) {
+        priv.persistent = false;
+        return !enabled;
+    }
+
+    return true;
+}
+
+static void graphics_gl3_set_redraw_rect(qu_recti const *rect)
+{
+    priv.redraw = (rect != NULL);
+
+    if (rect) {
+        priv.redraw_rect = *rect;
+    }
+
+    update_scissor();
+}
+
 //------------------------------------------------------------------------------
 
 struct libqu_graphics_impl const libqu_graphics_gl3_impl = {
@@ -672,7 +2083,26 @@ struct libqu_graphics_impl const libqu_graphics_gl3_impl = {
     graphics_gl3_update_texture_flags,
     graphics_gl3_apply_texture,
     graphics_gl3_apply_blend_mode,
+    graphics_gl3_apply_blend_hint,
     graphics_gl3_capture_screen,
+    graphics_gl3_update_vertex_buffer,
+    graphics_gl3_destroy_vertex_buffer,
+    graphics_gl3_draw_vertex_buffer,
+    graphics_gl3_create_particle_buffer,
+    graphics_gl3_destroy_particle_buffer,
+    graphics_gl3_write_particles,
+    graphics_gl3_update_particle_buffer,
+    graphics_gl3_draw_particle_buffer,
+    graphics_gl3_apply_clip,
+    graphics_gl3_get_max_texture_size,
+    graphics_gl3_write_texture,
+    graphics_gl3_get_texture_units,
+    graphics_gl3_apply_texture_set,
+    graphics_gl3_set_render_scale,
+    graphics_gl3_present,
+    graphics_gl3_get_frame_time,
+    graphics_gl3_set_incremental,
+    graphics_gl3_set_redraw_rect,
 };
 
 //------------------------------------------------------------------------------
@@ -40,7 +40,8 @@ static void graphics_null_terminate(void)
     LIBQU_LOGI("Terminated.\n");
 }
 
-static void graphics_null_upload_vertices(struct libqu_vertex *vertices, size_t count)
+static void graphics_null_upload_vertices(struct libqu_vertex *vertices,
+    int8_t const *units, size_t count)
 {
 }
 
@@ -73,11 +74,84 @@ static void graphics_null_apply_blend_mode(qu_blend_mode const *mode)
 {
 }
 
+static void graphics_null_apply_blend_hint(enum libqu_blend_hint hint)
+{
+}
+
 static int graphics_null_capture_screen(struct libqu_image *image)
 {
     return 0;
 }
 
+static int graphics_null_update_vertex_buffer(struct libqu_vertex_buffer *buffer,
+    struct libqu_vertex const *vertices, size_t count)
+{
+    buffer->count = count;
+
+    return 0;
+}
+
+static void graphics_null_destroy_vertex_buffer(struct libqu_vertex_buffer *buffer)
+{
+}
+
+static void graphics_null_draw_vertex_buffer(struct libqu_vertex_buffer *buffer,
+    affine_t const *transform)
+{
+}
+
+static int graphics_null_create_particle_buffer(struct libqu_particle_buffer *buffer)
+{
+    return -1;
+}
+
+static void graphics_null_apply_clip(qu_recti const *rect)
+{
+}
+
+static int graphics_null_get_max_texture_size(void)
+{
+    return 0;
+}
+
+static void graphics_null_write_texture(struct libqu_texture *texture,
+    qu_vec2i pos, struct libqu_image const *image)
+{
+}
+
+static int graphics_null_get_texture_units(void)
+{
+    return 1;
+}
+
+static void graphics_null_apply_texture_set(struct libqu_texture *const *textures,
+    int count)
+{
+}
+
+static bool graphics_null_set_render_scale(float scale, bool smooth)
+{
+    return scale == 1.f;
+}
+
+static void graphics_null_present(void)
+{
+}
+
+static double graphics_null_get_frame_time(void)
+{
+    return -1.0;
+}
+
+static bool graphics_null_set_incremental(bool enabled)
+{
+    return true;
+}
+
+static void graphics_null_set_redraw_rect(qu_recti const *rect)
+{
+}
+
 //------------------------------------------------------------------------------
 
 struct libqu_graphics_impl const libqu_graphics_null_impl = {
@@ -92,6 +166,25 @@ struct libqu_graphics_impl const libqu_graphics_null_impl = {
     graphics_null_update_texture_flags,
     graphics_null_apply_texture,
     graphics_null_apply_blend_mode,
+    graphics_null_apply_blend_hint,
     graphics_null_capture_screen,
+    graphics_null_update_vertex_buffer,
+    graphics_null_destroy_vertex_buffer,
+    graphics_null_draw_vertex_buffer,
+    graphics_null_create_particle_buffer,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    graphics_null_apply_clip,
+    graphics_null_get_max_texture_size,
+    graphics_null_write_texture,
+    graphics_null_get_texture_units,
+    graphics_null_apply_texture_set,
+    graphics_null_set_render_scale,
+    graphics_null_present,
+    graphics_null_get_frame_time,
+    graphics_null_set_incremental,
+    graphics_null_set_redraw_rect,
 };
 
@@ -0,0 +1,1500 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+#include <stb_ds.h>
+#include "graphics.h"
+#include "log.h"
+#include "platform.h"
+#include "simd.h"
+
+//------------------------------------------------------------------------------
+
+#define TILE_SIZE               64
+#define SUBPIXEL_BITS           4
+#define SUBPIXEL_ONE            (1 << SUBPIXEL_BITS)
+#define SUBPIXEL_HALF           (SUBPIXEL_ONE / 2)
+#define GUARD_BAND              16384.f
+#define MAX_WORKERS             15
+#define TOTAL_ATTRIBUTES        6
+
+//------------------------------------------------------------------------------
+// Span vectors. Pixels are kept in SoA form: one vector per channel, one
+// lane per pixel. Masks are integer vectors with all bits set in active
+// lanes. The scalar fallback processes one pixel at a time.
+
+#if defined(LIBQU_SIMD_SSE2)
+
+#define LANES                   4
+
+typedef __m128 vf;
+typedef __m128i vi;
+
+#define vf_set1(x)              _mm_set1_ps(x)
+#define vf_lane_index()         _mm_setr_ps(0.f, 1.f, 2.f, 3.f)
+#define vf_add(a, b)            _mm_add_ps(a, b)
+#define vf_sub(a, b)            _mm_sub_ps(a, b)
+#define vf_mul(a, b)            _mm_mul_ps(a, b)
+#define vf_min(a, b)            _mm_min_ps(a, b)
+#define vf_max(a, b)            _mm_max_ps(a, b)
+#define vf_lt(a, b)             _mm_castps_si128(_mm_cmplt_ps(a, b))
+#define vf_store(p, a)          _mm_storeu_ps(p, a)
+#define vf_from_vi(a)           _mm_cvtepi32_ps(a)
+#define vf_to_vi(a)             _mm_cvtps_epi32(a)
+
+#define vi_set1(x)              _mm_set1_epi32(x)
+#define vi_lane_index()         _mm_setr_epi32(0, 1, 2, 3)
+#define vi_and(a, b)            _mm_and_si128(a, b)
+#define vi_or(a, b)             _mm_or_si128(a, b)
+#define vi_andnot(a, b)         _mm_andnot_si128(a, b)
+#define vi_srl(a, n)            _mm_srli_epi32(a, n)
+#define vi_sll(a, n)            _mm_slli_epi32(a, n)
+#define vi_lt(a, b)             _mm_cmplt_epi32(a, b)
+#define vi_load(p)              _mm_loadu_si128((__m128i const *) (p))
+#define vi_store(p, a)          _mm_storeu_si128((__m128i *) (p), a)
+
+#else
+
+#define LANES                   1
+
+typedef float vf;
+typedef uint32_t vi;
+
+#define vf_set1(x)              (x)
+#define vf_lane_index()         0.f
+#define vf_add(a, b)            ((a) + (b))
+#define vf_sub(a, b)            ((a) - (b))
+#define vf_mul(a, b)            ((a) * (b))
+#define vf_min(a, b)            ((a) < (b) ? (a) : (b))
+#define vf_max(a, b)            ((a) > (b) ? (a) : (b))
+#define vf_lt(a, b)             ((a) < (b) ? 0xffffffffu : 0u)
+#define vf_store(p, a)          (*(p) = (a))
+#define vf_from_vi(a)           ((float) (int32_t) (a))
+#define vf_to_vi(a)             ((uint32_t) lrintf(a))
+
+#define vi_set1(x)              ((uint32_t) (x))
+#define vi_lane_index()         0u
+#define vi_and(a, b)            ((a) & (b))
+#define vi_or(a, b)             ((a) | (b))
+#define vi_andnot(a, b)         (~(a) & (b))
+#define vi_srl(a, n)            ((a) >> (n))
+#define vi_sll(a, n)            ((a) << (n))
+#define vi_lt(a, b)             ((int32_t) (a) < (int32_t) (b) ? 0xffffffffu : 0u)
+#define vi_load(p)              (*(p))
+#define vi_store(p, a)          (*(p) = (a))
+
+#endif
+
+#define vi_select(m, a, b)      vi_or(vi_and(m, a), vi_andnot(m, b))
+
+//------------------------------------------------------------------------------
+
+struct soft_texture
+{
+    int width;
+    int height;
+    bool premultiplied;
+    uint32_t *pixels;
+};
+
+struct draw_state
+{
+    struct soft_texture const *texture;
+    unsigned int flags;
+    enum libqu_blend_hint hint;
+    qu_blend_mode blend;
+};
+
+enum prim_type
+{
+    PRIM_CLEAR,
+    PRIM_TRIANGLE,
+    PRIM_LINE,
+    PRIM_POINT,
+};
+
+struct edge
+{
+    int64_t x;
+    int64_t y;
+    int64_t dx;
+    int64_t dy;
+    int64_t bias;
+};
+
+/**
+ * Primitive ready for rasterization. Setup is done once when the draw call
+ * is recorded; tiles only walk the rows that intersect them.
+ */
+struct prim
+{
+    enum prim_type type;
+    int state;
+    int x0, y0, x1, y1;
+
+    union {
+        struct {
+            uint32_t color;
+        } clear;
+
+        struct {
+            struct edge edges[3];
+            float origin[2];
+        } triangle;
+
+        struct {
+            float x, y;
+            float dx, dy;
+            int steps;
+        } line;
+    } args;
+
+    float attr[TOTAL_ATTRIBUTES];
+    float dadx[TOTAL_ATTRIBUTES];
+    float dady[TOTAL_ATTRIBUTES];
+};
+
+static struct
+{
+    int width;
+    int height;
+    uint32_t *framebuffer;
+
+    int cols;
+    int rows;
+    uint32_t **bins;
+
+    // Scissor rectangle, covers the whole framebuffer when disabled.
+    int clip_x0;
+    int clip_y0;
+    int clip_x1;
+    int clip_y1;
+
+    // Region being redrawn, limits both scissor and clears.
+    bool clipping;
+    qu_recti clip_rect;
+    int region_x0;
+    int region_y0;
+    int region_x1;
+    int region_y1;
+
+    struct libqu_vertex const *vertices;
+    size_t vertex_count;
+    struct libqu_vertex *translated;
+
+    struct prim *prims;
+    struct draw_state *states;
+    struct draw_state current_state;
+    int current_state_index;
+
+    pl_thread *workers[MAX_WORKERS];
+    int worker_count;
+    pl_mutex *mutex;
+    pl_cond *work_cond;
+    pl_cond *done_cond;
+    unsigned int generation;
+    int next_tile;
+    int finished_tiles;
+    bool quit;
+} priv;
+
+//------------------------------------------------------------------------------
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+    return ((a % b) != 0 && a < 0) ? q - 1 : q;
+}
+
+static int64_t ceil_div(int64_t a, int64_t b)
+{
+    return -floor_div(-a, b);
+}
+
+static uint32_t pack_color(qu_color color)
+{
+    return (uint32_t) QU_EXTRACT_RED(color)
+        | ((uint32_t) QU_EXTRACT_GREEN(color) << 8)
+        | ((uint32_t) QU_EXTRACT_BLUE(color) << 16)
+        | ((uint32_t) QU_EXTRACT_ALPHA(color) << 24);
+}
+
+static void unpack_vertex_attributes(struct libqu_vertex const *vertex, float *out)
+{
+    out[0] = QU_EXTRACT_RED(vertex->color) / 255.f;
+    out[1] = QU_EXTRACT_GREEN(vertex->color) / 255.f;
+    out[2] = QU_EXTRACT_BLUE(vertex->color) / 255.f;
+    out[3] = QU_EXTRACT_ALPHA(vertex->color) / 255.f;
+    out[4] = vertex->texcoord.x;
+    out[5] = vertex->texcoord.y;
+}
+
+//------------------------------------------------------------------------------
+// Texture sampling
+
+static int wrap_coord(int i, int size, bool repeat)
+{
+    if (repeat) {
+        i %= size;
+        return (i < 0) ? i + size : i;
+    }
+
+    return LIBQU_MIN(LIBQU_MAX(i, 0), size - 1);
+}
+
+static int texel_coord(float x)
+{
+    return (int) floorf(LIBQU_MIN(LIBQU_MAX(x, -1e7f), 1e7f));
+}
+
+static uint32_t sample_nearest(struct soft_texture const *texture,
+    bool repeat, float u, float v)
+{
+    int x = wrap_coord(texel_coord(u * texture->width), texture->width, repeat);
+    int y = wrap_coord(texel_coord(v * texture->height), texture->height, repeat);
+
+    return texture->pixels[y * texture->width + x];
+}
+
+static uint32_t sample_bilinear(struct soft_texture const *texture,
+    bool repeat, float u, float v)
+{
+    float fx = u * texture->width - 0.5f;
+    float fy = v * texture->height - 0.5f;
+
+    int ix = texel_coord(fx);
+    int iy = texel_coord(fy);
+
+    uint32_t wx = (uint32_t) ((fx - ix) * 256.f);
+    uint32_t wy = (uint32_t) ((fy - iy) * 256.f);
+
+    int x0 = wrap_coord(ix, texture->width, repeat);
+    int x1 = wrap_coord(ix + 1, texture->width, repeat);
+    int y0 = wrap_coord(iy, texture->height, repeat);
+    int y1 = wrap_coord(iy + 1, texture->height, repeat);
+
+    uint32_t const *row0 = texture->pixels + y0 * texture->width;
+    uint32_t const *row1 = texture->pixels + y1 * texture->width;
+
+    uint32_t a = row0[x0], b = row0[x1], c = row1[x0], d = row1[x1];
+    uint32_t result = 0;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t top = ((a >> shift) & 0xff) * (256 - wx) + ((b >> shift) & 0xff) * wx;
+        uint32_t bottom = ((c >> shift) & 0xff) * (256 - wx) + ((d >> shift) & 0xff) * wx;
+        uint32_t value = (top * (256 - wy) + bottom * wy + 32768) >> 16;
+
+        result |= value << shift;
+    }
+
+    return result;
+}
+
+/**
+ * GL3 backend always minifies with a linear filter, so the same is done
+ * here. Texture coordinates change linearly over a primitive, so it's
+ * decided once per span, from the number of texels covered by a pixel.
+ */
+static bool is_minified(struct soft_texture const *texture,
+    float const *step, float const *step_y)
+{
+    float dudx = step[4] * texture->width;
+    float dvdx = step[5] * texture->height;
+    float dudy = step_y[4] * texture->width;
+    float dvdy = step_y[5] * texture->height;
+
+    float rho = LIBQU_MAX(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+
+    // Tolerance keeps rounding errors from filtering 1:1 draws.
+    return rho > 1.001f;
+}
+
+static uint32_t sample_texture(struct draw_state const *state, bool smooth,
+    float u, float v)
+{
+    bool repeat = (state->flags & QU_TEXTURE_REPEAT);
+
+    if (smooth) {
+        return sample_bilinear(state->texture, repeat, u, v);
+    }
+
+    return sample_nearest(state->texture, repeat, u, v);
+}
+
+//------------------------------------------------------------------------------
+// Span kernel
+
+static vf unpack_channel(vi pixels, int shift)
+{
+    vf channel = vf_from_vi(vi_and(vi_srl(pixels, shift), vi_set1(0xff)));
+    return vf_mul(channel, vf_set1(1.f / 255.f));
+}
+
+static vi pack_channel(vf channel, int shift)
+{
+    channel = vf_min(vf_max(channel, vf_set1(0.f)), vf_set1(1.f));
+    return vi_sll(vf_to_vi(vf_mul(channel, vf_set1(255.f))), shift);
+}
+
+static vf blend_factor(qu_blend_factor factor, vf s, vf d, vf sa, vf da)
+{
+    vf one = vf_set1(1.f);
+
+    switch (factor) {
+    case QU_BLEND_ZERO:
+        return vf_set1(0.f);
+    case QU_BLEND_ONE:
+        return one;
+    case QU_BLEND_SRC_COLOR:
+        return s;
+    case QU_BLEND_ONE_MINUS_SRC_COLOR:
+        return vf_sub(one, s);
+    case QU_BLEND_DST_COLOR:
+        return d;
+    case QU_BLEND_ONE_MINUS_DST_COLOR:
+        return vf_sub(one, d);
+    case QU_BLEND_SRC_ALPHA:
+        return sa;
+    case QU_BLEND_ONE_MINUS_SRC_ALPHA:
+        return vf_sub(one, sa);
+    case QU_BLEND_DST_ALPHA:
+        return da;
+    case QU_BLEND_ONE_MINUS_DST_ALPHA:
+        return vf_sub(one, da);
+    default:
+        return one;
+    }
+}
+
+static vf blend_channel(qu_blend_factor src_factor, qu_blend_factor dst_factor,
+    qu_blend_equation equation, vf s, vf d, vf sa, vf da)
+{
+    vf x = vf_mul(s, blend_factor(src_factor, s, d, sa, da));
+    vf y = vf_mul(d, blend_factor(dst_factor, s, d, sa, da));
+
+    switch (equation) {
+    case QU_BLEND_SUB:
+        return vf_sub(x, y);
+    case QU_BLEND_REV_SUB:
+        return vf_sub(y, x);
+    default:
+        return vf_add(x, y);
+    }
+}
+
+static bool is_state_replacing(struct draw_state const *state)
+{
+    if (state->hint != LIBQU_BLEND_HINT_NONE) {
+        return true;
+    }
+
+    qu_blend_mode const *mode = &state->blend;
+
+    return mode->color_src_factor == QU_BLEND_ONE
+        && mode->color_dst_factor == QU_BLEND_ZERO
+        && mode->color_equation == QU_BLEND_ADD
+        && mode->alpha_src_factor == QU_BLEND_ONE
+        && mode->alpha_dst_factor == QU_BLEND_ZERO
+        && mode->alpha_equation == QU_BLEND_ADD;
+}
+
+static float get_texel_alpha(uint32_t texel)
+{
+    return (float) (texel >> 24) / 255.f;
+}
+
+/**
+ * Replaces distance in the alpha channel with coverage. Edge is smoothed
+ * over about a pixel, using the same measure as fwidth() on the GPU.
+ * Premultiplied textures get their color scaled by coverage as well.
+ */
+static uint32_t resolve_sdf_texel(struct draw_state const *state, bool smooth,
+    uint32_t texel, float u, float v, float const *step, float const *step_y)
+{
+    float d = get_texel_alpha(texel);
+    float dx = get_texel_alpha(sample_texture(state, smooth, u + step[4], v + step[5])) - d;
+    float dy = get_texel_alpha(sample_texture(state, smooth, u + step_y[4], v + step_y[5])) - d;
+
+    float w = LIBQU_MAX(0.5f * (fabsf(dx) + fabsf(dy)), 1e-3f);
+    float t = LIBQU_MIN(LIBQU_MAX((d - 0.5f + w) / (2.f * w), 0.f), 1.f);
+    float coverage = t * t * (3.f - 2.f * t);
+    uint32_t result = (uint32_t) lrintf(coverage * 255.f) << 24;
+
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t channel = (texel >> shift) & 255;
+
+        if (state->texture->premultiplied) {
+            channel = (uint32_t) lrintf((float) channel * coverage);
+        }
+
+        result |= channel << shift;
+    }
+
+    return result;
+}
+
+static vf interpolate(float const *attr, float const *step, int index, vf t)
+{
+    return vf_add(vf_set1(attr[index]), vf_mul(vf_set1(step[index]), t));
+}
+
+/**
+ * Shades and blends `count` consecutive pixels. Attributes are given for
+ * the first pixel and advance by `step` for each following one; `step_y`
+ * is the change to the next row.
+ */
+static void shade_span(struct draw_state const *state, uint32_t *dst,
+    int count, float const *attr, float const *step, float const *step_y)
+{
+    qu_blend_mode const *mode = &state->blend;
+    bool replace = is_state_replacing(state);
+    bool alpha_test = (state->hint == LIBQU_BLEND_HINT_ALPHA_TEST);
+    bool smooth = state->texture && ((state->flags & QU_TEXTURE_SMOOTH)
+        || is_minified(state->texture, step, step_y));
+
+    for (int i = 0; i < count; i += LANES) {
+        int n = LIBQU_MIN(LANES, count - i);
+        vf t = vf_add(vf_set1((float) i), vf_lane_index());
+
+        vf sr = interpolate(attr, step, 0, t);
+        vf sg = interpolate(attr, step, 1, t);
+        vf sb = interpolate(attr, step, 2, t);
+        vf sa = interpolate(attr, step, 3, t);
+
+        if (state->texture) {
+            float u[LANES], v[LANES];
+            uint32_t texels[LANES] = { 0 };
+
+            vf_store(u, interpolate(attr, step, 4, t));
+            vf_store(v, interpolate(attr, step, 5, t));
+
+            for (int lane = 0; lane < n; lane++) {
+                texels[lane] = sample_texture(state, smooth, u[lane], v[lane]);
+            }
+
+            if (state->flags & QU_TEXTURE_SDF) {
+                for (int lane = 0; lane < n; lane++) {
+                    texels[lane] = resolve_sdf_texel(state, smooth, texels[lane],
+                        u[lane], v[lane], step, step_y);
+                }
+            }
+
+            vi texel = vi_load(texels);
+
+            sr = vf_mul(sr, unpack_channel(texel, 0));
+            sg = vf_mul(sg, unpack_channel(texel, 8));
+            sb = vf_mul(sb, unpack_channel(texel, 16));
+            sa = vf_mul(sa, unpack_channel(texel, 24));
+        }
+
+        vi mask = vi_lt(vi_lane_index(), vi_set1(n));
+
+        if (alpha_test) {
+            mask = vi_andnot(vf_lt(sa, vf_set1(0.5f)), mask);
+        }
+
+        uint32_t pixels[LANES] = { 0 };
+        memcpy(pixels, dst + i, sizeof(uint32_t) * n);
+
+        vi old = vi_load(pixels);
+
+        if (!replace) {
+            vf dr = unpack_channel(old, 0);
+            vf dg = unpack_channel(old, 8);
+            vf db = unpack_channel(old, 16);
+            vf da = unpack_channel(old, 24);
+
+            vf r = blend_channel(mode->color_src_factor, mode->color_dst_factor,
+                mode->color_equation, sr, dr, sa, da);
+            vf g = blend_channel(mode->color_src_factor, mode->color_dst_factor,
+                mode->color_equation, sg, dg, sa, da);
+            vf b = blend_channel(mode->color_src_factor, mode->color_dst_factor,
+                mode->color_equation, sb, db, sa, da);
+            vf a = blend_channel(mode->alpha_src_factor, mode->alpha_dst_factor,
+                mode->alpha_equation, sa, da, sa, da);
+
+            sr = r;
+            sg = g;
+            sb = b;
+            sa = a;
+        }
+
+        vi out = vi_or(
+            vi_or(pack_channel(sr, 0), pack_channel(sg, 8)),
+            vi_or(pack_channel(sb, 16), pack_channel(sa, 24))
+        );
+
+        vi_store(pixels, vi_select(mask, out, old));
+        memcpy(dst + i, pixels, sizeof(uint32_t) * n);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Tile rasterization
+
+static void clear_tile(struct prim const *prim, int tx0, int ty0, int tx1, int ty1)
+{
+    for (int y = ty0; y < ty1; y++) {
+        uint32_t *row = priv.framebuffer + y * priv.width;
+
+        for (int x = tx0; x < tx1; x++) {
+            row[x] = prim->args.clear.color;
+        }
+    }
+}
+
+static void rasterize_triangle(struct prim const *prim, int tx0, int ty0, int tx1, int ty1)
+{
+    struct draw_state const *state = &priv.states[prim->state];
+    struct edge const *edges = prim->args.triangle.edges;
+
+    int y0 = LIBQU_MAX(prim->y0, ty0);
+    int y1 = LIBQU_MIN(prim->y1, ty1);
+
+    for (int y = y0; y < y1; y++) {
+        int64_t py = (int64_t) y * SUBPIXEL_ONE + SUBPIXEL_HALF;
+        int64_t lo = LIBQU_MAX(prim->x0, tx0);
+        int64_t hi = LIBQU_MIN(prim->x1, tx1);
+
+        // Each edge function is linear along the row, so the covered
+        // span can be solved for directly instead of testing each pixel.
+        for (int e = 0; e < 3 && lo < hi; e++) {
+            int64_t e0 = edges[e].dx * (py - edges[e].y)
+                - edges[e].dy * (SUBPIXEL_HALF - edges[e].x)
+                - edges[e].bias;
+            int64_t k = -edges[e].dy * SUBPIXEL_ONE;
+
+            if (k > 0) {
+                lo = LIBQU_MAX(lo, ceil_div(-e0, k));
+            } else if (k < 0) {
+                hi = LIBQU_MIN(hi, floor_div(e0, -k) + 1);
+            } else if (e0 < 0) {
+                hi = lo;
+            }
+        }
+
+        if (lo >= hi) {
+            continue;
+        }
+
+        float fx = (float) lo + 0.5f - prim->args.triangle.origin[0];
+        float fy = (float) y + 0.5f - prim->args.triangle.origin[1];
+        float attr[TOTAL_ATTRIBUTES];
+
+        for (int i = 0; i < TOTAL_ATTRIBUTES; i++) {
+            attr[i] = prim->attr[i] + prim->dadx[i] * fx + prim->dady[i] * fy;
+        }
+
+        uint32_t *dst = priv.framebuffer + y * priv.width + lo;
+        shade_span(state, dst, (int) (hi - lo), attr, prim->dadx, prim->dady);
+    }
+}
+
+static void rasterize_line(struct prim const *prim, int tx0, int ty0, int tx1, int ty1)
+{
+    struct draw_state const *state = &priv.states[prim->state];
+    float const zero[TOTAL_ATTRIBUTES] = { 0 };
+
+    for (int i = 0; i < prim->args.line.steps; i++) {
+        float t = (i + 0.5f) / prim->args.line.steps;
+        int x = (int) floorf(prim->args.line.x + prim->args.line.dx * t);
+        int y = (int) floorf(prim->args.line.y + prim->args.line.dy * t);
+
+        if (x < tx0 || x >= tx1 || y < ty0 || y >= ty1) {
+            continue;
+        }
+
+        if (x < prim->x0 || x >= prim->x1 || y < prim->y0 || y >= prim->y1) {
+            continue;
+        }
+
+        float attr[TOTAL_ATTRIBUTES];
+
+        for (int a = 0; a < TOTAL_ATTRIBUTES; a++) {
+            attr[a] = prim->attr[a] + prim->dadx[a] * t;
+        }
+
+        shade_span(state, priv.framebuffer + y * priv.width + x, 1, attr, zero, zero);
+    }
+}
+
+static void rasterize_point(struct prim const *prim, int tx0, int ty0, int tx1, int ty1)
+{
+    struct draw_state const *state = &priv.states[prim->state];
+    float const zero[TOTAL_ATTRIBUTES] = { 0 };
+
+    if (prim->x0 < tx0 || prim->x0 >= tx1 || prim->y0 < ty0 || prim->y0 >= ty1) {
+        return;
+    }
+
+    uint32_t *dst = priv.framebuffer + prim->y0 * priv.width + prim->x0;
+    shade_span(state, dst, 1, prim->attr, zero, zero);
+}
+
+static void rasterize_tile(int tile)
+{
+    uint32_t const *bin = priv.bins[tile];
+
+    if (arrlenu(bin) == 0) {
+        return;
+    }
+
+    int tx0 = (tile % priv.cols) * TILE_SIZE;
+    int ty0 = (tile / priv.cols) * TILE_SIZE;
+    int tx1 = LIBQU_MIN(tx0 + TILE_SIZE, priv.width);
+    int ty1 = LIBQU_MIN(ty0 + TILE_SIZE, priv.height);
+
+    for (size_t i = 0; i < arrlenu(bin); i++) {
+        struct prim const *prim = &priv.prims[bin[i]];
+
+        switch (prim->type) {
+        case PRIM_CLEAR:
+            clear_tile(prim, tx0, ty0, tx1, ty1);
+            break;
+        case PRIM_TRIANGLE:
+            rasterize_triangle(prim, tx0, ty0, tx1, ty1);
+            break;
+        case PRIM_LINE:
+            rasterize_line(prim, tx0, ty0, tx1, ty1);
+            break;
+        case PRIM_POINT:
+            rasterize_point(prim, tx0, ty0, tx1, ty1);
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Worker threads
+
+/**
+ * Claims and rasterizes tiles until none are left. Called with the mutex
+ * locked; returns with the mutex locked.
+ */
+static void run_tiles(void)
+{
+    int total = priv.cols * priv.rows;
+
+    while (priv.next_tile < total) {
+        int tile = priv.next_tile++;
+
+        pl_unlock_mutex(priv.mutex);
+        rasterize_tile(tile);
+        pl_lock_mutex(priv.mutex);
+
+        if (++priv.finished_tiles == total) {
+            pl_broadcast_cond(priv.done_cond);
+        }
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    unsigned int generation = 0;
+
+    pl_lock_mutex(priv.mutex);
+
+    while (true) {
+        while (priv.generation == generation && !priv.quit) {
+            pl_wait_cond(priv.work_cond, priv.mutex);
+        }
+
+        if (priv.quit) {
+            break;
+        }
+
+        generation = priv.generation;
+        run_tiles();
+    }
+
+    pl_unlock_mutex(priv.mutex);
+
+    return NULL;
+}
+
+static void start_workers(void)
+{
+    priv.mutex = pl_create_mutex();
+    priv.work_cond = pl_create_cond();
+    priv.done_cond = pl_create_cond();
+
+    if (!priv.mutex || !priv.work_cond || !priv.done_cond) {
+        return;
+    }
+
+    int count = LIBQU_MIN(pl_get_cpu_count() - 1, MAX_WORKERS);
+
+    for (int i = 0; i < count; i++) {
+        pl_thread *thread = pl_create_thread("libqu-soft", worker_main, NULL);
+
+        if (!thread) {
+            break;
+        }
+
+        priv.workers[priv.worker_count++] = thread;
+    }
+}
+
+static void stop_workers(void)
+{
+    if (priv.mutex) {
+        pl_lock_mutex(priv.mutex);
+        priv.quit = true;
+        pl_broadcast_cond(priv.work_cond);
+        pl_unlock_mutex(priv.mutex);
+    }
+
+    for (int i = 0; i < priv.worker_count; i++) {
+        pl_wait_thread(priv.workers[i]);
+    }
+
+    pl_destroy_cond(priv.done_cond);
+    pl_destroy_cond(priv.work_cond);
+    pl_destroy_mutex(priv.mutex);
+}
+
+//------------------------------------------------------------------------------
+// Recording
+
+static void reset_bins(void)
+{
+    for (int i = 0; i < priv.cols * priv.rows; i++) {
+        arrsetlen(priv.bins[i], 0);
+    }
+
+    arrsetlen(priv.prims, 0);
+    arrsetlen(priv.states, 0);
+    priv.current_state_index = -1;
+}
+
+/**
+ * Executes all recorded primitives. Tiles are independent, so workers
+ * and the calling thread share them; order inside a tile is preserved.
+ */
+static void resolve(void)
+{
+    if (arrlenu(priv.prims) == 0) {
+        return;
+    }
+
+    if (priv.worker_count == 0) {
+        for (int i = 0; i < priv.cols * priv.rows; i++) {
+            rasterize_tile(i);
+        }
+    } else {
+        pl_lock_mutex(priv.mutex);
+
+        priv.next_tile = 0;
+        priv.finished_tiles = 0;
+        priv.generation++;
+        pl_broadcast_cond(priv.work_cond);
+
+        run_tiles();
+
+        while (priv.finished_tiles < priv.cols * priv.rows) {
+            pl_wait_cond(priv.done_cond, priv.mutex);
+        }
+
+        pl_unlock_mutex(priv.mutex);
+    }
+
+    reset_bins();
+}
+
+static int get_state_index(void)
+{
+    if (priv.current_state_index == -1) {
+        arrput(priv.states, priv.current_state);
+        priv.current_state_index = (int) arrlen(priv.states) - 1;
+    }
+
+    return priv.current_state_index;
+}
+
+static void add_prim(struct prim *prim)
+{
+    if (prim->type == PRIM_CLEAR) {
+        prim->x0 = LIBQU_MAX(prim->x0, 0);
+        prim->y0 = LIBQU_MAX(prim->y0, 0);
+        prim->x1 = LIBQU_MIN(prim->x1, priv.width);
+        prim->y1 = LIBQU_MIN(prim->y1, priv.height);
+    } else {
+        prim->x0 = LIBQU_MAX(prim->x0, priv.clip_x0);
+        prim->y0 = LIBQU_MAX(prim->y0, priv.clip_y0);
+        prim->x1 = LIBQU_MIN(prim->x1, priv.clip_x1);
+        prim->y1 = LIBQU_MIN(prim->y1, priv.clip_y1);
+    }
+
+    if (prim->x0 >= prim->x1 || prim->y0 >= prim->y1) {
+        return;
+    }
+
+    uint32_t index = (uint32_t) arrlenu(priv.prims);
+    arrput(priv.prims, *prim);
+
+    int c0 = prim->x0 / TILE_SIZE;
+    int r0 = prim->y0 / TILE_SIZE;
+    int c1 = (prim->x1 - 1) / TILE_SIZE;
+    int r1 = (prim->y1 - 1) / TILE_SIZE;
+
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            arrput(priv.bins[r * priv.cols + c], index);
+        }
+    }
+}
+
+static int64_t to_fixed(float x)
+{
+    x = LIBQU_MIN(LIBQU_MAX(x, -GUARD_BAND), GUARD_BAND);
+    return (int64_t) lrintf(x * SUBPIXEL_ONE);
+}
+
+static void setup_edge(struct edge *edge, int64_t const *a, int64_t const *b)
+{
+    edge->x = a[0];
+    edge->y = a[1];
+    edge->dx = b[0] - a[0];
+    edge->dy = b[1] - a[1];
+
+    // Shared edges run in opposite directions in adjacent triangles, so
+    // exactly one of them owns the pixels lying on the edge.
+    bool owner = (edge->dy > 0) || (edge->dy == 0 && edge->dx < 0);
+    edge->bias = owner ? 0 : 1;
+}
+
+static void add_triangle(struct libqu_vertex const *va,
+    struct libqu_vertex const *vb, struct libqu_vertex const *vc)
+{
+    int64_t p[3][2] = {
+        { to_fixed(va->pos.x), to_fixed(va->pos.y) },
+        { to_fixed(vb->pos.x), to_fixed(vb->pos.y) },
+        { to_fixed(vc->pos.x), to_fixed(vc->pos.y) },
+    };
+
+    int64_t area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1])
+        - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+
+    if (area == 0) {
+        return;
+    }
+
+    struct libqu_vertex const *v[3] = { va, vb, vc };
+
+    if (area < 0) {
+        int64_t x = p[1][0], y = p[1][1];
+
+        p[1][0] = p[2][0];
+        p[1][1] = p[2][1];
+        p[2][0] = x;
+        p[2][1] = y;
+
+        v[1] = vc;
+        v[2] = vb;
+        area = -area;
+    }
+
+    struct prim prim = {
+        .type = PRIM_TRIANGLE,
+        .state = get_state_index(),
+    };
+
+    setup_edge(&prim.args.triangle.edges[0], p[0], p[1]);
+    setup_edge(&prim.args.triangle.edges[1], p[1], p[2]);
+    setup_edge(&prim.args.triangle.edges[2], p[2], p[0]);
+
+    int64_t min_x = LIBQU_MIN(p[0][0], LIBQU_MIN(p[1][0], p[2][0]));
+    int64_t min_y = LIBQU_MIN(p[0][1], LIBQU_MIN(p[1][1], p[2][1]));
+    int64_t max_x = LIBQU_MAX(p[0][0], LIBQU_MAX(p[1][0], p[2][0]));
+    int64_t max_y = LIBQU_MAX(p[0][1], LIBQU_MAX(p[1][1], p[2][1]));
+
+    prim.x0 = (int) ceil_div(min_x - SUBPIXEL_HALF, SUBPIXEL_ONE);
+    prim.y0 = (int) ceil_div(min_y - SUBPIXEL_HALF, SUBPIXEL_ONE);
+    prim.x1 = (int) floor_div(max_x - SUBPIXEL_HALF, SUBPIXEL_ONE) + 1;
+    prim.y1 = (int) floor_div(max_y - SUBPIXEL_HALF, SUBPIXEL_ONE) + 1;
+
+    // Attribute planes, relative to the first vertex.
+    double x1 = (double) (p[1][0] - p[0][0]) / SUBPIXEL_ONE;
+    double y1 = (double) (p[1][1] - p[0][1]) / SUBPIXEL_ONE;
+    double x2 = (double) (p[2][0] - p[0][0]) / SUBPIXEL_ONE;
+    double y2 = (double) (p[2][1] - p[0][1]) / SUBPIXEL_ONE;
+    double det = (double) area / (SUBPIXEL_ONE * SUBPIXEL_ONE);
+
+    float a[3][TOTAL_ATTRIBUTES];
+
+    for (int i = 0; i < 3; i++) {
+        unpack_vertex_attributes(v[i], a[i]);
+    }
+
+    for (int i = 0; i < TOTAL_ATTRIBUTES; i++) {
+        double d1 = a[1][i] - a[0][i];
+        double d2 = a[2][i] - a[0][i];
+
+        prim.attr[i] = a[0][i];
+        prim.dadx[i] = (float) ((d1 * y2 - d2 * y1) / det);
+        prim.dady[i] = (float) ((d2 * x1 - d1 * x2) / det);
+    }
+
+    prim.args.triangle.origin[0] = (float) p[0][0] / SUBPIXEL_ONE;
+    prim.args.triangle.origin[1] = (float) p[0][1] / SUBPIXEL_ONE;
+
+    add_prim(&prim);
+}
+
+static void add_line(struct libqu_vertex const *va, struct libqu_vertex const *vb)
+{
+    float x0 = LIBQU_MIN(LIBQU_MAX(va->pos.x, -GUARD_BAND), GUARD_BAND);
+    float y0 = LIBQU_MIN(LIBQU_MAX(va->pos.y, -GUARD_BAND), GUARD_BAND);
+    float x1 = LIBQU_MIN(LIBQU_MAX(vb->pos.x, -GUARD_BAND), GUARD_BAND);
+    float y1 = LIBQU_MIN(LIBQU_MAX(vb->pos.y, -GUARD_BAND), GUARD_BAND);
+
+    int steps = (int) ceilf(LIBQU_MAX(fabsf(x1 - x0), fabsf(y1 - y0)));
+
+    if (steps == 0) {
+        return;
+    }
+
+    struct prim prim = {
+        .type = PRIM_LINE,
+        .state = get_state_index(),
+        .x0 = (int) floorf(LIBQU_MIN(x0, x1)),
+        .y0 = (int) floorf(LIBQU_MIN(y0, y1)),
+        .x1 = (int) floorf(LIBQU_MAX(x0, x1)) + 1,
+        .y1 = (int) floorf(LIBQU_MAX(y0, y1)) + 1,
+        .args.line = {
+            .x = x0,
+            .y = y0,
+            .dx = x1 - x0,
+            .dy = y1 - y0,
+            .steps = steps,
+        },
+    };
+
+    float b[TOTAL_ATTRIBUTES];
+
+    unpack_vertex_attributes(va, prim.attr);
+    unpack_vertex_attributes(vb, b);
+
+    for (int i = 0; i < TOTAL_ATTRIBUTES; i++) {
+        prim.dadx[i] = b[i] - prim.attr[i];
+    }
+
+    add_prim(&prim);
+}
+
+static void add_point(struct libqu_vertex const *vertex)
+{
+    float x = LIBQU_MIN(LIBQU_MAX(vertex->pos.x, -GUARD_BAND), GUARD_BAND);
+    float y = LIBQU_MIN(LIBQU_MAX(vertex->pos.y, -GUARD_BAND), GUARD_BAND);
+
+    struct prim prim = {
+        .type = PRIM_POINT,
+        .state = get_state_index(),
+        .x0 = (int) floorf(x),
+        .y0 = (int) floorf(y),
+    };
+
+    prim.x1 = prim.x0 + 1;
+    prim.y1 = prim.y0 + 1;
+
+    unpack_vertex_attributes(vertex, prim.attr);
+    add_prim(&prim);
+}
+
+//------------------------------------------------------------------------------
+
+static int get_pixel_size(qu_pixel_format format)
+{
+    switch (format) {
+    case QU_PIXFMT_Y8:
+        return 1;
+    case QU_PIXFMT_Y8A8:
+        return 2;
+    case QU_PIXFMT_R8G8B8:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+static void convert_pixels(uint32_t *dst, unsigned char const *src,
+    qu_pixel_format format, int count)
+{
+    for (int i = 0; i < count; i++) {
+        uint32_t r, g, b, a;
+
+        switch (format) {
+        case QU_PIXFMT_Y8:
+            r = g = b = src[i];
+            a = 255;
+            break;
+        case QU_PIXFMT_Y8A8:
+            r = g = b = src[2 * i];
+            a = src[2 * i + 1];
+            break;
+        case QU_PIXFMT_R8G8B8:
+            r = src[3 * i];
+            g = src[3 * i + 1];
+            b = src[3 * i + 2];
+            a = 255;
+            break;
+        default:
+            r = src[4 * i];
+            g = src[4 * i + 1];
+            b = src[4 * i + 2];
+            a = src[4 * i + 3];
+            break;
+        }
+
+        dst[i] = r | (g << 8) | (b << 16) | (a << 24);
+    }
+}
+
+static struct soft_texture *convert_texture(struct libqu_image const *image)
+{
+    int count = image->size.x * image->size.y;
+    struct soft_texture *texture = pl_malloc(sizeof(*texture) + sizeof(uint32_t) * count);
+
+    if (!texture) {
+        return NULL;
+    }
+
+    texture->width = image->size.x;
+    texture->height = image->size.y;
+    texture->pixels = (uint32_t *) (texture + 1);
+
+    convert_pixels(texture->pixels, image->pixels, image->format, count);
+
+    return texture;
+}
+
+//------------------------------------------------------------------------------
+
+static bool graphics_soft_check_if_available(void)
+{
+    return true;
+}
+
+static bool graphics_soft_initialize(struct libqu_graphics_params const *params)
+{
+    priv.width = LIBQU_MAX(params->window_size.x, 1);
+    priv.height = LIBQU_MAX(params->window_size.y, 1);
+    priv.framebuffer = pl_calloc(priv.width * priv.height, sizeof(uint32_t));
+
+    priv.clip_x1 = priv.width;
+    priv.clip_y1 = priv.height;
+    priv.region_x1 = priv.width;
+    priv.region_y1 = priv.height;
+
+    priv.cols = (priv.width + TILE_SIZE - 1) / TILE_SIZE;
+    priv.rows = (priv.height + TILE_SIZE - 1) / TILE_SIZE;
+    priv.bins = pl_calloc(priv.cols * priv.rows, sizeof(uint32_t *));
+
+    if (!priv.framebuffer || !priv.bins) {
+        pl_free(priv.framebuffer);
+        pl_free(priv.bins);
+        return false;
+    }
+
+    priv.current_state.blend = QU_BLEND_MODE_ALPHA;
+    priv.current_state_index = -1;
+
+    start_workers();
+
+    LIBQU_LOGI("Initialized with %d worker thread(s).\n", priv.worker_count);
+
+    return true;
+}
+
+static void graphics_soft_terminate(void)
+{
+    resolve();
+    stop_workers();
+
+    for (int i = 0; i < priv.cols * priv.rows; i++) {
+        arrfree(priv.bins[i]);
+    }
+
+    arrfree(priv.prims);
+    arrfree(priv.states);
+    arrfree(priv.translated);
+    pl_free(priv.bins);
+    pl_free(priv.framebuffer);
+
+    memset(&priv, 0, sizeof(priv));
+
+    LIBQU_LOGI("Terminated.\n");
+}
+
+static void graphics_soft_upload_vertices(struct libqu_vertex *vertices,
+    int8_t const *units, size_t count)
+{
+    // Previous frame is complete at this point.
+    resolve();
+
+    priv.vertices = vertices;
+    priv.vertex_count = count;
+}
+
+static void graphics_soft_clear(qu_color color)
+{
+    bool full = priv.region_x0 == 0 && priv.region_y0 == 0
+        && priv.region_x1 == priv.width && priv.region_y1 == priv.height;
+
+    // Everything recorded so far would be overwritten anyway.
+    if (full) {
+        reset_bins();
+    }
+
+    struct prim prim = {
+        .type = PRIM_CLEAR,
+        .x0 = priv.region_x0,
+        .y0 = priv.region_y0,
+        .x1 = priv.region_x1,
+        .y1 = priv.region_y1,
+        .args.clear.color = pack_color(color),
+    };
+
+    add_prim(&prim);
+}
+
+static void add_vertices(enum libqu_draw_mode mode,
+    struct libqu_vertex const *v, size_t count)
+{
+    switch (mode) {
+    case LIBQU_DRAW_MODE_POINTS:
+        for (size_t i = 0; i < count; i++) {
+            add_point(&v[i]);
+        }
+        break;
+    case LIBQU_DRAW_MODE_LINES:
+        for (size_t i = 0; i + 1 < count; i += 2) {
+            add_line(&v[i], &v[i + 1]);
+        }
+        break;
+    case LIBQU_DRAW_MODE_LINE_LOOP:
+    case LIBQU_DRAW_MODE_LINE_STRIP:
+        for (size_t i = 0; i + 1 < count; i++) {
+            add_line(&v[i], &v[i + 1]);
+        }
+        if (mode == LIBQU_DRAW_MODE_LINE_LOOP && count > 2) {
+            add_line(&v[count - 1], &v[0]);
+        }
+        break;
+    case LIBQU_DRAW_MODE_TRIANGLES:
+        for (size_t i = 0; i + 2 < count; i += 3) {
+            add_triangle(&v[i], &v[i + 1], &v[i + 2]);
+        }
+        break;
+    case LIBQU_DRAW_MODE_TRIANGLE_STRIP:
+        for (size_t i = 0; i + 2 < count; i++) {
+            add_triangle(&v[i], &v[i + 1], &v[i + 2]);
+        }
+        break;
+    case LIBQU_DRAW_MODE_TRIANGLE_FAN:
+        for (size_t i = 1; i + 1 < count; i++) {
+            add_triangle(&v[0], &v[i], &v[i + 1]);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void graphics_soft_draw(enum libqu_draw_mode mode, size_t vertex, size_t count)
+{
+    if (vertex + count > priv.vertex_count) {
+        return;
+    }
+
+    add_vertices(mode, priv.vertices + vertex, count);
+}
+
+static int graphics_soft_load_texture(struct libqu_texture *texture)
+{
+    struct soft_texture *soft = convert_texture(texture->image);
+
+    if (!soft) {
+        return -1;
+    }
+
+    soft->premultiplied = texture->premultiplied;
+    texture->priv[0] = (uintptr_t) soft;
+
+    return 0;
+}
+
+static void graphics_soft_destroy_texture(struct libqu_texture *texture)
+{
+    struct soft_texture *soft = (struct soft_texture *) texture->priv[0];
+
+    // Recorded primitives may still sample from this texture.
+    resolve();
+
+    if (priv.current_state.texture == soft) {
+        priv.current_state.texture = NULL;
+        priv.current_state_index = -1;
+    }
+
+    pl_free(soft);
+}
+
+static void graphics_soft_update_texture_flags(struct libqu_texture *texture)
+{
+    if (priv.current_state.texture == (struct soft_texture *) texture->priv[0]) {
+        priv.current_state.flags = texture->flags;
+        priv.current_state_index = -1;
+    }
+}
+
+static void graphics_soft_apply_texture(struct libqu_texture *texture)
+{
+    struct soft_texture const *soft = texture ? (struct soft_texture *) texture->priv[0] : NULL;
+    unsigned int flags = texture ? texture->flags : 0;
+
+    if (priv.current_state.texture == soft && priv.current_state.flags == flags) {
+        return;
+    }
+
+    priv.current_state.texture = soft;
+    priv.current_state.flags = flags;
+    priv.current_state_index = -1;
+}
+
+static void graphics_soft_apply_blend_mode(qu_blend_mode const *mode)
+{
+    priv.current_state.blend = *mode;
+    priv.current_state_index = -1;
+}
+
+static void graphics_soft_apply_blend_hint(enum libqu_blend_hint hint)
+{
+    if (priv.current_state.hint == hint) {
+        return;
+    }
+
+    priv.current_state.hint = hint;
+    priv.current_state_index = -1;
+}
+
+static int graphics_soft_capture_screen(struct libqu_image *image)
+{
+    resolve();
+
+    int width = LIBQU_MIN(image->size.x, priv.width);
+    int height = LIBQU_MIN(image->size.y, priv.height);
+
+    for (int y = 0; y < height; y++) {
+        uint32_t const *src = priv.framebuffer + y * priv.width;
+        unsigned char *dst = image->pixels + y * image->size.x * 3;
+
+        for (int x = 0; x < width; x++) {
+            dst[3 * x + 0] = (src[x] >> 0) & 0xff;
+            dst[3 * x + 1] = (src[x] >> 8) & 0xff;
+            dst[3 * x + 2] = (src[x] >> 16) & 0xff;
+        }
+    }
+
+    return 0;
+}
+
+static int graphics_soft_update_vertex_buffer(struct libqu_vertex_buffer *buffer,
+    struct libqu_vertex const *vertices, size_t count)
+{
+    struct libqu_vertex *copy = pl_realloc((void *) buffer->priv[0],
+        sizeof(*copy) * LIBQU_MAX(count, 1));
+
+    if (!copy) {
+        return -1;
+    }
+
+    memcpy(copy, vertices, sizeof(*copy) * count);
+
+    buffer->priv[0] = (uintptr_t) copy;
+    buffer->count = count;
+
+    return 0;
+}
+
+static void graphics_soft_destroy_vertex_buffer(struct libqu_vertex_buffer *buffer)
+{
+    pl_free((void *) buffer->priv[0]);
+
+    buffer->priv[0] = 0;
+    buffer->count = 0;
+}
+
+static void graphics_soft_draw_vertex_buffer(struct libqu_vertex_buffer *buffer,
+    affine_t const *transform)
+{
+    struct libqu_vertex const *vertices = (struct libqu_vertex const *) buffer->priv[0];
+
+    if (!vertices) {
+        return;
+    }
+
+    // Primitives are set up on record, so transformed copy can be reused.
+    arrsetlen(priv.translated, buffer->count);
+
+    for (size_t i = 0; i < buffer->count; i++) {
+        priv.translated[i] = vertices[i];
+        priv.translated[i].pos = affine_transform_point(transform, vertices[i].pos);
+    }
+
+    add_vertices(buffer->mode, priv.translated, buffer->count);
+}
+
+static int graphics_soft_create_particle_buffer(struct libqu_particle_buffer *buffer)
+{
+    // Not supported, CPU emitter is used instead.
+    return -1;
+}
+
+static void update_clip(void)
+{
+    priv.clip_x0 = priv.region_x0;
+    priv.clip_y0 = priv.region_y0;
+    priv.clip_x1 = priv.region_x1;
+    priv.clip_y1 = priv.region_y1;
+
+    if (priv.clipping) {
+        qu_recti const *rect = &priv.clip_rect;
+
+        priv.clip_x0 = LIBQU_MAX(rect->x, priv.clip_x0);
+        priv.clip_y0 = LIBQU_MAX(rect->y, priv.clip_y0);
+        priv.clip_x1 = LIBQU_MIN(rect->x + rect->w, priv.clip_x1);
+        priv.clip_y1 = LIBQU_MIN(rect->y + rect->h, priv.clip_y1);
+    }
+}
+
+static void graphics_soft_apply_clip(qu_recti const *rect)
+{
+    priv.clipping = (rect != NULL);
+
+    if (rect) {
+        priv.clip_rect = *rect;
+    }
+
+    update_clip();
+}
+
+static void graphics_soft_write_texture(struct libqu_texture *texture,
+    qu_vec2i pos, struct libqu_image const *image)
+{
+    struct soft_texture *soft = (struct soft_texture *) texture->priv[0];
+
+    // Recorded primitives may still sample from this texture.
+    resolve();
+
+    int w = image->size.x;
+    int c = get_pixel_size(image->format);
+
+    for (int y = 0; y < image->size.y; y++) {
+        uint32_t *dst = soft->pixels + (pos.y + y) * soft->width + pos.x;
+        convert_pixels(dst, &image->pixels[y * w * c], image->format, w);
+    }
+}
+
+static int graphics_soft_get_max_texture_size(void)
+{
+    // Textures are sampled from plain memory, any size will do.
+    return 0;
+}
+
+static int graphics_soft_get_texture_units(void)
+{
+    // Switching textures costs nothing here, no batching across them.
+    return 1;
+}
+
+static bool graphics_soft_set_render_scale(float scale, bool smooth)
+{
+    // Nothing is presented to a window, frames are always full size.
+    return scale == 1.f;
+}
+
+static void graphics_soft_present(void)
+{
+}
+
+static double graphics_soft_get_frame_time(void)
+{
+    return -1.0;
+}
+
+static bool graphics_soft_set_incremental(bool enabled)
+{
+    // Framebuffer is never discarded between frames.
+    return true;
+}
+
+static void graphics_soft_set_redraw_rect(qu_recti const *rect)
+{
+    if (rect) {
+        priv.region_x0 = LIBQU_MAX(rect->x, 0);
+        priv.region_y0 = LIBQU_MAX(rect->y, 0);
+        priv.region_x1 = LIBQU_MIN(rect->x + rect->w, priv.width);
+        priv.region_y1 = LIBQU_MIN(rect->y + rect->h, priv.height);
+    } else {
+        priv.region_x0 = 0;
+        priv.region_y0 = 0;
+        priv.region_x1 = priv.width;
+        priv.region_y1 = priv.height;
+    }
+
+    update_clip();
+}
+
+//------------------------------------------------------------------------------
+
+struct libqu_graphics_impl const libqu_graphics_soft_impl = {
+    graphics_soft_check_if_available,
+    graphics_soft_initialize,
+    graphics_soft_terminate,
+    graphics_soft_upload_vertices,
+    graphics_soft_clear,
+    graphics_soft_draw,
+    graphics_soft_load_texture,
+    graphics_soft_destroy_texture,
+    graphics_soft_update_texture_flags,
+    graphics_soft_apply_texture,
+    graphics_soft_apply_blend_mode,
+    graphics_soft_apply_blend_hint,
+    graphics_soft_capture_screen,
+    graphics_soft_update_vertex_buffer,
+    graphics_soft_destroy_vertex_buffer,
+    graphics_soft_draw_vertex_buffer,
+    graphics_soft_create_particle_buffer,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    graphics_soft_apply_clip,
+    graphics_soft_get_max_texture_size,
+    graphics_soft_write_texture,
+    graphics_soft_get_texture_units,
+    NULL,
+    graphics_soft_set_render_scale,
+    graphics_soft_present,
+    graphics_soft_get_frame_time,
+    graphics_soft_set_incremental,
+    graphics_soft_set_redraw_rect,
+};
@@ -45,6 +45,21 @@ static void dtor(enum libqu_handle_type type, void *data)
     case LIBQU_HANDLE_IMAGE:
         libqu_image_destroy(data);
         break;
+    case LIBQU_HANDLE_TILEMAP:
+        libqu_tilemap_destroy(data);
+        break;
+    case LIBQU_HANDLE_EMITTER:
+        libqu_emitter_destroy(data);
+        break;
+    case LIBQU_HANDLE_SCENE:
+        libqu_scene_destroy(data);
+        break;
+    case LIBQU_HANDLE_VTEXTURE:
+        libqu_vtexture_destroy(data);
+        break;
+    case LIBQU_HANDLE_FONT:
+        libqu_font_destroy(data);
+        break;
     case LIBQU_HANDLE_TEXTURE:
         libqu_graphics_destroy_texture(data);
         break;
@@ -30,6 +30,11 @@
 enum libqu_handle_type
 {
     LIBQU_HANDLE_IMAGE,
+    LIBQU_HANDLE_TILEMAP,       /*!< Released before tilesets */
+    LIBQU_HANDLE_EMITTER,       /*!< Released before textures */
+    LIBQU_HANDLE_SCENE,         /*!< Released before textures */
+    LIBQU_HANDLE_VTEXTURE,
+    LIBQU_HANDLE_FONT,          /*!< Owns its page textures */
     LIBQU_HANDLE_TEXTURE,
     LIBQU_HANDLE_WAVE,
     LIBQU_HANDLE_SOUND,
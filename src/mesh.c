@@ -0,0 +1,331 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+#include "graphics.h"
+#include "platform.h"
+
+//------------------------------------------------------------------------------
+
+#define MIN_TRIMMED_AREA            0.9f
+
+//------------------------------------------------------------------------------
+
+static int pixfmt_alpha_channel(qu_pixel_format format)
+{
+    switch (format) {
+    case QU_PIXFMT_Y8A8:
+        return 2;
+    case QU_PIXFMT_R8G8B8A8:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static float cross(qu_vec2f o, qu_vec2f a, qu_vec2f b)
+{
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+static int compare_points(void const *a, void const *b)
+{
+    qu_vec2f const *p = a;
+    qu_vec2f const *q = b;
+
+    if (p->x != q->x) {
+        return (p->x < q->x) ? -1 : 1;
+    }
+
+    if (p->y != q->y) {
+        return (p->y < q->y) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Andrew's monotone chain. Sorts `points` in place and writes the hull
+ * to `hull`, which must have room for `count + 1` points.
+ */
+static int convex_hull(qu_vec2f *points, int count, qu_vec2f *hull)
+{
+    if (count < 3) {
+        memcpy(hull, points, sizeof(*hull) * count);
+        return count;
+    }
+
+    qsort(points, count, sizeof(*points), compare_points);
+
+    int k = 0;
+
+    for (int i = 0; i < count; i++) {
+        while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.f) {
+            k--;
+        }
+
+        hull[k++] = points[i];
+    }
+
+    for (int i = count - 2, lower = k + 1; i >= 0; i--) {
+        while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.f) {
+            k--;
+        }
+
+        hull[k++] = points[i];
+    }
+
+    return k - 1;
+}
+
+static float polygon_area(qu_vec2f const *points, int count)
+{
+    float area = 0.f;
+
+    for (int i = 0; i < count; i++) {
+        qu_vec2f a = points[i];
+        qu_vec2f b = points[(i + 1) % count];
+
+        area += a.x * b.y - b.x * a.y;
+    }
+
+    return fabsf(area) * 0.5f;
+}
+
+/**
+ * Removes one edge of convex polygon by extending its two neighbouring
+ * edges until they meet. Picks the edge that adds the least area and
+ * keeps the polygon inside the `w` by `h` rectangle.
+ */
+static bool remove_edge(qu_vec2f *points, int *count, float w, float h)
+{
+    int n = *count;
+    int best = -1;
+    float best_area = INFINITY;
+    qu_vec2f best_point = { 0.f, 0.f };
+
+    for (int i = 0; i < n; i++) {
+        qu_vec2f a = points[(i + n - 1) % n];
+        qu_vec2f b = points[i];
+        qu_vec2f c = points[(i + 1) % n];
+        qu_vec2f d = points[(i + 2) % n];
+
+        // b + t * (b - a) = c + s * (c - d)
+        float ux = b.x - a.x;
+        float uy = b.y - a.y;
+        float vx = c.x - d.x;
+        float vy = c.y - d.y;
+        float den = ux * vy - uy * vx;
+
+        if (fabsf(den) < 1e-6f) {
+            continue;
+        }
+
+        float t = ((c.x - b.x) * vy - (c.y - b.y) * vx) / den;
+        float s = ((c.x - b.x) * uy - (c.y - b.y) * ux) / den;
+
+        if (t < 0.f || s < 0.f) {
+            continue;
+        }
+
+        qu_vec2f x = { b.x + t * ux, b.y + t * uy };
+
+        if (x.x < 0.f || x.y < 0.f || x.x > w || x.y > h) {
+            continue;
+        }
+
+        float area = fabsf(cross(b, c, x)) * 0.5f;
+
+        if (area < best_area) {
+            best = i;
+            best_area = area;
+            best_point = x;
+        }
+    }
+
+    if (best == -1) {
+        return false;
+    }
+
+    // Replace b with the new point and drop c.
+    int c = (best + 1) % n;
+
+    points[best] = best_point;
+    memmove(&points[c], &points[c + 1], sizeof(*points) * (n - c - 1));
+    *count = n - 1;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool libqu_mesh_build_outline(struct libqu_mesh *mesh,
+    struct libqu_image const *image)
+{
+    int c = pixfmt_alpha_channel(image->format);
+
+    if (c == 0) {
+        return false;
+    }
+
+    int w = image->size.x;
+    int h = image->size.y;
+
+    // Each non-empty row contributes the corners of its extent,
+    // dilated by a pixel so that filtering on the edges is kept.
+    qu_vec2f *points = pl_malloc(sizeof(*points) * 4 * h);
+    qu_vec2f *hull = pl_malloc(sizeof(*hull) * (4 * h + 1));
+    int count = 0;
+
+    if (!points || !hull) {
+        pl_free(points);
+        pl_free(hull);
+        return false;
+    }
+
+    for (int y = 0; y < h; y++) {
+        unsigned char const *row = &image->pixels[w * c * y + (c - 1)];
+        int l = 0;
+        int r = w - 1;
+
+        while (l < w && row[l * c] == 0) {
+            l++;
+        }
+
+        if (l == w) {
+            continue;
+        }
+
+        while (r > l && row[r * c] == 0) {
+            r--;
+        }
+
+        float x0 = (float) LIBQU_MAX(0, l - 1);
+        float x1 = (float) LIBQU_MIN(w, r + 2);
+        float y0 = (float) LIBQU_MAX(0, y - 1);
+        float y1 = (float) LIBQU_MIN(h, y + 2);
+
+        points[count++] = (qu_vec2f) { x0, y0 };
+        points[count++] = (qu_vec2f) { x1, y0 };
+        points[count++] = (qu_vec2f) { x0, y1 };
+        points[count++] = (qu_vec2f) { x1, y1 };
+    }
+
+    int n = convex_hull(points, count, hull);
+
+    while (n > LIBQU_MESH_MAX_POINTS) {
+        if (!remove_edge(hull, &n, (float) w, (float) h)) {
+            break;
+        }
+    }
+
+    pl_free(points);
+
+    // Not worth it if the outline is degenerate, too complex or
+    // doesn't trim much.
+    if (n < 3 || n > LIBQU_MESH_MAX_POINTS
+        || polygon_area(hull, n) > (w * h * MIN_TRIMMED_AREA)) {
+        pl_free(hull);
+        return false;
+    }
+
+    for (int i = 0; i < n; i++) {
+        hull[i].x /= w;
+        hull[i].y /= h;
+    }
+
+    libqu_mesh_destroy(mesh);
+
+    mesh->points = hull;
+    mesh->count = n;
+
+    return true;
+}
+
+void libqu_mesh_destroy(struct libqu_mesh *mesh)
+{
+    pl_free(mesh->points);
+
+    mesh->points = NULL;
+    mesh->count = 0;
+}
+
+int libqu_mesh_clip(struct libqu_mesh const *mesh, qu_rectf rect,
+    qu_vec2f *out)
+{
+    qu_vec2f buffer[2][LIBQU_MESH_MAX_CLIPPED_POINTS];
+    qu_vec2f *src = buffer[0];
+    qu_vec2f *dst = buffer[1];
+
+    float edges[4] = {
+        LIBQU_MIN(rect.x, rect.x + rect.w),
+        LIBQU_MIN(rect.y, rect.y + rect.h),
+        LIBQU_MAX(rect.x, rect.x + rect.w),
+        LIBQU_MAX(rect.y, rect.y + rect.h),
+    };
+
+    int n = mesh->count;
+    memcpy(src, mesh->points, sizeof(*src) * n);
+
+    // Sutherland-Hodgman against each side of the rectangle:
+    // left, top, right, bottom.
+    for (int e = 0; e < 4 && n > 0; e++) {
+        int k = 0;
+
+        for (int i = 0; i < n; i++) {
+            qu_vec2f p = src[i];
+            qu_vec2f q = src[(i + 1) % n];
+
+            float pd = (e & 1) ? p.y : p.x;
+            float qd = (e & 1) ? q.y : q.x;
+
+            if (e >= 2) {
+                pd = edges[e] - pd;
+                qd = edges[e] - qd;
+            } else {
+                pd = pd - edges[e];
+                qd = qd - edges[e];
+            }
+
+            if (pd >= 0.f) {
+                dst[k++] = p;
+            }
+
+            if ((pd >= 0.f) != (qd >= 0.f)) {
+                float t = pd / (pd - qd);
+
+                dst[k++] = (qu_vec2f) {
+                    p.x + t * (q.x - p.x),
+                    p.y + t * (q.y - p.y),
+                };
+            }
+        }
+
+        qu_vec2f *tmp = src;
+        src = dst;
+        dst = tmp;
+        n = k;
+    }
+
+    memcpy(out, src, sizeof(*out) * n);
+
+    return n;
+}
@@ -0,0 +1,443 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+#include <stb_ds.h>
+#include "graphics.h"
+#include "log.h"
+#include "platform.h"
+#include "simd.h"
+
+//------------------------------------------------------------------------------
+
+/**
+ * Particle state is kept in structure-of-arrays form, one array per
+ * component, so that the update loop works on several particles at once.
+ */
+enum
+{
+    COMPONENT_X,
+    COMPONENT_Y,
+    COMPONENT_VX,
+    COMPONENT_VY,
+    COMPONENT_R,
+    COMPONENT_G,
+    COMPONENT_B,
+    COMPONENT_A,
+    COMPONENT_DR,
+    COMPONENT_DG,
+    COMPONENT_DB,
+    COMPONENT_DA,
+    COMPONENT_SIZE,
+    COMPONENT_LIFE,
+    TOTAL_COMPONENTS,
+};
+
+struct libqu_emitter
+{
+    struct libqu_texture *texture;
+    qu_vec2f gravity;
+
+    int count;
+    int capacity;
+    float *components[TOTAL_COMPONENTS];
+    uint32_t *colors;
+
+    // GPU emitters keep particles in a ring of slots on the backend side,
+    // new particles are uploaded in batches.
+    struct libqu_particle_buffer *gpu;
+    struct libqu_particle_state *pending;
+    int next_slot;
+
+    uint64_t update_time;
+    uint64_t submit_time;
+};
+
+//------------------------------------------------------------------------------
+
+static float clamp_channel(float x)
+{
+    return (x < 0.f) ? 0.f : (x > 255.f) ? 255.f : x;
+}
+
+// Rounds the same way as the SIMD path.
+static uint32_t pack_color(float r, float g, float b, float a)
+{
+    return (uint32_t) lrintf(clamp_channel(r)) << 24
+        | (uint32_t) lrintf(clamp_channel(g)) << 16
+        | (uint32_t) lrintf(clamp_channel(b)) << 8
+        | (uint32_t) lrintf(clamp_channel(a));
+}
+
+/**
+ * Integrates particles in [start, end) and packs their colors.
+ * Returns true if any of them has died.
+ */
+static bool integrate_scalar(struct libqu_emitter *emitter, int start, int end,
+    float dt)
+{
+    float **c = emitter->components;
+    float gx = emitter->gravity.x * dt;
+    float gy = emitter->gravity.y * dt;
+    bool dead = false;
+
+    for (int i = start; i < end; i++) {
+        c[COMPONENT_VX][i] += gx;
+        c[COMPONENT_VY][i] += gy;
+        c[COMPONENT_X][i] += c[COMPONENT_VX][i] * dt;
+        c[COMPONENT_Y][i] += c[COMPONENT_VY][i] * dt;
+
+        for (int k = 0; k < 4; k++) {
+            c[COMPONENT_R + k][i] += c[COMPONENT_DR + k][i] * dt;
+        }
+
+        c[COMPONENT_LIFE][i] -= dt;
+        dead |= (c[COMPONENT_LIFE][i] <= 0.f);
+
+        emitter->colors[i] = pack_color(c[COMPONENT_R][i], c[COMPONENT_G][i],
+            c[COMPONENT_B][i], c[COMPONENT_A][i]);
+    }
+
+    return dead;
+}
+
+#ifdef LIBQU_SIMD_SSE2
+
+static bool integrate_sse2(struct libqu_emitter *emitter, int end, float dt)
+{
+    float **c = emitter->components;
+
+    __m128 vdt = _mm_set1_ps(dt);
+    __m128 gx = _mm_set1_ps(emitter->gravity.x * dt);
+    __m128 gy = _mm_set1_ps(emitter->gravity.y * dt);
+    __m128 zero = _mm_setzero_ps();
+    __m128 max = _mm_set1_ps(255.f);
+    __m128 dead = zero;
+
+    for (int i = 0; i < end; i += 4) {
+        __m128 vx = _mm_add_ps(_mm_loadu_ps(&c[COMPONENT_VX][i]), gx);
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(&c[COMPONENT_VY][i]), gy);
+        __m128 x = _mm_loadu_ps(&c[COMPONENT_X][i]);
+        __m128 y = _mm_loadu_ps(&c[COMPONENT_Y][i]);
+
+        _mm_storeu_ps(&c[COMPONENT_VX][i], vx);
+        _mm_storeu_ps(&c[COMPONENT_VY][i], vy);
+        _mm_storeu_ps(&c[COMPONENT_X][i], _mm_add_ps(x, _mm_mul_ps(vx, vdt)));
+        _mm_storeu_ps(&c[COMPONENT_Y][i], _mm_add_ps(y, _mm_mul_ps(vy, vdt)));
+
+        __m128i color = _mm_setzero_si128();
+
+        for (int k = 0; k < 4; k++) {
+            __m128 ch = _mm_loadu_ps(&c[COMPONENT_R + k][i]);
+            __m128 dch = _mm_loadu_ps(&c[COMPONENT_DR + k][i]);
+
+            ch = _mm_add_ps(ch, _mm_mul_ps(dch, vdt));
+            _mm_storeu_ps(&c[COMPONENT_R + k][i], ch);
+
+            __m128i packed = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(ch, zero), max));
+            color = _mm_or_si128(color, _mm_slli_epi32(packed, 24 - 8 * k));
+        }
+
+        _mm_storeu_si128((__m128i *) &emitter->colors[i], color);
+
+        __m128 life = _mm_sub_ps(_mm_loadu_ps(&c[COMPONENT_LIFE][i]), vdt);
+        _mm_storeu_ps(&c[COMPONENT_LIFE][i], life);
+
+        dead = _mm_or_ps(dead, _mm_cmple_ps(life, zero));
+    }
+
+    return _mm_movemask_ps(dead) != 0;
+}
+
+#endif
+
+/**
+ * Dead particles are replaced with the last live one, so the arrays
+ * stay dense without shifting.
+ */
+static void remove_dead(struct libqu_emitter *emitter)
+{
+    float **c = emitter->components;
+    int i = 0;
+
+    while (i < emitter->count) {
+        if (c[COMPONENT_LIFE][i] > 0.f) {
+            i++;
+            continue;
+        }
+
+        int last = --emitter->count;
+
+        for (int k = 0; k < TOTAL_COMPONENTS; k++) {
+            c[k][i] = c[k][last];
+        }
+
+        emitter->colors[i] = emitter->colors[last];
+    }
+}
+
+/**
+ * Uploads particles emitted since the last call. When the ring is full,
+ * the oldest slots are overwritten.
+ */
+static void write_pending(struct libqu_emitter *emitter)
+{
+    int total = (int) arrlen(emitter->pending);
+
+    for (int i = 0; i < total;) {
+        int slot = emitter->next_slot;
+        int count = LIBQU_MIN(total - i, emitter->capacity - slot);
+
+        libqu_graphics_write_particles(emitter->gpu, slot, &emitter->pending[i], count);
+
+        emitter->next_slot = (slot + count) % emitter->capacity;
+        emitter->gpu->count = LIBQU_MAX(emitter->gpu->count, slot + count);
+        i += count;
+    }
+
+    arrsetlen(emitter->pending, 0);
+}
+
+static bool create_gpu_buffer(struct libqu_emitter *emitter)
+{
+    emitter->gpu = pl_calloc(1, sizeof(*emitter->gpu));
+
+    if (!emitter->gpu) {
+        return false;
+    }
+
+    emitter->gpu->capacity = emitter->capacity;
+
+    if (!libqu_graphics_create_particle_buffer(emitter->gpu)) {
+        pl_free(emitter->gpu);
+        emitter->gpu = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+struct libqu_emitter *libqu_emitter_create(struct libqu_texture *texture,
+    int capacity, bool gpu)
+{
+    if (capacity <= 0) {
+        return NULL;
+    }
+
+    struct libqu_emitter *emitter = pl_calloc(1, sizeof(*emitter));
+
+    if (!emitter) {
+        return NULL;
+    }
+
+    emitter->texture = texture;
+    emitter->capacity = capacity;
+
+    if (gpu) {
+        if (create_gpu_buffer(emitter)) {
+            return emitter;
+        }
+
+        LIBQU_LOGW("GPU particles are not supported, falling back to CPU.\n");
+    }
+
+    bool success = true;
+
+    for (int k = 0; k < TOTAL_COMPONENTS; k++) {
+        emitter->components[k] = pl_malloc(sizeof(float) * capacity);
+        success = success && emitter->components[k];
+    }
+
+    emitter->colors = pl_malloc(sizeof(uint32_t) * capacity);
+
+    if (!success || !emitter->colors) {
+        libqu_emitter_destroy(emitter);
+        return NULL;
+    }
+
+    return emitter;
+}
+
+void libqu_emitter_destroy(struct libqu_emitter *emitter)
+{
+    if (emitter->gpu) {
+        libqu_graphics_destroy_particle_buffer(emitter->gpu);
+        pl_free(emitter->gpu);
+        arrfree(emitter->pending);
+    }
+
+    for (int k = 0; k < TOTAL_COMPONENTS; k++) {
+        pl_free(emitter->components[k]);
+    }
+
+    pl_free(emitter->colors);
+    pl_free(emitter);
+}
+
+void libqu_emitter_set_gravity(struct libqu_emitter *emitter, qu_vec2f gravity)
+{
+    emitter->gravity = gravity;
+}
+
+void libqu_emitter_emit(struct libqu_emitter *emitter, qu_particle const *particle)
+{
+    if (particle->lifetime <= 0.f) {
+        return;
+    }
+
+    float values[4][2] = {
+        { QU_EXTRACT_RED(particle->start_color), QU_EXTRACT_RED(particle->end_color) },
+        { QU_EXTRACT_GREEN(particle->start_color), QU_EXTRACT_GREEN(particle->end_color) },
+        { QU_EXTRACT_BLUE(particle->start_color), QU_EXTRACT_BLUE(particle->end_color) },
+        { QU_EXTRACT_ALPHA(particle->start_color), QU_EXTRACT_ALPHA(particle->end_color) },
+    };
+
+    if (emitter->gpu) {
+        if (arrlen(emitter->pending) == emitter->capacity) {
+            return;
+        }
+
+        struct libqu_particle_state state = {
+            .position = particle->position,
+            .velocity = particle->velocity,
+            .size = particle->size,
+            .life = particle->lifetime,
+        };
+
+        for (int k = 0; k < 4; k++) {
+            state.color[k] = values[k][0];
+            state.color_delta[k] = (values[k][1] - values[k][0]) / particle->lifetime;
+        }
+
+        arrput(emitter->pending, state);
+        return;
+    }
+
+    if (emitter->count == emitter->capacity) {
+        return;
+    }
+
+    float **c = emitter->components;
+    int i = emitter->count++;
+
+    c[COMPONENT_X][i] = particle->position.x;
+    c[COMPONENT_Y][i] = particle->position.y;
+    c[COMPONENT_VX][i] = particle->velocity.x;
+    c[COMPONENT_VY][i] = particle->velocity.y;
+
+    for (int k = 0; k < 4; k++) {
+        c[COMPONENT_R + k][i] = values[k][0];
+        c[COMPONENT_DR + k][i] = (values[k][1] - values[k][0]) / particle->lifetime;
+    }
+
+    c[COMPONENT_SIZE][i] = particle->size;
+    c[COMPONENT_LIFE][i] = particle->lifetime;
+
+    emitter->colors[i] = particle->start_color;
+}
+
+void libqu_emitter_update(struct libqu_emitter *emitter, float dt)
+{
+    uint64_t start = pl_get_ticks_highp();
+
+    if (emitter->gpu) {
+        write_pending(emitter);
+        libqu_graphics_update_particle_buffer(emitter->gpu, dt, emitter->gravity);
+        emitter->update_time = pl_get_ticks_highp() - start;
+        return;
+    }
+
+    int i = 0;
+    bool dead = false;
+
+#ifdef LIBQU_SIMD_SSE2
+    i = emitter->count & ~3;
+    dead = integrate_sse2(emitter, i, dt);
+#endif
+
+    dead |= integrate_scalar(emitter, i, emitter->count, dt);
+
+    if (dead) {
+        remove_dead(emitter);
+    }
+
+    emitter->update_time = pl_get_ticks_highp() - start;
+}
+
+/**
+ * Writes all particles as a single triangle list straight into the
+ * vertex stream of the current frame.
+ */
+void libqu_emitter_draw(struct libqu_emitter *emitter)
+{
+    uint64_t start = pl_get_ticks_highp();
+
+    if (emitter->gpu) {
+        write_pending(emitter);
+        libqu_graphics_draw_particle_buffer(emitter->gpu, emitter->texture);
+        emitter->submit_time = pl_get_ticks_highp() - start;
+        return;
+    }
+
+    if (emitter->count == 0) {
+        emitter->submit_time = 0;
+        return;
+    }
+
+    struct libqu_vertex *v =
+        libqu_graphics_reserve_triangles(emitter->texture, 6 * emitter->count);
+
+    float const *x = emitter->components[COMPONENT_X];
+    float const *y = emitter->components[COMPONENT_Y];
+    float const *size = emitter->components[COMPONENT_SIZE];
+
+    for (int i = 0; i < emitter->count; i++, v += 6) {
+        float half = size[i] * 0.5f;
+        float ax = x[i] - half;
+        float ay = y[i] - half;
+        float bx = x[i] + half;
+        float by = y[i] + half;
+        qu_color color = emitter->colors[i];
+
+        v[0] = (struct libqu_vertex) { { ax, ay }, color, { 0.f, 0.f } };
+        v[1] = (struct libqu_vertex) { { bx, ay }, color, { 1.f, 0.f } };
+        v[2] = (struct libqu_vertex) { { bx, by }, color, { 1.f, 1.f } };
+        v[3] = v[2];
+        v[4] = (struct libqu_vertex) { { ax, by }, color, { 0.f, 1.f } };
+        v[5] = v[0];
+    }
+
+    emitter->submit_time = pl_get_ticks_highp() - start;
+}
+
+void libqu_emitter_get_stats(struct libqu_emitter *emitter,
+    qu_emitter_stats *stats)
+{
+    // GPU emitters don't read back lifetimes: expired slots are counted
+    // until they are overwritten.
+    stats->count = emitter->gpu
+        ? emitter->gpu->count + (int) arrlen(emitter->pending)
+        : emitter->count;
+    stats->update_time = emitter->update_time / 1000000000.0;
+    stats->submit_time = emitter->submit_time / 1000000000.0;
+}
@@ -0,0 +1,681 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <string.h>
+#include "pixels.h"
+#include "simd.h"
+
+//------------------------------------------------------------------------------
+// Scalar reference
+
+// Values of qu_pixel_format are equal to channel counts.
+#define CHANNELS(format)            ((int) (format))
+
+/**
+ * x * y / 255, rounded to nearest. Exact for all 8-bit inputs.
+ */
+static unsigned int mul255(unsigned int x, unsigned int y)
+{
+    unsigned int t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static unsigned int luminance(unsigned int r, unsigned int g, unsigned int b)
+{
+    return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+void pixels_convert_scalar(unsigned char *dst, qu_pixel_format dst_format,
+                           unsigned char const *src, qu_pixel_format src_format,
+                           size_t count)
+{
+    int sc = CHANNELS(src_format);
+    int dc = CHANNELS(dst_format);
+
+    for (size_t i = 0; i < count; i++, src += sc, dst += dc) {
+        unsigned int r, g, b, a = 255;
+
+        if (sc < 3) {
+            r = g = b = src[0];
+        } else {
+            r = src[0];
+            g = src[1];
+            b = src[2];
+        }
+
+        if (sc == 2 || sc == 4) {
+            a = src[sc - 1];
+        }
+
+        switch (dc) {
+        case 1:
+            dst[0] = (unsigned char) luminance(r, g, b);
+            break;
+        case 2:
+            dst[0] = (unsigned char) luminance(r, g, b);
+            dst[1] = (unsigned char) a;
+            break;
+        case 3:
+            dst[0] = (unsigned char) r;
+            dst[1] = (unsigned char) g;
+            dst[2] = (unsigned char) b;
+            break;
+        case 4:
+            dst[0] = (unsigned char) r;
+            dst[1] = (unsigned char) g;
+            dst[2] = (unsigned char) b;
+            dst[3] = (unsigned char) a;
+            break;
+        }
+    }
+}
+
+void pixels_premultiply_scalar(unsigned char *pixels, qu_pixel_format format, size_t count)
+{
+    int c = CHANNELS(format);
+
+    if (c != 2 && c != 4) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++, pixels += c) {
+        unsigned int a = pixels[c - 1];
+
+        for (int j = 0; j < c - 1; j++) {
+            pixels[j] = (unsigned char) mul255(pixels[j], a);
+        }
+    }
+}
+
+void pixels_swap_scalar(unsigned char *a, unsigned char *b, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        unsigned char t = a[i];
+        a[i] = b[i];
+        b[i] = t;
+    }
+}
+
+static unsigned int get_blend_factor(qu_blend_factor factor,
+    unsigned int s, unsigned int d, unsigned int sa, unsigned int da)
+{
+    switch (factor) {
+    case QU_BLEND_ZERO:
+        return 0;
+    case QU_BLEND_ONE:
+        return 255;
+    case QU_BLEND_SRC_COLOR:
+        return s;
+    case QU_BLEND_ONE_MINUS_SRC_COLOR:
+        return 255 - s;
+    case QU_BLEND_DST_COLOR:
+        return d;
+    case QU_BLEND_ONE_MINUS_DST_COLOR:
+        return 255 - d;
+    case QU_BLEND_SRC_ALPHA:
+        return sa;
+    case QU_BLEND_ONE_MINUS_SRC_ALPHA:
+        return 255 - sa;
+    case QU_BLEND_DST_ALPHA:
+        return da;
+    case QU_BLEND_ONE_MINUS_DST_ALPHA:
+        return 255 - da;
+    default:
+        return 255;
+    }
+}
+
+static unsigned char blend_channel(qu_blend_factor src_factor, qu_blend_factor dst_factor,
+    qu_blend_equation equation, unsigned int s, unsigned int d, unsigned int sa, unsigned int da)
+{
+    unsigned int x = mul255(s, get_blend_factor(src_factor, s, d, sa, da));
+    unsigned int y = mul255(d, get_blend_factor(dst_factor, s, d, sa, da));
+
+    switch (equation) {
+    case QU_BLEND_SUB:
+        return (unsigned char) (x > y ? x - y : 0);
+    case QU_BLEND_REV_SUB:
+        return (unsigned char) (y > x ? y - x : 0);
+    default:
+        return (unsigned char) (x + y > 255 ? 255 : x + y);
+    }
+}
+
+void pixels_blend_scalar(unsigned char *dst, unsigned char const *src, size_t count,
+                         qu_blend_mode const *mode)
+{
+    for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+        unsigned int sa = src[3];
+        unsigned int da = dst[3];
+
+        for (int j = 0; j < 3; j++) {
+            dst[j] = blend_channel(mode->color_src_factor, mode->color_dst_factor,
+                mode->color_equation, src[j], dst[j], sa, da);
+        }
+
+        dst[3] = blend_channel(mode->alpha_src_factor, mode->alpha_dst_factor,
+            mode->alpha_equation, sa, da, sa, da);
+    }
+}
+
+/**
+ * Inverse of premultiplication. Colors of fully transparent pixels are
+ * lost, they become black. Division doesn't vectorize well, so there is
+ * only this version.
+ */
+void pixels_unpremultiply(unsigned char *pixels, qu_pixel_format format, size_t count)
+{
+    int c = CHANNELS(format);
+
+    if (c != 2 && c != 4) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++, pixels += c) {
+        unsigned int a = pixels[c - 1];
+
+        for (int j = 0; j < c - 1; j++) {
+            unsigned int v = a ? (pixels[j] * 255 + a / 2) / a : 0;
+            pixels[j] = (unsigned char) (v > 255 ? 255 : v);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Blend modes with vectorized paths
+
+enum fast_blend
+{
+    FAST_BLEND_NONE,
+    FAST_BLEND_ALPHA,
+    FAST_BLEND_ADD,
+    FAST_BLEND_MUL,
+    FAST_BLEND_OTHER,
+};
+
+static bool is_blend_mode(qu_blend_mode const *a, qu_blend_mode b)
+{
+    return a->color_src_factor == b.color_src_factor
+        && a->color_dst_factor == b.color_dst_factor
+        && a->color_equation == b.color_equation
+        && a->alpha_src_factor == b.alpha_src_factor
+        && a->alpha_dst_factor == b.alpha_dst_factor
+        && a->alpha_equation == b.alpha_equation;
+}
+
+static enum fast_blend get_fast_blend(qu_blend_mode const *mode)
+{
+    if (is_blend_mode(mode, QU_BLEND_MODE_NONE)) {
+        return FAST_BLEND_NONE;
+    } else if (is_blend_mode(mode, QU_BLEND_MODE_ALPHA)) {
+        return FAST_BLEND_ALPHA;
+    } else if (is_blend_mode(mode, QU_BLEND_MODE_ADD)) {
+        return FAST_BLEND_ADD;
+    } else if (is_blend_mode(mode, QU_BLEND_MODE_MUL)) {
+        return FAST_BLEND_MUL;
+    }
+
+    return FAST_BLEND_OTHER;
+}
+
+//------------------------------------------------------------------------------
+// SSE2
+
+#if defined(LIBQU_SIMD_SSE2)
+
+/**
+ * mul255() on eight 16-bit lanes.
+ */
+static __m128i mul255_sse2(__m128i x, __m128i y)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+/**
+ * Broadcasts alpha of two RGBA pixels unpacked to 16-bit lanes.
+ */
+static __m128i get_alpha_sse2(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static size_t y8_to_rgba_sse2(unsigned char *dst, unsigned char const *src, size_t count)
+{
+    __m128i ones = _mm_set1_epi8((char) 0xFF);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i y = _mm_loadu_si128((__m128i const *) &src[i]);
+
+        __m128i yy_lo = _mm_unpacklo_epi8(y, y);
+        __m128i yy_hi = _mm_unpackhi_epi8(y, y);
+        __m128i ya_lo = _mm_unpacklo_epi8(y, ones);
+        __m128i ya_hi = _mm_unpackhi_epi8(y, ones);
+
+        __m128i *out = (__m128i *) &dst[i * 4];
+
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(yy_lo, ya_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(yy_lo, ya_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(yy_hi, ya_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(yy_hi, ya_hi));
+    }
+
+    return i;
+}
+
+static size_t y8a8_to_rgba_sse2(unsigned char *dst, unsigned char const *src, size_t count)
+{
+    __m128i low = _mm_set1_epi16(0x00FF);
+    __m128i twice = _mm_set1_epi16(0x0101);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i ya = _mm_loadu_si128((__m128i const *) &src[i * 2]);
+        __m128i yy = _mm_mullo_epi16(_mm_and_si128(ya, low), twice);
+
+        __m128i *out = (__m128i *) &dst[i * 4];
+
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(yy, ya));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(yy, ya));
+    }
+
+    return i;
+}
+
+/**
+ * Luma of four RGBA pixels, in 32-bit lanes.
+ */
+static __m128i luminance_sse2(__m128i rgba)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(rgba, zero), weights);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(rgba, zero), weights);
+
+    __m128 rg = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 b = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+
+    __m128i sum = _mm_add_epi32(_mm_castps_si128(rg), _mm_castps_si128(b));
+    return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+}
+
+static size_t rgba_to_y8_sse2(unsigned char *dst, unsigned char const *src, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i const *in = (__m128i const *) &src[i * 4];
+
+        __m128i y0 = luminance_sse2(_mm_loadu_si128(in + 0));
+        __m128i y1 = luminance_sse2(_mm_loadu_si128(in + 1));
+        __m128i y2 = luminance_sse2(_mm_loadu_si128(in + 2));
+        __m128i y3 = luminance_sse2(_mm_loadu_si128(in + 3));
+
+        __m128i y = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3));
+        _mm_storeu_si128((__m128i *) &dst[i], y);
+    }
+
+    return i;
+}
+
+static size_t rgba_to_y8a8_sse2(unsigned char *dst, unsigned char const *src, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i const *in = (__m128i const *) &src[i * 4];
+
+        __m128i v0 = _mm_loadu_si128(in + 0);
+        __m128i v1 = _mm_loadu_si128(in + 1);
+
+        __m128i y = _mm_packs_epi32(luminance_sse2(v0), luminance_sse2(v1));
+        __m128i a = _mm_packs_epi32(_mm_srli_epi32(v0, 24), _mm_srli_epi32(v1, 24));
+
+        // Luma in the low byte, alpha in the high byte of each 16-bit lane.
+        _mm_storeu_si128((__m128i *) &dst[i * 2], _mm_or_si128(y, _mm_slli_epi16(a, 8)));
+    }
+
+    return i;
+}
+
+static size_t premultiply_rgba_sse2(unsigned char *pixels, size_t count)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((__m128i const *) &pixels[i * 4]);
+
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+        // Alpha is multiplied by 255, so it stays the same.
+        __m128i a_lo = _mm_or_si128(get_alpha_sse2(lo), _mm_and_si128(alpha_lanes, _mm_set1_epi16(255)));
+        __m128i a_hi = _mm_or_si128(get_alpha_sse2(hi), _mm_and_si128(alpha_lanes, _mm_set1_epi16(255)));
+
+        lo = mul255_sse2(lo, a_lo);
+        hi = mul255_sse2(hi, a_hi);
+
+        _mm_storeu_si128((__m128i *) &pixels[i * 4], _mm_packus_epi16(lo, hi));
+    }
+
+    return i;
+}
+
+static size_t premultiply_y8a8_sse2(unsigned char *pixels, size_t count)
+{
+    __m128i low = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((__m128i const *) &pixels[i * 2]);
+
+        __m128i y = _mm_and_si128(v, low);
+        __m128i a = _mm_srli_epi16(v, 8);
+
+        y = mul255_sse2(y, a);
+        v = _mm_or_si128(y, _mm_slli_epi16(a, 8));
+
+        _mm_storeu_si128((__m128i *) &pixels[i * 2], v);
+    }
+
+    return i;
+}
+
+static __m128i blend_sse2(__m128i s, __m128i d, enum fast_blend blend)
+{
+    __m128i sa = get_alpha_sse2(s);
+
+    switch (blend) {
+    case FAST_BLEND_ALPHA:
+        return _mm_add_epi16(mul255_sse2(s, sa),
+                             mul255_sse2(d, _mm_sub_epi16(_mm_set1_epi16(255), sa)));
+    case FAST_BLEND_ADD:
+        return _mm_add_epi16(mul255_sse2(s, sa), d);
+    default:
+        // Alpha lane of `s` is source alpha, as MUL wants.
+        return mul255_sse2(d, s);
+    }
+}
+
+static size_t blend_sse2_run(unsigned char *dst, unsigned char const *src,
+    size_t count, enum fast_blend blend)
+{
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((__m128i const *) &src[i * 4]);
+        __m128i d = _mm_loadu_si128((__m128i const *) &dst[i * 4]);
+
+        __m128i lo = blend_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), blend);
+        __m128i hi = blend_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), blend);
+
+        // Saturation clamps sums, as in the scalar version.
+        _mm_storeu_si128((__m128i *) &dst[i * 4], _mm_packus_epi16(lo, hi));
+    }
+
+    return i;
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// NEON
+
+#if defined(LIBQU_SIMD_NEON)
+
+/**
+ * mul255() on sixteen 8-bit lanes.
+ */
+static uint8x16_t mul255_neon(uint8x16_t x, uint8x16_t y)
+{
+    uint16x8_t lo = vmull_u8(vget_low_u8(x), vget_low_u8(y));
+    uint16x8_t hi = vmull_u8(vget_high_u8(x), vget_high_u8(y));
+
+    return vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                       vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+}
+
+static size_t y8_to_rgba_neon(unsigned char *dst, unsigned char const *src, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t y = vld1q_u8(&src[i]);
+        uint8x16x4_t rgba = { { y, y, y, vdupq_n_u8(255) } };
+
+        vst4q_u8(&dst[i * 4], rgba);
+    }
+
+    return i;
+}
+
+static size_t rgb_to_rgba_neon(unsigned char *dst, unsigned char const *src, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t rgb = vld3q_u8(&src[i * 3]);
+        uint8x16x4_t rgba = { { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255) } };
+
+        vst4q_u8(&dst[i * 4], rgba);
+    }
+
+    return i;
+}
+
+static size_t rgba_to_rgb_neon(unsigned char *dst, unsigned char const *src, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t rgba = vld4q_u8(&src[i * 4]);
+        uint8x16x3_t rgb = { { rgba.val[0], rgba.val[1], rgba.val[2] } };
+
+        vst3q_u8(&dst[i * 3], rgb);
+    }
+
+    return i;
+}
+
+static size_t premultiply_rgba_neon(unsigned char *pixels, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t v = vld4q_u8(&pixels[i * 4]);
+
+        v.val[0] = mul255_neon(v.val[0], v.val[3]);
+        v.val[1] = mul255_neon(v.val[1], v.val[3]);
+        v.val[2] = mul255_neon(v.val[2], v.val[3]);
+
+        vst4q_u8(&pixels[i * 4], v);
+    }
+
+    return i;
+}
+
+static uint8x16_t blend_neon(uint8x16_t s, uint8x16_t d, uint8x16_t sa,
+    enum fast_blend blend)
+{
+    switch (blend) {
+    case FAST_BLEND_ALPHA:
+        return vqaddq_u8(mul255_neon(s, sa), mul255_neon(d, vmvnq_u8(sa)));
+    case FAST_BLEND_ADD:
+        return vqaddq_u8(mul255_neon(s, sa), d);
+    default:
+        return mul255_neon(d, s);
+    }
+}
+
+static size_t blend_neon_run(unsigned char *dst, unsigned char const *src,
+    size_t count, enum fast_blend blend)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t s = vld4q_u8(&src[i * 4]);
+        uint8x16x4_t d = vld4q_u8(&dst[i * 4]);
+
+        for (int j = 0; j < 4; j++) {
+            d.val[j] = blend_neon(s.val[j], d.val[j], s.val[3], blend);
+        }
+
+        vst4q_u8(&dst[i * 4], d);
+    }
+
+    return i;
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// Dispatch
+
+/**
+ * Converts pixels between formats. `dst` and `src` must not overlap.
+ */
+void pixels_convert(unsigned char *dst, qu_pixel_format dst_format,
+                    unsigned char const *src, qu_pixel_format src_format,
+                    size_t count)
+{
+    if (src_format == dst_format) {
+        memcpy(dst, src, count * CHANNELS(src_format));
+        return;
+    }
+
+    size_t i = 0;
+
+#if defined(LIBQU_SIMD_SSE2)
+    if (dst_format == QU_PIXFMT_R8G8B8A8) {
+        if (src_format == QU_PIXFMT_Y8) {
+            i = y8_to_rgba_sse2(dst, src, count);
+        } else if (src_format == QU_PIXFMT_Y8A8) {
+            i = y8a8_to_rgba_sse2(dst, src, count);
+        }
+    } else if (src_format == QU_PIXFMT_R8G8B8A8) {
+        if (dst_format == QU_PIXFMT_Y8) {
+            i = rgba_to_y8_sse2(dst, src, count);
+        } else if (dst_format == QU_PIXFMT_Y8A8) {
+            i = rgba_to_y8a8_sse2(dst, src, count);
+        }
+    }
+#elif defined(LIBQU_SIMD_NEON)
+    if (dst_format == QU_PIXFMT_R8G8B8A8) {
+        if (src_format == QU_PIXFMT_Y8) {
+            i = y8_to_rgba_neon(dst, src, count);
+        } else if (src_format == QU_PIXFMT_R8G8B8) {
+            i = rgb_to_rgba_neon(dst, src, count);
+        }
+    } else if (src_format == QU_PIXFMT_R8G8B8A8) {
+        if (dst_format == QU_PIXFMT_R8G8B8) {
+            i = rgba_to_rgb_neon(dst, src, count);
+        }
+    }
+#endif
+
+    pixels_convert_scalar(dst + i * CHANNELS(dst_format), dst_format,
+                          src + i * CHANNELS(src_format), src_format,
+                          count - i);
+}
+
+/**
+ * Multiplies color by alpha, in place. Formats without alpha are left
+ * as they are.
+ */
+void pixels_premultiply(unsigned char *pixels, qu_pixel_format format, size_t count)
+{
+    size_t i = 0;
+
+#if defined(LIBQU_SIMD_SSE2)
+    if (format == QU_PIXFMT_R8G8B8A8) {
+        i = premultiply_rgba_sse2(pixels, count);
+    } else if (format == QU_PIXFMT_Y8A8) {
+        i = premultiply_y8a8_sse2(pixels, count);
+    }
+#elif defined(LIBQU_SIMD_NEON)
+    if (format == QU_PIXFMT_R8G8B8A8) {
+        i = premultiply_rgba_neon(pixels, count);
+    }
+#endif
+
+    pixels_premultiply_scalar(pixels + i * CHANNELS(format), format, count - i);
+}
+
+/**
+ * Exchanges `size` bytes between two non-overlapping buffers.
+ */
+void pixels_swap(unsigned char *a, unsigned char *b, size_t size)
+{
+    size_t i = 0;
+
+#if defined(LIBQU_SIMD_SSE2)
+    for (; i + 16 <= size; i += 16) {
+        __m128i va = _mm_loadu_si128((__m128i const *) &a[i]);
+        __m128i vb = _mm_loadu_si128((__m128i const *) &b[i]);
+
+        _mm_storeu_si128((__m128i *) &a[i], vb);
+        _mm_storeu_si128((__m128i *) &b[i], va);
+    }
+#elif defined(LIBQU_SIMD_NEON)
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t va = vld1q_u8(&a[i]);
+        uint8x16_t vb = vld1q_u8(&b[i]);
+
+        vst1q_u8(&a[i], vb);
+        vst1q_u8(&b[i], va);
+    }
+#endif
+
+    pixels_swap_scalar(a + i, b + i, size - i);
+}
+
+/**
+ * Blends `src` over `dst` like the GPU would, with 8-bit precision.
+ * NONE, ALPHA, ADD and MUL modes have vectorized paths, others are
+ * done one pixel at a time.
+ */
+void pixels_blend(unsigned char *dst, unsigned char const *src, size_t count,
+                  qu_blend_mode const *mode)
+{
+    enum fast_blend blend = get_fast_blend(mode);
+
+    if (blend == FAST_BLEND_NONE) {
+        memcpy(dst, src, count * 4);
+        return;
+    }
+
+    size_t i = 0;
+
+    if (blend != FAST_BLEND_OTHER) {
+#if defined(LIBQU_SIMD_SSE2)
+        i = blend_sse2_run(dst, src, count, blend);
+#elif defined(LIBQU_SIMD_NEON)
+        i = blend_neon_run(dst, src, count, blend);
+#endif
+    }
+
+    pixels_blend_scalar(dst + i * 4, src + i * 4, count - i, mode);
+}
@@ -0,0 +1,61 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#ifndef LIBQU_PIXELS_H_INC
+#define LIBQU_PIXELS_H_INC
+
+//------------------------------------------------------------------------------
+
+#include <stddef.h>
+#include "libquack.h"
+
+//------------------------------------------------------------------------------
+
+/**
+ * Pixel kernels work on tightly packed runs of `count` pixels. Luminance
+ * formats are treated as gray: Y expands to equal R, G and B, and RGB
+ * collapses to Rec. 601 luma. Formats without alpha are opaque.
+ * Blending is done on R8G8B8A8 pixels only.
+ */
+
+void pixels_convert(unsigned char *dst, qu_pixel_format dst_format,
+                    unsigned char const *src, qu_pixel_format src_format,
+                    size_t count);
+
+void pixels_premultiply(unsigned char *pixels, qu_pixel_format format, size_t count);
+void pixels_unpremultiply(unsigned char *pixels, qu_pixel_format format, size_t count);
+
+void pixels_swap(unsigned char *a, unsigned char *b, size_t size);
+
+void pixels_blend(unsigned char *dst, unsigned char const *src, size_t count,
+                  qu_blend_mode const *mode);
+
+// Plain C versions of vectorized functions, for reference.
+void pixels_convert_scalar(unsigned char *dst, qu_pixel_format dst_format,
+                           unsigned char const *src, qu_pixel_format src_format,
+                           size_t count);
+void pixels_premultiply_scalar(unsigned char *pixels, qu_pixel_format format, size_t count);
+void pixels_swap_scalar(unsigned char *a, unsigned char *b, size_t size);
+void pixels_blend_scalar(unsigned char *dst, unsigned char const *src, size_t count,
+                         qu_blend_mode const *mode);
+
+//------------------------------------------------------------------------------
+
+#endif // LIBQU_PIXELS_H_INC
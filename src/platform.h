@@ -29,6 +29,7 @@
 
 typedef struct pl_thread pl_thread;
 typedef struct pl_mutex pl_mutex;
+typedef struct pl_cond pl_cond;
 
 typedef struct pl_date_time
 {
@@ -61,8 +62,19 @@ void pl_destroy_mutex(pl_mutex *mutex);
 void pl_lock_mutex(pl_mutex *mutex);
 void pl_unlock_mutex(pl_mutex *mutex);
 
+pl_cond *pl_create_cond(void);
+void pl_destroy_cond(pl_cond *cond);
+void pl_wait_cond(pl_cond *cond, pl_mutex *mutex);
+void pl_signal_cond(pl_cond *cond);
+void pl_broadcast_cond(pl_cond *cond);
+
+int pl_get_cpu_count(void);
+uint64_t pl_get_memory_size(void);
+
 void pl_sleep(uint32_t milliseconds);
 
+bool pl_get_cache_dir(char *buffer, size_t size);
+
 void *pl_open_dll(char const *path);
 void pl_close_dll(void *dll);
 void *pl_get_dll_proc(void *dll, char const *name);
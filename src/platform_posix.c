@@ -26,12 +26,15 @@
     #define _GNU_SOURCE
 #endif
 
+#include <stdio.h>
 #include <string.h>
 
 #include <dlfcn.h>
 #include <errno.h>
 #include <pthread.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include "platform.h"
 
@@ -45,6 +48,10 @@ struct pl_thread
 {
     pthread_t id;
     char name[THREAD_NAME_LENGTH];
+};
+
+struct thread_start
+{
     void *(*func)(void *);
     void *arg;
 };
@@ -54,6 +61,11 @@ struct pl_mutex
     pthread_mutex_t id;
 };
 
+struct pl_cond
+{
+    pthread_cond_t id;
+};
+
 //------------------------------------------------------------------------------
 // Memory
 
@@ -99,13 +111,15 @@ uint64_t pl_get_ticks_highp(void)
 //------------------------------------------------------------------------------
 // Threads
 
-static void *thread_main(void *thread_ptr)
+// Thread info struct is owned by the creator and released in
+// pl_detach_thread() or pl_wait_thread(), so the thread itself only
+// receives a copy of its entry point.
+static void *thread_main(void *start_ptr)
 {
-    pl_thread *thread = thread_ptr;
-    void *retval = thread->func(thread->arg);
-    pl_free(thread);
+    struct thread_start start = *(struct thread_start *) start_ptr;
+    pl_free(start_ptr);
 
-    return retval;
+    return start.func(start.arg);
 }
 
 pl_thread *pl_create_thread(char const *name, void *(*func)(void *), void *arg)
@@ -122,12 +136,20 @@ pl_thread *pl_create_thread(char const *name, void *(*func)(void *), void *arg)
         strncpy(thread->name, name, THREAD_NAME_LENGTH - 1);
     }
 
-    thread->func = func;
-    thread->arg = arg;
+    struct thread_start *start = pl_malloc(sizeof(*start));
 
-    int error = pthread_create(&thread->id, NULL, thread_main, thread);
+    if (!start) {
+        pl_free(thread);
+        return NULL;
+    }
+
+    start->func = func;
+    start->arg = arg;
+
+    int error = pthread_create(&thread->id, NULL, thread_main, start);
 
     if (error) {
+        pl_free(start);
         pl_free(thread);
         return NULL;
     }
@@ -142,12 +164,14 @@ pl_thread *pl_create_thread(char const *name, void *(*func)(void *), void *arg)
 void pl_detach_thread(pl_thread *thread)
 {
     pthread_detach(thread->id);
+    pl_free(thread);
 }
 
 void *pl_wait_thread(pl_thread *thread)
 {
     void *retval;
     pthread_join(thread->id, &retval);
+    pl_free(thread);
 
     return retval;
 }
@@ -190,6 +214,73 @@ void pl_unlock_mutex(pl_mutex *mutex)
     pthread_mutex_unlock(&mutex->id);
 }
 
+pl_cond *pl_create_cond(void)
+{
+    pl_cond *cond = pl_calloc(1, sizeof(pl_cond));
+
+    if (!cond) {
+        return NULL;
+    }
+
+    int error = pthread_cond_init(&cond->id, NULL);
+
+    if (error) {
+        pl_free(cond);
+        return NULL;
+    }
+
+    return cond;
+}
+
+void pl_destroy_cond(pl_cond *cond)
+{
+    if (!cond) {
+        return;
+    }
+
+    pthread_cond_destroy(&cond->id);
+    pl_free(cond);
+}
+
+void pl_wait_cond(pl_cond *cond, pl_mutex *mutex)
+{
+    pthread_cond_wait(&cond->id, &mutex->id);
+}
+
+void pl_signal_cond(pl_cond *cond)
+{
+    pthread_cond_signal(&cond->id);
+}
+
+void pl_broadcast_cond(pl_cond *cond)
+{
+    pthread_cond_broadcast(&cond->id);
+}
+
+int pl_get_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (int) count : 1;
+}
+
+/**
+ * Returns installed physical memory in bytes, or 0 if it's unknown.
+ */
+uint64_t pl_get_memory_size(void)
+{
+#ifdef _SC_PHYS_PAGES
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    if (pages > 0 && page_size > 0) {
+        return (uint64_t) pages * (uint64_t) page_size;
+    }
+#endif
+
+    return 0;
+}
+
 void pl_sleep(uint32_t milliseconds)
 {
     struct timespec ts = {
@@ -226,6 +317,38 @@ void *pl_get_dll_proc(void *library, char const *name)
     return NULL;
 }
 
+//------------------------------------------------------------------------------
+// Files
+
+bool pl_get_cache_dir(char *buffer, size_t size)
+{
+    char const *xdg = getenv("XDG_CACHE_HOME");
+    char const *home = getenv("HOME");
+    int length;
+
+    if (xdg && xdg[0] == '/') {
+        length = snprintf(buffer, size, "%s", xdg);
+    } else if (home && home[0]) {
+        length = snprintf(buffer, size, "%s/.cache", home);
+    } else {
+        return false;
+    }
+
+    if (length < 0 || (size_t) length >= size) {
+        return false;
+    }
+
+    mkdir(buffer, 0700);
+
+    int extra = snprintf(buffer + length, size - length, "/libquack");
+
+    if (extra < 0 || (size_t) (length + extra) >= size) {
+        return false;
+    }
+
+    return mkdir(buffer, 0700) == 0 || errno == EEXIST;
+}
+
 //------------------------------------------------------------------------------
 // Date & Time
 
@@ -35,6 +35,8 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
+#include <stdio.h>
+
 #include "platform.h"
 
 //------------------------------------------------------------------------------
@@ -61,6 +63,11 @@ struct pl_mutex
     CRITICAL_SECTION cs;
 };
 
+struct pl_cond
+{
+    CONDITION_VARIABLE cv;
+};
+
 //------------------------------------------------------------------------------
 // Memory
 
@@ -245,6 +252,62 @@ void pl_unlock_mutex(pl_mutex *mutex)
     LeaveCriticalSection(&mutex->cs);
 }
 
+pl_cond *pl_create_cond(void)
+{
+    pl_cond *cond = pl_calloc(1, sizeof(*cond));
+
+    if (!cond) {
+        return NULL;
+    }
+
+    InitializeConditionVariable(&cond->cv);
+
+    return cond;
+}
+
+void pl_destroy_cond(pl_cond *cond)
+{
+    pl_free(cond);
+}
+
+void pl_wait_cond(pl_cond *cond, pl_mutex *mutex)
+{
+    SleepConditionVariableCS(&cond->cv, &mutex->cs, INFINITE);
+}
+
+void pl_signal_cond(pl_cond *cond)
+{
+    WakeConditionVariable(&cond->cv);
+}
+
+void pl_broadcast_cond(pl_cond *cond)
+{
+    WakeAllConditionVariable(&cond->cv);
+}
+
+int pl_get_cpu_count(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return (info.dwNumberOfProcessors > 0) ? (int) info.dwNumberOfProcessors : 1;
+}
+
+/**
+ * Returns installed physical memory in bytes, or 0 if it's unknown.
+ */
+uint64_t pl_get_memory_size(void)
+{
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+
+    if (!GlobalMemoryStatusEx(&status)) {
+        return 0;
+    }
+
+    return (uint64_t) status.ullTotalPhys;
+}
+
 void pl_sleep(uint32_t milliseconds)
 {
     Sleep(milliseconds);
@@ -306,6 +369,26 @@ void *pl_get_dll_proc(void *library, char const *name)
     return NULL;
 }
 
+//------------------------------------------------------------------------------
+// Files
+
+bool pl_get_cache_dir(char *buffer, size_t size)
+{
+    char const *local = getenv("LOCALAPPDATA");
+
+    if (!local || !local[0]) {
+        return false;
+    }
+
+    int length = snprintf(buffer, size, "%s\\libquack", local);
+
+    if (length < 0 || (size_t) length >= size) {
+        return false;
+    }
+
+    return CreateDirectoryA(buffer, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
 //------------------------------------------------------------------------------
 // Date & Time
 
@@ -0,0 +1,374 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "fs.h"
+#include "graphics.h"
+#include "log.h"
+#include "platform.h"
+
+//------------------------------------------------------------------------------
+// QOI, "Quite OK Image" format (qoiformat.org), version 1.0:
+//
+//   header                     14 bytes, integers are big-endian
+//   chunks                     one per pixel or per run of pixels
+//   end marker                 7 zero bytes and 0x01
+//
+// Each chunk either repeats the previous pixel, picks one of 64 recently
+// seen pixels by hash, stores a small difference to the previous pixel,
+// or stores the pixel as is. Decoding is a single pass with no entropy
+// coding. That usually makes it faster than PNG, but not always: small
+// images that PNG compresses well can decode as fast or faster from PNG,
+// and without entropy coding QOI files are often larger.
+
+#define QOI_MAGIC                   "qoif"
+#define QOI_HEADER_SIZE             14
+#define QOI_PADDING_SIZE            8
+#define QOI_MAX_PIXELS              400000000u
+
+#define QOI_OP_INDEX                0x00    // 00xxxxxx
+#define QOI_OP_DIFF                 0x40    // 01xxxxxx
+#define QOI_OP_LUMA                 0x80    // 10xxxxxx
+#define QOI_OP_RUN                  0xc0    // 11xxxxxx
+#define QOI_OP_RGB                  0xfe    // 11111110
+#define QOI_OP_RGBA                 0xff    // 11111111
+#define QOI_MASK                    0xc0
+
+//------------------------------------------------------------------------------
+
+struct qoi_pixel
+{
+    unsigned char r, g, b, a;
+};
+
+static unsigned char const qoi_padding[QOI_PADDING_SIZE] = {
+    0, 0, 0, 0, 0, 0, 0, 1,
+};
+
+//------------------------------------------------------------------------------
+
+static int hash_pixel(struct qoi_pixel px)
+{
+    return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) & 63;
+}
+
+static bool is_pixel_equal(struct qoi_pixel a, struct qoi_pixel b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static uint32_t read_u32(unsigned char const *bytes)
+{
+    return (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16
+        | (uint32_t) bytes[2] << 8 | (uint32_t) bytes[3];
+}
+
+static unsigned char *write_u32(unsigned char *bytes, uint32_t value)
+{
+    *bytes++ = (unsigned char) (value >> 24);
+    *bytes++ = (unsigned char) (value >> 16);
+    *bytes++ = (unsigned char) (value >> 8);
+    *bytes++ = (unsigned char) value;
+
+    return bytes;
+}
+
+/**
+ * Decodes chunks into `count` pixels of `c` channels. Input that ends
+ * early leaves the rest of the pixels as the last decoded one. Always
+ * inlined with a constant `c`, so that pixel stores are unrolled.
+ */
+static inline void decode_chunks(unsigned char *pixels, int c, size_t count,
+    unsigned char const *data, size_t size)
+{
+    struct qoi_pixel index[64] = { 0 };
+    struct qoi_pixel px = { 0, 0, 0, 255 };
+    unsigned char *last = pixels + count * c;
+    size_t p = 0;
+
+    // Longest chunk is 5 bytes, so it never runs past the end marker.
+    size_t end = (size > QOI_PADDING_SIZE) ? size - QOI_PADDING_SIZE : 0;
+
+    while (pixels < last) {
+        size_t run = 1;
+
+        if (p < end) {
+            int b1 = data[p++];
+
+            if (b1 == QOI_OP_RGB) {
+                px.r = data[p++];
+                px.g = data[p++];
+                px.b = data[p++];
+            } else if (b1 == QOI_OP_RGBA) {
+                px.r = data[p++];
+                px.g = data[p++];
+                px.b = data[p++];
+                px.a = data[p++];
+            } else if ((b1 & QOI_MASK) == QOI_OP_INDEX) {
+                px = index[b1];
+            } else if ((b1 & QOI_MASK) == QOI_OP_DIFF) {
+                px.r += ((b1 >> 4) & 3) - 2;
+                px.g += ((b1 >> 2) & 3) - 2;
+                px.b += (b1 & 3) - 2;
+            } else if ((b1 & QOI_MASK) == QOI_OP_LUMA) {
+                int b2 = data[p++];
+                int dg = (b1 & 63) - 32;
+
+                px.r += dg - 8 + ((b2 >> 4) & 15);
+                px.g += dg;
+                px.b += dg - 8 + (b2 & 15);
+            } else {
+                run = (size_t) (b1 & 63) + 1;
+            }
+
+            index[hash_pixel(px)] = px;
+        } else {
+            run = (size_t) (last - pixels) / c;
+        }
+
+        run = LIBQU_MIN(run, (size_t) (last - pixels) / c);
+
+        for (size_t i = 0; i < run; i++, pixels += c) {
+            pixels[0] = px.r;
+            pixels[1] = px.g;
+            pixels[2] = px.b;
+
+            if (c == 4) {
+                pixels[3] = px.a;
+            }
+        }
+    }
+}
+
+/**
+ * Writes chunks for `count` pixels of `c` channels. Returns the end of
+ * the written data.
+ */
+static unsigned char *encode_chunks(unsigned char *out,
+    unsigned char const *pixels, int c, size_t count)
+{
+    struct qoi_pixel index[64] = { 0 };
+    struct qoi_pixel prev = { 0, 0, 0, 255 };
+    int run = 0;
+
+    for (size_t i = 0; i < count; i++, pixels += c) {
+        struct qoi_pixel px = {
+            pixels[0], pixels[1], pixels[2], (c == 4) ? pixels[3] : 255,
+        };
+
+        if (is_pixel_equal(px, prev)) {
+            run++;
+
+            if (run == 62 || i == count - 1) {
+                *out++ = (unsigned char) (QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            continue;
+        }
+
+        if (run > 0) {
+            *out++ = (unsigned char) (QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        int hash = hash_pixel(px);
+
+        if (is_pixel_equal(index[hash], px)) {
+            *out++ = (unsigned char) (QOI_OP_INDEX | hash);
+            prev = px;
+            continue;
+        }
+
+        index[hash] = px;
+
+        if (px.a != prev.a) {
+            *out++ = QOI_OP_RGBA;
+            *out++ = px.r;
+            *out++ = px.g;
+            *out++ = px.b;
+            *out++ = px.a;
+            prev = px;
+            continue;
+        }
+
+        // Differences wrap around, as in the decoder.
+        signed char dr = (signed char) (px.r - prev.r);
+        signed char dg = (signed char) (px.g - prev.g);
+        signed char db = (signed char) (px.b - prev.b);
+        signed char dr_dg = (signed char) (dr - dg);
+        signed char db_dg = (signed char) (db - dg);
+
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+            *out++ = (unsigned char) (QOI_OP_DIFF
+                | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+        } else if (dg >= -32 && dg <= 31
+            && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+            *out++ = (unsigned char) (QOI_OP_LUMA | (dg + 32));
+            *out++ = (unsigned char) ((dr_dg + 8) << 4 | (db_dg + 8));
+        } else {
+            *out++ = QOI_OP_RGB;
+            *out++ = px.r;
+            *out++ = px.g;
+            *out++ = px.b;
+        }
+
+        prev = px;
+    }
+
+    return out;
+}
+
+//------------------------------------------------------------------------------
+
+/**
+ * True if the file starts with the QOI magic. Position is kept.
+ */
+bool libqu_qoi_check(struct libqu_file *file)
+{
+    char magic[4];
+    int64_t start = libqu_ftell(file);
+    bool match = libqu_fread(magic, sizeof(magic), file) == (int64_t) sizeof(magic)
+        && memcmp(magic, QOI_MAGIC, sizeof(magic)) == 0;
+
+    libqu_fseek(file, start, SEEK_SET);
+
+    return match;
+}
+
+/**
+ * Images with three channels are loaded as R8G8B8, with four as
+ * R8G8B8A8. Colorspace byte is ignored, pixels are taken as they are.
+ */
+struct libqu_image *libqu_qoi_load(struct libqu_file *file)
+{
+    unsigned char header[QOI_HEADER_SIZE];
+
+    if (libqu_fread(header, sizeof(header), file) != (int64_t) sizeof(header)
+        || memcmp(header, QOI_MAGIC, 4) != 0) {
+        LIBQU_LOGE("Not a QOI image: %s\n", file->name);
+        return NULL;
+    }
+
+    uint32_t w = read_u32(&header[4]);
+    uint32_t h = read_u32(&header[8]);
+    int c = header[12];
+
+    if (w == 0 || h == 0 || h >= QOI_MAX_PIXELS / w || (c != 3 && c != 4)) {
+        LIBQU_LOGE("Invalid QOI header: %s\n", file->name);
+        return NULL;
+    }
+
+    int64_t start = libqu_ftell(file);
+    size_t size = (file->size > (size_t) start) ? file->size - (size_t) start : 0;
+    unsigned char *data = pl_malloc(size);
+
+    if (!data && size > 0) {
+        return NULL;
+    }
+
+    if (libqu_fread(data, size, file) != (int64_t) size) {
+        LIBQU_LOGE("Failed to read QOI image: %s\n", file->name);
+        pl_free(data);
+        return NULL;
+    }
+
+    qu_vec2i image_size = { (int) w, (int) h };
+    struct libqu_image *image = libqu_image_create(
+        (c == 4) ? QU_PIXFMT_R8G8B8A8 : QU_PIXFMT_R8G8B8, image_size);
+
+    if (image && c == 4) {
+        decode_chunks(image->pixels, 4, (size_t) w * h, data, size);
+    } else if (image) {
+        decode_chunks(image->pixels, 3, (size_t) w * h, data, size);
+    }
+
+    pl_free(data);
+
+    return image;
+}
+
+/**
+ * Grayscale images are stored as RGB or RGBA, since QOI has no
+ * luminance formats. Returns false and removes the file on failure.
+ */
+bool libqu_qoi_save(struct libqu_image const *image, char const *path)
+{
+    struct libqu_image *converted = NULL;
+
+    if (image->format == QU_PIXFMT_Y8 || image->format == QU_PIXFMT_Y8A8) {
+        converted = libqu_image_convert(image, (image->format == QU_PIXFMT_Y8)
+            ? QU_PIXFMT_R8G8B8 : QU_PIXFMT_R8G8B8A8);
+
+        if (!converted) {
+            return false;
+        }
+
+        image = converted;
+    }
+
+    int c = (image->format == QU_PIXFMT_R8G8B8A8) ? 4 : 3;
+    size_t count = (size_t) image->size.x * image->size.y;
+
+    // Worst case is a full RGB or RGBA chunk for every pixel.
+    size_t capacity = QOI_HEADER_SIZE + count * (c + 1) + QOI_PADDING_SIZE;
+    unsigned char *data = pl_malloc(capacity);
+    bool success = false;
+
+    if (data) {
+        unsigned char *out = data;
+
+        memcpy(out, QOI_MAGIC, 4);
+        out = write_u32(out + 4, (uint32_t) image->size.x);
+        out = write_u32(out, (uint32_t) image->size.y);
+        *out++ = (unsigned char) c;
+        *out++ = 0; // sRGB with linear alpha
+
+        out = encode_chunks(out, image->pixels, c, count);
+
+        memcpy(out, qoi_padding, QOI_PADDING_SIZE);
+        out += QOI_PADDING_SIZE;
+
+        FILE *file = fopen(path, "wb");
+
+        if (file) {
+            size_t size = (size_t) (out - data);
+            success = fwrite(data, size, 1, file) == 1;
+            success = (fclose(file) == 0) && success;
+
+            if (!success) {
+                remove(path);
+            }
+        }
+
+        pl_free(data);
+    }
+
+    if (converted) {
+        libqu_image_destroy(converted);
+    }
+
+    if (!success) {
+        LIBQU_LOGE("Failed to write QOI image to %s.\n", path);
+    }
+
+    return success;
+}
@@ -0,0 +1,752 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_ds.h>
+#include "graphics.h"
+#include "log.h"
+#include "platform.h"
+
+//------------------------------------------------------------------------------
+
+#define DEFAULT_CELL_SIZE           256.f
+#define DEGREES_TO_RADIANS          0.017453292519943295f
+
+// Longest run of sprites written with a single reservation, so that it
+// stays within the flush threshold.
+#define MAX_RUN_SPRITES             4096
+
+// Sprites covering more cells than this aren't put into the grid, they
+// are tested against the viewport one by one instead.
+#define MAX_SPRITE_CELLS            64
+
+//------------------------------------------------------------------------------
+
+struct sprite
+{
+    bool used;
+    bool visible;
+    bool dirty;                     /*!< World transform is out of date */
+    bool large;                     /*!< Kept out of the grid */
+
+    int parent;
+    int *children;
+
+    struct libqu_texture *texture;
+    qu_rectf rect;                  /*!< Quad in local coordinates */
+    float s, t, u, v;               /*!< Normalized texture coordinates */
+    qu_color color;
+    int order;
+
+    qu_vec2f position;
+    float rotation;
+    qu_vec2f scale;
+
+    affine_t world;
+    qu_vec2f corners[4];            /*!< Quad in world coordinates */
+    float x0, y0, x1, y1;           /*!< Bounding box of the corners */
+
+    int col0, row0, col1, row1;     /*!< Grid cells the sprite is in */
+    unsigned int mark;              /*!< Last query that visited it */
+};
+
+struct cell_item
+{
+    uint64_t key;
+    int *value;
+};
+
+struct libqu_scene
+{
+    float cell_size;
+    struct sprite *sprites;
+    int *free_sprites;
+    int *dirty;
+    struct cell_item *cells;
+    int *large;
+    unsigned int mark;
+    int *visible;
+};
+
+//------------------------------------------------------------------------------
+// Transforms
+
+static affine_t get_local_transform(struct sprite const *sprite)
+{
+    float radians = sprite->rotation * DEGREES_TO_RADIANS;
+    float cs = cosf(radians);
+    float sn = sinf(radians);
+
+    return (affine_t) {
+        {
+            cs * sprite->scale.x,   sn * sprite->scale.x,
+            -sn * sprite->scale.y,  cs * sprite->scale.y,
+            sprite->position.x,     sprite->position.y,
+        },
+    };
+}
+
+//------------------------------------------------------------------------------
+// Spatial hash
+
+static uint64_t get_cell_key(int col, int row)
+{
+    return ((uint64_t) (uint32_t) col << 32) | (uint32_t) row;
+}
+
+static void remove_from_cell(struct libqu_scene *scene, int col, int row, int index)
+{
+    struct cell_item *item = hmgetp_null(scene->cells, get_cell_key(col, row));
+
+    if (!item) {
+        return;
+    }
+
+    for (ptrdiff_t i = 0; i < arrlen(item->value); i++) {
+        if (item->value[i] == index) {
+            arrdelswap(item->value, i);
+            break;
+        }
+    }
+}
+
+static void add_to_cell(struct libqu_scene *scene, int col, int row, int index)
+{
+    uint64_t key = get_cell_key(col, row);
+    struct cell_item *item = hmgetp_null(scene->cells, key);
+
+    if (!item) {
+        hmput(scene->cells, key, NULL);
+        item = hmgetp_null(scene->cells, key);
+    }
+
+    arrput(item->value, index);
+}
+
+static void unlink_sprite(struct libqu_scene *scene, int index)
+{
+    struct sprite *sprite = &scene->sprites[index];
+
+    if (sprite->large) {
+        for (ptrdiff_t i = 0; i < arrlen(scene->large); i++) {
+            if (scene->large[i] == index) {
+                arrdelswap(scene->large, i);
+                break;
+            }
+        }
+
+        sprite->large = false;
+        return;
+    }
+
+    for (int row = sprite->row0; row <= sprite->row1; row++) {
+        for (int col = sprite->col0; col <= sprite->col1; col++) {
+            remove_from_cell(scene, col, row, index);
+        }
+    }
+
+    sprite->col0 = sprite->row0 = 0;
+    sprite->col1 = sprite->row1 = -1;
+}
+
+/**
+ * Moves the sprite to the cells covered by its bounding box. Nothing is
+ * done if the set of cells stays the same, which is the common case
+ * for sprites moving by a few pixels.
+ */
+static void link_sprite(struct libqu_scene *scene, int index)
+{
+    struct sprite *sprite = &scene->sprites[index];
+
+    bool empty = !sprite->texture || !(sprite->x0 <= sprite->x1 && sprite->y0 <= sprite->y1);
+
+    int col0 = 0, row0 = 0, col1 = -1, row1 = -1;
+
+    if (!empty) {
+        col0 = (int) floorf(LIBQU_MAX(sprite->x0 / scene->cell_size, (float) INT32_MIN));
+        row0 = (int) floorf(LIBQU_MAX(sprite->y0 / scene->cell_size, (float) INT32_MIN));
+        col1 = (int) floorf(LIBQU_MIN(sprite->x1 / scene->cell_size, (float) INT32_MAX));
+        row1 = (int) floorf(LIBQU_MIN(sprite->y1 / scene->cell_size, (float) INT32_MAX));
+    }
+
+    bool large = !empty
+        && ((int64_t) col1 - col0 + 1) * ((int64_t) row1 - row0 + 1) > MAX_SPRITE_CELLS;
+
+    if (!large && !sprite->large && col0 == sprite->col0 && row0 == sprite->row0
+        && col1 == sprite->col1 && row1 == sprite->row1) {
+        return;
+    }
+
+    if (large && sprite->large) {
+        return;
+    }
+
+    unlink_sprite(scene, index);
+
+    if (large) {
+        arrput(scene->large, index);
+        sprite->large = true;
+        return;
+    }
+
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            add_to_cell(scene, col, row, index);
+        }
+    }
+
+    sprite->col0 = col0;
+    sprite->row0 = row0;
+    sprite->col1 = col1;
+    sprite->row1 = row1;
+}
+
+/**
+ * Recomputes the world transform of the sprite and all of its
+ * descendants, whose transforms depend on it.
+ */
+static void update_sprite(struct libqu_scene *scene, int index)
+{
+    struct sprite *sprite = &scene->sprites[index];
+    affine_t local = get_local_transform(sprite);
+
+    if (sprite->parent >= 0) {
+        sprite->world = scene->sprites[sprite->parent].world;
+        affine_multiply(&sprite->world, &local);
+    } else {
+        sprite->world = local;
+    }
+
+    qu_rectf r = sprite->rect;
+
+    qu_vec2f const corners[4] = {
+        { r.x,          r.y },
+        { r.x + r.w,    r.y },
+        { r.x + r.w,    r.y + r.h },
+        { r.x,          r.y + r.h },
+    };
+
+    affine_transform_points(&sprite->world, sprite->corners, corners, 4);
+
+    sprite->x0 = sprite->x1 = sprite->corners[0].x;
+    sprite->y0 = sprite->y1 = sprite->corners[0].y;
+
+    for (int i = 1; i < 4; i++) {
+        sprite->x0 = LIBQU_MIN(sprite->x0, sprite->corners[i].x);
+        sprite->y0 = LIBQU_MIN(sprite->y0, sprite->corners[i].y);
+        sprite->x1 = LIBQU_MAX(sprite->x1, sprite->corners[i].x);
+        sprite->y1 = LIBQU_MAX(sprite->y1, sprite->corners[i].y);
+    }
+
+    sprite->dirty = false;
+    link_sprite(scene, index);
+
+    for (ptrdiff_t i = 0; i < arrlen(sprite->children); i++) {
+        update_sprite(scene, sprite->children[i]);
+    }
+}
+
+static void mark_dirty(struct libqu_scene *scene, int index)
+{
+    struct sprite *sprite = &scene->sprites[index];
+
+    if (!sprite->dirty) {
+        sprite->dirty = true;
+        arrput(scene->dirty, index);
+    }
+}
+
+/**
+ * Only sprites changed since the last call are updated, starting from
+ * the topmost changed ancestor so that every transform is computed once.
+ */
+static void update_dirty_sprites(struct libqu_scene *scene)
+{
+    for (ptrdiff_t i = 0; i < arrlen(scene->dirty); i++) {
+        int index = scene->dirty[i];
+
+        if (!scene->sprites[index].used || !scene->sprites[index].dirty) {
+            continue;
+        }
+
+        int top = index;
+
+        for (int p = scene->sprites[index].parent; p >= 0; p = scene->sprites[p].parent) {
+            if (scene->sprites[p].dirty) {
+                top = p;
+            }
+        }
+
+        update_sprite(scene, top);
+    }
+
+    arrsetlen(scene->dirty, 0);
+}
+
+//------------------------------------------------------------------------------
+// Drawing
+
+static struct libqu_scene *sort_scene;
+
+static int compare_sprites(void const *a, void const *b)
+{
+    int i = *(int const *) a;
+    int j = *(int const *) b;
+    int oi = sort_scene->sprites[i].order;
+    int oj = sort_scene->sprites[j].order;
+
+    if (oi != oj) {
+        return (oi < oj) ? -1 : 1;
+    }
+
+    return (i > j) - (i < j);
+}
+
+static void visit_sprite(struct libqu_scene *scene, int index, qu_rectf view)
+{
+    struct sprite *sprite = &scene->sprites[index];
+
+    if (sprite->mark == scene->mark) {
+        return;
+    }
+
+    sprite->mark = scene->mark;
+
+    if (!sprite->visible
+        || sprite->x1 < view.x || sprite->x0 > view.x + view.w
+        || sprite->y1 < view.y || sprite->y0 > view.y + view.h) {
+        return;
+    }
+
+    arrput(scene->visible, index);
+}
+
+/**
+ * Collects sprites overlapping the view rectangle (in world coordinates)
+ * into scene->visible, in drawing order.
+ */
+static void query_view(struct libqu_scene *scene, qu_rectf view)
+{
+    arrsetlen(scene->visible, 0);
+
+    if (++scene->mark == 0) {
+        for (ptrdiff_t i = 0; i < arrlen(scene->sprites); i++) {
+            scene->sprites[i].mark = 0;
+        }
+
+        scene->mark = 1;
+    }
+
+    int col0 = (int) floorf(view.x / scene->cell_size);
+    int row0 = (int) floorf(view.y / scene->cell_size);
+    int col1 = (int) floorf((view.x + view.w) / scene->cell_size);
+    int row1 = (int) floorf((view.y + view.h) / scene->cell_size);
+
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            struct cell_item *item = hmgetp_null(scene->cells, get_cell_key(col, row));
+
+            if (!item) {
+                continue;
+            }
+
+            for (ptrdiff_t i = 0; i < arrlen(item->value); i++) {
+                visit_sprite(scene, item->value[i], view);
+            }
+        }
+    }
+
+    for (ptrdiff_t i = 0; i < arrlen(scene->large); i++) {
+        visit_sprite(scene, scene->large[i], view);
+    }
+
+    sort_scene = scene;
+    qsort(scene->visible, arrlenu(scene->visible), sizeof(int), compare_sprites);
+    sort_scene = NULL;
+}
+
+static void write_quad(struct libqu_vertex *v, qu_vec2f const *p, qu_vec2f offset,
+    float s, float t, float u, float w, qu_color color)
+{
+    v[0] = (struct libqu_vertex) { { p[0].x + offset.x, p[0].y + offset.y }, color, { s, t } };
+    v[1] = (struct libqu_vertex) { { p[1].x + offset.x, p[1].y + offset.y }, color, { u, t } };
+    v[2] = (struct libqu_vertex) { { p[2].x + offset.x, p[2].y + offset.y }, color, { u, w } };
+    v[3] = v[2];
+    v[4] = (struct libqu_vertex) { { p[3].x + offset.x, p[3].y + offset.y }, color, { s, w } };
+    v[5] = v[0];
+}
+
+static qu_vec2f lerp_quad(qu_vec2f const *p, float fx, float fy)
+{
+    return (qu_vec2f) {
+        p[0].x + (p[1].x - p[0].x) * fx + (p[3].x - p[0].x) * fy,
+        p[0].y + (p[1].y - p[0].y) * fx + (p[3].y - p[0].y) * fy,
+    };
+}
+
+/**
+ * Sprites with textures split into a grid are drawn cell by cell. Their
+ * world transform is affine, so cell corners are interpolated from the
+ * corners of the whole quad.
+ */
+static void draw_grid_sprite(struct sprite const *sprite, qu_vec2f offset)
+{
+    struct libqu_texture *texture = sprite->texture;
+    struct libqu_texture_grid const *grid = &texture->grid;
+
+    float sx0 = sprite->s * texture->size.x;
+    float sy0 = sprite->t * texture->size.y;
+    float sx1 = sprite->u * texture->size.x;
+    float sy1 = sprite->v * texture->size.y;
+
+    if (sx0 == sx1 || sy0 == sy1) {
+        return;
+    }
+
+    float l = LIBQU_MAX(LIBQU_MIN(sx0, sx1), 0.f);
+    float r = LIBQU_MIN(LIBQU_MAX(sx0, sx1), (float) texture->size.x);
+    float top = LIBQU_MAX(LIBQU_MIN(sy0, sy1), 0.f);
+    float bottom = LIBQU_MIN(LIBQU_MAX(sy0, sy1), (float) texture->size.y);
+
+    int col0 = LIBQU_MAX(0, (int) (l / grid->step));
+    int row0 = LIBQU_MAX(0, (int) (top / grid->step));
+    int col1 = LIBQU_MIN(grid->cols - 1, (int) (r / grid->step));
+    int row1 = LIBQU_MIN(grid->rows - 1, (int) (bottom / grid->step));
+
+    for (int row = row0; row <= row1; row++) {
+        float py0 = LIBQU_MAX(top, (float) (row * grid->step));
+        float py1 = LIBQU_MIN(bottom, (float) ((row + 1) * grid->step));
+
+        if (py0 >= py1) {
+            continue;
+        }
+
+        for (int col = col0; col <= col1; col++) {
+            float px0 = LIBQU_MAX(l, (float) (col * grid->step));
+            float px1 = LIBQU_MIN(r, (float) ((col + 1) * grid->step));
+
+            if (px0 >= px1) {
+                continue;
+            }
+
+            struct libqu_texture *cell = grid->cells[row * grid->cols + col];
+
+            // Cell origin in texels, accounting for the overlap.
+            float ox = (float) LIBQU_MAX(0, col * grid->step - 1);
+            float oy = (float) LIBQU_MAX(0, row * grid->step - 1);
+
+            float fx0 = (px0 - sx0) / (sx1 - sx0);
+            float fy0 = (py0 - sy0) / (sy1 - sy0);
+            float fx1 = (px1 - sx0) / (sx1 - sx0);
+            float fy1 = (py1 - sy0) / (sy1 - sy0);
+
+            qu_vec2f points[4] = {
+                lerp_quad(sprite->corners, fx0, fy0),
+                lerp_quad(sprite->corners, fx1, fy0),
+                lerp_quad(sprite->corners, fx1, fy1),
+                lerp_quad(sprite->corners, fx0, fy1),
+            };
+
+            write_quad(libqu_graphics_reserve_triangles(cell, 6), points, offset,
+                (px0 - ox) / cell->size.x, (py0 - oy) / cell->size.y,
+                (px1 - ox) / cell->size.x, (py1 - oy) / cell->size.y,
+                sprite->color);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+struct libqu_scene *libqu_scene_create(float cell_size)
+{
+    struct libqu_scene *scene = pl_calloc(1, sizeof(*scene));
+
+    if (scene) {
+        scene->cell_size = (cell_size > 0.f) ? cell_size : DEFAULT_CELL_SIZE;
+    }
+
+    return scene;
+}
+
+void libqu_scene_destroy(struct libqu_scene *scene)
+{
+    for (ptrdiff_t i = 0; i < arrlen(scene->sprites); i++) {
+        arrfree(scene->sprites[i].children);
+    }
+
+    for (ptrdiff_t i = 0; i < hmlen(scene->cells); i++) {
+        arrfree(scene->cells[i].value);
+    }
+
+    hmfree(scene->cells);
+    arrfree(scene->sprites);
+    arrfree(scene->free_sprites);
+    arrfree(scene->dirty);
+    arrfree(scene->large);
+    arrfree(scene->visible);
+    pl_free(scene);
+}
+
+/**
+ * Adds a sprite drawing the whole texture over `rect`, which is in the
+ * sprite's own coordinates. Sprites without a texture are only used to
+ * group others. Returns sprite index, or -1 on failure.
+ */
+int libqu_scene_add_sprite(struct libqu_scene *scene,
+    struct libqu_texture *texture, qu_rectf rect)
+{
+    struct sprite sprite = {
+        .used = true,
+        .visible = true,
+        .parent = -1,
+        .texture = texture,
+        .rect = rect,
+        .s = 0.f,
+        .t = 0.f,
+        .u = 1.f,
+        .v = 1.f,
+        .color = 0xFFFFFFFF,
+        .scale = { 1.f, 1.f },
+        .col1 = -1,
+        .row1 = -1,
+    };
+
+    int index;
+
+    if (arrlen(scene->free_sprites) > 0) {
+        index = arrpop(scene->free_sprites);
+        scene->sprites[index] = sprite;
+    } else {
+        index = (int) arrlen(scene->sprites);
+        arrput(scene->sprites, sprite);
+    }
+
+    mark_dirty(scene, index);
+
+    return index;
+}
+
+static struct sprite *get_sprite(struct libqu_scene *scene, int index)
+{
+    if (index < 0 || index >= arrlen(scene->sprites) || !scene->sprites[index].used) {
+        return NULL;
+    }
+
+    return &scene->sprites[index];
+}
+
+static void detach_sprite(struct libqu_scene *scene, int index)
+{
+    int parent = scene->sprites[index].parent;
+
+    if (parent < 0) {
+        return;
+    }
+
+    int *children = scene->sprites[parent].children;
+
+    for (ptrdiff_t i = 0; i < arrlen(children); i++) {
+        if (children[i] == index) {
+            arrdel(children, i);
+            break;
+        }
+    }
+
+    scene->sprites[parent].children = children;
+    scene->sprites[index].parent = -1;
+}
+
+/**
+ * Removes the sprite along with all of its descendants.
+ */
+void libqu_scene_remove_sprite(struct libqu_scene *scene, int index)
+{
+    struct sprite *sprite = get_sprite(scene, index);
+
+    if (!sprite) {
+        return;
+    }
+
+    detach_sprite(scene, index);
+
+    while (arrlen(scene->sprites[index].children) > 0) {
+        libqu_scene_remove_sprite(scene, scene->sprites[index].children[0]);
+    }
+
+    sprite = &scene->sprites[index];
+
+    unlink_sprite(scene, index);
+    arrfree(sprite->children);
+
+    // Index stays in the dirty list if it's there, but it's skipped.
+    sprite->used = false;
+    sprite->dirty = false;
+
+    arrput(scene->free_sprites, index);
+}
+
+/**
+ * Attaches the sprite to a parent, -1 makes it a root again. Cycles are
+ * refused.
+ */
+bool libqu_scene_set_parent(struct libqu_scene *scene, int index, int parent)
+{
+    if (!get_sprite(scene, index) || (parent >= 0 && !get_sprite(scene, parent))) {
+        return false;
+    }
+
+    for (int p = parent; p >= 0; p = scene->sprites[p].parent) {
+        if (p == index) {
+            LIBQU_LOGE("Sprite %d can't be a descendant of itself.\n", index);
+            return false;
+        }
+    }
+
+    detach_sprite(scene, index);
+
+    if (parent >= 0) {
+        arrput(scene->sprites[parent].children, index);
+        scene->sprites[index].parent = parent;
+    }
+
+    mark_dirty(scene, index);
+    return true;
+}
+
+void libqu_scene_set_position(struct libqu_scene *scene, int index, qu_vec2f position)
+{
+    struct sprite *sprite = get_sprite(scene, index);
+
+    if (sprite) {
+        sprite->position = position;
+        mark_dirty(scene, index);
+    }
+}
+
+void libqu_scene_set_transform(struct libqu_scene *scene, int index,
+    qu_vec2f position, float rotation, qu_vec2f scale)
+{
+    struct sprite *sprite = get_sprite(scene, index);
+
+    if (sprite) {
+        sprite->position = position;
+        sprite->rotation = rotation;
+        sprite->scale = scale;
+        mark_dirty(scene, index);
+    }
+}
+
+/**
+ * Texture region is in texels, like in libqu_graphics_draw_subtexture().
+ */
+void libqu_scene_set_subrect(struct libqu_scene *scene, int index, qu_rectf sub)
+{
+    struct sprite *sprite = get_sprite(scene, index);
+
+    if (sprite && sprite->texture) {
+        sprite->s = sub.x / sprite->texture->full_size.x;
+        sprite->t = sub.y / sprite->texture->full_size.y;
+        sprite->u = (sub.x + sub.w) / sprite->texture->full_size.x;
+        sprite->v = (sub.y + sub.h) / sprite->texture->full_size.y;
+    }
+}
+
+void libqu_scene_set_color(struct libqu_scene *scene, int index, qu_color color)
+{
+    struct sprite *sprite = get_sprite(scene, index);
+
+    if (sprite) {
+        sprite->color = color;
+    }
+}
+
+/**
+ * Sprites with lower order are drawn first. Sprites of the same order
+ * are drawn by index.
+ */
+void libqu_scene_set_order(struct libqu_scene *scene, int index, int order)
+{
+    struct sprite *sprite = get_sprite(scene, index);
+
+    if (sprite) {
+        sprite->order = order;
+    }
+}
+
+/**
+ * Hidden sprites aren't drawn, but their children still are.
+ */
+void libqu_scene_set_visible(struct libqu_scene *scene, int index, bool visible)
+{
+    struct sprite *sprite = get_sprite(scene, index);
+
+    if (sprite) {
+        sprite->visible = visible;
+    }
+}
+
+/**
+ * Draws sprites visible in the window, with the scene origin at `pos`.
+ * Only changed sprites have their transforms updated, and only cells of
+ * the grid under the window are looked at. Consecutive sprites with the
+ * same texture are written as a single run of triangles.
+ */
+void libqu_scene_draw(struct libqu_scene *scene, qu_vec2f pos)
+{
+    update_dirty_sprites(scene);
+
+    qu_rectf window = libqu_graphics_get_visible_rect();
+    qu_rectf view = { window.x - pos.x, window.y - pos.y, window.w, window.h };
+
+    query_view(scene, view);
+
+    int const *visible = scene->visible;
+    int count = (int) arrlen(scene->visible);
+
+    for (int i = 0; i < count;) {
+        struct sprite const *sprite = &scene->sprites[visible[i]];
+        struct libqu_texture *texture = sprite->texture;
+
+        if (texture->grid.cells) {
+            draw_grid_sprite(sprite, pos);
+            i++;
+            continue;
+        }
+
+        int run = 1;
+
+        while (i + run < count && run < MAX_RUN_SPRITES
+               && scene->sprites[visible[i + run]].texture == texture) {
+            run++;
+        }
+
+        struct libqu_vertex *v = libqu_graphics_reserve_triangles(texture, 6 * run);
+
+        for (int j = 0; j < run; j++, v += 6) {
+            sprite = &scene->sprites[visible[i + j]];
+            write_quad(v, sprite->corners, pos,
+                sprite->s, sprite->t, sprite->u, sprite->v, sprite->color);
+        }
+
+        i += run;
+    }
+}
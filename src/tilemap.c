@@ -0,0 +1,276 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+#include <stb_ds.h>
+#include "graphics.h"
+#include "log.h"
+#include "platform.h"
+
+//------------------------------------------------------------------------------
+
+#define CHUNK_SIZE                  32
+
+//------------------------------------------------------------------------------
+
+/**
+ * Square block of tiles drawn with a single vertex buffer. The buffer is
+ * only rebuilt when one of its tiles changes.
+ */
+struct chunk
+{
+    struct libqu_vertex_buffer buffer;
+    unsigned int alpha;
+    bool dirty;
+};
+
+struct libqu_tilemap
+{
+    struct libqu_texture *tileset;
+    qu_vec2i tile_size;
+    qu_vec2i size;
+    int tileset_cols;
+    int tileset_count;
+
+    int cols;
+    int rows;
+    struct chunk *chunks;
+    int *tiles;
+};
+
+static struct
+{
+    struct libqu_vertex *vertices;
+} priv;
+
+//------------------------------------------------------------------------------
+
+static bool is_tile_valid(struct libqu_tilemap const *tilemap, int tile)
+{
+    return tile >= 0 && tile < tilemap->tileset_count;
+}
+
+static qu_rectf get_tile_rect(struct libqu_tilemap const *tilemap, int tile)
+{
+    qu_rectf rect = {
+        (float) ((tile % tilemap->tileset_cols) * tilemap->tile_size.x),
+        (float) ((tile / tilemap->tileset_cols) * tilemap->tile_size.y),
+        (float) tilemap->tile_size.x,
+        (float) tilemap->tile_size.y,
+    };
+
+    return rect;
+}
+
+/**
+ * Texture coordinates are inset by half a stored texel, so that filtered
+ * or minified tiles don't pick up their neighbours in the tileset.
+ */
+static void append_tile(struct libqu_tilemap const *tilemap, int x, int y, int tile)
+{
+    qu_rectf sub = get_tile_rect(tilemap, tile);
+    qu_vec2i size = tilemap->tileset->full_size;
+
+    float hx = 0.5f / tilemap->tileset->size.x;
+    float hy = 0.5f / tilemap->tileset->size.y;
+
+    float s = sub.x / size.x + hx;
+    float t = sub.y / size.y + hy;
+    float u = (sub.x + sub.w) / size.x - hx;
+    float v = (sub.y + sub.h) / size.y - hy;
+
+    float ax = (float) (x * tilemap->tile_size.x);
+    float ay = (float) (y * tilemap->tile_size.y);
+    float bx = ax + sub.w;
+    float by = ay + sub.h;
+
+    struct libqu_vertex quad[] = {
+        { { ax, ay }, 0xFFFFFFFF, { s, t } },
+        { { bx, ay }, 0xFFFFFFFF, { u, t } },
+        { { bx, by }, 0xFFFFFFFF, { u, v } },
+        { { bx, by }, 0xFFFFFFFF, { u, v } },
+        { { ax, by }, 0xFFFFFFFF, { s, v } },
+        { { ax, ay }, 0xFFFFFFFF, { s, t } },
+    };
+
+    struct libqu_vertex *ptr = arraddnptr(priv.vertices, 6);
+    memcpy(ptr, quad, sizeof(quad));
+}
+
+static void rebuild_chunk(struct libqu_tilemap *tilemap, int col, int row)
+{
+    struct chunk *chunk = &tilemap->chunks[row * tilemap->cols + col];
+
+    int x0 = col * CHUNK_SIZE;
+    int y0 = row * CHUNK_SIZE;
+    int x1 = LIBQU_MIN(x0 + CHUNK_SIZE, tilemap->size.x);
+    int y1 = LIBQU_MIN(y0 + CHUNK_SIZE, tilemap->size.y);
+
+    arrsetlen(priv.vertices, 0);
+    chunk->alpha = 0;
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int tile = tilemap->tiles[y * tilemap->size.x + x];
+
+            if (!is_tile_valid(tilemap, tile)) {
+                continue;
+            }
+
+            qu_rectf sub = get_tile_rect(tilemap, tile);
+            chunk->alpha |= libqu_graphics_get_region_alpha(tilemap->tileset, sub);
+
+            append_tile(tilemap, x, y, tile);
+        }
+    }
+
+    chunk->buffer.mode = LIBQU_DRAW_MODE_TRIANGLES;
+
+    if (!libqu_graphics_update_vertex_buffer(&chunk->buffer,
+            priv.vertices, arrlenu(priv.vertices))) {
+        LIBQU_LOGE("Failed to update tilemap chunk (%d, %d).\n", col, row);
+        chunk->buffer.count = 0;
+    }
+
+    chunk->dirty = false;
+}
+
+//------------------------------------------------------------------------------
+
+struct libqu_tilemap *libqu_tilemap_create(struct libqu_texture *tileset,
+    qu_vec2i tile_size, qu_vec2i size)
+{
+    if (tile_size.x <= 0 || tile_size.y <= 0 || size.x <= 0 || size.y <= 0) {
+        return NULL;
+    }
+
+    // Chunks are drawn as vertex buffers with a single texture.
+    if (tileset->grid.cells) {
+        LIBQU_LOGE("Tileset is too large to be used as a single texture.\n");
+        return NULL;
+    }
+
+    int tileset_cols = tileset->full_size.x / tile_size.x;
+    int tileset_rows = tileset->full_size.y / tile_size.y;
+
+    if (tileset_cols == 0 || tileset_rows == 0) {
+        LIBQU_LOGE("Tileset is smaller than a single tile.\n");
+        return NULL;
+    }
+
+    struct libqu_tilemap *tilemap = pl_calloc(1, sizeof(*tilemap));
+
+    if (!tilemap) {
+        return NULL;
+    }
+
+    tilemap->tileset = tileset;
+    tilemap->tile_size = tile_size;
+    tilemap->size = size;
+    tilemap->tileset_cols = tileset_cols;
+    tilemap->tileset_count = tileset_cols * tileset_rows;
+
+    tilemap->cols = (size.x + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    tilemap->rows = (size.y + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    tilemap->chunks = pl_calloc(tilemap->cols * tilemap->rows, sizeof(*tilemap->chunks));
+    tilemap->tiles = pl_malloc(sizeof(*tilemap->tiles) * size.x * size.y);
+
+    if (!tilemap->chunks || !tilemap->tiles) {
+        pl_free(tilemap->chunks);
+        pl_free(tilemap->tiles);
+        pl_free(tilemap);
+        return NULL;
+    }
+
+    for (int i = 0; i < size.x * size.y; i++) {
+        tilemap->tiles[i] = -1;
+    }
+
+    return tilemap;
+}
+
+void libqu_tilemap_destroy(struct libqu_tilemap *tilemap)
+{
+    for (int i = 0; i < tilemap->cols * tilemap->rows; i++) {
+        libqu_graphics_destroy_vertex_buffer(&tilemap->chunks[i].buffer);
+    }
+
+    pl_free(tilemap->chunks);
+    pl_free(tilemap->tiles);
+    pl_free(tilemap);
+
+    arrfree(priv.vertices);
+}
+
+int libqu_tilemap_get_tile(struct libqu_tilemap *tilemap, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= tilemap->size.x || y >= tilemap->size.y) {
+        return -1;
+    }
+
+    return tilemap->tiles[y * tilemap->size.x + x];
+}
+
+void libqu_tilemap_set_tile(struct libqu_tilemap *tilemap, int x, int y, int tile)
+{
+    if (x < 0 || y < 0 || x >= tilemap->size.x || y >= tilemap->size.y) {
+        return;
+    }
+
+    int *dst = &tilemap->tiles[y * tilemap->size.x + x];
+
+    if (*dst == tile) {
+        return;
+    }
+
+    *dst = tile;
+    tilemap->chunks[(y / CHUNK_SIZE) * tilemap->cols + (x / CHUNK_SIZE)].dirty = true;
+}
+
+/**
+ * Only chunks overlapping the window are drawn, and only dirty ones among
+ * them are rebuilt, so the cost doesn't depend on the size of the map.
+ */
+void libqu_tilemap_draw(struct libqu_tilemap *tilemap, qu_vec2f pos)
+{
+    qu_rectf visible = libqu_graphics_get_visible_rect();
+
+    float chunk_w = (float) (CHUNK_SIZE * tilemap->tile_size.x);
+    float chunk_h = (float) (CHUNK_SIZE * tilemap->tile_size.y);
+
+    int col0 = LIBQU_MAX(0, (int) floorf((visible.x - pos.x) / chunk_w));
+    int row0 = LIBQU_MAX(0, (int) floorf((visible.y - pos.y) / chunk_h));
+    int col1 = LIBQU_MIN(tilemap->cols - 1, (int) floorf((visible.x + visible.w - pos.x) / chunk_w));
+    int row1 = LIBQU_MIN(tilemap->rows - 1, (int) floorf((visible.y + visible.h - pos.y) / chunk_h));
+
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            struct chunk *chunk = &tilemap->chunks[row * tilemap->cols + col];
+
+            if (chunk->dirty) {
+                rebuild_chunk(tilemap, col, row);
+            }
+
+            libqu_graphics_draw_vertex_buffer(&chunk->buffer,
+                tilemap->tileset, chunk->alpha, pos);
+        }
+    }
+}
@@ -0,0 +1,897 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stb_ds.h>
+#include "graphics.h"
+#include "log.h"
+#include "platform.h"
+
+//------------------------------------------------------------------------------
+// Virtual texture file layout (little-endian):
+//
+//   struct file_header
+//   struct file_entry[]        one per tile, level by level, rows first
+//   tile data                  any image format libqu can decode
+//
+// Level 0 is the full image, each next level is half the size of the
+// previous one. The last level fits in a single tile.
+
+#define FILE_MAGIC                  0x54565551 // "QUVT"
+#define FILE_VERSION                1
+
+#define MAX_LEVELS                  24
+#define MAX_POOL_SIZE               2048
+#define MAX_REQUESTS                64
+
+//------------------------------------------------------------------------------
+
+struct file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile_size;
+    uint32_t levels;
+};
+
+struct file_entry
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct level
+{
+    int cols;
+    int rows;
+    int first_tile;
+};
+
+/**
+ * Slot of the physical texture. Slots are one texel larger than a tile
+ * on every side, so that filtering doesn't pick up neighbouring slots.
+ */
+struct page
+{
+    int tile;
+    unsigned int last_use;
+};
+
+struct loaded_tile
+{
+    int tile;
+    struct libqu_image *image;
+};
+
+/**
+ * Background thread reading and decoding requested tiles. The request
+ * queue is replaced on every draw, so tiles that went out of view are
+ * never loaded.
+ */
+struct loader
+{
+    pl_thread *thread;
+    pl_mutex *mutex;
+    pl_cond *cond;
+    bool quit;
+
+    struct libqu_file *file;
+    struct file_entry *entries;
+
+    int *requests;
+    struct loaded_tile *loaded;
+};
+
+struct libqu_vtexture
+{
+    qu_vec2i size;
+    int tile_size;
+    int level_count;
+    struct level levels[MAX_LEVELS];
+    int tile_count;
+
+    struct libqu_texture *pool;
+    int pool_cols;
+    struct page *pages;
+    int page_count;
+    int *tile_pages;            // Page index for each tile, -1 if absent
+    bool *pending;              // Tile is queued or being loaded
+    unsigned int tick;
+
+    struct loader loader;
+};
+
+//------------------------------------------------------------------------------
+
+/**
+ * Size of a mip level. Rounded up, as libqu_image_downscale() does, so
+ * that edge texels of the full image are covered at every level.
+ */
+static int get_level_extent(int size, int level)
+{
+    return (size + (1 << level) - 1) >> level;
+}
+
+static int get_tile_index(struct libqu_vtexture const *vt, int level, int x, int y)
+{
+    return vt->levels[level].first_tile + y * vt->levels[level].cols + x;
+}
+
+static struct libqu_image *read_tile(struct libqu_file *file,
+    struct file_entry const *entry)
+{
+    void *data = pl_malloc((size_t) entry->size);
+
+    if (!data) {
+        return NULL;
+    }
+
+    struct libqu_image *image = NULL;
+
+    if (libqu_fseek(file, (int64_t) entry->offset, SEEK_SET) != -1
+        && libqu_fread(data, (size_t) entry->size, file) == (int64_t) entry->size) {
+        struct libqu_file *blob = libqu_fopen_buffer(data, (size_t) entry->size);
+
+        if (blob) {
+            image = libqu_image_load(blob);
+            libqu_fclose(blob);
+        }
+    }
+
+    pl_free(data);
+
+    return image;
+}
+
+//------------------------------------------------------------------------------
+
+static void *loader_main(void *arg)
+{
+    struct loader *loader = arg;
+
+    pl_lock_mutex(loader->mutex);
+
+    while (true) {
+        while (!loader->quit && arrlen(loader->requests) == 0) {
+            pl_wait_cond(loader->cond, loader->mutex);
+        }
+
+        if (loader->quit) {
+            break;
+        }
+
+        // Requests are ordered by priority.
+        int tile = loader->requests[0];
+        arrdel(loader->requests, 0);
+
+        pl_unlock_mutex(loader->mutex);
+
+        struct libqu_image *image = read_tile(loader->file, &loader->entries[tile]);
+
+        pl_lock_mutex(loader->mutex);
+
+        struct loaded_tile loaded = { tile, image };
+        arrput(loader->loaded, loaded);
+    }
+
+    pl_unlock_mutex(loader->mutex);
+
+    return NULL;
+}
+
+static bool start_loader(struct loader *loader)
+{
+    loader->mutex = pl_create_mutex();
+    loader->cond = pl_create_cond();
+
+    if (!loader->mutex || !loader->cond) {
+        return false;
+    }
+
+    loader->thread = pl_create_thread("libqu-vtexture", loader_main, loader);
+
+    return loader->thread != NULL;
+}
+
+static void stop_loader(struct loader *loader)
+{
+    if (loader->thread) {
+        pl_lock_mutex(loader->mutex);
+        loader->quit = true;
+        pl_signal_cond(loader->cond);
+        pl_unlock_mutex(loader->mutex);
+
+        pl_wait_thread(loader->thread);
+    }
+
+    for (int i = 0; i < arrlen(loader->loaded); i++) {
+        if (loader->loaded[i].image) {
+            libqu_image_destroy(loader->loaded[i].image);
+        }
+    }
+
+    arrfree(loader->requests);
+    arrfree(loader->loaded);
+
+    if (loader->cond) {
+        pl_destroy_cond(loader->cond);
+    }
+
+    if (loader->mutex) {
+        pl_destroy_mutex(loader->mutex);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+/**
+ * Picks a page for a new tile: a free one, or the least recently used
+ * one that isn't needed by the current draw and wasn't just filled by
+ * the tiles received for the next one. Returns -1 if there is none.
+ */
+static int find_page(struct libqu_vtexture *vt)
+{
+    int best = -1;
+
+    for (int i = 0; i < vt->page_count; i++) {
+        struct page const *page = &vt->pages[i];
+
+        if (page->tile == -1) {
+            return i;
+        }
+
+        if (page->last_use >= vt->tick) {
+            continue;
+        }
+
+        if (best == -1 || page->last_use < vt->pages[best].last_use) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+static qu_vec2i get_page_origin(struct libqu_vtexture const *vt, int page)
+{
+    int slot = vt->tile_size + 2;
+
+    qu_vec2i origin = {
+        (page % vt->pool_cols) * slot + 1,
+        (page / vt->pool_cols) * slot + 1,
+    };
+
+    return origin;
+}
+
+/**
+ * Copies a tile into a page, repeating its edges into the border.
+ */
+static bool store_tile(struct libqu_vtexture *vt, int tile,
+    struct libqu_image const *image, unsigned int last_use)
+{
+    if (image->format != vt->pool->format
+        || image->size.x > vt->tile_size || image->size.y > vt->tile_size) {
+        LIBQU_LOGW("Tile %d doesn't match the virtual texture.\n", tile);
+        return false;
+    }
+
+    int page = find_page(vt);
+
+    if (page == -1) {
+        return false;
+    }
+
+    int w = image->size.x;
+    int h = image->size.y;
+    int c = image->format == QU_PIXFMT_Y8 ? 1
+        : image->format == QU_PIXFMT_Y8A8 ? 2
+        : image->format == QU_PIXFMT_R8G8B8 ? 3 : 4;
+
+    qu_vec2i size = { w + 2, h + 2 };
+    struct libqu_image *bordered = libqu_image_create(image->format, size);
+
+    if (!bordered) {
+        return false;
+    }
+
+    for (int y = 0; y < size.y; y++) {
+        int sy = LIBQU_MIN(LIBQU_MAX(y - 1, 0), h - 1);
+
+        for (int x = 0; x < size.x; x++) {
+            int sx = LIBQU_MIN(LIBQU_MAX(x - 1, 0), w - 1);
+
+            memcpy(&bordered->pixels[(y * size.x + x) * c],
+                &image->pixels[(sy * w + sx) * c], c);
+        }
+    }
+
+    qu_vec2i origin = get_page_origin(vt, page);
+    origin.x -= 1;
+    origin.y -= 1;
+
+    libqu_graphics_write_texture(vt->pool, origin, bordered);
+    libqu_image_destroy(bordered);
+
+    if (vt->pages[page].tile != -1) {
+        vt->tile_pages[vt->pages[page].tile] = -1;
+    }
+
+    vt->pages[page].tile = tile;
+    vt->pages[page].last_use = last_use;
+    vt->tile_pages[tile] = page;
+
+    return true;
+}
+
+static void receive_tiles(struct libqu_vtexture *vt)
+{
+    struct loader *loader = &vt->loader;
+
+    pl_lock_mutex(loader->mutex);
+
+    struct loaded_tile *loaded = loader->loaded;
+    loader->loaded = NULL;
+
+    for (int i = 0; i < arrlen(loaded); i++) {
+        vt->pending[loaded[i].tile] = false;
+    }
+
+    pl_unlock_mutex(loader->mutex);
+
+    for (int i = 0; i < arrlen(loaded); i++) {
+        if (!loaded[i].image) {
+            LIBQU_LOGE("Failed to load virtual texture tile %d.\n", loaded[i].tile);
+            continue;
+        }
+
+        // Tiles count as used by the draw that follows, so that the rest
+        // of the batch doesn't evict them again.
+        if (vt->tile_pages[loaded[i].tile] == -1) {
+            store_tile(vt, loaded[i].tile, loaded[i].image, vt->tick + 1);
+        }
+
+        libqu_image_destroy(loaded[i].image);
+    }
+
+    arrfree(loaded);
+}
+
+static void send_requests(struct libqu_vtexture *vt, int const *tiles)
+{
+    struct loader *loader = &vt->loader;
+
+    pl_lock_mutex(loader->mutex);
+
+    for (int i = 0; i < arrlen(loader->requests); i++) {
+        vt->pending[loader->requests[i]] = false;
+    }
+
+    arrsetlen(loader->requests, 0);
+
+    for (int i = 0; i < arrlen(tiles) && i < MAX_REQUESTS; i++) {
+        if (!vt->pending[tiles[i]]) {
+            vt->pending[tiles[i]] = true;
+            arrput(loader->requests, tiles[i]);
+        }
+    }
+
+    if (arrlen(loader->requests) > 0) {
+        pl_signal_cond(loader->cond);
+    }
+
+    pl_unlock_mutex(loader->mutex);
+}
+
+//------------------------------------------------------------------------------
+
+static bool read_header(struct libqu_vtexture *vt, struct libqu_file *file)
+{
+    struct file_header header;
+
+    if (libqu_fread(&header, sizeof(header), file) != sizeof(header)
+        || header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+        LIBQU_LOGE("Not a virtual texture file.\n");
+        return false;
+    }
+
+    if (header.width == 0 || header.height == 0 || header.tile_size == 0
+        || header.levels == 0 || header.levels > MAX_LEVELS) {
+        LIBQU_LOGE("Invalid virtual texture header.\n");
+        return false;
+    }
+
+    vt->size.x = (int) header.width;
+    vt->size.y = (int) header.height;
+    vt->tile_size = (int) header.tile_size;
+    vt->level_count = (int) header.levels;
+
+    for (int i = 0; i < vt->level_count; i++) {
+        int w = get_level_extent(vt->size.x, i);
+        int h = get_level_extent(vt->size.y, i);
+
+        vt->levels[i].cols = (w + vt->tile_size - 1) / vt->tile_size;
+        vt->levels[i].rows = (h + vt->tile_size - 1) / vt->tile_size;
+        vt->levels[i].first_tile = vt->tile_count;
+
+        vt->tile_count += vt->levels[i].cols * vt->levels[i].rows;
+    }
+
+    return true;
+}
+
+static bool create_pool(struct libqu_vtexture *vt, qu_pixel_format format)
+{
+    int max_size = libqu_graphics_get_max_texture_size();
+    int pool_size = (max_size > 0) ? LIBQU_MIN(max_size, MAX_POOL_SIZE) : MAX_POOL_SIZE;
+
+    // Coarsest level is pinned and at least one more page is needed.
+    struct level const *last = &vt->levels[vt->level_count - 1];
+
+    vt->pool_cols = pool_size / (vt->tile_size + 2);
+    vt->page_count = vt->pool_cols * vt->pool_cols;
+
+    if (vt->page_count < last->cols * last->rows + 1) {
+        LIBQU_LOGE("Virtual texture tiles are too large.\n");
+        return false;
+    }
+
+    qu_vec2i size = { pool_size, pool_size };
+    vt->pool = libqu_graphics_create_texture(format, size);
+
+    if (!vt->pool) {
+        return false;
+    }
+
+    vt->pages = pl_calloc(vt->page_count, sizeof(*vt->pages));
+
+    if (!vt->pages) {
+        return false;
+    }
+
+    for (int i = 0; i < vt->page_count; i++) {
+        vt->pages[i].tile = -1;
+    }
+
+    return true;
+}
+
+/**
+ * Loads the coarsest level right away, so that there is always something
+ * to draw. Its pages are never replaced.
+ */
+static bool load_last_level(struct libqu_vtexture *vt)
+{
+    int last = vt->level_count - 1;
+
+    for (int y = 0; y < vt->levels[last].rows; y++) {
+        for (int x = 0; x < vt->levels[last].cols; x++) {
+            int tile = get_tile_index(vt, last, x, y);
+            struct libqu_image *image =
+                read_tile(vt->loader.file, &vt->loader.entries[tile]);
+
+            if (!image) {
+                LIBQU_LOGE("Failed to load virtual texture tile %d.\n", tile);
+                return false;
+            }
+
+            bool stored = (vt->pool || create_pool(vt, image->format))
+                && store_tile(vt, tile, image, UINT32_MAX);
+
+            libqu_image_destroy(image);
+
+            if (!stored) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+struct libqu_vtexture *libqu_vtexture_load(struct libqu_file *file)
+{
+    struct libqu_vtexture *vt = pl_calloc(1, sizeof(*vt));
+
+    if (!vt) {
+        libqu_fclose(file);
+        return NULL;
+    }
+
+    vt->loader.file = file;
+
+    if (!read_header(vt, file)) {
+        libqu_vtexture_destroy(vt);
+        return NULL;
+    }
+
+    size_t entries_size = sizeof(struct file_entry) * vt->tile_count;
+
+    vt->loader.entries = pl_malloc(entries_size);
+    vt->tile_pages = pl_malloc(sizeof(int) * vt->tile_count);
+    vt->pending = pl_calloc(vt->tile_count, sizeof(bool));
+
+    if (!vt->loader.entries || !vt->tile_pages || !vt->pending
+        || libqu_fread(vt->loader.entries, entries_size, file) != (int64_t) entries_size) {
+        libqu_vtexture_destroy(vt);
+        return NULL;
+    }
+
+    for (int i = 0; i < vt->tile_count; i++) {
+        vt->tile_pages[i] = -1;
+    }
+
+    if (!load_last_level(vt) || !start_loader(&vt->loader)) {
+        libqu_vtexture_destroy(vt);
+        return NULL;
+    }
+
+    LIBQU_LOGI("Loaded %dx%d virtual texture, %d levels, %d pages.\n",
+        vt->size.x, vt->size.y, vt->level_count, vt->page_count);
+
+    return vt;
+}
+
+void libqu_vtexture_destroy(struct libqu_vtexture *vt)
+{
+    stop_loader(&vt->loader);
+
+    if (vt->pool) {
+        libqu_graphics_destroy_texture(vt->pool);
+    }
+
+    if (vt->loader.file) {
+        libqu_fclose(vt->loader.file);
+    }
+
+    pl_free(vt->loader.entries);
+    pl_free(vt->tile_pages);
+    pl_free(vt->pending);
+    pl_free(vt->pages);
+    pl_free(vt);
+}
+
+qu_vec2i libqu_vtexture_get_size(struct libqu_vtexture *vt)
+{
+    return vt->size;
+}
+
+//------------------------------------------------------------------------------
+
+static void add_request(int **requests, int tile)
+{
+    for (int i = 0; i < arrlen(*requests); i++) {
+        if ((*requests)[i] == tile) {
+            return;
+        }
+    }
+
+    arrput(*requests, tile);
+}
+
+/**
+ * Draws the `sub` region (in texels of the full image) into `rect`. Level
+ * of detail is chosen from the scale; each visible tile of that level is
+ * drawn from the finest level available, and missing tiles are requested
+ * coarsest first.
+ */
+void libqu_vtexture_draw(struct libqu_vtexture *vt, qu_rectf rect, qu_rectf sub)
+{
+    if (rect.w == 0.f || rect.h == 0.f || sub.w == 0.f || sub.h == 0.f) {
+        return;
+    }
+
+    receive_tiles(vt);
+    vt->tick++;
+
+    float scale = LIBQU_MAX(fabsf(sub.w / rect.w), fabsf(sub.h / rect.h))
+        / libqu_graphics_get_transform_scale();
+    int level = (scale > 1.f) ? (int) floorf(log2f(scale)) : 0;
+    level = LIBQU_MIN(level, vt->level_count - 1);
+
+    // Visible part of the region, in texels of the full image.
+    qu_rectf visible = libqu_graphics_get_visible_rect();
+
+    float kx = sub.w / rect.w;
+    float ky = sub.h / rect.h;
+
+    float x0 = sub.x + (LIBQU_MAX(LIBQU_MIN(rect.x, rect.x + rect.w), visible.x) - rect.x) * kx;
+    float x1 = sub.x + (LIBQU_MIN(LIBQU_MAX(rect.x, rect.x + rect.w), visible.x + visible.w) - rect.x) * kx;
+    float y0 = sub.y + (LIBQU_MAX(LIBQU_MIN(rect.y, rect.y + rect.h), visible.y) - rect.y) * ky;
+    float y1 = sub.y + (LIBQU_MIN(LIBQU_MAX(rect.y, rect.y + rect.h), visible.y + visible.h) - rect.y) * ky;
+
+    float l = LIBQU_MAX(LIBQU_MIN(x0, x1), 0.f);
+    float r = LIBQU_MIN(LIBQU_MAX(x0, x1), (float) vt->size.x);
+    float t = LIBQU_MAX(LIBQU_MIN(y0, y1), 0.f);
+    float b = LIBQU_MIN(LIBQU_MAX(y0, y1), (float) vt->size.y);
+
+    if (l >= r || t >= b) {
+        return;
+    }
+
+    int span = vt->tile_size << level;
+
+    int col0 = (int) (l / span);
+    int row0 = (int) (t / span);
+    int col1 = LIBQU_MIN((int) ((r - 1.f) / span), vt->levels[level].cols - 1);
+    int row1 = LIBQU_MIN((int) ((b - 1.f) / span), vt->levels[level].rows - 1);
+
+    int *requests = NULL;
+
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            // Finest level that has this area loaded.
+            int found = level;
+            int page = -1;
+
+            for (; found < vt->level_count; found++) {
+                int shift = found - level;
+                page = vt->tile_pages[get_tile_index(vt, found, col >> shift, row >> shift)];
+
+                if (page != -1) {
+                    break;
+                }
+            }
+
+            for (int i = found - 1; i >= level; i--) {
+                int shift = i - level;
+                add_request(&requests, get_tile_index(vt, i, col >> shift, row >> shift));
+            }
+
+            if (page == -1) {
+                continue;
+            }
+
+            if (vt->pages[page].last_use != UINT32_MAX) {
+                vt->pages[page].last_use = vt->tick;
+            }
+
+            // Part of this tile that is visible, in texels of the full image.
+            float tl = LIBQU_MAX(l, (float) (col * span));
+            float tr = LIBQU_MIN(r, (float) ((col + 1) * span));
+            float tt = LIBQU_MAX(t, (float) (row * span));
+            float tb = LIBQU_MIN(b, (float) ((row + 1) * span));
+
+            // Same area in texels of the level it's drawn from.
+            int shift = found - level;
+            float k = 1.f / (float) (1 << found);
+            qu_vec2i origin = get_page_origin(vt, page);
+
+            qu_rectf pool_sub = {
+                origin.x + tl * k - (float) ((col >> shift) * vt->tile_size),
+                origin.y + tt * k - (float) ((row >> shift) * vt->tile_size),
+                (tr - tl) * k,
+                (tb - tt) * k,
+            };
+
+            qu_rectf screen = {
+                rect.x + (tl - sub.x) / kx,
+                rect.y + (tt - sub.y) / ky,
+                (tr - tl) / kx,
+                (tb - tt) / ky,
+            };
+
+            libqu_graphics_draw_subtexture(vt->pool, screen, pool_sub);
+        }
+    }
+
+    send_requests(vt, requests);
+    arrfree(requests);
+}
+
+//------------------------------------------------------------------------------
+
+static bool write_u8(FILE *file, unsigned char const *data, size_t size)
+{
+    return fwrite(data, size, 1, file) == 1;
+}
+
+/**
+ * Writes a region of the image as an uncompressed TGA blob. Two-channel
+ * images are expanded to RGBA, as TGA has no such format.
+ */
+static bool write_tga(FILE *file, struct libqu_image const *image,
+    int x0, int y0, int w, int h)
+{
+    int c = image->format == QU_PIXFMT_Y8 ? 1
+        : image->format == QU_PIXFMT_Y8A8 ? 2
+        : image->format == QU_PIXFMT_R8G8B8 ? 3 : 4;
+
+    int bpp = (c == 1) ? 8 : (c == 3) ? 24 : 32;
+
+    unsigned char header[18] = { 0 };
+    header[2] = (c == 1) ? 3 : 2;
+    header[12] = (unsigned char) (w & 0xFF);
+    header[13] = (unsigned char) (w >> 8);
+    header[14] = (unsigned char) (h & 0xFF);
+    header[15] = (unsigned char) (h >> 8);
+    header[16] = (unsigned char) bpp;
+    header[17] = (unsigned char) (0x20 | ((bpp == 32) ? 8 : 0));
+
+    if (!write_u8(file, header, sizeof(header))) {
+        return false;
+    }
+
+    unsigned char *row = pl_malloc(w * 4);
+
+    if (!row) {
+        return false;
+    }
+
+    bool success = true;
+
+    for (int y = 0; success && y < h; y++) {
+        unsigned char const *src = &image->pixels[((y0 + y) * image->size.x + x0) * c];
+        unsigned char *dst = row;
+
+        for (int x = 0; x < w; x++, src += c) {
+            switch (c) {
+            case 1:
+                *dst++ = src[0];
+                break;
+            case 2:
+                *dst++ = src[0];
+                *dst++ = src[0];
+                *dst++ = src[0];
+                *dst++ = src[1];
+                break;
+            case 3:
+                *dst++ = src[2];
+                *dst++ = src[1];
+                *dst++ = src[0];
+                break;
+            default:
+                *dst++ = src[2];
+                *dst++ = src[1];
+                *dst++ = src[0];
+                *dst++ = src[3];
+                break;
+            }
+        }
+
+        success = write_u8(file, row, dst - row);
+    }
+
+    pl_free(row);
+
+    return success;
+}
+
+/**
+ * Builds the mip pyramid of the image and writes it as a virtual texture
+ * file. Meant for offline use: the whole image is kept in memory.
+ */
+bool libqu_vtexture_save(struct libqu_image const *image, char const *path,
+    int tile_size)
+{
+    if (tile_size <= 0 || tile_size > 65535) {
+        return false;
+    }
+
+    struct libqu_vtexture layout = { .tile_size = tile_size };
+    int levels = 1;
+
+    while ((get_level_extent(image->size.x, levels - 1) > tile_size
+        || get_level_extent(image->size.y, levels - 1) > tile_size)
+        && levels < MAX_LEVELS) {
+        levels++;
+    }
+
+    struct file_header header = {
+        .magic = FILE_MAGIC,
+        .version = FILE_VERSION,
+        .width = (uint32_t) image->size.x,
+        .height = (uint32_t) image->size.y,
+        .tile_size = (uint32_t) tile_size,
+        .levels = (uint32_t) levels,
+    };
+
+    layout.size = image->size;
+    layout.level_count = levels;
+
+    for (int i = 0; i < levels; i++) {
+        int w = get_level_extent(image->size.x, i);
+        int h = get_level_extent(image->size.y, i);
+
+        layout.levels[i].cols = (w + tile_size - 1) / tile_size;
+        layout.levels[i].rows = (h + tile_size - 1) / tile_size;
+        layout.levels[i].first_tile = layout.tile_count;
+
+        layout.tile_count += layout.levels[i].cols * layout.levels[i].rows;
+    }
+
+    struct file_entry *entries = pl_calloc(layout.tile_count, sizeof(*entries));
+    FILE *file = fopen(path, "wb");
+
+    if (!entries || !file) {
+        pl_free(entries);
+
+        if (file) {
+            fclose(file);
+        }
+
+        return false;
+    }
+
+    // Entries are written again once offsets are known.
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(entries, sizeof(*entries), layout.tile_count, file) == (size_t) layout.tile_count;
+
+    struct libqu_image const *current = image;
+    struct libqu_image *scaled = NULL;
+
+    for (int i = 0; success && i < levels; i++) {
+        if (i > 0) {
+            struct libqu_image *next = libqu_image_downscale(current, 1);
+
+            if (scaled) {
+                libqu_image_destroy(scaled);
+            }
+
+            scaled = next;
+            current = next;
+
+            if (!current) {
+                success = false;
+                break;
+            }
+        }
+
+        for (int row = 0; success && row < layout.levels[i].rows; row++) {
+            for (int col = 0; success && col < layout.levels[i].cols; col++) {
+                int x = col * tile_size;
+                int y = row * tile_size;
+                int w = LIBQU_MIN(tile_size, current->size.x - x);
+                int h = LIBQU_MIN(tile_size, current->size.y - y);
+
+                struct file_entry *entry = &entries[get_tile_index(&layout, i, col, row)];
+                long start = ftell(file);
+
+                success = write_tga(file, current, x, y, w, h);
+
+                entry->offset = (uint64_t) start;
+                entry->size = (uint64_t) (ftell(file) - start);
+            }
+        }
+    }
+
+    if (scaled) {
+        libqu_image_destroy(scaled);
+    }
+
+    if (success) {
+        success = fseek(file, sizeof(header), SEEK_SET) == 0
+            && fwrite(entries, sizeof(*entries), layout.tile_count, file) == (size_t) layout.tile_count;
+    }
+
+    success = (fclose(file) == 0) && success;
+    pl_free(entries);
+
+    if (!success) {
+        LIBQU_LOGE("Failed to write virtual texture to %s.\n", path);
+        remove(path);
+    }
+
+    return success;
+}
@@ -0,0 +1,127 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+// Compares the vectorized point transform of the library against its
+// plain C version. Built together with src/algebra.c, since these
+// functions aren't part of the public API.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libquack.h>
+#include "algebra.h"
+
+//------------------------------------------------------------------------------
+
+#define POINT_COUNT     4096
+#define ITERATIONS      2000
+#define RUNS            9
+
+//------------------------------------------------------------------------------
+
+typedef void (*transform_fn)(affine_t const *, qu_vec2f *, qu_vec2f const *, size_t);
+
+static qu_vec2f src[POINT_COUNT];
+static qu_vec2f dst[POINT_COUNT];
+
+// Results are stored here, so that the compiler can't drop the work.
+static volatile float sink;
+
+/**
+ * Transforms the whole array in batches of `batch` points, the way
+ * scene sprites transform their four corners at a time.
+ */
+static double bench_transform(transform_fn fn, affine_t const *mat, size_t batch)
+{
+    uint64_t start = qu_get_ticks_nsec();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        for (size_t j = 0; j < POINT_COUNT; j += batch) {
+            fn(mat, &dst[j], &src[j], batch);
+        }
+
+        sink = dst[i].x;
+    }
+
+    uint64_t elapsed = qu_get_ticks_nsec() - start;
+    return (double) POINT_COUNT * ITERATIONS / (double) elapsed;
+}
+
+static int compare_doubles(void const *a, void const *b)
+{
+    double x = *(double const *) a;
+    double y = *(double const *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Single runs vary a lot with CPU frequency and other load, so both
+ * versions are run in turns and the median of each is reported.
+ */
+static void report_transform(affine_t const *mat, size_t batch)
+{
+    double scalar[RUNS];
+    double vector[RUNS];
+
+    for (int i = 0; i < RUNS; i++) {
+        scalar[i] = bench_transform(affine_transform_points_scalar, mat, batch);
+        vector[i] = bench_transform(affine_transform_points, mat, batch);
+    }
+
+    qsort(scalar, RUNS, sizeof(double), compare_doubles);
+    qsort(vector, RUNS, sizeof(double), compare_doubles);
+
+    printf("affine_transform_points, %4d per call: %.3f points/ns (scalar: %.3f, x%.2f)\n",
+           (int) batch, vector[RUNS / 2], scalar[RUNS / 2],
+           vector[RUNS / 2] / scalar[RUNS / 2]);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    for (int i = 0; i < POINT_COUNT; i++) {
+        src[i].x = (float) (rand() % 2048) - 1024.f;
+        src[i].y = (float) (rand() % 2048) - 1024.f;
+    }
+
+    affine_t mat;
+    affine_identity(&mat);
+    affine_translate(&mat, 320.f, 240.f);
+    affine_rotate(&mat, 0.5f);
+    affine_scale(&mat, 2.f, 0.5f);
+
+    // Results must match exactly, both paths do the same operations.
+    qu_vec2f check[POINT_COUNT];
+    affine_transform_points_scalar(&mat, check, src, POINT_COUNT);
+    affine_transform_points(&mat, dst, src, POINT_COUNT);
+
+    for (int i = 0; i < POINT_COUNT; i++) {
+        if (check[i].x != dst[i].x || check[i].y != dst[i].y) {
+            printf("Mismatch at point %d.\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    report_transform(&mat, POINT_COUNT);
+    report_transform(&mat, 4);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+// Compares load time of the PNG test assets against the same images
+// stored as QOI. Files are read into memory first, so only decoding is
+// measured. QOI copies are written to a scratch file, which is removed
+// afterwards.
+//
+// QOI isn't a win on every asset. These are small and compress well,
+// so PNG files are smaller for sky, mountains-bg and trees-fg, and
+// trees-bg decodes as fast or faster from PNG.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libquack.h>
+
+//------------------------------------------------------------------------------
+
+#define ITERATIONS      200
+#define QOI_PATH        "image-bench.qoi"
+
+//------------------------------------------------------------------------------
+
+static char const *const assets[] = {
+    "assets/textures/sky.png",
+    "assets/textures/mountains-bg.png",
+    "assets/textures/mountains-fg.png",
+    "assets/textures/trees-bg.png",
+    "assets/textures/trees-fg.png",
+};
+
+static void *read_file(char const *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    *size = (size_t) ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    void *data = malloc(*size);
+
+    if (data && fread(data, *size, 1, file) != 1) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+
+    return data;
+}
+
+static double bench_load(void *data, size_t size)
+{
+    uint64_t start = qu_get_ticks_nsec();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        qu_destroy_image(qu_load_image_from_buffer(data, size));
+    }
+
+    return (double) (qu_get_ticks_nsec() - start) / ITERATIONS / 1000.0;
+}
+
+static bool is_image_equal(qu_image a, qu_image b)
+{
+    qu_vec2i size = qu_get_image_size(a);
+    qu_vec2i other = qu_get_image_size(b);
+
+    if (size.x != other.x || size.y != other.y
+        || qu_get_image_format(a) != qu_get_image_format(b)) {
+        return false;
+    }
+
+    size_t bytes = (size_t) size.x * size.y * qu_get_image_format(a);
+    return memcmp(qu_get_image_pixels(a), qu_get_image_pixels(b), bytes) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int failures = 0;
+
+    printf("%-34s %10s %10s %10s %10s\n",
+        "asset", "png bytes", "png us", "qoi bytes", "qoi us");
+
+    for (size_t i = 0; i < sizeof(assets) / sizeof(assets[0]); i++) {
+        size_t png_size = 0;
+        void *png = read_file(assets[i], &png_size);
+        qu_image image = png ? qu_load_image_from_buffer(png, png_size) : (qu_image) { 0 };
+
+        // Image is converted to RGB(A) by the encoder, compare with that.
+        if (!image.id || !qu_save_image_qoi(image, QOI_PATH)) {
+            printf("%-34s failed to load or save\n", assets[i]);
+            free(png);
+            failures++;
+            continue;
+        }
+
+        size_t qoi_size = 0;
+        void *qoi = read_file(QOI_PATH, &qoi_size);
+        qu_image decoded = qoi ? qu_load_image_from_buffer(qoi, qoi_size) : (qu_image) { 0 };
+        qu_pixel_format format = qu_get_image_format(image);
+
+        if (format == QU_PIXFMT_Y8 || format == QU_PIXFMT_Y8A8) {
+            qu_image converted = qu_convert_image(image, (format == QU_PIXFMT_Y8)
+                ? QU_PIXFMT_R8G8B8 : QU_PIXFMT_R8G8B8A8);
+            qu_destroy_image(image);
+            image = converted;
+        }
+
+        if (!decoded.id || !is_image_equal(image, decoded)) {
+            printf("%-34s QOI round trip mismatch\n", assets[i]);
+            failures++;
+        } else {
+            printf("%-34s %10zu %10.1f %10zu %10.1f\n", assets[i],
+                png_size, bench_load(png, png_size),
+                qoi_size, bench_load(qoi, qoi_size));
+        }
+
+        qu_destroy_image(decoded);
+        qu_destroy_image(image);
+        free(qoi);
+        free(png);
+    }
+
+    remove(QOI_PATH);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
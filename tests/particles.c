@@ -0,0 +1,111 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <libquack.h>
+
+//------------------------------------------------------------------------------
+
+#define MAX_PARTICLES       100000
+#define BURST_SIZE          20000
+
+//------------------------------------------------------------------------------
+
+static qu_emitter emitter;
+
+//------------------------------------------------------------------------------
+
+static float random_float(float min, float max)
+{
+    return min + (max - min) * (rand() / (float) RAND_MAX);
+}
+
+static void burst(float x, float y)
+{
+    for (int i = 0; i < BURST_SIZE; i++) {
+        float angle = random_float(0.f, 6.2831853f);
+        float speed = random_float(20.f, 300.f);
+
+        qu_particle particle = {
+            .position = { x, y },
+            .velocity = { cosf(angle) * speed, sinf(angle) * speed },
+            .size = random_float(2.f, 4.f),
+            .lifetime = random_float(0.5f, 3.f),
+            .start_color = 0xFFC832FF,
+            .end_color = 0xFF000000,
+        };
+
+        qu_emit_particle(emitter, &particle);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    qu_set_window_title("[libquack] particles");
+    qu_set_window_size(720, 480);
+
+    qu_initialize();
+    atexit(qu_terminate);
+
+    // Pass "--gpu" to simulate particles with transform feedback.
+    if (argc > 1 && strcmp(argv[1], "--gpu") == 0) {
+        emitter = qu_create_gpu_emitter((qu_texture) { 0 }, MAX_PARTICLES);
+    } else {
+        emitter = qu_create_emitter((qu_texture) { 0 }, MAX_PARTICLES);
+    }
+    qu_set_emitter_gravity(emitter, 0.f, 100.f);
+
+    double then = qu_get_time_highp();
+    double next_burst = then;
+    double next_report = then + 1.0;
+
+    while (qu_process()) {
+        double now = qu_get_time_highp();
+
+        if (now >= next_burst) {
+            burst(random_float(160.f, 560.f), random_float(120.f, 360.f));
+            next_burst = now + 0.25;
+        }
+
+        qu_update_emitter(emitter, (float) (now - then));
+
+        qu_clear(0x000000FF);
+        qu_draw_emitter(emitter);
+        qu_present();
+
+        if (now >= next_report) {
+            qu_emitter_stats stats = qu_get_emitter_stats(emitter);
+
+            printf("%d particles, update: %.3f ms, submit: %.3f ms\n",
+                stats.count, stats.update_time * 1000.0,
+                stats.submit_time * 1000.0);
+
+            next_report = now + 1.0;
+        }
+
+        then = now;
+    }
+
+    return 0;
+}
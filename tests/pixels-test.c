@@ -0,0 +1,212 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+// Checks vectorized pixel kernels of the library against their plain C
+// versions. Built together with src/pixels.c, since these functions
+// aren't part of the public API.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libquack.h>
+#include "pixels.h"
+
+//------------------------------------------------------------------------------
+
+#define MAX_PIXELS      300
+
+//------------------------------------------------------------------------------
+
+static unsigned char input[MAX_PIXELS * 4];
+static unsigned char backdrop[MAX_PIXELS * 4];
+static unsigned char expected[MAX_PIXELS * 4];
+static unsigned char actual[MAX_PIXELS * 4];
+
+static int failures;
+
+static void fill_random(unsigned char *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        // Edge values are more likely, they are where rounding breaks.
+        switch (rand() % 8) {
+        case 0:
+            data[i] = 0;
+            break;
+        case 1:
+            data[i] = 255;
+            break;
+        default:
+            data[i] = (unsigned char) (rand() & 255);
+            break;
+        }
+    }
+}
+
+static void check(char const *what, size_t count, size_t size)
+{
+    if (memcmp(expected, actual, size) != 0) {
+        printf("FAIL: %s, %d pixels\n", what, (int) count);
+        failures++;
+    }
+}
+
+static void test_convert(size_t count)
+{
+    for (int from = QU_PIXFMT_Y8; from <= QU_PIXFMT_R8G8B8A8; from++) {
+        for (int to = QU_PIXFMT_Y8; to <= QU_PIXFMT_R8G8B8A8; to++) {
+            char what[64];
+            sprintf(what, "convert %d to %d", from, to);
+
+            pixels_convert_scalar(expected, to, input, from, count);
+            pixels_convert(actual, to, input, from, count);
+            check(what, count, count * to);
+        }
+    }
+
+    // Gray survives a round trip through RGB.
+    pixels_convert(actual, QU_PIXFMT_R8G8B8A8, input, QU_PIXFMT_Y8A8, count);
+    pixels_convert(expected, QU_PIXFMT_Y8A8, actual, QU_PIXFMT_R8G8B8A8, count);
+    memcpy(actual, input, count * 2);
+    check("gray round trip", count, count * 2);
+}
+
+static void test_premultiply(size_t count)
+{
+    for (int format = QU_PIXFMT_Y8; format <= QU_PIXFMT_R8G8B8A8; format++) {
+        char what[64];
+        sprintf(what, "premultiply %d", format);
+
+        memcpy(expected, input, count * format);
+        memcpy(actual, input, count * format);
+
+        pixels_premultiply_scalar(expected, format, count);
+        pixels_premultiply(actual, format, count);
+        check(what, count, count * format);
+    }
+
+    // Opaque pixels don't change either way.
+    for (size_t i = 0; i < count; i++) {
+        expected[i * 4 + 0] = input[i * 4 + 0];
+        expected[i * 4 + 1] = input[i * 4 + 1];
+        expected[i * 4 + 2] = input[i * 4 + 2];
+        expected[i * 4 + 3] = 255;
+    }
+
+    memcpy(actual, expected, count * 4);
+    pixels_premultiply(actual, QU_PIXFMT_R8G8B8A8, count);
+    pixels_unpremultiply(actual, QU_PIXFMT_R8G8B8A8, count);
+    check("opaque premultiply", count, count * 4);
+}
+
+static void test_swap(size_t count)
+{
+    size_t size = count * 3;
+
+    memcpy(expected, input, size);
+    memcpy(actual, input, size);
+
+    unsigned char a[MAX_PIXELS * 3], b[MAX_PIXELS * 3];
+
+    memcpy(a, backdrop, size);
+    memcpy(b, backdrop, size);
+
+    pixels_swap_scalar(expected, a, size);
+    pixels_swap(actual, b, size);
+    check("swap", count, size);
+
+    memcpy(expected, a, size);
+    memcpy(actual, b, size);
+    check("swap back", count, size);
+}
+
+static void test_blend(size_t count)
+{
+    qu_blend_mode const modes[] = {
+        QU_BLEND_MODE_NONE,
+        QU_BLEND_MODE_ALPHA,
+        QU_BLEND_MODE_ADD,
+        QU_BLEND_MODE_MUL,
+        QU_DEFINE_BLEND_MODE(QU_BLEND_ONE_MINUS_DST_COLOR, QU_BLEND_DST_ALPHA),
+        {
+            QU_BLEND_ONE, QU_BLEND_ONE, QU_BLEND_SUB,
+            QU_BLEND_ONE, QU_BLEND_ONE, QU_BLEND_REV_SUB,
+        },
+    };
+
+    for (size_t i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+        char what[64];
+        sprintf(what, "blend mode %d", (int) i);
+
+        memcpy(expected, backdrop, count * 4);
+        memcpy(actual, backdrop, count * 4);
+
+        pixels_blend_scalar(expected, input, count, &modes[i]);
+        pixels_blend(actual, input, count, &modes[i]);
+        check(what, count, count * 4);
+    }
+
+    // Opaque source replaces the destination in alpha mode.
+    for (size_t i = 0; i < count; i++) {
+        memcpy(&expected[i * 4], &input[i * 4], 3);
+        expected[i * 4 + 3] = 255;
+    }
+
+    memcpy(actual, backdrop, count * 4);
+
+    for (size_t i = 0; i < count; i++) {
+        actual[i * 4 + 3] = 255;
+    }
+
+    pixels_blend(actual, expected, count, &modes[1]);
+    check("opaque alpha blend", count, count * 4);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    srand(1);
+
+    for (int round = 0; round < 20; round++) {
+        fill_random(input, sizeof(input));
+        fill_random(backdrop, sizeof(backdrop));
+
+        // Every length up to a few vectors, to cover leftover pixels.
+        for (size_t count = 0; count <= 70; count++) {
+            test_convert(count);
+            test_premultiply(count);
+            test_swap(count);
+            test_blend(count);
+        }
+
+        test_convert(MAX_PIXELS);
+        test_premultiply(MAX_PIXELS);
+        test_swap(MAX_PIXELS);
+        test_blend(MAX_PIXELS);
+    }
+
+    if (failures > 0) {
+        printf("%d checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("All checks passed.\n");
+    return EXIT_SUCCESS;
+}
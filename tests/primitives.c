@@ -19,6 +19,7 @@
 //------------------------------------------------------------------------------
 
 #include <math.h>
+#include <stdio.h>
 #include <libquack.h>
 
 //------------------------------------------------------------------------------
@@ -148,6 +149,31 @@ static void test_rectangles(void)
 
 //------------------------------------------------------------------------------
 
+/**
+ * The frame presented right after the render scale changes must already
+ * be drawn at the new scale, so it shouldn't be captured as black.
+ */
+static void check_capture(float scale)
+{
+    qu_image image = qu_capture_screen();
+    qu_vec2i size = qu_get_image_size(image);
+    unsigned char *pixels = qu_get_image_pixels(image);
+
+    int lit = 0;
+
+    for (int i = 0; i < size.x * size.y * 3; i++) {
+        if (pixels[i]) {
+            lit++;
+        }
+    }
+
+    printf("render scale %.2f: %s\n", scale, lit ? "ok" : "captured black frame");
+
+    qu_destroy_image(image);
+}
+
+//------------------------------------------------------------------------------
+
 int main(int argc, char *argv[])
 {
     qu_set_window_title("[libquack] primitives: points");
@@ -157,8 +183,21 @@ int main(int argc, char *argv[])
     atexit(qu_terminate);
 
     int mode = 0;
+    float scale = 1.f;
+    bool scale_key = false;
+    bool scale_changed = false;
 
     while (qu_process()) {
+        if (qu_is_key_pressed(QU_KEY_R) && !scale_key) {
+            scale = (scale == 1.f) ? 0.5f : 1.f;
+            qu_set_render_scale(scale, false);
+            scale_key = true;
+            scale_changed = true;
+        } else if (qu_is_key_released(QU_KEY_R)) {
+            scale_key = false;
+        }
+
+
         if (qu_is_key_pressed(QU_KEY_1)) {
             if (mode != 0) {
                 qu_set_window_title("[libquack] primitives: points");
@@ -199,6 +238,11 @@ int main(int argc, char *argv[])
             qu_present();
             break;
         }
+
+        if (scale_changed) {
+            check_capture(scale);
+            scale_changed = false;
+        }
     }
 
     return 0;
@@ -58,7 +58,7 @@ static void load_textures(void)
         "assets/textures/trees-fg.png",
     };
 
-    qu_set_default_texture_flags(0);
+    qu_set_default_texture_flags(QU_TEXTURE_TRIM);
 
     for (int i = 0; i < TOTAL_TEXTURES; i++) {
         textures[i] = qu_load_texture_from_file(paths[i]);
@@ -73,7 +73,7 @@ static void update(double dt)
     if (qu_is_key_pressed(QU_KEY_S) && !smooth_key) {
         smooth_flag = !smooth_flag;
 
-        unsigned int f = (smooth_flag ? QU_TEXTURE_SMOOTH : 0);
+        unsigned int f = QU_TEXTURE_TRIM | (smooth_flag ? QU_TEXTURE_SMOOTH : 0);
 
         for (int i = 0; i < TOTAL_TEXTURES; i++) {
             qu_set_texture_flags(textures[i], f);
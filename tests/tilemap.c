@@ -0,0 +1,147 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2021-2024 tuorqai
+// 
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// 
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <libquack.h>
+
+//------------------------------------------------------------------------------
+
+#define TILE_SIZE           16
+#define TILESET_COLS        4
+#define TILESET_ROWS        4
+#define MAP_SIZE            1000
+
+//------------------------------------------------------------------------------
+
+static qu_texture tileset;
+static qu_tilemap tilemap;
+
+static float x_camera;
+static float y_camera;
+
+//------------------------------------------------------------------------------
+
+/**
+ * Generates a tileset of flat-colored tiles with a darker border.
+ */
+static qu_texture create_tileset(void)
+{
+    int w = TILE_SIZE * TILESET_COLS;
+    int h = TILE_SIZE * TILESET_ROWS;
+
+    qu_image image = qu_create_image(w, h, QU_PIXFMT_R8G8B8A8);
+    unsigned char *pixels = qu_get_image_pixels(image);
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int tile = (y / TILE_SIZE) * TILESET_COLS + (x / TILE_SIZE);
+            int tx = x % TILE_SIZE;
+            int ty = y % TILE_SIZE;
+            bool border = tx == 0 || ty == 0;
+
+            unsigned char *p = &pixels[4 * (y * w + x)];
+
+            p[0] = (unsigned char) (64 + (tile % 4) * 48 - (border ? 32 : 0));
+            p[1] = (unsigned char) (64 + (tile / 4) * 48 - (border ? 32 : 0));
+            p[2] = (unsigned char) (96 - (border ? 32 : 0));
+            p[3] = 255;
+        }
+    }
+
+    return qu_load_texture_from_image(image);
+}
+
+static void fill_tilemap(void)
+{
+    for (int y = 0; y < MAP_SIZE; y++) {
+        for (int x = 0; x < MAP_SIZE; x++) {
+            int tile = (int) (8.f + 4.f * sinf(x * 0.05f) + 4.f * cosf(y * 0.07f));
+            qu_set_tile(tilemap, x, y, tile % (TILESET_COLS * TILESET_ROWS));
+        }
+    }
+}
+
+static void update(double dt)
+{
+    float speed = 400.f * (float) dt;
+
+    if (qu_is_key_pressed(QU_KEY_LEFT)) {
+        x_camera -= speed;
+    }
+
+    if (qu_is_key_pressed(QU_KEY_RIGHT)) {
+        x_camera += speed;
+    }
+
+    if (qu_is_key_pressed(QU_KEY_UP)) {
+        y_camera -= speed;
+    }
+
+    if (qu_is_key_pressed(QU_KEY_DOWN)) {
+        y_camera += speed;
+    }
+
+    // Changed tiles only rebuild their own chunk.
+    if (qu_is_key_pressed(QU_KEY_SPACE)) {
+        int x = (int) ((x_camera + 360.f) / TILE_SIZE);
+        int y = (int) ((y_camera + 240.f) / TILE_SIZE);
+
+        qu_set_tile(tilemap, x, y, -1);
+    }
+}
+
+static void draw(void)
+{
+    qu_clear(0x202020FF);
+    qu_draw_tilemap(tilemap, -x_camera, -y_camera);
+    qu_present();
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    qu_set_window_title("[libquack] tilemap");
+    qu_set_window_size(720, 480);
+
+    qu_initialize();
+    atexit(qu_terminate);
+
+    tileset = create_tileset();
+    tilemap = qu_create_tilemap(tileset, TILE_SIZE, TILE_SIZE, MAP_SIZE, MAP_SIZE);
+
+    printf("tileset -> %d, tilemap -> %d\n", tileset.id, tilemap.id);
+
+    fill_tilemap();
+
+    double then = qu_get_time_highp();
+
+    while (qu_process()) {
+        double now = qu_get_time_highp();
+
+        update(now - then);
+        draw();
+
+        then = now;
+    }
+
+    return 0;
+}